@@ -0,0 +1,219 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file backendprobe.cpp
+ *
+ * @brief This file contains the definition of methods of the BackendProbe class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "backendprobe.h"
+#include "cpufeatures.h"
+#include <openssl/crypto.h>
+#include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QMutex>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logBackendProbe, "Probe")
+/// number of bytes encrypted with every backend, in bytes.
+static qint64 const kProbeLength = 4 * 1024 * 1024;
+/// version of the probe, a new version measures again.
+static int const kProbeVersion = 1;
+/// names of the methods in the log and in the About dialog, in the order of CryptFileDevice::EncryptionMethod.
+static const char *const kMethodNames[] = { "XOR", "AES", "AES-GCM", "ChaCha20" };
+
+/// results of the last BackendProbe::select.
+static QList<BackendProbe::Result> s_results;
+static QMutex s_resultsMutex;
+
+/**
+ * @brief BackendProbe::measure
+ *
+ * Measures every backend of every supported method.
+ *
+ * @param length of the type qint64, number of bytes encrypted with every backend
+ * @return the throughput of the backends
+ */
+QList<BackendProbe::Result> BackendProbe::measure( qint64 length )
+{
+    QList<Result> results;
+    for ( int m = CryptFileDevice::XorCipher; m <= CryptFileDevice::ChaCha20Cipher; m++ )
+    {
+        for ( int b = CryptFileDevice::PortableBackend; b <= CryptFileDevice::EvpBackend; b++ )
+        {
+            const CryptFileDevice::EncryptionMethod method = static_cast<CryptFileDevice::EncryptionMethod>( m );
+            const CryptFileDevice::Backend backend = static_cast<CryptFileDevice::Backend>( b );
+            if ( !CryptFileDevice::isBackendSupported( method, backend ) )
+            {
+                continue;
+            }
+            Result result;
+            result.method = method;
+            result.backend = backend;
+            result.megabytesPerSec = CryptFileDevice::benchmark( method, backend, length );
+            results.append( result );
+        }
+    }
+
+    return results;
+}
+
+/**
+ * @brief BackendProbe::select
+ *
+ * Takes the measurements from QSettings, if they were made on this machine, or measures the backends
+ * and saves the results. The fastest backend of every method is selected with CryptFileDevice::setBackend.
+ */
+void BackendProbe::select( void )
+{
+    const QString signature = BackendProbe::signature();
+    QList<Result> results;
+
+    QSettings settings;
+    settings.beginGroup( "BackendProbe" );
+    if ( settings.value( "signature" ).toString() == signature )
+    {
+        // "<method> <backend> <MB/s>"
+        foreach ( const QString &entry, settings.value( "results" ).toStringList() )
+        {
+            const QStringList fields = entry.split( QLatin1Char( ' ' ) );
+            bool okMethod = false;
+            bool okBackend = false;
+            bool okRate = false;
+            Result result;
+            result.method = static_cast<CryptFileDevice::EncryptionMethod>( fields.value( 0 ).toInt( &okMethod ) );
+            result.backend = static_cast<CryptFileDevice::Backend>( fields.value( 1 ).toInt( &okBackend ) );
+            result.megabytesPerSec = fields.value( 2 ).toDouble( &okRate );
+            if ( fields.size() == 3 && okMethod && okBackend && okRate
+                 && CryptFileDevice::isBackendSupported( result.method, result.backend ) )
+            {
+                results.append( result );
+            }
+        }
+    }
+
+    if ( results.isEmpty() )
+    {
+        QElapsedTimer timer;
+        timer.start();
+        results = BackendProbe::measure( kProbeLength );
+        qInfo(logBackendProbe) << QObject::tr( "Measured the cipher backends in %1 ms" ).arg( timer.elapsed() );
+
+        QStringList entries;
+        foreach ( const Result &result, results )
+        {
+            entries.append( QString( "%1 %2 %3" ).arg( result.method ).arg( result.backend ).arg( result.megabytesPerSec, 0, 'f', 1 ) );
+        }
+        settings.setValue( "signature", signature );
+        settings.setValue( "results", entries );
+    }
+    settings.endGroup();
+
+    for ( int m = CryptFileDevice::XorCipher; m <= CryptFileDevice::ChaCha20Cipher; m++ )
+    {
+        const Result *best = nullptr;
+        for ( int i = 0; i < results.size(); i++ )
+        {
+            if ( results.at( i ).method == m && ( best == nullptr || results.at( i ).megabytesPerSec > best->megabytesPerSec ) )
+            {
+                best = &results.at( i );
+            }
+        }
+        if ( best != nullptr )
+        {
+            CryptFileDevice::setBackend( best->method, best->backend );
+        }
+    }
+
+    {
+        QMutexLocker locker( &s_resultsMutex );
+        s_results = results;
+    }
+    foreach ( const QString &line, BackendProbe::summary() )
+    {
+        qInfo(logBackendProbe) << line;
+    }
+}
+
+/**
+ * @brief get-function for the results of the last BackendProbe::select
+ * @return the throughput of the backends, empty before the probe
+ */
+QList<BackendProbe::Result> BackendProbe::results( void )
+{
+    QMutexLocker locker( &s_resultsMutex );
+    return s_results;
+}
+
+/**
+ * @brief BackendProbe::summary
+ *
+ * Describes the processor and the backend of every method, one line each, e.g.
+ * "AES: evp 2450.3 MB/s (selected), portable 181.0 MB/s".
+ *
+ * @return lines of plain text
+ */
+QStringList BackendProbe::summary( void )
+{
+    QStringList lines;
+    lines.append( QObject::tr( "Processor: %1" ).arg( CpuFeatures::processorName() ) );
+    lines.append( QObject::tr( "Features: %1" ).arg( CpuFeatures::names( CpuFeatures::detect() ) ) );
+
+    const QList<Result> results = BackendProbe::results();
+    for ( int m = CryptFileDevice::XorCipher; m <= CryptFileDevice::ChaCha20Cipher; m++ )
+    {
+        const CryptFileDevice::EncryptionMethod method = static_cast<CryptFileDevice::EncryptionMethod>( m );
+        QStringList backends;
+        foreach ( const Result &result, results )
+        {
+            if ( result.method != method )
+            {
+                continue;
+            }
+            QString text = QObject::tr( "%1 %2 MB/s" ).arg( CryptFileDevice::backendName( result.backend ) )
+                                                      .arg( result.megabytesPerSec, 0, 'f', 1 );
+            if ( result.backend == CryptFileDevice::backend( method ) )
+            {
+                text += QObject::tr( " (selected)" );
+            }
+            backends.append( text );
+        }
+        if ( !backends.isEmpty() )
+        {
+            lines.append( QString( "%1: %2" ).arg( QLatin1String( kMethodNames[m] ) ).arg( backends.join( QStringLiteral( ", " ) ) ) );
+        }
+    }
+
+    return lines;
+}
+
+/**
+ * @brief BackendProbe::signature
+ * @return identifier of the machine, the measurements of which are valid for the other
+ */
+QString BackendProbe::signature( void )
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    const char *openssl = OpenSSL_version( OPENSSL_VERSION );
+#else
+    const char *openssl = SSLeay_version( SSLEAY_VERSION );
+#endif
+    return QString( "%1|%2|%3|%4" ).arg( kProbeVersion )
+                                   .arg( CpuFeatures::processorName() )
+                                   .arg( static_cast<int>( CpuFeatures::detect() ), 0, 16 )
+                                   .arg( QLatin1String( openssl ) );
+}
@@ -0,0 +1,67 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file backendprobe.h
+ *
+ * @brief This file contains the declaration of the class BackendProbe
+ */
+#ifndef BACKENDPROBE_H
+#define BACKENDPROBE_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "cryptfiledevice.h"
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @class BackendProbe
+ *
+ * @brief The BackendProbe class selects the fastest backend of every encryption method at startup.
+ *
+ * The probe encrypts a few MiB in memory with every backend, which a method supports
+ * (CryptFileDevice::benchmark), and selects the fastest one with CryptFileDevice::setBackend.
+ * The measurements are saved in QSettings together with a signature of the machine
+ * (processor, its features (CpuFeatures) and the OpenSSL version); at the next start with the same
+ * signature they are reused, so the probe costs nothing. The choice and the throughput
+ * are written to the log and shown in the About dialog (BackendProbe::summary).
+ *
+ * @code
+ * BackendProbe::select();
+ * qInfo() << BackendProbe::summary();
+ * @endcode
+ *
+ * @note All functions in this class are thread-safe, BackendProbe::select is called once at startup.
+ */
+class BackendProbe
+{
+public:
+    /// Throughput of one backend of a method.
+    struct Result
+    {
+        CryptFileDevice::EncryptionMethod method;
+        CryptFileDevice::Backend backend;
+        double megabytesPerSec;
+    };
+
+    static QList<Result> measure( qint64 length );
+    static void select( void );
+    static QList<Result> results( void );
+    static QStringList summary( void );
+    static QString signature( void );
+};
+
+#endif // BACKENDPROBE_H
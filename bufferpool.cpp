@@ -0,0 +1,379 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file bufferpool.cpp
+ *
+ * @brief This file contains the definition of methods of the BufferPool and PooledBuffer classes.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "bufferpool.h"
+#include <QMutexLocker>
+#include <QLoggingCategory>
+#include <QObject>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logBufferPool, "Pool")
+/// number of size classes, the largest class is kMinClassSize * 2^(kClassCount - 1).
+static int const kClassCount = 16;
+
+qint64 const BufferPool::kMinClassSize;
+size_t const BufferPool::kAlignment;
+
+/**
+ * @brief The constructor of a null handle.
+ */
+PooledBuffer::PooledBuffer( void ) :
+    m_pool( nullptr ),
+    m_data( nullptr ),
+    m_sizeClass( -1 ),
+    m_recycled( false )
+{
+}
+
+/**
+ * @brief The constructor of a handle, used by BufferPool::acquire.
+ */
+PooledBuffer::PooledBuffer( BufferPool *pool, char *data, int sizeClass, bool recycled ) :
+    m_pool( pool ),
+    m_data( data ),
+    m_sizeClass( sizeClass ),
+    m_recycled( recycled )
+{
+}
+
+/**
+ * @brief The move constructor, the other handle becomes null.
+ * @param other of the type PooledBuffer&&
+ */
+PooledBuffer::PooledBuffer( PooledBuffer &&other ) :
+    m_pool( other.m_pool ),
+    m_data( other.m_data ),
+    m_sizeClass( other.m_sizeClass ),
+    m_recycled( other.m_recycled )
+{
+    other.m_pool = nullptr;
+    other.m_data = nullptr;
+    other.m_sizeClass = -1;
+}
+
+/**
+ * @brief The move assignment, the own buffer is returned to the pool.
+ * @param other of the type PooledBuffer&&
+ * @return reference to this handle
+ */
+PooledBuffer &PooledBuffer::operator=( PooledBuffer &&other )
+{
+    if ( this != &other )
+    {
+        this->release();
+        qSwap( m_pool, other.m_pool );
+        qSwap( m_data, other.m_data );
+        qSwap( m_sizeClass, other.m_sizeClass );
+        qSwap( m_recycled, other.m_recycled );
+    }
+    return *this;
+}
+
+/**
+ * @brief The destructor returns the buffer to the pool.
+ */
+PooledBuffer::~PooledBuffer( void )
+{
+    this->release();
+}
+
+/**
+ * @brief PooledBuffer::data
+ * @return pointer to the buffer, aligned to BufferPool::kAlignment, or nullptr for a null handle.
+ */
+char *PooledBuffer::data( void ) const
+{
+    return m_data;
+}
+
+/**
+ * @brief PooledBuffer::capacity
+ * @return the size of the buffer (size of its class), in bytes. At least the requested size.
+ */
+qint64 PooledBuffer::capacity( void ) const
+{
+    return ( m_data != nullptr ) ? BufferPool::classSize( m_sizeClass ) : 0;
+}
+
+/**
+ * @brief PooledBuffer::isNull
+ *
+ * @retval true if the handle has no buffer;
+ * @retval false otherwise.
+ */
+bool PooledBuffer::isNull( void ) const
+{
+    return m_data == nullptr;
+}
+
+/**
+ * @brief PooledBuffer::isRecycled
+ *
+ * @retval true if the buffer has been used before (no heap allocation was needed);
+ * @retval false if it has been allocated for this request.
+ */
+bool PooledBuffer::isRecycled( void ) const
+{
+    return m_recycled;
+}
+
+/**
+ * @brief PooledBuffer::release
+ *
+ * Returns the buffer to the pool before the handle is destroyed. The handle becomes null.
+ */
+void PooledBuffer::release( void )
+{
+    if ( m_pool != nullptr && m_data != nullptr )
+    {
+        m_pool->release( m_data, m_sizeClass );
+    }
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_sizeClass = -1;
+}
+
+/**
+ * @brief The constructor of the class BufferPool
+ * @param capacity of the type qint64, the upper limit of the memory of the pool, in bytes
+ */
+BufferPool::BufferPool( qint64 capacity ) :
+    m_capacity( capacity ),
+    m_idle( kClassCount )
+{
+}
+
+/**
+ * @brief The destructor frees the idle buffers.
+ *
+ * @warning All buffers must have been returned before the pool is destroyed.
+ */
+BufferPool::~BufferPool( void )
+{
+    Q_ASSERT_X( m_stats.bytesInUse == 0, Q_FUNC_INFO, "Buffers in use at the destruction of the pool" );
+    this->trim();
+}
+
+/**
+ * @brief BufferPool::instance
+ * @return the process-wide pool shared by MainWindow and CryptFileDevice.
+ */
+BufferPool &BufferPool::instance( void )
+{
+    static BufferPool pool;
+    return pool;
+}
+
+/**
+ * @brief BufferPool::defaultCapacity
+ * @return the default capacity, 4 Gb on 64-bit systems and 1 Gb on 32-bit systems.
+ */
+qint64 BufferPool::defaultCapacity( void )
+{
+    return ( sizeof( void * ) > 4 ) ? Q_INT64_C( 4 ) << 30 : Q_INT64_C( 1 ) << 30;
+}
+
+/**
+ * @brief BufferPool::acquire
+ *
+ * Provides a buffer of at least size bytes. An idle buffer of the matching class
+ * is reused, otherwise a new buffer is allocated.
+ *
+ * @param size of the type qint64, the required size, in bytes
+ * @return the handle of the buffer, or a null handle if the capacity is exhausted
+ * or the allocation failed.
+ */
+PooledBuffer BufferPool::acquire( qint64 size )
+{
+    const int sc = sizeClass( size );
+    QMutexLocker locker( &m_mutex );
+    if ( sc < 0 )
+    {
+        m_stats.failures++;
+        return PooledBuffer();
+    }
+
+    const qint64 bytes = classSize( sc );
+    QVector<char *> &idle = m_idle[sc];
+    if ( !idle.isEmpty() )
+    {
+        char *data = idle.takeLast();
+        m_stats.acquires++;
+        m_stats.hits++;
+        m_stats.bytesIdle -= bytes;
+        m_stats.bytesInUse += bytes;
+        return PooledBuffer( this, data, sc, true );
+    }
+
+    const qint64 excess = m_stats.bytesInUse + m_stats.bytesIdle + bytes - m_capacity;
+    if ( excess > 0 && !this->evict( excess, bytes ) )
+    {
+        m_stats.failures++;
+        qWarning(logBufferPool) << QObject::tr( "Capacity of %1 Kb exhausted, request of %2 Kb refused" )
+                                   .arg( m_capacity / 1024 ).arg( bytes / 1024 );
+        return PooledBuffer();
+    }
+
+    char *data = static_cast<char *>( qMallocAligned( static_cast<size_t>( bytes ), kAlignment ) );
+    if ( data == nullptr )
+    {
+        // give the idle memory back to the system and try once more
+        this->evict( m_stats.bytesIdle, bytes );
+        data = static_cast<char *>( qMallocAligned( static_cast<size_t>( bytes ), kAlignment ) );
+        if ( data == nullptr )
+        {
+            m_stats.failures++;
+            qWarning(logBufferPool) << QObject::tr( "Allocation of %1 Kb failed" ).arg( bytes / 1024 );
+            return PooledBuffer();
+        }
+    }
+
+    m_stats.acquires++;
+    m_stats.misses++;
+    m_stats.bytesInUse += bytes;
+    m_stats.bytesPeak = qMax( m_stats.bytesPeak, m_stats.bytesInUse + m_stats.bytesIdle );
+    return PooledBuffer( this, data, sc, false );
+}
+
+/**
+ * @brief BufferPool::trim
+ *
+ * Frees all idle buffers, e.g. at the end of a job.
+ */
+void BufferPool::trim( void )
+{
+    QMutexLocker locker( &m_mutex );
+    this->evict( m_stats.bytesIdle, 0 );
+}
+
+/**
+ * @brief get-function for the capacity
+ * @return the upper limit of the memory of the pool, in bytes
+ */
+qint64 BufferPool::capacity( void ) const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_capacity;
+}
+
+/**
+ * @brief set-function for the capacity
+ *
+ * Idle buffers above the new capacity are freed, buffers in use are not affected.
+ *
+ * @param capacity of the type qint64, in bytes
+ */
+void BufferPool::setCapacity( qint64 capacity )
+{
+    QMutexLocker locker( &m_mutex );
+    m_capacity = capacity;
+    const qint64 excess = m_stats.bytesInUse + m_stats.bytesIdle - m_capacity;
+    if ( excess > 0 )
+    {
+        this->evict( excess, 0 );
+    }
+}
+
+/**
+ * @brief BufferPool::statistics
+ * @return a copy of the counters of the pool.
+ */
+BufferPoolStatistics BufferPool::statistics( void ) const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_stats;
+}
+
+/**
+ * @brief The function takes a buffer back, used by PooledBuffer.
+ *
+ * The buffer is kept for the next request of its class.
+ *
+ * @param data of the type char*, the buffer
+ * @param sizeClass of the type int, the class of the buffer
+ */
+void BufferPool::release( char *data, int sizeClass )
+{
+    const qint64 bytes = classSize( sizeClass );
+    QMutexLocker locker( &m_mutex );
+    m_stats.bytesInUse -= bytes;
+    if ( m_stats.bytesInUse + m_stats.bytesIdle + bytes > m_capacity )
+    {
+        // the capacity has been reduced in the meantime
+        qFreeAligned( data );
+        m_stats.evictions++;
+        return;
+    }
+    m_idle[sizeClass].append( data );
+    m_stats.bytesIdle += bytes;
+}
+
+/**
+ * @brief The function frees idle buffers, the largest ones first.
+ *
+ * @note The mutex must be locked by the caller.
+ *
+ * @param bytes of the type qint64, the number of bytes to free
+ * @param request of the type qint64, the size of the pending request, in bytes, or 0
+ * @retval true if the pool has room for the request within the capacity;
+ * @retval false otherwise.
+ */
+bool BufferPool::evict( qint64 bytes, qint64 request )
+{
+    qint64 freed = 0;
+    for ( int sc = kClassCount - 1; sc >= 0 && freed < bytes; sc-- )
+    {
+        QVector<char *> &idle = m_idle[sc];
+        while ( !idle.isEmpty() && freed < bytes )
+        {
+            qFreeAligned( idle.takeLast() );
+            freed += classSize( sc );
+            m_stats.bytesIdle -= classSize( sc );
+            m_stats.evictions++;
+        }
+    }
+    return m_stats.bytesInUse + m_stats.bytesIdle + request <= m_capacity;
+}
+
+/**
+ * @brief The function returns the smallest size class which fits a size.
+ * @param size of the type qint64, in bytes
+ * @return the size class, or -1 if the size is larger than the largest class.
+ */
+int BufferPool::sizeClass( qint64 size )
+{
+    int sc = 0;
+    while ( sc < kClassCount && classSize( sc ) < size )
+    {
+        sc++;
+    }
+    return ( sc < kClassCount ) ? sc : -1;
+}
+
+/**
+ * @brief The function returns the size of the buffers of a class.
+ * @param sizeClass of the type int
+ * @return the size, in bytes
+ */
+qint64 BufferPool::classSize( int sizeClass )
+{
+    return kMinClassSize << sizeClass;
+}
@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file bufferpool.h
+ *
+ * @brief This file contains the declaration of the classes BufferPool and PooledBuffer
+ */
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QtGlobal>
+#include <QMutex>
+#include <QVector>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+class BufferPool;
+
+/**
+ * @struct BufferPoolStatistics
+ *
+ * @brief The BufferPoolStatistics structure contains the counters of a BufferPool.
+ */
+struct BufferPoolStatistics
+{
+    //! Number of successful calls of BufferPool::acquire().
+    quint64 acquires = 0;
+    //! Number of acquires served by a recycled buffer.
+    quint64 hits = 0;
+    //! Number of acquires, which allocated a new buffer on the heap.
+    quint64 misses = 0;
+    //! Number of acquires refused because of the capacity or a failed allocation.
+    quint64 failures = 0;
+    //! Number of idle buffers freed to stay within the capacity or by BufferPool::trim().
+    quint64 evictions = 0;
+    //! Bytes of the buffers handed out and not yet returned.
+    qint64 bytesInUse = 0;
+    //! Bytes of the idle buffers kept by the pool.
+    qint64 bytesIdle = 0;
+    //! Highest value of bytesInUse + bytesIdle.
+    qint64 bytesPeak = 0;
+};
+
+/**
+ * @class PooledBuffer
+ *
+ * @brief The PooledBuffer class is a handle of a buffer of a BufferPool.
+ *
+ * The buffer is returned to its pool when the handle is destroyed or released.
+ * The handle can be moved, but not copied. A null handle means that the pool
+ * could not provide a buffer.
+ */
+class PooledBuffer
+{
+public:
+    PooledBuffer( void );
+    PooledBuffer( PooledBuffer &&other );
+    PooledBuffer &operator=( PooledBuffer &&other );
+    ~PooledBuffer( void );
+
+    char *data( void ) const;
+    qint64 capacity( void ) const;
+    bool isNull( void ) const;
+    bool isRecycled( void ) const;
+
+    void release( void );
+
+private:
+    Q_DISABLE_COPY(PooledBuffer)
+    friend class BufferPool;
+    PooledBuffer( BufferPool *pool, char *data, int sizeClass, bool recycled );
+
+    BufferPool *m_pool;
+    char *m_data;
+    int m_sizeClass;
+    bool m_recycled;
+};
+
+/**
+ * @class BufferPool
+ *
+ * @brief The BufferPool class provides reusable, page aligned buffers for the data path.
+ *
+ * The buffers are grouped in size classes (powers of two, starting with kMinClassSize),
+ * a request is served by the smallest class which fits. Returned buffers are kept
+ * and handed out again, so that a job which processes chunks of the same size
+ * allocates its buffers once and then runs without heap allocations.
+ *
+ * The memory of the pool (buffers in use and idle buffers) never exceeds the capacity:
+ * idle buffers of other classes are freed first, if that is not enough, the request fails.
+ * The pool is thread-safe; MainWindow and CryptFileDevice share BufferPool::instance().
+ *
+ * @code
+ * PooledBuffer buffer = BufferPool::instance().acquire( size );
+ * if ( buffer.isNull() )
+ * {
+ *     // out of memory
+ * }
+ * qint64 read = file.read( buffer.data(), size );
+ * @endcode
+ */
+class BufferPool
+{
+public:
+    explicit BufferPool( qint64 capacity = defaultCapacity() );
+    ~BufferPool( void );
+
+    static BufferPool &instance( void );
+    static qint64 defaultCapacity( void );
+
+    PooledBuffer acquire( qint64 size );
+    void trim( void );
+
+    qint64 capacity( void ) const;
+    void setCapacity( qint64 capacity );
+
+    BufferPoolStatistics statistics( void ) const;
+
+    /// smallest size class, in bytes.
+    static qint64 const kMinClassSize = 64 * 1024;
+    /// alignment of the buffers (page size), in bytes.
+    static size_t const kAlignment = 4096;
+
+private:
+    Q_DISABLE_COPY(BufferPool)
+    friend class PooledBuffer;
+
+    void release( char *data, int sizeClass );
+    bool evict( qint64 bytes, qint64 request );
+
+    static int sizeClass( qint64 size );
+    static qint64 classSize( int sizeClass );
+
+    mutable QMutex m_mutex;
+    qint64 m_capacity;
+    QVector< QVector<char *> > m_idle;
+    BufferPoolStatistics m_stats;
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,218 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file buffertuner.cpp
+ *
+ * @brief This file contains the definition of methods of the BufferTuner class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "buffertuner.h"
+#include <QLoggingCategory>
+#include <QStorageInfo>
+#include <QFileInfo>
+#include <QSettings>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logBufferTuner, "Tuner")
+/// smallest chunk size, in bytes.
+static qint64 const kMinChunk = 256 * 1024;
+/// chunk size of the first job on a storage device, in bytes.
+static qint64 const kDefaultChunk = 4 * 1024 * 1024;
+/// number of full chunks measured for each probed size.
+static int const kWindowSamples = 3;
+/// relative gain of the throughput, which is required to accept a probed size.
+static double const kMinGain = 0.05;
+
+/**
+ * @brief The constructor of the class BufferTuner
+ *
+ * The starting size is the winner of the previous job on the same storage device.
+ *
+ * @param storageKey of the type QString &, the identifier of the storage device, see BufferTuner::storageKey
+ * @param budget of the type qint64, the memory budget (upper limit of the chunk size), in bytes
+ */
+BufferTuner::BufferTuner( const QString &storageKey, qint64 budget ) :
+    m_key( storageKey ),
+    m_budget( qMax( budget, kMinChunk ) ),
+    m_bestRate( 0.0 ),
+    m_direction( 1 ),
+    m_flipped( false ),
+    m_improved( false ),
+    m_converged( false ),
+    m_windowBytes( 0 ),
+    m_windowNsecs( 0 ),
+    m_windowSamples( 0 )
+{
+    QSettings settings;
+    settings.beginGroup( "BufferTuner" );
+    const QString key = QString::fromLatin1( m_key.toUtf8().toBase64( QByteArray::Base64UrlEncoding ) );
+    m_size = this->bounded( settings.value( key, kDefaultChunk ).toLongLong() );
+    settings.endGroup();
+    m_bestSize = m_size;
+}
+
+/**
+ * @brief BufferTuner::storageKey
+ *
+ * @param path of the type QString &, path to a file
+ * @return the identifier of the storage device of the file.
+ */
+QString BufferTuner::storageKey( const QString &path )
+{
+    QStorageInfo storage( QFileInfo( path ).absolutePath() );
+    const QString device = QString::fromLocal8Bit( storage.device() );
+    return device.isEmpty() ? storage.rootPath() : device;
+}
+
+/**
+ * @brief get-function for the chunk size to use for the next chunk
+ *
+ * @return the chunk size, in bytes
+ */
+qint64 BufferTuner::chunkSize( void ) const
+{
+    return m_size;
+}
+
+/**
+ * @brief BufferTuner::isConverged
+ *
+ * @retval true if the tuner has found the best chunk size,
+ * @retval false if it is still probing.
+ */
+bool BufferTuner::isConverged( void ) const
+{
+    return m_converged;
+}
+
+/**
+ * @brief BufferTuner::addSample
+ *
+ * Adds the measurement of one chunk. Only full chunks of the current size are taken
+ * into account, the tail of a file and small files are ignored.
+ *
+ * @param bytes of the type qint64, number of bytes processed
+ * @param nsecs of the type qint64, time of the read, encryption and write of the chunk, in ns
+ */
+void BufferTuner::addSample( qint64 bytes, qint64 nsecs )
+{
+    if ( m_converged || bytes < m_size || nsecs <= 0 )
+    {
+        return;
+    }
+
+    m_windowBytes += bytes;
+    m_windowNsecs += nsecs;
+    if ( ++m_windowSamples < kWindowSamples )
+    {
+        return;
+    }
+
+    const double rate = static_cast<double>( m_windowBytes ) / m_windowNsecs;
+    m_windowBytes = 0;
+    m_windowNsecs = 0;
+    m_windowSamples = 0;
+
+    if ( m_bestRate <= 0.0 || rate > m_bestRate * ( 1.0 + kMinGain ) )
+    {
+        m_improved = m_improved || ( m_bestRate > 0.0 );
+        m_bestRate = rate;
+        m_bestSize = m_size;
+    }
+    else if ( !m_improved && !m_flipped )
+    {
+        // the first step made it worse, try the other direction
+        m_flipped = true;
+        m_direction = -m_direction;
+    }
+    else
+    {
+        m_converged = true;
+        m_size = m_bestSize;
+        qInfo(logBufferTuner) << QObject::tr( "Buffer size for %1: %2 Kb" ).arg( m_key ).arg( m_size / 1024 );
+        return;
+    }
+
+    this->nextStep();
+}
+
+/**
+ * @brief BufferTuner::allocationFailed
+ *
+ * Reacts on a failed allocation of a chunk: halves the chunk size and the memory budget
+ * and stops probing larger sizes.
+ */
+void BufferTuner::allocationFailed( void )
+{
+    m_budget = qMax( m_size / 2, kMinChunk );
+    m_size = this->bounded( m_size / 2 );
+    m_bestSize = qMin( m_bestSize, m_size );
+    m_converged = true;
+    qWarning(logBufferTuner) << QObject::tr( "Allocation failed, buffer size reduced to %1 Kb" ).arg( m_size / 1024 );
+}
+
+/**
+ * @brief BufferTuner::save
+ *
+ * Saves the best chunk size found for the storage device in QSettings.
+ */
+void BufferTuner::save( void ) const
+{
+    if ( m_bestRate <= 0.0 )
+    {
+        return;
+    }
+
+    QSettings settings;
+    settings.beginGroup( "BufferTuner" );
+    const QString key = QString::fromLatin1( m_key.toUtf8().toBase64( QByteArray::Base64UrlEncoding ) );
+    settings.setValue( key, m_bestSize );
+    settings.endGroup();
+}
+
+/**
+ * @brief The function selects the next size to probe, starting from the best size.
+ *
+ * If the limit of the range is reached, the direction is reversed once;
+ * if no other size is left, the tuner has converged.
+ */
+void BufferTuner::nextStep( void )
+{
+    qint64 next = this->bounded( m_direction > 0 ? m_bestSize * 2 : m_bestSize / 2 );
+    if ( next == m_bestSize && !m_improved && !m_flipped )
+    {
+        m_flipped = true;
+        m_direction = -m_direction;
+        next = this->bounded( m_direction > 0 ? m_bestSize * 2 : m_bestSize / 2 );
+    }
+    if ( next == m_bestSize )
+    {
+        m_converged = true;
+        qInfo(logBufferTuner) << QObject::tr( "Buffer size for %1: %2 Kb" ).arg( m_key ).arg( m_bestSize / 1024 );
+    }
+    m_size = next;
+}
+
+/**
+ * @brief The function limits a size to the range [kMinChunk, budget].
+ *
+ * @param size of the type qint64, in bytes
+ * @return the limited size
+ */
+qint64 BufferTuner::bounded( qint64 size ) const
+{
+    return qBound( kMinChunk, size, m_budget );
+}
@@ -0,0 +1,84 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file buffertuner.h
+ *
+ * @brief This file contains the declaration of the class BufferTuner
+ */
+#ifndef BUFFERTUNER_H
+#define BUFFERTUNER_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QString>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @class BufferTuner
+ *
+ * @brief The BufferTuner class selects the buffer (chunk) size of a job automatically.
+ *
+ * The tuner measures the throughput of the first chunks of a job and hill-climbs the
+ * chunk size: it doubles (or halves) the size as long as the throughput improves by
+ * more than a few percent, and stops at the best size found. The size never leaves
+ * the range [kMinChunk, memory budget]. One tuner is used per storage device, because
+ * the best size depends on the device. The winner is saved in QSettings and is the
+ * starting point of the next job on that device.
+ *
+ * @code
+ * BufferTuner tuner( BufferTuner::storageKey( path ), budget );
+ * while ( ... )
+ * {
+ *     qint64 size = tuner.chunkSize();
+ *     // read, encrypt and write size bytes, measure the time
+ *     tuner.addSample( bytes, nsecs );
+ * }
+ * tuner.save();
+ * @endcode
+ */
+class BufferTuner
+{
+public:
+    BufferTuner( const QString &storageKey, qint64 budget );
+
+    static QString storageKey( const QString &path );
+
+    qint64 chunkSize( void ) const;
+    bool isConverged( void ) const;
+
+    void addSample( qint64 bytes, qint64 nsecs );
+    void allocationFailed( void );
+
+    void save( void ) const;
+
+private:
+    void nextStep( void );
+    qint64 bounded( qint64 size ) const;
+
+    QString m_key;
+    qint64 m_budget;
+    qint64 m_size;
+    qint64 m_bestSize;
+    double m_bestRate;
+    int m_direction;
+    bool m_flipped;
+    bool m_improved;
+    bool m_converged;
+
+    qint64 m_windowBytes;
+    qint64 m_windowNsecs;
+    int m_windowSamples;
+};
+
+#endif // BUFFERTUNER_H
@@ -0,0 +1,882 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file compressiondevice.cpp
+ *
+ * @brief This file contains the definition of methods of the CompressionDevice class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "compressiondevice.h"
+#include "tracer.h"
+#include <QtConcurrent>
+#include <QThread>
+#include <QtEndian>
+#include <QLoggingCategory>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logCompression, "Compress")
+/// magic number at the beginning of the stream.
+static char const kMagic[] = { 'C', 'D', 'Z' };
+/// version of the stream format, version 1 has no footer index.
+static quint8 const kVersion = 0x02;
+static quint8 const kMinVersion = 0x01;
+/// length of the stream header: magic, version, codec, level, flags, reserved, frame size.
+static int const kHeaderLength = 12;
+/// flag in the stream header: the stream ends with a footer index.
+static quint8 const kFlagIndexed = 0x01;
+/// magic number at the end of the footer.
+static char const kIndexMagic[] = { 'C', 'D', 'Z', 'X' };
+/// length of the trailer of the footer: number of frames, size of the data, magic.
+static int const kTrailerLength = 16;
+/// length of the frame header: stored length (and flag), raw length.
+static int const kFrameHeaderLength = 8;
+/// flag in the stored length of a frame, which is not compressed.
+static quint32 const kStoredFlag = 0x80000000U;
+/// default size of a frame, in bytes.
+static qint64 const kDefaultFrameSize = 1024 * 1024;
+/// limits of the frame size, in bytes.
+static qint64 const kMinFrameSize = 4 * 1024;
+static qint64 const kMaxFrameSize = 64 * 1024 * 1024;
+
+/**
+ * @brief The FrameEncoder functor compresses one frame, used by QtConcurrent::blockingMapped.
+ */
+struct FrameEncoder
+{
+    typedef QByteArray result_type;
+
+    explicit FrameEncoder( int level ) : level( level ) {}
+
+    QByteArray operator()( const QByteArray &raw ) const
+    {
+        CRYPTO_TRACE_SPAN( "compress", "compress" );
+        return qCompress( raw, level );
+    }
+
+    int level;
+};
+
+/**
+ * @brief The EncodedFrame structure contains the payload of a frame, read from the device.
+ */
+struct EncodedFrame
+{
+    QByteArray payload;
+    bool stored;
+};
+
+/**
+ * @brief The FrameDecoder functor decompresses one frame, used by QtConcurrent::blockingMapped.
+ */
+struct FrameDecoder
+{
+    typedef QByteArray result_type;
+
+    QByteArray operator()( const EncodedFrame &frame ) const
+    {
+        if ( frame.stored )
+        {
+            return frame.payload;
+        }
+        CRYPTO_TRACE_SPAN( "decompress", "compress" );
+        return qUncompress( frame.payload );
+    }
+};
+
+/**
+ * @brief The constructor of the class CompressionDevice
+ *
+ * @param device of the type QIODevice*, the device, which receives the compressed stream
+ * @param parent of the type QObject*
+ */
+CompressionDevice::CompressionDevice( QIODevice *device, QObject *parent ) :
+    QIODevice( parent ),
+    m_device( device ),
+    m_deviceOwner( false ),
+    m_failed( false ),
+    m_finished( false ),
+    m_base( 0 ),
+    m_level( -1 ),
+    m_frameSize( kDefaultFrameSize ),
+    m_codec( ZlibCodec ),
+    m_indexed( true ),
+    m_rawPos( 0 ),
+    m_storedPos( 0 ),
+    m_scanComplete( false ),
+    m_indexChecked( false ),
+    m_cacheFirst( 0 )
+{
+}
+
+/**
+ * @brief The destructor of the class CompressionDevice
+ *
+ * Closes the device, the pending data is written.
+ */
+CompressionDevice::~CompressionDevice()
+{
+    this->close();
+}
+
+/**
+ * @brief CompressionDevice::open
+ *
+ * Reimplemented from QIODevice::open(). The device is opened either for reading or for writing.
+ * On writing, the stream header is written; on reading, the stream header is checked.
+ *
+ * @param mode of the type QIODevice::OpenMode
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::open( OpenMode mode )
+{
+    if ( m_device == nullptr || this->isOpen() )
+    {
+        return false;
+    }
+
+    const bool writing = ( mode & WriteOnly );
+    if ( ( writing && ( mode & ReadOnly ) ) || ( mode & Append ) )
+    {
+        this->setErrorString( QObject::tr( "The compressed stream can be opened either for reading or for writing" ) );
+        return false;
+    }
+
+    m_deviceOwner = !m_device->isOpen();
+    if ( m_deviceOwner )
+    {
+        const OpenMode deviceMode = writing ? ( WriteOnly | ( mode & Truncate ) ) : ReadOnly;
+        if ( !m_device->open( deviceMode ) )
+        {
+            this->setErrorString( m_device->errorString() );
+            return false;
+        }
+    }
+    else if ( ( writing && !m_device->isWritable() ) || ( !writing && !m_device->isReadable() ) )
+    {
+        this->setErrorString( QObject::tr( "The underlying device is opened in a wrong mode" ) );
+        return false;
+    }
+
+    m_failed = false;
+    m_finished = false;
+    m_base = m_device->pos();
+    m_rawPos = 0;
+    m_storedPos = m_base;
+    m_pending.clear();
+    m_index.clear();
+    m_frames.clear();
+    m_scanComplete = false;
+    m_indexChecked = false;
+    m_cacheFirst = 0;
+    m_cache.clear();
+
+    const bool ok = writing ? this->writeHeader() : this->readHeader();
+    if ( !ok )
+    {
+        if ( m_deviceOwner )
+        {
+            m_device->close();
+        }
+        return false;
+    }
+
+    // the frames are cached by the device itself, the buffer of QIODevice is not needed
+    return QIODevice::open( mode | Unbuffered );
+}
+
+/**
+ * @brief CompressionDevice::close
+ *
+ * Reimplemented from QIODevice::close(). Writes the pending frames and the footer index
+ * (CompressionDevice::finish, if it was not called) and closes the underlying device,
+ * if it has been opened by CompressionDevice.
+ *
+ * @note close() cannot report an error of the last frames, call CompressionDevice::finish before.
+ */
+void CompressionDevice::close( void )
+{
+    if ( !this->isOpen() )
+    {
+        return;
+    }
+
+    this->finish();
+
+    QIODevice::close();
+    if ( m_deviceOwner )
+    {
+        m_device->close();
+        m_deviceOwner = false;
+    }
+    m_pending.clear();
+    m_index.clear();
+    m_frames.clear();
+    m_cache.clear();
+}
+
+/**
+ * @brief CompressionDevice::finish
+ *
+ * Writes the pending frames and the footer index of a written stream, the device stays open.
+ * Nothing may be written afterwards.
+ *
+ * @retval true if the stream is complete, or if it is not open for writing;
+ * @retval false if a frame or the footer could not be written, the stream is corrupt.
+ */
+bool CompressionDevice::finish( void )
+{
+    if ( this->isOpen() && this->isWritable() && !m_finished )
+    {
+        m_finished = true;
+        if ( this->flushFrames( true ) && m_indexed )
+        {
+            this->writeIndex();
+        }
+    }
+    return !m_failed;
+}
+
+/**
+ * @brief CompressionDevice::hasFailed
+ *
+ * The error stays set after close(), until the device is opened again.
+ *
+ * @retval true if a write or a read of the stream failed, see errorString();
+ * @retval false otherwise.
+ */
+bool CompressionDevice::hasFailed( void ) const
+{
+    return m_failed;
+}
+
+/**
+ * @brief CompressionDevice::size
+ *
+ * Reimplemented from QIODevice::size().
+ *
+ * @return the size of the uncompressed data. On reading, the footer index is loaded
+ * or, without an index, all frame headers are scanned once.
+ */
+qint64 CompressionDevice::size( void ) const
+{
+    if ( this->isWritable() )
+    {
+        return m_rawPos;
+    }
+
+    CompressionDevice *self = const_cast<CompressionDevice *>( this );
+    self->loadIndex();
+    while ( !m_scanComplete && self->scanFrame() )
+    {
+    }
+    return m_frames.isEmpty() ? 0 : m_frames.last().rawOffset + m_frames.last().rawLength;
+}
+
+/**
+ * @brief CompressionDevice::seek
+ *
+ * Reimplemented from QIODevice::seek(). Only supported on reading.
+ *
+ * @param pos of the type qint64, position in the uncompressed data
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::seek( qint64 pos )
+{
+    if ( this->isWritable() && pos != m_rawPos )
+    {
+        return false;
+    }
+    if ( !QIODevice::seek( pos ) )
+    {
+        return false;
+    }
+    m_rawPos = pos;
+    return true;
+}
+
+/**
+ * @brief set-function for the compression level
+ *
+ * Takes effect with the next open() for writing.
+ *
+ * @param level of the type int, 0 (fastest) to 9 (smallest), -1 selects the default of zlib
+ */
+void CompressionDevice::setLevel( int level )
+{
+    m_level = qBound( -1, level, 9 );
+}
+
+/**
+ * @brief get-function for the compression level
+ * @return the level, on reading the level recorded in the stream header.
+ */
+int CompressionDevice::level( void ) const
+{
+    return m_level;
+}
+
+/**
+ * @brief set-function for the frame size
+ *
+ * Takes effect with the next open() for writing. Smaller frames allow cheaper random
+ * access, larger frames compress better.
+ *
+ * @param frameSize of the type qint64, in bytes
+ */
+void CompressionDevice::setFrameSize( qint64 frameSize )
+{
+    m_frameSize = qBound( kMinFrameSize, frameSize, kMaxFrameSize );
+}
+
+/**
+ * @brief get-function for the frame size
+ * @return the frame size in bytes, on reading the size recorded in the stream header.
+ */
+qint64 CompressionDevice::frameSize( void ) const
+{
+    return m_frameSize;
+}
+
+/**
+ * @brief set-function for the footer index
+ *
+ * Takes effect with the next open() for writing. The index costs 8 bytes per frame.
+ *
+ * @param indexed of the type bool, true (default) writes the footer index at close()
+ */
+void CompressionDevice::setIndexed( bool indexed )
+{
+    m_indexed = indexed;
+}
+
+/**
+ * @brief get-function for the footer index
+ * @return true if a footer index is written, on reading true if the stream header announces one.
+ */
+bool CompressionDevice::isIndexed( void ) const
+{
+    return m_indexed;
+}
+
+/**
+ * @brief get-function for the codec
+ * @return the codec of the frames.
+ */
+CompressionDevice::Codec CompressionDevice::codec( void ) const
+{
+    return m_codec;
+}
+
+/**
+ * @brief CompressionDevice::compressedSize
+ *
+ * @return the size of the compressed stream (header and frames), in bytes.
+ */
+qint64 CompressionDevice::compressedSize( void ) const
+{
+    if ( this->isWritable() )
+    {
+        return m_storedPos - m_base;
+    }
+
+    this->size();
+    if ( m_frames.isEmpty() )
+    {
+        return kHeaderLength;
+    }
+    const Frame &last = m_frames.last();
+    return last.offset + kFrameHeaderLength + last.storedLength - m_base;
+}
+
+/**
+ * @brief CompressionDevice::isCompressed
+ *
+ * Checks, whether the data at the current position of an open device is a compressed stream.
+ * The position of the device is not changed.
+ *
+ * @param device of the type QIODevice*
+ *
+ * @retval true if the stream header is found;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::isCompressed( QIODevice *device )
+{
+    if ( device == nullptr || !device->isReadable() )
+    {
+        return false;
+    }
+    const QByteArray header = device->peek( kHeaderLength );
+    return ( header.size() == kHeaderLength )
+            && ( memcmp( header.constData(), kMagic, sizeof( kMagic ) ) == 0 )
+            && ( static_cast<quint8>( header.at( 3 ) ) >= kMinVersion )
+            && ( static_cast<quint8>( header.at( 3 ) ) <= kVersion );
+}
+
+/**
+ * @brief CompressionDevice::readData
+ *
+ * Reimplemented from QIODevice::readData(). Decodes the frames which contain the requested data.
+ *
+ * @param data of the type char*
+ * @param length the length of the data
+ *
+ * @return the number of bytes read or -1 if an error occurred.
+ */
+qint64 CompressionDevice::readData( char *data, qint64 length )
+{
+    qint64 done = 0;
+    while ( done < length )
+    {
+        const int index = this->findFrame( m_rawPos );
+        if ( index < 0 )
+        {
+            break;
+        }
+        if ( index < m_cacheFirst || index >= m_cacheFirst + m_cache.size() )
+        {
+            if ( !this->decodeFrames( index ) )
+            {
+                break;
+            }
+        }
+
+        const Frame &frame = m_frames.at( index );
+        const QByteArray &raw = m_cache.at( index - m_cacheFirst );
+        const qint64 offset = m_rawPos - frame.rawOffset;
+        const qint64 n = qMin( length - done, raw.size() - offset );
+        memcpy( data + done, raw.constData() + offset, n );
+        done += n;
+        m_rawPos += n;
+    }
+
+    return ( m_failed && done == 0 ) ? -1 : done;
+}
+
+/**
+ * @brief CompressionDevice::writeData
+ *
+ * Reimplemented from QIODevice::writeData(). The data is collected until a batch
+ * of frames is complete, the batch is compressed in parallel and written.
+ *
+ * @param data of the type const char*
+ * @param length the length of the data
+ *
+ * @return the number of bytes written or -1 if an error occurred.
+ */
+qint64 CompressionDevice::writeData( const char *data, qint64 length )
+{
+    if ( m_failed )
+    {
+        return -1;
+    }
+
+    m_pending.append( data, static_cast<int>( length ) );
+    m_rawPos += length;
+    if ( !this->flushFrames( false ) )
+    {
+        return -1;
+    }
+    return length;
+}
+
+/**
+ * @brief The function writes the stream header.
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::writeHeader( void )
+{
+    char header[kHeaderLength] = {};
+    memcpy( header, kMagic, sizeof( kMagic ) );
+    header[3] = static_cast<char>( kVersion );
+    header[4] = static_cast<char>( m_codec );
+    header[5] = static_cast<char>( m_level );
+    header[6] = static_cast<char>( m_indexed ? kFlagIndexed : 0 );
+    qToBigEndian( static_cast<quint32>( m_frameSize ), reinterpret_cast<uchar *>( header + 8 ) );
+
+    if ( m_device->write( header, kHeaderLength ) != kHeaderLength )
+    {
+        this->fail( QObject::tr( "Cannot write the header of the compressed stream: %1" ).arg( m_device->errorString() ) );
+        return false;
+    }
+    m_storedPos += kHeaderLength;
+    return true;
+}
+
+/**
+ * @brief The function reads and checks the stream header.
+ *
+ * @retval true if the stream header is valid;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::readHeader( void )
+{
+    char header[kHeaderLength];
+    if ( m_device->read( header, kHeaderLength ) != kHeaderLength
+         || memcmp( header, kMagic, sizeof( kMagic ) ) != 0
+         || static_cast<quint8>( header[3] ) < kMinVersion
+         || static_cast<quint8>( header[3] ) > kVersion )
+    {
+        this->setErrorString( QObject::tr( "The data is not a compressed stream" ) );
+        return false;
+    }
+    if ( static_cast<quint8>( header[4] ) != ZlibCodec )
+    {
+        this->fail( QObject::tr( "Unknown codec of the compressed stream: %1" ).arg( static_cast<quint8>( header[4] ) ) );
+        return false;
+    }
+
+    const qint64 frameSize = qFromBigEndian<quint32>( reinterpret_cast<const uchar *>( header + 8 ) );
+    if ( frameSize < kMinFrameSize || frameSize > kMaxFrameSize )
+    {
+        this->fail( QObject::tr( "Invalid frame size of the compressed stream: %1" ).arg( frameSize ) );
+        return false;
+    }
+
+    m_codec = static_cast<Codec>( header[4] );
+    m_level = static_cast<qint8>( header[5] );
+    m_indexed = ( static_cast<quint8>( header[3] ) >= 0x02 ) && ( header[6] & kFlagIndexed );
+    m_frameSize = frameSize;
+    m_storedPos += kHeaderLength;
+    return true;
+}
+
+/**
+ * @brief The function compresses and writes the collected data.
+ *
+ * @param all of the type bool, false writes complete batches of full frames only,
+ * true writes all data (on closing).
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::flushFrames( bool all )
+{
+    const int batch = qMax( QThread::idealThreadCount(), 1 );
+    while ( m_pending.size() >= m_frameSize * batch || ( all && !m_pending.isEmpty() ) )
+    {
+        QList<QByteArray> raw;
+        int offset = 0;
+        while ( raw.size() < batch && offset < m_pending.size() )
+        {
+            raw.append( m_pending.mid( offset, static_cast<int>( m_frameSize ) ) );
+            offset += raw.last().size();
+        }
+        const QList<QByteArray> packed = QtConcurrent::blockingMapped( raw, FrameEncoder( m_level ) );
+
+        CRYPTO_TRACE_SPAN( "write frames", "compress" );
+        for ( int i = 0; i < raw.size(); i++ )
+        {
+            const bool stored = ( packed.at( i ).size() >= raw.at( i ).size() );
+            const QByteArray &payload = stored ? raw.at( i ) : packed.at( i );
+            uchar header[kFrameHeaderLength];
+            qToBigEndian( static_cast<quint32>( payload.size() ) | ( stored ? kStoredFlag : 0U ), header );
+            qToBigEndian( static_cast<quint32>( raw.at( i ).size() ), header + 4 );
+            if ( m_device->write( reinterpret_cast<const char *>( header ), kFrameHeaderLength ) != kFrameHeaderLength
+                 || m_device->write( payload ) != payload.size() )
+            {
+                this->fail( QObject::tr( "Cannot write the compressed stream: %1" ).arg( m_device->errorString() ) );
+                m_pending.clear();
+                return false;
+            }
+            m_storedPos += kFrameHeaderLength + payload.size();
+            m_index.append( reinterpret_cast<const char *>( header ), kFrameHeaderLength );
+        }
+        m_pending.remove( 0, offset );
+    }
+    return true;
+}
+
+/**
+ * @brief The function writes the footer: the end marker (a frame header of zeros), the index
+ * (the headers of all frames) and the trailer (number of frames, size of the data, magic).
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::writeIndex( void )
+{
+    uchar trailer[kTrailerLength];
+    qToBigEndian( static_cast<quint32>( m_index.size() / kFrameHeaderLength ), trailer );
+    qToBigEndian( static_cast<quint64>( m_rawPos ), trailer + 4 );
+    memcpy( trailer + 12, kIndexMagic, sizeof( kIndexMagic ) );
+
+    const QByteArray footer = QByteArray( kFrameHeaderLength, '\0' ) + m_index
+                              + QByteArray( reinterpret_cast<const char *>( trailer ), kTrailerLength );
+    if ( m_device->write( footer ) != footer.size() )
+    {
+        this->fail( QObject::tr( "Cannot write the index of the compressed stream: %1" ).arg( m_device->errorString() ) );
+        return false;
+    }
+    m_storedPos += footer.size();
+    return true;
+}
+
+/**
+ * @brief The function reads the footer index, once, instead of scanning the frame headers.
+ *
+ * The offsets of the frames follow from their lengths, the index is accepted if the frames
+ * end at the end marker and their data adds up to the size of the trailer. Otherwise
+ * (no index, a sequential device or a damaged footer) the frame headers are scanned.
+ */
+void CompressionDevice::loadIndex( void )
+{
+    if ( m_indexChecked )
+    {
+        return;
+    }
+    m_indexChecked = true;
+    if ( !m_indexed || m_device->isSequential() || !m_frames.isEmpty() )
+    {
+        return;
+    }
+
+    CRYPTO_TRACE_SPAN( "read index", "compress" );
+    const qint64 end = m_device->size();
+    const qint64 first = m_base + kHeaderLength;
+    uchar trailer[kTrailerLength];
+    if ( end - first < kFrameHeaderLength + kTrailerLength
+         || !m_device->seek( end - kTrailerLength )
+         || m_device->read( reinterpret_cast<char *>( trailer ), kTrailerLength ) != kTrailerLength
+         || memcmp( trailer + 12, kIndexMagic, sizeof( kIndexMagic ) ) != 0 )
+    {
+        qWarning(logCompression) << QObject::tr( "The index of the compressed stream is missing, the frames are scanned" );
+        return;
+    }
+
+    const qint64 count = qFromBigEndian<quint32>( trailer );
+    const qint64 rawSize = static_cast<qint64>( qFromBigEndian<quint64>( trailer + 4 ) );
+    const qint64 marker = end - kTrailerLength - count * kFrameHeaderLength - kFrameHeaderLength;
+    QByteArray index;
+    if ( marker < first
+         || !m_device->seek( marker + kFrameHeaderLength )
+         || ( index = m_device->read( count * kFrameHeaderLength ) ).size() != count * kFrameHeaderLength )
+    {
+        qWarning(logCompression) << QObject::tr( "The index of the compressed stream is damaged, the frames are scanned" );
+        return;
+    }
+
+    QVector<Frame> frames;
+    frames.reserve( static_cast<int>( count ) );
+    Frame frame;
+    frame.offset = first;
+    frame.rawOffset = 0;
+    for ( int i = 0; i < count; i++ )
+    {
+        const uchar *header = reinterpret_cast<const uchar *>( index.constData() ) + i * kFrameHeaderLength;
+        const quint32 stored = qFromBigEndian<quint32>( header );
+        frame.stored = ( stored & kStoredFlag ) != 0;
+        frame.storedLength = stored & ~kStoredFlag;
+        frame.rawLength = qFromBigEndian<quint32>( header + 4 );
+        if ( !this->isValidFrame( frame ) )
+        {
+            break;
+        }
+        frames.append( frame );
+        frame.offset += kFrameHeaderLength + frame.storedLength;
+        frame.rawOffset += frame.rawLength;
+    }
+    if ( frames.size() != count || frame.offset != marker || frame.rawOffset != rawSize )
+    {
+        qWarning(logCompression) << QObject::tr( "The index of the compressed stream is damaged, the frames are scanned" );
+        return;
+    }
+
+    m_frames = frames;
+    m_scanComplete = true;
+}
+
+/**
+ * @brief The function checks the lengths of a frame.
+ * @param frame of the type Frame&
+ * @retval true if the lengths are plausible;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::isValidFrame( const Frame &frame ) const
+{
+    // zlib never expands a frame by more than a few bytes per 16 Kb
+    const quint32 maxStored = frame.rawLength + frame.rawLength / 16 + 64;
+    return frame.rawLength != 0 && frame.rawLength <= m_frameSize && frame.storedLength <= maxStored
+           && ( !frame.stored || frame.storedLength == frame.rawLength );
+}
+
+/**
+ * @brief The function reads the header of the frame following the last known frame.
+ *
+ * @retval true if a frame has been found;
+ * @retval false at the end of the stream or on an error.
+ */
+bool CompressionDevice::scanFrame( void )
+{
+    if ( m_scanComplete )
+    {
+        return false;
+    }
+
+    Frame frame;
+    frame.offset = m_base + kHeaderLength;
+    frame.rawOffset = 0;
+    if ( !m_frames.isEmpty() )
+    {
+        const Frame &last = m_frames.last();
+        frame.offset = last.offset + kFrameHeaderLength + last.storedLength;
+        frame.rawOffset = last.rawOffset + last.rawLength;
+    }
+
+    if ( m_device->pos() != frame.offset && !m_device->seek( frame.offset ) )
+    {
+        m_scanComplete = true;
+        return false;
+    }
+    uchar header[kFrameHeaderLength];
+    const qint64 read = m_device->read( reinterpret_cast<char *>( header ), kFrameHeaderLength );
+    if ( read != kFrameHeaderLength )
+    {
+        m_scanComplete = true;
+        if ( read != 0 )
+        {
+            this->fail( QObject::tr( "The compressed stream is truncated" ) );
+        }
+        return false;
+    }
+
+    const quint32 stored = qFromBigEndian<quint32>( header );
+    frame.stored = ( stored & kStoredFlag ) != 0;
+    frame.storedLength = stored & ~kStoredFlag;
+    frame.rawLength = qFromBigEndian<quint32>( header + 4 );
+    // the end marker of the frames, the footer index follows
+    if ( m_indexed && stored == 0 && frame.rawLength == 0 )
+    {
+        m_scanComplete = true;
+        return false;
+    }
+    if ( !this->isValidFrame( frame ) )
+    {
+        m_scanComplete = true;
+        this->fail( QObject::tr( "The compressed stream is corrupted at offset %1" ).arg( frame.offset - m_base ) );
+        return false;
+    }
+
+    m_frames.append( frame );
+    return true;
+}
+
+/**
+ * @brief The function returns the frame, which contains a position of the uncompressed data.
+ *
+ * The footer index is loaded, without it the frame headers are scanned as far as needed.
+ *
+ * @param rawPos of the type qint64, position in the uncompressed data
+ * @return the index of the frame, or -1 if the position is behind the end of the stream.
+ */
+int CompressionDevice::findFrame( qint64 rawPos )
+{
+    this->loadIndex();
+    while ( m_frames.isEmpty() || m_frames.last().rawOffset + m_frames.last().rawLength <= rawPos )
+    {
+        if ( !this->scanFrame() )
+        {
+            return -1;
+        }
+    }
+
+    int low = 0;
+    int high = m_frames.size() - 1;
+    while ( low < high )
+    {
+        const int middle = ( low + high + 1 ) / 2;
+        if ( m_frames.at( middle ).rawOffset <= rawPos )
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief The function decodes a batch of frames in parallel, starting with a frame.
+ *
+ * @param first of the type int, index of the first frame
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CompressionDevice::decodeFrames( int first )
+{
+    const int batch = qMax( QThread::idealThreadCount(), 1 );
+    while ( m_frames.size() < first + batch && this->scanFrame() )
+    {
+    }
+    const int count = qMin( batch, m_frames.size() - first );
+
+    QList<EncodedFrame> encoded;
+    {
+        CRYPTO_TRACE_SPAN( "read frames", "compress" );
+        for ( int i = first; i < first + count; i++ )
+        {
+            const Frame &frame = m_frames.at( i );
+            const qint64 offset = frame.offset + kFrameHeaderLength;
+            EncodedFrame item;
+            item.stored = frame.stored;
+            if ( ( m_device->pos() != offset && !m_device->seek( offset ) )
+                 || ( item.payload = m_device->read( frame.storedLength ) ).size() != static_cast<int>( frame.storedLength ) )
+            {
+                this->fail( QObject::tr( "Cannot read the compressed stream: %1" ).arg( m_device->errorString() ) );
+                return false;
+            }
+            if ( !item.stored && ( frame.storedLength < 4
+                 || qFromBigEndian<quint32>( reinterpret_cast<const uchar *>( item.payload.constData() ) ) != frame.rawLength ) )
+            {
+                this->fail( QObject::tr( "The compressed stream is corrupted at offset %1" ).arg( frame.offset - m_base ) );
+                return false;
+            }
+            encoded.append( item );
+        }
+    }
+
+    m_cache = QtConcurrent::blockingMapped( encoded, FrameDecoder() );
+    m_cacheFirst = first;
+    for ( int i = 0; i < m_cache.size(); i++ )
+    {
+        if ( static_cast<quint32>( m_cache.at( i ).size() ) != m_frames.at( first + i ).rawLength )
+        {
+            m_cache.clear();
+            this->fail( QObject::tr( "The compressed stream is corrupted at offset %1" ).arg( m_frames.at( first + i ).offset - m_base ) );
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief The function records an error of the stream.
+ * @param message of the type QString&
+ */
+void CompressionDevice::fail( const QString &message )
+{
+    m_failed = true;
+    this->setErrorString( message );
+    qCritical(logCompression) << message;
+}
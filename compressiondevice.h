@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file compressiondevice.h
+ *
+ * @brief This file contains the declaration of the class CompressionDevice
+ */
+#ifndef COMPRESSIONDEVICE_H
+#define COMPRESSIONDEVICE_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QIODevice>
+#include <QVector>
+#include <QList>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @class CompressionDevice
+ *
+ * @brief The CompressionDevice class compresses the data written to another device
+ * and decompresses the data read from it.
+ *
+ * The device is placed in front of a CryptFileDevice, so that the data is compressed
+ * before it is encrypted. The stream consists of a header and of frames:
+ * - the header contains a magic number, the codec, the compression level and the frame size,
+ * - every frame contains up to frameSize bytes of the data and is compressed independently,
+ *   so that a frame can be decoded without its predecessors. A frame which does not
+ *   shrink is stored uncompressed.
+ * .
+ * - the footer (optional, see CompressionDevice::setIndexed) follows the last frame:
+ *   an end marker, the index with the stored and raw length of every frame and a trailer
+ *   with the number of frames and the size of the data.
+ * .
+ * Frames are compressed and decompressed in parallel (QtConcurrent), a batch of
+ * QThread::idealThreadCount() frames at a time. On reading the device supports seek(),
+ * only the frames which contain the requested data are decoded. The index of the footer
+ * is loaded with the first seek(), size() or read: one read of the trailer and one of the index,
+ * then a position is found by a binary search over the frames. A stream without
+ * (or with a damaged) index is read by scanning the frame headers as far as needed.
+ *
+ * @code
+ * CryptFileDevice cryptDevice( fileName, password, salt );
+ * CompressionDevice device( &cryptDevice );
+ * device.setLevel( 6 );
+ * device.open( QIODevice::WriteOnly | QIODevice::Truncate );
+ * device.write( data );
+ * if ( !device.finish() ) { ... discard the output ... }
+ * device.close();
+ * @endcode
+ *
+ * @note The underlying device is opened and closed by CompressionDevice, unless it is already
+ * open; then the stream starts at its current position and the device stays open.
+ */
+class CompressionDevice : public QIODevice
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(CompressionDevice)
+
+public:
+    /// The codec of the frames.
+    enum Codec
+    {
+        ZlibCodec = 1
+    };
+
+    explicit CompressionDevice( QIODevice *device, QObject *parent = 0 );
+    ~CompressionDevice() override;
+
+    bool open( OpenMode flags ) override;
+    void close( void ) override;
+    bool finish( void );
+    bool hasFailed( void ) const;
+
+    qint64 size( void ) const override;
+    bool seek( qint64 pos ) override;
+
+    void setLevel( int level );
+    int level( void ) const;
+    void setFrameSize( qint64 frameSize );
+    qint64 frameSize( void ) const;
+    void setIndexed( bool indexed );
+    bool isIndexed( void ) const;
+    Codec codec( void ) const;
+
+    qint64 compressedSize( void ) const;
+
+    static bool isCompressed( QIODevice *device );
+
+protected:
+    qint64 readData( char *data, qint64 length ) override;
+    qint64 writeData( const char *data, qint64 length ) override;
+
+private:
+    /// Position of a frame in the stream.
+    struct Frame
+    {
+        qint64 offset;      ///< offset of the frame header in the underlying device
+        qint64 rawOffset;   ///< offset of the data of the frame in the uncompressed stream
+        quint32 storedLength;
+        quint32 rawLength;
+        bool stored;        ///< the payload is not compressed
+    };
+
+    bool writeHeader( void );
+    bool readHeader( void );
+    bool flushFrames( bool all );
+    bool writeIndex( void );
+    void loadIndex( void );
+    bool isValidFrame( const Frame &frame ) const;
+    bool scanFrame( void );
+    int findFrame( qint64 rawPos );
+    bool decodeFrames( int first );
+    void fail( const QString &message );
+
+    QIODevice *m_device;
+    bool m_deviceOwner;
+    bool m_failed;
+    /// writing: the pending frames and the footer are written (CompressionDevice::finish).
+    bool m_finished;
+    qint64 m_base;
+    int m_level;
+    qint64 m_frameSize;
+    Codec m_codec;
+    /// writing: a footer index is written; reading: the stream has a footer index.
+    bool m_indexed;
+
+    qint64 m_rawPos;
+    qint64 m_storedPos;
+
+    // write side
+    QByteArray m_pending;
+    /// the headers of the written frames, the index of the footer
+    QByteArray m_index;
+
+    // read side
+    QVector<Frame> m_frames;
+    bool m_scanComplete;
+    bool m_indexChecked;
+    int m_cacheFirst;
+    QList<QByteArray> m_cache;
+};
+
+#endif // COMPRESSIONDEVICE_H
@@ -0,0 +1,231 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file cpufeatures.cpp
+ *
+ * @brief This file contains the definition of methods of the CpuFeatures class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "cpufeatures.h"
+#include <QStringList>
+#include <QSysInfo>
+#include <QtGlobal>
+#include <cstring>
+#if defined( Q_PROCESSOR_X86 )
+#  if defined( Q_CC_MSVC )
+#    include <intrin.h>
+#    include <immintrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+#if defined( Q_PROCESSOR_X86 )
+/// bits of CPUID leaf 1 (ECX, EDX) and leaf 7 (EBX, ECX).
+static quint32 const kLeaf1EdxSse2 = 1u << 26;
+static quint32 const kLeaf1EcxPclmul = 1u << 1;
+static quint32 const kLeaf1EcxSsse3 = 1u << 9;
+static quint32 const kLeaf1EcxAes = 1u << 25;
+static quint32 const kLeaf1EcxOsxsave = 1u << 27;
+static quint32 const kLeaf1EcxAvx = 1u << 28;
+static quint32 const kLeaf7EbxAvx2 = 1u << 5;
+static quint32 const kLeaf7EbxAvx512F = 1u << 16;
+static quint32 const kLeaf7EcxVaes = 1u << 9;
+/// state components in XCR0, which the operating system must save: SSE and AVX (YMM),
+/// in addition opmask, ZMM0..15 and ZMM16..31 for AVX-512.
+static quint64 const kXcr0Avx = 0x06;
+static quint64 const kXcr0Avx512 = 0xe6;
+
+/**
+ * @brief cpuid
+ * @param leaf of the type quint32
+ * @param subleaf of the type quint32
+ * @param regs of the type quint32[4], receives EAX, EBX, ECX, EDX
+ */
+static void cpuid( quint32 leaf, quint32 subleaf, quint32 regs[4] )
+{
+#if defined( Q_CC_MSVC )
+    int info[4];
+    __cpuidex( info, static_cast<int>( leaf ), static_cast<int>( subleaf ) );
+    for ( int i = 0; i < 4; i++ )
+    {
+        regs[i] = static_cast<quint32>( info[i] );
+    }
+#else
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count( leaf, subleaf, a, b, c, d );
+    regs[0] = a;
+    regs[1] = b;
+    regs[2] = c;
+    regs[3] = d;
+#endif
+}
+
+/**
+ * @brief xcr0
+ * @return the register XCR0, which tells the state components saved by the operating system
+ */
+static quint64 xcr0( void )
+{
+#if defined( Q_CC_MSVC )
+    return _xgetbv( 0 );
+#else
+    unsigned int low = 0, high = 0;
+    __asm__ __volatile__ ( "xgetbv" : "=a" ( low ), "=d" ( high ) : "c" ( 0 ) );
+    return ( static_cast<quint64>( high ) << 32 ) | low;
+#endif
+}
+
+/**
+ * @brief detectX86
+ * @return the features reported by CPUID and enabled by the operating system
+ */
+static CpuFeatures::Features detectX86( void )
+{
+    CpuFeatures::Features features = CpuFeatures::NoFeature;
+    quint32 regs[4];
+    cpuid( 0, 0, regs );
+    const quint32 maxLeaf = regs[0];
+    if ( maxLeaf < 1 )
+    {
+        return features;
+    }
+
+    cpuid( 1, 0, regs );
+    const quint32 ecx1 = regs[2];
+    const quint32 edx1 = regs[3];
+    if ( edx1 & kLeaf1EdxSse2 )
+    {
+        features |= CpuFeatures::Sse2;
+    }
+    if ( ecx1 & kLeaf1EcxSsse3 )
+    {
+        features |= CpuFeatures::Ssse3;
+    }
+    if ( ecx1 & kLeaf1EcxAes )
+    {
+        features |= CpuFeatures::AesNi;
+    }
+    if ( ecx1 & kLeaf1EcxPclmul )
+    {
+        features |= CpuFeatures::Pclmul;
+    }
+
+    // the AVX family needs the operating system to save the YMM / ZMM registers
+    const quint64 xcr = ( ecx1 & kLeaf1EcxOsxsave ) ? xcr0() : 0;
+    const bool avx = ( ecx1 & kLeaf1EcxAvx ) && ( xcr & kXcr0Avx ) == kXcr0Avx;
+    if ( !avx )
+    {
+        return features;
+    }
+    features |= CpuFeatures::Avx;
+
+    if ( maxLeaf >= 7 )
+    {
+        cpuid( 7, 0, regs );
+        if ( regs[1] & kLeaf7EbxAvx2 )
+        {
+            features |= CpuFeatures::Avx2;
+        }
+        if ( regs[2] & kLeaf7EcxVaes )
+        {
+            features |= CpuFeatures::Vaes;
+        }
+        if ( ( regs[1] & kLeaf7EbxAvx512F ) && ( xcr & kXcr0Avx512 ) == kXcr0Avx512 )
+        {
+            features |= CpuFeatures::Avx512F;
+        }
+    }
+
+    return features;
+}
+#endif
+
+/**
+ * @brief CpuFeatures::detect
+ * @return the features of the processor, the detection runs at the first call
+ */
+CpuFeatures::Features CpuFeatures::detect( void )
+{
+#if defined( Q_PROCESSOR_X86 )
+    static const Features features = detectX86();
+    return features;
+#else
+    return NoFeature;
+#endif
+}
+
+/**
+ * @brief CpuFeatures::names
+ * @param features of the type CpuFeatures::Features
+ * @return the names of the features separated by spaces, "none" if there is none
+ */
+QString CpuFeatures::names( CpuFeatures::Features features )
+{
+    static const struct
+    {
+        Feature feature;
+        const char *name;
+    } kNames[] = {
+        { Sse2, "SSE2" },
+        { Ssse3, "SSSE3" },
+        { AesNi, "AES-NI" },
+        { Pclmul, "PCLMUL" },
+        { Avx, "AVX" },
+        { Avx2, "AVX2" },
+        { Vaes, "VAES" },
+        { Avx512F, "AVX-512F" }
+    };
+
+    QStringList list;
+    for ( size_t i = 0; i < sizeof( kNames ) / sizeof( kNames[0] ); i++ )
+    {
+        if ( features & kNames[i].feature )
+        {
+            list.append( QLatin1String( kNames[i].name ) );
+        }
+    }
+
+    return list.isEmpty() ? QStringLiteral( "none" ) : list.join( QLatin1Char( ' ' ) );
+}
+
+/**
+ * @brief CpuFeatures::processorName
+ * @return the brand string of the processor (CPUID), or the architecture if it is not available
+ */
+QString CpuFeatures::processorName( void )
+{
+#if defined( Q_PROCESSOR_X86 )
+    quint32 regs[4];
+    cpuid( 0x80000000u, 0, regs );
+    if ( regs[0] >= 0x80000004u )
+    {
+        char brand[49] = {};
+        for ( quint32 leaf = 0; leaf < 3; leaf++ )
+        {
+            cpuid( 0x80000002u + leaf, 0, regs );
+            memcpy( brand + leaf * 16, regs, sizeof( regs ) );
+        }
+        const QString name = QString::fromLatin1( brand ).simplified();
+        if ( !name.isEmpty() )
+        {
+            return name;
+        }
+    }
+#endif
+    return QSysInfo::currentCpuArchitecture();
+}
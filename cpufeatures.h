@@ -0,0 +1,73 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file cpufeatures.h
+ *
+ * @brief This file contains the declaration of the class CpuFeatures
+ */
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QString>
+#include <QFlags>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @class CpuFeatures
+ *
+ * @brief The CpuFeatures class detects the instruction set extensions of the processor,
+ * which matter for the ciphers.
+ *
+ * On x86 and x86-64 the features are read with CPUID. The AVX family is only reported
+ * if the operating system saves the wider registers (XGETBV). On other architectures
+ * no feature is reported. The detection runs once, the result is kept.
+ *
+ * @code
+ * if ( CpuFeatures::detect() & CpuFeatures::AesNi )
+ * {
+ *     ...
+ * }
+ * qInfo() << CpuFeatures::names( CpuFeatures::detect() );   // "SSE2 SSSE3 AES-NI PCLMUL AVX AVX2"
+ * @endcode
+ *
+ * @note All functions in this class are thread-safe.
+ */
+class CpuFeatures
+{
+public:
+    /// Instruction set extensions.
+    enum Feature
+    {
+        NoFeature = 0x00,
+        Sse2      = 0x01,
+        Ssse3     = 0x02,
+        AesNi     = 0x04,   ///< AES round instructions
+        Pclmul    = 0x08,   ///< carry-less multiplication (GHASH of AES-GCM)
+        Avx       = 0x10,
+        Avx2      = 0x20,
+        Vaes      = 0x40,   ///< AES round instructions on 256/512-bit registers
+        Avx512F   = 0x80
+    };
+    Q_DECLARE_FLAGS( Features, Feature )
+
+    static Features detect( void );
+    static QString names( Features features );
+    static QString processorName( void );
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS( CpuFeatures::Features )
+
+#endif // CPUFEATURES_H
@@ -18,28 +18,481 @@
 // Includes
 //------------------------------------------------------------------------------
 #include "cryptfiledevice.h"
+#include "tracer.h"
+#include "bufferpool.h"
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
 #include <limits>
 #include <QtEndian>
-#include <QDataStream>
 #include <QFileDevice>
 #include <QFile>
 #include <QCryptographicHash>
 #include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QList>
+#include <QVector>
+#include <QThread>
+#include <QtConcurrent>
+#if defined( Q_OS_WIN )
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <unistd.h>
+#  include <cerrno>
+#endif
 
 //------------------------------------------------------------------------------
 // Types
 //------------------------------------------------------------------------------
-/// file header size. in bytes
-static int const kHeaderLength = 0;
-/// @todo develop the concept of headers for coded files.
-//static int const kHeaderLength = 128;
-static int const kHashLength = 32;
-static int const kPaddingLength = 54;
+const int CryptFileDevice::kHeaderLength;
+const qint64 CryptFileDevice::kLegacyChunkSize;
+/// first byte of the header.
+static quint8 const kHeaderMagic = 0xcd;
+/// version of the header layout.
+static quint8 const kHeaderVersion = 0x02;
+/// offsets of the fields of the header, see CryptFileDevice::insertHeader.
+static int const kOffsetMethod = 2;
+static int const kOffsetKeyLength = 3;
+static int const kOffsetRounds = 4;
+static int const kOffsetNonce = 8;
+static int const kOffsetCheck = 24;
+static int const kOffsetKdf = 56;
+static int const kOffsetScryptR = 57;
+static int const kOffsetScryptP = 58;
+static int const kOffsetSaltLength = 59;
+static int const kOffsetSalt = 60;
+static int const kOffsetKeyScheme = 76;
+static int const kOffsetChunkShift = 77;
+static int const kOffsetCrc = 124;
+/// length of the per-file nonce, in bytes.
+static int const kNonceLength = 16;
+/// length of the key check value (HMAC-SHA256), in bytes.
+static int const kCheckLength = 32;
+/// derivation of the key of a file from the key derived from the password (the master key).
+enum KeyScheme
+{
+    DirectKey = 0,  ///< the master key, the IV is combined with the nonce (files of version 2 without a scheme)
+    HkdfKey = 1     ///< key and IV of the file are HKDF-SHA256( master key, salt = nonce )
+};
+/// context of the HKDF of the key of a file.
+static const char kFileKeyInfo[] = "CryptFileDevice file key";
+/// context of the HKDF of the key of the digests in the manifests (CryptFileDevice::digestKey).
+static const char kDigestKeyInfo[] = "CryptFileDevice digest key";
+/// length of the key of the digests, in bytes.
+static int const kDigestKeyLength = 32;
+/// log2 of the size of the chunks of AesGcmCipher (64 KiB) and its limits accepted from a header.
+static int const kChunkShift = 16;
+static int const kMinChunkShift = 12;
+static int const kMaxChunkShift = 24;
+/// length of the GCM tag of a chunk, in bytes.
+static int const kTagLength = 16;
+/// length of the GCM nonce: the first bytes of the IV of the file and the index of the chunk (8 bytes).
+static int const kGcmNonceLength = 12;
+/// length of the trailer of AesGcmCipher: the sealed size of the data and its tag.
+static int const kTrailerLength = 8 + kTagLength;
+/// block of the ChaCha20 key stream, in bytes; the IV of EVP_chacha20 is the block counter
+/// (32 bits, little endian) followed by the nonce.
+static int const kChaChaBlockLength = 64;
+static int const kChaChaNonceLength = 12;
+/// length of the ChaCha20 key stream of a file (2^32 blocks), beyond it the block counter would wrap.
+static qint64 const kChaChaStreamLength = Q_INT64_C( 0x100000000 ) * kChaChaBlockLength;
+/// period of the key stream of XorCipher: a SHA3-512 hash (64 bytes, of the key of the file)
+/// combined with the position modulo 251.
+static int const kXorHashLength = 64;
+static qint64 const kXorPeriod = kXorHashLength * 251;
+/// iteration count of EVP_BytesToKey in the files of version 1.0.
+static int const kLegacyRounds = 5;
+/// largest single read or write of the positional I/O, in bytes.
+static qint64 const kMaxPositionalIo = 1 << 30;
+/// upper limit of the iteration count accepted from a header.
+static qint32 const kMaxRounds = 1 << 24;
 /// restriction on the length of the salt.
-static int const kSaltMaxLength = 8;
+static int const kSaltMaxLength = 16;
+/// block size (r) and parallelisation (p) of scrypt.
+static int const kScryptR = 8;
+static int const kScryptP = 1;
+/// limits of the cost of scrypt (log2 of N): 1 MiB ... 1 GiB of memory with r = 8.
+static int const kMinScryptLog2N = 10;
+static int const kMaxScryptLog2N = 20;
+/// lower limit of the calibrated iteration count of PBKDF2.
+static int const kMinPbkdf2Rounds = 10000;
+/// shortest measurement of the calibration, in ms.
+static qint64 const kCalibrationMsecs = 50;
 Q_LOGGING_CATEGORY(cryptFileDev, "CryptDev")
 
+/**
+ * @brief crc32
+ *
+ * Calculates the CRC-32 (IEEE 802.3, as zlib) of the data.
+ * The header is short, so the bitwise form is used instead of a table.
+ *
+ * @param data of the type unsigned char*
+ * @param length of the type int
+ * @return the checksum
+ */
+static quint32 crc32( const unsigned char *data, int length )
+{
+    quint32 crc = 0xffffffffu;
+    for ( int i = 0; i < length; i++ )
+    {
+        crc ^= data[i];
+        for ( int bit = 0; bit < 8; bit++ )
+        {
+            crc = ( crc >> 1 ) ^ ( 0xedb88320u & ( 0u - ( crc & 1u ) ) );
+        }
+    }
+
+    return ~crc;
+}
+
+/**
+ * @brief hkdfSha256
+ *
+ * HKDF with HMAC-SHA256 (RFC 5869): extracts a pseudorandom key from the input key and
+ * the salt, then expands it to length bytes. Costs a few HMACs, so it can run for every file.
+ *
+ * @param ikm of the type unsigned char*, the input key
+ * @param ikmLength of the type int
+ * @param salt of the type unsigned char*
+ * @param saltLength of the type int
+ * @param info of the type QByteArray &, the context
+ * @param out of the type unsigned char*, receives the output
+ * @param length of the type int, at most 255 * 32 bytes
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+static bool hkdfSha256( const unsigned char *ikm, int ikmLength,
+                        const unsigned char *salt, int saltLength,
+                        const QByteArray &info,
+                        unsigned char *out, int length )
+{
+    unsigned char prk[EVP_MAX_MD_SIZE];
+    unsigned int prkLength = 0;
+    if ( HMAC( EVP_sha256(), salt, saltLength, ikm, ikmLength, prk, &prkLength ) == nullptr )
+    {
+        return false;
+    }
+
+    QByteArray block;
+    bool ok = true;
+    for ( int done = 0, counter = 1; ok && done < length; counter++ )
+    {
+        const QByteArray input = block + info + char( counter );
+        unsigned char t[EVP_MAX_MD_SIZE];
+        unsigned int tLength = 0;
+        ok = HMAC( EVP_sha256(), prk, static_cast<int>( prkLength ),
+                   reinterpret_cast<const unsigned char *>( input.constData() ), static_cast<size_t>( input.size() ),
+                   t, &tLength ) != nullptr;
+        block = QByteArray( reinterpret_cast<const char *>( t ), static_cast<int>( tLength ) );
+        const int n = qMin( length - done, static_cast<int>( tLength ) );
+        memcpy( out + done, t, n );
+        done += n;
+        OPENSSL_cleanse( t, sizeof( t ) );
+    }
+    OPENSSL_cleanse( prk, sizeof( prk ) );
+
+    return ok;
+}
+
+/**
+ * @brief gcmChunk
+ *
+ * Seals or opens one chunk with AES-GCM. The nonce is the start of the IV of the file followed by
+ * the index of the chunk, the authenticated data is the index and a flag of the trailer, so a chunk
+ * only opens at its own position. The function has no state, it runs in any thread.
+ *
+ * @param seal of the type bool, true encrypts and produces the tag, false decrypts and checks the tag
+ * @param cipher of the type EVP_CIPHER*, AES-GCM with the length of the key
+ * @param key of the type unsigned char*, the key of the file
+ * @param fileIv of the type unsigned char*, the IV of the file
+ * @param index of the type quint64, the index of the chunk
+ * @param trailer of the type bool, the chunk is the trailer
+ * @param in of the type unsigned char*
+ * @param length of the type int
+ * @param out of the type unsigned char*, may be in; cleared if the tag does not match
+ * @param tag of the type unsigned char*, kTagLength bytes
+ * @retval true if successful (and authentic),
+ * @retval false otherwise.
+ */
+static bool gcmChunk( bool seal, const EVP_CIPHER *cipher,
+                      const unsigned char *key, const unsigned char *fileIv,
+                      quint64 index, bool trailer,
+                      const unsigned char *in, int length,
+                      unsigned char *out, unsigned char *tag )
+{
+    unsigned char nonce[kGcmNonceLength];
+    memcpy( nonce, fileIv, kGcmNonceLength - 8 );
+    qToBigEndian<quint64>( index, nonce + kGcmNonceLength - 8 );
+    unsigned char aad[9];
+    qToBigEndian<quint64>( index, aad );
+    aad[8] = trailer ? 1 : 0;
+
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    unsigned char tail[AES_BLOCK_SIZE];
+    int outLength = 0;
+    const bool ok = ( ctx != nullptr )
+                    && EVP_CipherInit_ex( ctx, cipher, nullptr, nullptr, nullptr, seal ? 1 : 0 ) == 1
+                    && EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_IVLEN, kGcmNonceLength, nullptr ) == 1
+                    && EVP_CipherInit_ex( ctx, nullptr, nullptr, key, nonce, -1 ) == 1
+                    && EVP_CipherUpdate( ctx, nullptr, &outLength, aad, sizeof( aad ) ) == 1
+                    && ( length == 0 || EVP_CipherUpdate( ctx, out, &outLength, in, length ) == 1 )
+                    && ( seal || EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_TAG, kTagLength, tag ) == 1 )
+                    && EVP_CipherFinal_ex( ctx, tail, &outLength ) == 1
+                    && ( !seal || EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_GET_TAG, kTagLength, tag ) == 1 );
+    EVP_CIPHER_CTX_free( ctx );
+
+    if ( !ok && !seal )
+    {
+        OPENSSL_cleanse( out, length );
+    }
+    return ok;
+}
+
+/**
+ * @brief gcmCipherOf
+ * @param keyLength of the type CryptFileDevice::AesKeyLength
+ * @return the AES-GCM cipher of the key length
+ */
+static const EVP_CIPHER *gcmCipherOf( CryptFileDevice::AesKeyLength keyLength )
+{
+    if ( keyLength == CryptFileDevice::AesKeyLength::kAesKeyLength128 )
+    {
+        return EVP_aes_128_gcm();
+    }
+    if ( keyLength == CryptFileDevice::AesKeyLength::kAesKeyLength192 )
+    {
+        return EVP_aes_192_gcm();
+    }
+    return EVP_aes_256_gcm();
+}
+
+/**
+ * @struct GcmChunk
+ *
+ * @brief The GcmChunk structure describes one chunk of a batch, see ChunkCipher.
+ */
+struct GcmChunk
+{
+    const unsigned char *in;
+    unsigned char *out;
+    unsigned char *tag;
+    int length;
+    quint64 index;
+    bool ok;
+};
+
+/**
+ * @struct ChunkCipher
+ *
+ * @brief The ChunkCipher functor seals or opens one chunk, used by QtConcurrent::blockingMap.
+ */
+struct ChunkCipher
+{
+    ChunkCipher( bool seal, const EVP_CIPHER *cipher, const unsigned char *key, const unsigned char *fileIv ) :
+        seal( seal ), cipher( cipher ), key( key ), fileIv( fileIv )
+    {
+    }
+
+    void operator()( GcmChunk &chunk ) const
+    {
+        chunk.ok = gcmChunk( seal, cipher, key, fileIv, chunk.index, false, chunk.in, chunk.length, chunk.out, chunk.tag );
+    }
+
+    /// runs the batch in the global thread pool, a single chunk in the calling thread.
+    void run( QVector<GcmChunk> &chunks ) const
+    {
+        if ( chunks.size() > 1 )
+        {
+            QtConcurrent::blockingMap( chunks, *this );
+        }
+        else if ( !chunks.isEmpty() )
+        {
+            ( *this )( chunks[0] );
+        }
+    }
+
+    bool seal;
+    const EVP_CIPHER *cipher;
+    const unsigned char *key;
+    const unsigned char *fileIv;
+};
+
+/// enables the performance counters of all devices.
+static QAtomicInt s_statsEnabled( 0 );
+/// backend of every EncryptionMethod, which is used by the devices opened next (CryptFileDevice::setBackend).
+static QAtomicInt s_backends[CryptFileDevice::ChaCha20Cipher + 1] = {
+    CryptFileDevice::PortableBackend,   // XorCipher
+    CryptFileDevice::PortableBackend,   // AesCipher
+    CryptFileDevice::EvpBackend,        // AesGcmCipher
+    CryptFileDevice::EvpBackend         // ChaCha20Cipher
+};
+/// process-wide sum of the counters of all devices, see CryptFileDevice::publishStatistics.
+static CryptStatistics s_globalStats;
+static QMutex s_globalStatsMutex;
+
+/// number of keys derived in advance, which are kept (CryptFileDevice::cacheKey).
+static int const kKeyCacheSize = 4;
+/// keys derived in advance, the most recent first.
+static QList<DerivedKey> s_keyCache;
+static QMutex s_keyCacheMutex;
+
+/// adds value to a counter of the device, if the statistics are enabled.
+#define CRYPT_STAT_ADD( field, value ) \
+    do { if ( s_statsEnabled.load() ) { m_stats.field += (value); } } while ( 0 )
+
+/**
+ * @class StatTimer
+ *
+ * @brief The StatTimer class adds the lifetime of a scope (in ns) to a counter of CryptStatistics.
+ *
+ * The clock is only read while the statistics are enabled.
+ */
+class StatTimer
+{
+public:
+    explicit StatTimer( quint64 &counter ) :
+        m_counter( s_statsEnabled.load() ? &counter : nullptr )
+    {
+        if ( m_counter != nullptr )
+        {
+            m_timer.start();
+        }
+    }
+    ~StatTimer()
+    {
+        if ( m_counter != nullptr )
+        {
+            *m_counter += m_timer.nsecsElapsed();
+        }
+    }
+
+private:
+    quint64 *m_counter;
+    QElapsedTimer m_timer;
+};
+
+/**
+ * @brief Adds the counters of other to this structure.
+ * @param other of the type CryptStatistics &
+ * @return a reference to this structure
+ */
+CryptStatistics &CryptStatistics::operator+=( const CryptStatistics &other )
+{
+    readCalls += other.readCalls;
+    readBytes += other.readBytes;
+    writeCalls += other.writeCalls;
+    writeBytes += other.writeBytes;
+    cipherNsecs += other.cipherNsecs;
+    ioNsecs += other.ioNsecs;
+    seeks += other.seeks;
+    ctrInits += other.ctrInits;
+    keyDerivations += other.keyDerivations;
+    allocations += other.allocations;
+    return *this;
+}
+
+/**
+ * @brief Subtracts the counters of other from this structure.
+ * @param other of the type CryptStatistics &
+ * @return a reference to this structure
+ */
+CryptStatistics &CryptStatistics::operator-=( const CryptStatistics &other )
+{
+    readCalls -= other.readCalls;
+    readBytes -= other.readBytes;
+    writeCalls -= other.writeCalls;
+    writeBytes -= other.writeBytes;
+    cipherNsecs -= other.cipherNsecs;
+    ioNsecs -= other.ioNsecs;
+    seeks -= other.seeks;
+    ctrInits -= other.ctrInits;
+    keyDerivations -= other.keyDerivations;
+    allocations -= other.allocations;
+    return *this;
+}
+
+/**
+ * @brief deriveKeyMaterial
+ *
+ * Derives the key and the IV for the cipher from the password.
+ * - BytesToKey: EVP_BytesToKey with SHA-256, rounds is the iteration count (only for old files).
+ * - Pbkdf2Sha256: PKCS5_PBKDF2_HMAC with SHA-256, rounds is the iteration count.
+ * - Scrypt: EVP_PBE_scrypt (OpenSSL 1.1.0 or newer), rounds is log2 of N, r = 8, p = 1.
+ * .
+ *
+ * @param kdf of the type CryptFileDevice::KeyDerivation
+ * @param password of the type QByteArray &
+ * @param salt of the type QByteArray &
+ * @param rounds of the type int, the cost
+ * @param cipher of the type EVP_CIPHER*, defines the length of the key and of the IV
+ * @param key of the type unsigned char*, receives the key
+ * @param iv of the type unsigned char*, receives the IV
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+static bool deriveKeyMaterial( CryptFileDevice::KeyDerivation kdf,
+                               const QByteArray &password,
+                               const QByteArray &salt,
+                               int rounds,
+                               const EVP_CIPHER *cipher,
+                               unsigned char *key,
+                               unsigned char *iv )
+{
+    const int keyLength = EVP_CIPHER_key_length( cipher );
+    const int ivLength = EVP_CIPHER_iv_length( cipher );
+    const unsigned char *saltData = reinterpret_cast<const unsigned char *>( salt.constData() );
+
+    if ( kdf == CryptFileDevice::BytesToKey )
+    {
+        return EVP_BytesToKey( cipher,
+                               EVP_sha256(),
+                               salt.isEmpty() ? nullptr : saltData,
+                               reinterpret_cast<const unsigned char *>( password.constData() ),
+                               password.length(),
+                               rounds,
+                               key,
+                               iv ) != 0;
+    }
+
+    QByteArray material( keyLength + ivLength, '\0' );
+    unsigned char *out = reinterpret_cast<unsigned char *>( material.data() );
+    int ok = 0;
+    if ( kdf == CryptFileDevice::Pbkdf2Sha256 )
+    {
+        ok = PKCS5_PBKDF2_HMAC( password.constData(), password.length(),
+                                saltData, salt.length(),
+                                rounds, EVP_sha256(),
+                                material.length(), out );
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    else if ( kdf == CryptFileDevice::Scrypt && rounds >= 1 && rounds <= kMaxScryptLog2N )
+    {
+        const quint64 n = Q_UINT64_C( 1 ) << rounds;
+        const quint64 maxMemory = 2 * 128 * kScryptR * ( n + kScryptP ) + 1024 * 1024;
+        ok = EVP_PBE_scrypt( password.constData(), password.length(),
+                             saltData, salt.length(),
+                             n, kScryptR, kScryptP, maxMemory,
+                             out, material.length() );
+    }
+#endif
+
+    if ( ok != 1 )
+    {
+        return false;
+    }
+
+    memcpy( key, out, keyLength );
+    memcpy( iv, out + keyLength, ivLength );
+    OPENSSL_cleanse( out, material.length() );
+    return true;
+}
+
 /**
  * @brief The default constructor of the class CryptFileDevice
  *
@@ -121,6 +574,8 @@ CryptFileDevice::CryptFileDevice( const QString &fileName,
 CryptFileDevice::~CryptFileDevice()
 {
     this->close();
+    this->publishStatistics();
+    EVP_CIPHER_CTX_free( m_streamCtx );
 
     if ( m_deviceOwner )
     {
@@ -135,6 +590,7 @@ CryptFileDevice::~CryptFileDevice()
 void CryptFileDevice::setPassword( const QByteArray &password )
 {
     m_password = password;
+    m_keyValid = false;
 }
 
 /**
@@ -144,6 +600,7 @@ void CryptFileDevice::setPassword( const QByteArray &password )
 void CryptFileDevice::setSalt( const QByteArray &salt )
 {
     m_salt = salt.mid( 0, kSaltMaxLength );
+    m_keyValid = false;
 }
 
 /**
@@ -153,6 +610,16 @@ void CryptFileDevice::setSalt( const QByteArray &salt )
 void CryptFileDevice::setKeyLength( CryptFileDevice::AesKeyLength keyLength )
 {
     m_aesKeyLength = keyLength;
+    m_keyValid = false;
+}
+
+/**
+ * @brief get-function for the keyLength
+ * @return keyLength of the type CryptFileDevice::AesKeyLength, taken from the header of an open file
+ */
+CryptFileDevice::AesKeyLength CryptFileDevice::keyLength( void ) const
+{
+    return m_aesKeyLength;
 }
 
 /**
@@ -162,6 +629,277 @@ void CryptFileDevice::setKeyLength( CryptFileDevice::AesKeyLength keyLength )
 void CryptFileDevice::setNumRounds( int numRounds )
 {
     m_numRounds = numRounds;
+    m_keyValid = false;
+}
+
+/**
+ * @brief set-function for the keyDerivation
+ *
+ * The cost (CryptFileDevice::setNumRounds) is interpreted by the selected function,
+ * see CryptFileDevice::calibrate.
+ *
+ * @param kdf of the type CryptFileDevice::KeyDerivation
+ */
+void CryptFileDevice::setKeyDerivation( CryptFileDevice::KeyDerivation kdf )
+{
+    m_kdf = kdf;
+    m_keyValid = false;
+}
+
+/**
+ * @brief get-function for the keyDerivation
+ * @return kdf of the type CryptFileDevice::KeyDerivation
+ */
+CryptFileDevice::KeyDerivation CryptFileDevice::keyDerivation( void ) const
+{
+    return m_kdf;
+}
+
+/**
+ * @brief get-function for the numRounds
+ * @return numRounds of the type int
+ */
+int CryptFileDevice::numRounds( void ) const
+{
+    return m_numRounds;
+}
+
+/**
+ * @brief CryptFileDevice::isMethodSupported
+ *
+ * @param method of the type CryptFileDevice::EncryptionMethod
+ * @retval true if the OpenSSL library provides the cipher,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::isMethodSupported( CryptFileDevice::EncryptionMethod method )
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    return ( method >= XorCipher ) && ( method <= ChaCha20Cipher );
+#else
+    return ( method >= XorCipher ) && ( method <= AesGcmCipher );
+#endif
+}
+
+/**
+ * @brief CryptFileDevice::isBackendSupported
+ *
+ * AesCipher has both backends, XorCipher only the PortableBackend,
+ * AesGcmCipher and ChaCha20Cipher only the EvpBackend.
+ *
+ * @param method of the type CryptFileDevice::EncryptionMethod
+ * @param backend of the type CryptFileDevice::Backend
+ * @retval true if the method can use the backend,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::isBackendSupported( CryptFileDevice::EncryptionMethod method, CryptFileDevice::Backend backend )
+{
+    if ( !isMethodSupported( method ) )
+    {
+        return false;
+    }
+    if ( method == AesCipher )
+    {
+        return ( backend == PortableBackend ) || ( backend == EvpBackend );
+    }
+    return backend == ( ( method == XorCipher ) ? PortableBackend : EvpBackend );
+}
+
+/**
+ * @brief CryptFileDevice::setBackend
+ *
+ * Selects the implementation of a method for all devices, which are opened afterwards
+ * (an open device keeps its backend). Both backends of AesCipher produce the same data.
+ *
+ * @param method of the type CryptFileDevice::EncryptionMethod
+ * @param backend of the type CryptFileDevice::Backend
+ * @retval true if the backend was selected,
+ * @retval false if the method cannot use it.
+ */
+bool CryptFileDevice::setBackend( CryptFileDevice::EncryptionMethod method, CryptFileDevice::Backend backend )
+{
+    if ( !isBackendSupported( method, backend ) )
+    {
+        return false;
+    }
+    s_backends[method].store( backend );
+    return true;
+}
+
+/**
+ * @brief get-function for the backend of a method
+ * @param method of the type CryptFileDevice::EncryptionMethod
+ * @return backend of the type CryptFileDevice::Backend, see CryptFileDevice::setBackend
+ */
+CryptFileDevice::Backend CryptFileDevice::backend( CryptFileDevice::EncryptionMethod method )
+{
+    if ( method < XorCipher || method > ChaCha20Cipher )
+    {
+        return PortableBackend;
+    }
+    return static_cast<Backend>( s_backends[method].load() );
+}
+
+/**
+ * @brief CryptFileDevice::backendName
+ * @param backend of the type CryptFileDevice::Backend
+ * @return the name of the backend in the log and in the settings: "portable" or "evp"
+ */
+QString CryptFileDevice::backendName( CryptFileDevice::Backend backend )
+{
+    return ( backend == EvpBackend ) ? QStringLiteral( "evp" ) : QStringLiteral( "portable" );
+}
+
+/**
+ * @brief CryptFileDevice::benchmark
+ *
+ * Encrypts length bytes in memory with a random key and measures the throughput of the backend.
+ * Nothing is read or written, the statistics of the devices are not changed.
+ *
+ * @param method of the type CryptFileDevice::EncryptionMethod
+ * @param backend of the type CryptFileDevice::Backend
+ * @param length of the type qint64, number of the encrypted bytes
+ * @return throughput in MB/s, 0 if the method cannot use the backend
+ */
+double CryptFileDevice::benchmark( CryptFileDevice::EncryptionMethod method,
+                                   CryptFileDevice::Backend backend,
+                                   qint64 length )
+{
+    QByteArray buffer( static_cast<int>( qBound( Q_INT64_C( 4096 ), length, Q_INT64_C( 256 ) * 1024 * 1024 ) ), '\0' );
+    CryptFileDevice device;
+    device.m_encMethod = method;
+    device.m_backend = backend;
+    device.m_password = QByteArray( "benchmark" );
+    device.m_keyBytes = static_cast<int>( sizeof( device.m_fileKey ) );
+    device.m_fileKeyBytes = device.m_keyBytes;
+    if ( !isBackendSupported( method, backend )
+         || RAND_bytes( device.m_fileKey, sizeof( device.m_fileKey ) ) != 1
+         || RAND_bytes( device.m_fileIv, sizeof( device.m_fileIv ) ) != 1
+         || AES_set_encrypt_key( device.m_fileKey, device.m_keyBytes * 8, &device.m_aesKey ) != 0 )
+    {
+        return 0.0;
+    }
+
+    unsigned char *data = reinterpret_cast<unsigned char *>( buffer.data() );
+    unsigned char tag[kTagLength];
+    QElapsedTimer timer;
+    bool ok = true;
+    // the first round warms up the caches and the code, the second one is measured
+    for ( int round = 0; round < 2 && ok; round++ )
+    {
+        timer.start();
+        if ( method == AesGcmCipher )
+        {
+            const int chunk = 1 << kChunkShift;
+            for ( int offset = 0; offset < buffer.size() && ok; offset += chunk )
+            {
+                ok = gcmChunk( true, gcmCipherOf( device.m_aesKeyLength ), device.m_fileKey, device.m_fileIv,
+                               static_cast<quint64>( offset / chunk ), false,
+                               data + offset, qMin( chunk, buffer.size() - offset ), data + offset, tag );
+            }
+        }
+        else
+        {
+            ok = device.initTransform();
+            if ( ok )
+            {
+                device.encrypt( buffer.constData(), buffer.data(), buffer.size() );
+            }
+        }
+    }
+
+    const qint64 nsecs = qMax( Q_INT64_C( 1 ), timer.nsecsElapsed() );
+    return ok ? ( buffer.size() * 1000.0 / nsecs ) : 0.0;
+}
+
+/**
+ * @brief CryptFileDevice::isKeyDerivationSupported
+ *
+ * @param kdf of the type CryptFileDevice::KeyDerivation
+ * @retval true if the OpenSSL library provides the function,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::isKeyDerivationSupported( CryptFileDevice::KeyDerivation kdf )
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    return ( kdf == BytesToKey ) || ( kdf == Pbkdf2Sha256 ) || ( kdf == Scrypt );
+#else
+    return ( kdf == BytesToKey ) || ( kdf == Pbkdf2Sha256 );
+#endif
+}
+
+/**
+ * @brief CryptFileDevice::calibrate
+ *
+ * Measures the key derivation on this machine and returns the cost (CryptFileDevice::setNumRounds)
+ * for which one derivation takes about targetMsecs.
+ * - BytesToKey, Pbkdf2Sha256: the iteration count is doubled until a measurement takes
+ *   at least 50 ms (or the target), then it is scaled linearly to the target.
+ *   PBKDF2 gets at least 10000 iterations.
+ * - Scrypt: log2 of N is increased while the next step (twice the time and memory)
+ *   stays within the target; the memory is limited to 1 GiB.
+ * .
+ *
+ * @param kdf of the type CryptFileDevice::KeyDerivation
+ * @param targetMsecs of the type int, the wanted duration of the key derivation
+ * @return the cost, or 0 if the function is not supported
+ */
+int CryptFileDevice::calibrate( CryptFileDevice::KeyDerivation kdf, int targetMsecs )
+{
+    if ( !isKeyDerivationSupported( kdf ) )
+    {
+        return 0;
+    }
+
+    CRYPTO_TRACE_SPAN( "kdf.calibrate", "crypto" );
+    const QByteArray password( "calibration" );
+    const QByteArray salt( kSaltMaxLength, '\0' );
+    const EVP_CIPHER *cipher = EVP_aes_256_ctr();
+    unsigned char key[EVP_MAX_KEY_LENGTH];
+    unsigned char iv[EVP_MAX_IV_LENGTH];
+    QElapsedTimer timer;
+
+    if ( kdf == Scrypt )
+    {
+        int log2N = kMinScryptLog2N;
+        for ( ; log2N < kMaxScryptLog2N; log2N++ )
+        {
+            timer.start();
+            if ( !deriveKeyMaterial( kdf, password, salt, log2N, cipher, key, iv ) )
+            {
+                break;
+            }
+            if ( timer.elapsed() * 2 > targetMsecs )
+            {
+                break;
+            }
+        }
+        qInfo(cryptFileDev) << QObject::tr( "KDF calibration: scrypt, N = 2^%1 for %2 ms" ).arg( log2N ).arg( targetMsecs );
+        return log2N;
+    }
+
+    const qint64 measure = qMin( kCalibrationMsecs, static_cast<qint64>( qMax( 1, targetMsecs ) ) );
+    qint64 rounds = 1000;
+    qint64 elapsed = 0;
+    forever
+    {
+        timer.start();
+        if ( !deriveKeyMaterial( kdf, password, salt, static_cast<int>( rounds ), cipher, key, iv ) )
+        {
+            return 0;
+        }
+        elapsed = qMax( Q_INT64_C( 1 ), timer.nsecsElapsed() / 1000000 );
+        if ( elapsed >= measure || rounds >= kMaxRounds )
+        {
+            break;
+        }
+        rounds *= 2;
+    }
+
+    rounds = rounds * targetMsecs / elapsed;
+    rounds = qBound( static_cast<qint64>( ( kdf == Pbkdf2Sha256 ) ? kMinPbkdf2Rounds : 1 ), rounds, static_cast<qint64>( kMaxRounds ) );
+    qInfo(cryptFileDev) << QObject::tr( "KDF calibration: %1, %2 rounds for %3 ms" )
+                           .arg( ( kdf == Pbkdf2Sha256 ) ? "pbkdf2" : "bytestokey" ).arg( rounds ).arg( targetMsecs );
+    return static_cast<int>( rounds );
 }
 
 /**
@@ -173,6 +911,47 @@ void CryptFileDevice::setEncryptionMethod(CryptFileDevice::EncryptionMethod enc)
     m_encMethod = enc;
 }
 
+/**
+ * @brief get-function for the encryptionMethod
+ * @return enc of the type CryptFileDevice::EncryptionMethod, taken from the header of an open file
+ */
+CryptFileDevice::EncryptionMethod CryptFileDevice::encryptionMethod( void ) const
+{
+    return m_encMethod;
+}
+
+/**
+ * @brief set-function for the legacyFormat
+ *
+ * The next open() reads the file as a file of version 1.0, without a header (see CryptFileDevice::openLegacy).
+ * A file without a header cannot be told apart from plain data, so the format must be known.
+ *
+ * @param legacy of the type bool
+ */
+void CryptFileDevice::setLegacyFormat( bool legacy )
+{
+    m_legacy = legacy;
+}
+
+/**
+ * @brief get-function for the legacyFormat
+ * @return legacy of the type bool
+ */
+bool CryptFileDevice::legacyFormat( void ) const
+{
+    return m_legacy;
+}
+
+/**
+ * @brief set-function for the legacyChunkSize
+ * @param chunkSize of the type qint64, the size of the buffer, with which a file of version 1.0
+ * was written with XorCipher, kLegacyChunkSize by default
+ */
+void CryptFileDevice::setLegacyChunkSize( qint64 chunkSize )
+{
+    m_legacyChunkSize = qMax( Q_INT64_C( 1 ), chunkSize );
+}
+
 /**
  * @brief CryptFileDevice::open
  *
@@ -220,6 +999,9 @@ bool CryptFileDevice::open( OpenMode mode )
         deviceOpenMode |= Truncate;
     }
 
+    m_finished = false;
+    m_finishOk = true;
+    m_passwordRejected = false;
     bool ok;
     if ( m_device->isOpen() )
     {
@@ -241,36 +1023,73 @@ bool CryptFileDevice::open( OpenMode mode )
         return true;
     }
 
-    if ( (m_encMethod == AesCipher) && (!initCipher()) )
+    // An existing file must carry a valid header, which also rejects a wrong password
+    // before any data is read. A new file gets a header with a fresh nonce.
+    // A file of version 1.0 has no header at all (see CryptFileDevice::setLegacyFormat).
+    const qint64 size = m_device->size();
+    m_authenticated = false;
+    m_chunkIndex = -1;
+    m_plainPos = 0;
+    m_headerLength = m_legacy ? 0 : kHeaderLength;
+    if ( m_legacy )
     {
-        return false;
+        ok = this->openLegacy( mode );
     }
-
-    m_encrypted = true;
-    this->setOpenMode( mode );
-/// @todo develop the concept of headers for coded files.
-/// - Allow the user to assign a header for the files.
-/// - Handle files with and without headers.
-    qint64 size = m_device->size();
-    if ( size == 0 && mode != ReadOnly )
+    else if ( size > 0 )
     {
-//        this->insertHeader();
+        ok = m_device->seek( 0 ) && this->tryParseHeader();
+        if ( ok && m_encMethod == AesGcmCipher )
+        {
+            // rewriting a sealed chunk would reuse its nonce
+            if ( mode & WriteOnly )
+            {
+                qWarning(cryptFileDev) << QObject::tr( "An authenticated file cannot be modified: %1" ).arg( m_device->fileName() );
+                ok = false;
+            }
+            else
+            {
+                ok = this->openAuthenticated();
+            }
+        }
     }
-
-    if ( size > 0 )
+    else if ( this->initCipher() )
     {
-        if ( !this->tryParseHeader() )
+        // an empty file has no header, the master key is used as it is
+        static const unsigned char kNoHeader[kHeaderLength] = {};
+        ok = ( mode == ReadOnly ) ? this->initFileKey( kNoHeader ) : this->insertHeader();
+        if ( ok && mode != ReadOnly && m_encMethod == AesGcmCipher )
         {
-            m_encrypted = false;
-            m_device->seek(0);
-            m_device->close();
-            return false;
+            m_authenticated = true;
+            m_chunkSize = Q_INT64_C( 1 ) << kChunkShift;
+            m_chunkCount = 0;
+            m_plainSize = 0;
+            m_chunk.reserve( static_cast<int>( m_chunkSize ) );
+            m_chunk.resize( 0 );
         }
     }
+    else
+    {
+        ok = false;
+    }
+
+    m_backend = backend( m_encMethod );
+    if ( ok && !m_authenticated )
+    {
+        ok = this->initTransform();
+    }
+
+    if ( !ok )
+    {
+        m_device->close();
+        return false;
+    }
+
+    m_encrypted = true;
+    this->setOpenMode( mode );
 
     if ( mode & Append )
     {
-        seek( m_device->size() - kHeaderLength );
+        seek( m_device->size() - m_headerLength );
     }
 
     return true;
@@ -279,113 +1098,274 @@ bool CryptFileDevice::open( OpenMode mode )
 /**
  * @brief CryptFileDevice::insertHeader
  *
- * The method CryptFileDevice::insertHeader allow you to provide the files
- * being encoded with a special 1024 bit header (variable kHeaderLength).
- * Which contains AES encryption options, as well as a hash of the sum of the password and salt.
- *
- * @note In the next version, the header of the encrypted file will be backed up with a CRC checksum.
+ * Writes the header (kHeaderLength bytes, version 2) to the start of a new file:
+ *
+ * | offset | length | content                                                       |
+ * |--------|--------|---------------------------------------------------------------|
+ * | 0      | 1      | 0xcd                                                          |
+ * | 1      | 1      | version of the header (0x02)                                  |
+ * | 2      | 1      | encryption method (EncryptionMethod)                          |
+ * | 3      | 1      | AES key length (AesKeyLength)                                 |
+ * | 4      | 4      | cost of the key derivation (see calibrate), big endian        |
+ * | 8      | 16     | random nonce of the file                                      |
+ * | 24     | 32     | key check value: HMAC-SHA256 of the bytes 0..23, keyed with the key of the file |
+ * | 56     | 1      | key derivation function (KeyDerivation)                       |
+ * | 57     | 1      | r of scrypt                                                   |
+ * | 58     | 1      | p of scrypt                                                   |
+ * | 59     | 1      | length of the salt                                            |
+ * | 60     | 16     | salt of the key derivation                                    |
+ * | 76     | 1      | derivation of the key of the file (KeyScheme)                 |
+ * | 77     | 1      | log2 of the size of the chunks (AesGcmCipher only)            |
+ * | 78     | 46     | reserved, zero                                                |
+ * | 124    | 4      | CRC-32 of the bytes 0..123, big endian                        |
+ *
+ * The key derived from the password is the master key: it is derived once for all files
+ * with the same password and salt. The key and the IV of every file are derived from the master key
+ * and the random nonce with HKDF-SHA256 (CryptFileDevice::initFileKey), which costs microseconds,
+ * so every file has its own key stream. Neither the password nor a plain hash of it is stored;
+ * the check value can only be reproduced with the key of the file.
+ *
+ * With AesGcmCipher the header is followed by the sealed chunks (data and tag) and the trailer,
+ * see CryptFileDevice::sealChunks and CryptFileDevice::finishChunks.
+ *
+ * @retval true if the header was written,
+ * @retval false otherwise.
  */
-void CryptFileDevice::insertHeader( void )
+bool CryptFileDevice::insertHeader( void )
 {
-    QDataStream ostream( m_device );
-    ostream << quint8( 0xcd ); // cryptdevice byte
-    ostream << quint8( 0x01 ); // version
-    ostream << static_cast<quint32>( m_aesKeyLength ); // aes key length
-    ostream << static_cast<qint32>( m_numRounds ); // iteration count to use
-    ostream.writeRawData( QCryptographicHash::hash( m_password, QCryptographicHash::Sha3_256 ), kHashLength );
-    ostream.writeRawData( QCryptographicHash::hash( m_salt, QCryptographicHash::Sha3_256 ), kHashLength );
-    ostream.writeRawData( QByteArray( kPaddingLength, char( 0xcd ) ), kPaddingLength ); // padding with 0xcd
+    if ( !isMethodSupported( m_encMethod ) )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "The encryption method is not supported by this OpenSSL library" );
+        return false;
+    }
+
+    unsigned char header[kHeaderLength] = {};
+    header[0] = kHeaderMagic;
+    header[1] = kHeaderVersion;
+    header[kOffsetMethod] = static_cast<unsigned char>( m_encMethod );
+    header[kOffsetKeyLength] = static_cast<unsigned char>( m_aesKeyLength );
+    qToBigEndian<quint32>( static_cast<quint32>( m_numRounds ), header + kOffsetRounds );
+    header[kOffsetKdf] = static_cast<unsigned char>( m_kdf );
+    header[kOffsetScryptR] = kScryptR;
+    header[kOffsetScryptP] = kScryptP;
+    header[kOffsetSaltLength] = static_cast<unsigned char>( m_salt.length() );
+    memcpy( header + kOffsetSalt, m_salt.constData(), m_salt.length() );
+    header[kOffsetKeyScheme] = HkdfKey;
+    if ( m_encMethod == AesGcmCipher )
+    {
+        header[kOffsetChunkShift] = kChunkShift;
+    }
+    if ( RAND_bytes( header + kOffsetNonce, kNonceLength ) != 1 )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "Cannot generate the nonce of the file: %1" ).arg( m_device->fileName() );
+        return false;
+    }
+    if ( !this->initFileKey( header ) || !this->keyCheckValue( header, header + kOffsetCheck ) )
+    {
+        return false;
+    }
+    qToBigEndian<quint32>( crc32( header, kOffsetCrc ), header + kOffsetCrc );
+
+    if ( m_device->write( reinterpret_cast<const char *>( header ), kHeaderLength ) != kHeaderLength )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "Cannot write the header: %1" ).arg( m_device->errorString() );
+        return false;
+    }
+
+    return true;
 }
 
 /**
  * @brief CryptFileDevice::tryParseHeader
  *
- * The CryptFileDevice::tryParseHeader method parses the special 1024-bit header
- * (kHeaderLength variable). This will allow you to look up the special AES encryption
- * options as well as a hash of the sum of password and salt.
- *
- * @note In the next version, the header of the encrypted file will be backed up with a CRC checksum.
+ * Reads and checks the header of an existing file (see CryptFileDevice::insertHeader).
+ * The encryption method, the key length, the key derivation with its cost and the salt
+ * of the header replace the settings of the device, the key is derived (or taken from the cache) and its
+ * check value is compared with the header. A wrong password is rejected here,
+ * before any data is read.
  *
- * @retval true if parse successful,
+ * @retval true if the header is valid and the password matches,
  * @retval false otherwise.
  */
 bool CryptFileDevice::tryParseHeader( void )
 {
-    QDataStream istream( m_device );
-    quint8 cdByte;
-    istream >> cdByte;
-    if (cdByte != 0xcd)
+    unsigned char header[kHeaderLength];
+    if ( m_device->read( reinterpret_cast<char *>( header ), kHeaderLength ) != kHeaderLength )
     {
+        qDebug(cryptFileDev) << QObject::tr( "No header: %1" ).arg( m_device->fileName() );
         return false;
     }
 
-    quint8 version;
-    istream >> version;
-    if ( version != 0x01 )
+    if ( header[0] != kHeaderMagic || header[1] != kHeaderVersion )
     {
+        qDebug(cryptFileDev) << QObject::tr( "Unknown header: %1" ).arg( m_device->fileName() );
         return false;
     }
 
-    quint32 aesKeyLength;
-    istream >> aesKeyLength;
-    if (static_cast<AesKeyLength>(aesKeyLength) != m_aesKeyLength)
+    if ( qFromBigEndian<quint32>( header + kOffsetCrc ) != crc32( header, kOffsetCrc ) )
     {
+        qWarning(cryptFileDev) << QObject::tr( "The header is damaged: %1" ).arg( m_device->fileName() );
         return false;
     }
 
-    qint32 numRounds;
-    istream >> numRounds;
-    if (numRounds != m_numRounds)
-    {
+    const quint8 method = header[kOffsetMethod];
+    const quint8 keyLength = header[kOffsetKeyLength];
+    const qint32 numRounds = static_cast<qint32>( qFromBigEndian<quint32>( header + kOffsetRounds ) );
+    const KeyDerivation kdf = static_cast<KeyDerivation>( header[kOffsetKdf] );
+    const int saltLength = header[kOffsetSaltLength];
+    const qint32 maxRounds = ( kdf == Scrypt ) ? kMaxScryptLog2N : kMaxRounds;
+    const int chunkShift = header[kOffsetChunkShift];
+    if ( !isMethodSupported( static_cast<EncryptionMethod>( method ) )
+         || ( method == AesGcmCipher && ( header[kOffsetKeyScheme] != HkdfKey
+                                          || chunkShift < kMinChunkShift || chunkShift > kMaxChunkShift ) )
+         || ( method == ChaCha20Cipher && header[kOffsetKeyScheme] != HkdfKey )
+         || keyLength > static_cast<quint8>( AesKeyLength::kAesKeyLength256 )
+         || !isKeyDerivationSupported( kdf )
+         || ( kdf == Scrypt && ( header[kOffsetScryptR] != kScryptR || header[kOffsetScryptP] != kScryptP ) )
+         || saltLength > kSaltMaxLength
+         || header[kOffsetKeyScheme] > HkdfKey
+         || numRounds < 1 || numRounds > maxRounds )
+    {
+        qWarning(cryptFileDev) << QObject::tr( "Unsupported parameters in the header: %1" ).arg( m_device->fileName() );
         return false;
     }
 
-    QByteArray hash(kHashLength, '\0');
-    int read = istream.readRawData(hash.data(), kHashLength);
-    if (read != kHashLength)
+    // a header without a salt uses the salt of the device
+    const QByteArray salt = ( saltLength > 0 ) ? QByteArray( reinterpret_cast<const char *>( header + kOffsetSalt ), saltLength )
+                                               : m_salt;
+    m_encMethod = static_cast<EncryptionMethod>( method );
+    m_chunkSize = ( method == AesGcmCipher ) ? ( Q_INT64_C( 1 ) << chunkShift ) : 0;
+    if ( static_cast<AesKeyLength>( keyLength ) != m_aesKeyLength || numRounds != m_numRounds
+         || kdf != m_kdf || salt != m_salt )
     {
-        return false;
+        m_aesKeyLength = static_cast<AesKeyLength>( keyLength );
+        m_numRounds = numRounds;
+        m_kdf = kdf;
+        m_salt = salt;
+        m_keyValid = false;
     }
 
-    QByteArray expectedPasswordHash = QCryptographicHash::hash( m_password, QCryptographicHash::Sha3_256 );
-    if (hash != expectedPasswordHash)
+    unsigned char check[kCheckLength];
+    if ( !this->initCipher() || !this->initFileKey( header ) || !this->keyCheckValue( header, check ) )
     {
         return false;
     }
-
-    read = istream.readRawData(hash.data(), kHashLength);
-    if (read != kHashLength)
+    if ( CRYPTO_memcmp( check, header + kOffsetCheck, kCheckLength ) != 0 )
     {
+        qWarning(cryptFileDev) << QObject::tr( "Wrong password for the file: %1" ).arg( m_device->fileName() );
+        m_passwordRejected = true;
         return false;
     }
 
-    QByteArray expectedSaltHash = QCryptographicHash::hash( m_salt, QCryptographicHash::Sha3_256 );
-    if (hash != expectedSaltHash)
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::hasHeader
+ *
+ * Checks, whether the data at the current position of an open device starts with a header
+ * of the current version (magic, version and CRC), without the password.
+ * The position of the device is not changed.
+ *
+ * @param device of the type QIODevice*, the file without the CryptFileDevice
+ *
+ * @retval true if the header is found;
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::hasHeader( QIODevice *device )
+{
+    if ( device == nullptr || !device->isReadable() )
     {
         return false;
     }
+    const QByteArray header = device->peek( kHeaderLength );
+    const unsigned char *data = reinterpret_cast<const unsigned char *>( header.constData() );
+    return ( header.size() == kHeaderLength )
+            && ( data[0] == kHeaderMagic )
+            && ( data[1] == kHeaderVersion )
+            && ( qFromBigEndian<quint32>( data + kOffsetCrc ) == crc32( data, kOffsetCrc ) );
+}
 
-    QByteArray padding(kPaddingLength, '\0');
-    read = istream.readRawData(padding.data(), kPaddingLength);
-    if (read != kPaddingLength)
+/**
+ * @brief CryptFileDevice::keyCheckValue
+ *
+ * Calculates the key check value of a header: HMAC-SHA256 of the fields before it,
+ * keyed with the key of the file.
+ *
+ * @param header of the type unsigned char*, the header
+ * @param check of the type unsigned char*, receives kCheckLength bytes
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::keyCheckValue( const unsigned char *header, unsigned char *check ) const
+{
+    unsigned int length = 0;
+    if ( HMAC( EVP_sha256(), m_fileKey, m_fileKeyBytes, header, kOffsetCheck, check, &length ) == nullptr
+         || length != static_cast<unsigned int>( kCheckLength ) )
     {
+        qCritical(cryptFileDev) << QObject::tr( "Cannot calculate the key check value" );
         return false;
     }
 
-    QByteArray expectedPadding(kPaddingLength, char(0xcd));
-    return ( padding == expectedPadding );
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::initFileKey
+ *
+ * Derives the key and the IV of a file from the master key and the nonce of its header
+ * and prepares the AES key schedule.
+ * - HkdfKey: HKDF-SHA256( master key, salt = nonce ) gives the key and the IV.
+ *   The key of ChaCha20Cipher always has 256 bits, whatever the length of the master key.
+ * - DirectKey: the master key; the nonce is combined with the master IV.
+ * .
+ *
+ * @param header of the type unsigned char*, the header of the file
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::initFileKey( const unsigned char *header )
+{
+    const unsigned char *nonce = header + kOffsetNonce;
+    m_keyScheme = header[kOffsetKeyScheme];
+    if ( m_keyScheme == HkdfKey )
+    {
+        m_fileKeyBytes = ( m_encMethod == ChaCha20Cipher ) ? static_cast<int>( sizeof( m_fileKey ) ) : m_keyBytes;
+        unsigned char material[sizeof( m_fileKey ) + AES_BLOCK_SIZE];
+        if ( !hkdfSha256( m_key, m_keyBytes, nonce, kNonceLength, QByteArray( kFileKeyInfo ),
+                          material, m_fileKeyBytes + AES_BLOCK_SIZE ) )
+        {
+            qCritical(cryptFileDev) << QObject::tr( "Cannot derive the key of the file" );
+            return false;
+        }
+        memcpy( m_fileKey, material, m_fileKeyBytes );
+        memcpy( m_fileIv, material + m_fileKeyBytes, AES_BLOCK_SIZE );
+        OPENSSL_cleanse( material, sizeof( material ) );
+    }
+    else
+    {
+        m_fileKeyBytes = m_keyBytes;
+        memcpy( m_fileKey, m_key, m_keyBytes );
+        for ( int i = 0; i < AES_BLOCK_SIZE; i++ )
+        {
+            m_fileIv[i] = m_iv[i] ^ nonce[i % kNonceLength];
+        }
+    }
+
+    return AES_set_encrypt_key( m_fileKey, m_keyBytes * 8, &m_aesKey ) == 0;
 }
 
 /**
  * @brief CryptFileDevice::close
  *
  * Reimplemented from QIODevice::close().
- * Calls CryptFileDevice::flush() and closes the file.
+ * Calls CryptFileDevice::finish() and closes the file.
  *
  * First emits aboutToClose(), then closes the device and sets its OpenMode to NotOpen.
  * The error string is also reset.
+ * An authenticated file gets its last chunk and the trailer (CryptFileDevice::finishChunks).
  *
- * @note Errors from flush are ignored.
+ * @note close() cannot report an error of the completion, call CryptFileDevice::finish before.
  */
 void CryptFileDevice::close( void )
 {
@@ -394,12 +1374,12 @@ void CryptFileDevice::close( void )
         return;
     }
 
-    if ( (openMode() & WriteOnly) || (openMode() & Append) )
+    this->finish();
+
+    if ( !m_authenticated )
     {
-        flush();
+        this->seek(0);
     }
-
-    this->seek(0);
     m_device->close();
     this->setOpenMode(NotOpen);
 
@@ -407,6 +1387,11 @@ void CryptFileDevice::close( void )
     {
         m_encrypted = false;
     }
+    m_authenticated = false;
+    m_chunkIndex = -1;
+    m_chunk.resize( 0 );
+
+    this->publishStatistics();
 }
 
 /**
@@ -419,6 +1404,15 @@ void CryptFileDevice::setFileName( const QString &fileName )
     if ( m_device )
     {
         m_device->close();
+
+        // The own file object is reused, only a foreign device is replaced.
+        QFile *file = qobject_cast<QFile *>( m_device );
+        if ( m_deviceOwner && file != nullptr )
+        {
+            file->setFileName( fileName );
+            return;
+        }
+
         if ( m_deviceOwner )
         {
             delete m_device;
@@ -428,6 +1422,28 @@ void CryptFileDevice::setFileName( const QString &fileName )
     m_deviceOwner = true;
 }
 
+/**
+ * @brief CryptFileDevice::reset
+ *
+ * Retargets the device to another file: closes the current file and keeps the file object,
+ * the cipher settings and the derived key, so that the next open() neither allocates
+ * nor repeats the key derivation. This is the cheap way to process many small files
+ * with one device.
+ *
+ * @note QIODevice::reset() without a parameter keeps its meaning (seek to the start).
+ *
+ * @param fileName of the type QString &, name of the next file
+ * @retval true if the device is ready to be opened with the new file,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::reset( const QString &fileName )
+{
+    this->close();
+    this->setFileName( fileName );
+
+    return m_device != nullptr;
+}
+
 /**
  * @brief get-function for the fileName
  *
@@ -476,6 +1492,38 @@ bool CryptFileDevice::flush( void )
     return m_device->flush();
 }
 
+/**
+ * @brief CryptFileDevice::finish
+ *
+ * Completes a written file without closing it: an authenticated file gets its last chunk
+ * and the trailer (CryptFileDevice::finishChunks), then the data is flushed to the file.
+ * Nothing may be written afterwards. close() calls it, if it was not called before,
+ * but cannot report an error; a caller, which replaces or removes other files after
+ * the file was written, checks the result of finish() first.
+ *
+ * @retval true if the file is complete, or if it is not open for writing;
+ * @retval false if the last chunk, the trailer or the flush failed (e.g. the disk is full).
+ */
+bool CryptFileDevice::finish( void )
+{
+    if ( !this->isOpen() || !( ( openMode() & WriteOnly ) || ( openMode() & Append ) ) )
+    {
+        return true;
+    }
+
+    if ( !m_finished )
+    {
+        m_finished = true;
+        m_finishOk = !m_authenticated || this->finishChunks();
+        if ( !this->flush() )
+        {
+            qCritical(cryptFileDev) << QObject::tr( "Cannot flush the file: %1" ).arg( m_device->fileName() );
+            m_finishOk = false;
+        }
+    }
+    return m_finishOk;
+}
+
 /**
  * @brief CryptFileDevice::isEncrypted
  *
@@ -490,349 +1538,1574 @@ bool CryptFileDevice::isEncrypted( void ) const
 }
 
 /**
- * @brief CryptFileDevice::readBlock
+ * @brief CryptFileDevice::passwordRejected
  *
- * Reads from the open file into a buffer of length len.
+ * Returns whether the last open() failed, because the file has a valid header,
+ * which does not accept the password. Such a file is encrypted, but not with this password;
+ * it must not be taken for plain data. The flag is kept until the next open().
  *
- * @param len the length of the block
- * @param block a Reference to array of bytes
+ * @retval true if the password is wrong for the file;
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::passwordRejected( void ) const
+{
+    return m_passwordRejected;
+}
+
+/**
+ * @brief CryptFileDevice::digestKey
+ *
+ * Returns the key of the digests of the plain data (HMAC-SHA256, see TreeVerifier):
+ * HKDF-SHA256( master key ) with its own context, so the digests reveal nothing
+ * without the password and the key of the data is not used twice.
+ * Valid after open() derived the master key.
+ *
+ * @return the key, empty if there is no master key (no password)
+ */
+QByteArray CryptFileDevice::digestKey( void ) const
+{
+    if ( !m_keyValid )
+    {
+        return QByteArray();
+    }
+
+    // without a salt, HKDF uses a string of zeros of the length of the hash (RFC 5869)
+    const unsigned char salt[kDigestKeyLength] = {};
+    unsigned char key[kDigestKeyLength];
+    if ( !hkdfSha256( m_key, m_keyBytes, salt, sizeof( salt ), QByteArray( kDigestKeyInfo ), key, kDigestKeyLength ) )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "Key derivation failed" );
+        return QByteArray();
+    }
+    const QByteArray digestKey( reinterpret_cast<const char *>( key ), kDigestKeyLength );
+    OPENSSL_cleanse( key, sizeof( key ) );
+
+    return digestKey;
+}
+
+/**
+ * @brief CryptFileDevice::isAuthenticated
+ *
+ * Returns whether the open file is in the authenticated format (AesGcmCipher).
+ *
+ * @retval true if authenticated;
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::isAuthenticated( void ) const
+{
+    return m_authenticated;
+}
+
+/**
+ * @brief CryptFileDevice::verify
+ *
+ * Authenticates all chunks of a file opened for reading, in parallel batches.
+ * The data is decrypted into a pooled buffer and discarded, the position does not change.
+ *
+ * @retval true if the file is authenticated and all chunks are intact;
+ * @retval false otherwise, the error string names the first damaged chunk.
+ */
+bool CryptFileDevice::verify( void )
+{
+    if ( !m_authenticated || this->isWritable() )
+    {
+        return false;
+    }
+
+    CRYPTO_TRACE_SPAN( "verify", "crypto", this->fileName() );
+    const qint64 batch = qMax( QThread::idealThreadCount(), 1 );
+    PooledBuffer plainText = BufferPool::instance().acquire( qMax( batch * m_chunkSize, Q_INT64_C( 1 ) ) );
+    if ( plainText.isNull() )
+    {
+        this->setErrorString( QObject::tr( "Not enough memory" ) );
+        return false;
+    }
+
+    for ( qint64 first = 0; first < m_chunkCount; first += batch )
+    {
+        if ( !this->openChunks( first, qMin( batch, m_chunkCount - first ), plainText.data() ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::openAuthenticated
+ *
+ * Derives the layout of an authenticated file from its size and opens the trailer:
+ * the header, the chunks (the data of each followed by its tag, only the last one may be shorter)
+ * and the trailer. The trailer is sealed with the index after the last chunk and contains the size
+ * of the data, so a file which is truncated, extended or whose trailer is moved is rejected.
+ *
+ * @retval true if the trailer is authentic and matches the size of the file;
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::openAuthenticated( void )
+{
+    const qint64 stride = m_chunkSize + kTagLength;
+    const qint64 body = m_device->size() - kHeaderLength - kTrailerLength;
+    m_chunkCount = ( body > 0 ) ? ( body + stride - 1 ) / stride : 0;
+    m_plainSize = body - m_chunkCount * kTagLength;
+
+    unsigned char trailer[kTrailerLength];
+    unsigned char size[8];
+    bool ok = ( body >= 0 )
+              && ( m_chunkCount == 0 || body - ( m_chunkCount - 1 ) * stride > kTagLength )
+              && m_device->seek( kHeaderLength + body )
+              && m_device->read( reinterpret_cast<char *>( trailer ), kTrailerLength ) == kTrailerLength
+              && gcmChunk( false, gcmCipherOf( m_aesKeyLength ), m_fileKey, m_fileIv,
+                           static_cast<quint64>( m_chunkCount ), true, trailer, 8, size, trailer + 8 )
+              && qFromBigEndian<quint64>( size ) == static_cast<quint64>( m_plainSize );
+    if ( !ok )
+    {
+        qWarning(cryptFileDev) << QObject::tr( "The authenticated file is truncated or damaged: %1" ).arg( m_device->fileName() );
+        return false;
+    }
+
+    m_authenticated = true;
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::openLegacy
+ *
+ * Prepares the key stream of a file of version 1.0, which has no header: the data starts at the first byte,
+ * the key and the IV are derived with EVP_BytesToKey (kLegacyRounds) and used as they are.
+ * The key stream of XorCipher is taken from the hash of the password and restarts every
+ * m_legacyChunkSize bytes. A wrong password cannot be detected, and the file can only be read.
+ *
+ * @param mode of the flags QIODevice::OpenMode
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::openLegacy( OpenMode mode )
+{
+    if ( mode != ReadOnly || ( m_encMethod != XorCipher && m_encMethod != AesCipher ) )
+    {
+        qWarning(cryptFileDev) << QObject::tr( "A file without a header can only be read with XOR or AES: %1" ).arg( m_device->fileName() );
+        return false;
+    }
+
+    if ( m_kdf != BytesToKey || m_numRounds != kLegacyRounds )
+    {
+        m_kdf = BytesToKey;
+        m_numRounds = kLegacyRounds;
+        m_keyValid = false;
+    }
+    static const unsigned char kNoHeader[kHeaderLength] = {};
+    return m_device->seek( 0 ) && this->initCipher() && this->initFileKey( kNoHeader );
+}
+
+/**
+ * @brief CryptFileDevice::chunkLength
+ * @param index of the type qint64, the index of a chunk
+ * @return the length of the plain data of the chunk; all chunks but the last one are full
+ */
+qint64 CryptFileDevice::chunkLength( qint64 index ) const
+{
+    return qMin( m_chunkSize, m_plainSize - index * m_chunkSize );
+}
+
+/**
+ * @brief CryptFileDevice::openChunks
+ *
+ * Reads count consecutive chunks with one read of the underlying device, authenticates and decrypts
+ * them in parallel into plainText (count full chunks must fit).
+ *
+ * @param first of the type qint64, the index of the first chunk
+ * @param count of the type qint64, the number of chunks
+ * @param plainText of the type char*, receives the data
+ * @retval true if all chunks are authentic;
+ * @retval false otherwise, the error string is set.
+ */
+bool CryptFileDevice::openChunks( qint64 first, qint64 count, char *plainText )
+{
+    const qint64 stride = m_chunkSize + kTagLength;
+    const qint64 plainLength = ( first + count == m_chunkCount ) ? m_plainSize - first * m_chunkSize : count * m_chunkSize;
+    const qint64 rawLength = plainLength + count * kTagLength;
+    PooledBuffer raw = BufferPool::instance().acquire( rawLength );
+    if ( raw.isNull() )
+    {
+        this->setErrorString( QObject::tr( "Not enough memory" ) );
+        return false;
+    }
+    if ( !raw.isRecycled() )
+    {
+        CRYPT_STAT_ADD( allocations, 1 );
+    }
+
+    qint64 readBytes = 0;
+    {
+        CRYPTO_TRACE_SPAN( "device.read", "io" );
+        StatTimer ioTimer( m_stats.ioNsecs );
+        if ( m_device->seek( kHeaderLength + first * stride ) )
+        {
+            while ( readBytes < rawLength )
+            {
+                const qint64 fileRead = m_device->read( raw.data() + readBytes, rawLength - readBytes );
+                if ( fileRead <= 0 )
+                {
+                    break;
+                }
+                readBytes += fileRead;
+            }
+        }
+    }
+    if ( readBytes != rawLength )
+    {
+        this->setErrorString( QObject::tr( "Cannot read the file: %1" ).arg( m_device->errorString() ) );
+        return false;
+    }
+
+    QVector<GcmChunk> chunks( static_cast<int>( count ) );
+    for ( int i = 0; i < chunks.size(); i++ )
+    {
+        GcmChunk &chunk = chunks[i];
+        chunk.length = static_cast<int>( this->chunkLength( first + i ) );
+        chunk.in = reinterpret_cast<const unsigned char *>( raw.data() + i * stride );
+        chunk.tag = reinterpret_cast<unsigned char *>( raw.data() + i * stride + chunk.length );
+        chunk.out = reinterpret_cast<unsigned char *>( plainText + i * m_chunkSize );
+        chunk.index = static_cast<quint64>( first + i );
+        chunk.ok = false;
+    }
+    {
+        CRYPTO_TRACE_SPAN( "decrypt", "crypto" );
+        StatTimer cipherTimer( m_stats.cipherNsecs );
+        ChunkCipher( false, gcmCipherOf( m_aesKeyLength ), m_fileKey, m_fileIv ).run( chunks );
+    }
+
+    for ( int i = 0; i < chunks.size(); i++ )
+    {
+        if ( !chunks.at( i ).ok )
+        {
+            const QString message = QObject::tr( "The chunk %1 of the file is not authentic" ).arg( first + i );
+            qCritical(cryptFileDev) << message << m_device->fileName();
+            this->setErrorString( message );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::sealChunks
+ *
+ * Encrypts the data as consecutive chunks in parallel batches (one chunk per thread of the pool)
+ * and writes every chunk followed by its tag. Only the last chunk of a file may be shorter
+ * than the chunk size.
+ *
+ * @param plainText of the type char*
+ * @param length of the type qint64
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::sealChunks( const char *plainText, qint64 length )
+{
+    const qint64 stride = m_chunkSize + kTagLength;
+    const qint64 batch = qMax( QThread::idealThreadCount(), 1 );
+    for ( qint64 done = 0; done < length; )
+    {
+        const qint64 count = qMin( batch, ( length - done + m_chunkSize - 1 ) / m_chunkSize );
+        const qint64 bytes = qMin( length - done, count * m_chunkSize );
+        const qint64 rawLength = bytes + count * kTagLength;
+        PooledBuffer raw = BufferPool::instance().acquire( rawLength );
+        if ( raw.isNull() )
+        {
+            qCritical(cryptFileDev) << QObject::tr( "Buffer pool: bad allocation memory, execution terminating" );
+            emit errorMessage( QObject::tr( "Bad allocation memory, execution terminating.\n"
+                                            "Advice: try to reduce the size of the buffer!" ) );
+            return false;
+        }
+        if ( !raw.isRecycled() )
+        {
+            CRYPT_STAT_ADD( allocations, 1 );
+        }
+
+        QVector<GcmChunk> chunks( static_cast<int>( count ) );
+        for ( int i = 0; i < chunks.size(); i++ )
+        {
+            GcmChunk &chunk = chunks[i];
+            chunk.length = static_cast<int>( qMin( m_chunkSize, bytes - i * m_chunkSize ) );
+            chunk.in = reinterpret_cast<const unsigned char *>( plainText + done + i * m_chunkSize );
+            chunk.out = reinterpret_cast<unsigned char *>( raw.data() + i * stride );
+            chunk.tag = chunk.out + chunk.length;
+            chunk.index = static_cast<quint64>( m_chunkCount + i );
+            chunk.ok = false;
+        }
+        {
+            CRYPTO_TRACE_SPAN( "encrypt", "crypto" );
+            StatTimer cipherTimer( m_stats.cipherNsecs );
+            ChunkCipher( true, gcmCipherOf( m_aesKeyLength ), m_fileKey, m_fileIv ).run( chunks );
+        }
+        foreach ( const GcmChunk &chunk, chunks )
+        {
+            if ( !chunk.ok )
+            {
+                qCritical(cryptFileDev) << QObject::tr( "Cannot seal the chunk %1" ).arg( chunk.index );
+                return false;
+            }
+        }
+
+        qint64 written;
+        {
+            CRYPTO_TRACE_SPAN( "device.write", "io" );
+            StatTimer ioTimer( m_stats.ioNsecs );
+            written = m_device->write( raw.data(), rawLength );
+        }
+        if ( written != rawLength )
+        {
+            qCritical(cryptFileDev) << QObject::tr( "Write Error: %1, code: %2" ).arg( m_device->errorString() ).arg( m_device->error() );
+            emit errorMessage( QObject::tr( "File: %1\nWrite Error: %2" ).arg( m_device->fileName() ).arg( m_device->errorString() ) );
+            return false;
+        }
+
+        m_chunkCount += count;
+        done += bytes;
+    }
+
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::finishChunks
+ *
+ * Seals the collected data as the last chunk and writes the trailer: the size of the data (8 bytes,
+ * big endian), sealed with the index after the last chunk and the flag of the trailer.
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::finishChunks( void )
+{
+    if ( !m_chunk.isEmpty() && !this->sealChunks( m_chunk.constData(), m_chunk.size() ) )
+    {
+        return false;
+    }
+    m_chunk.resize( 0 );
+
+    unsigned char size[8];
+    unsigned char trailer[kTrailerLength];
+    qToBigEndian<quint64>( static_cast<quint64>( m_plainSize ), size );
+    if ( !gcmChunk( true, gcmCipherOf( m_aesKeyLength ), m_fileKey, m_fileIv,
+                    static_cast<quint64>( m_chunkCount ), true, size, 8, trailer, trailer + 8 )
+         || m_device->write( reinterpret_cast<const char *>( trailer ), kTrailerLength ) != kTrailerLength )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "Cannot write the trailer: %1" ).arg( m_device->fileName() );
+        emit errorMessage( QObject::tr( "File: %1\nWrite Error: %2" ).arg( m_device->fileName() ).arg( m_device->errorString() ) );
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::readBlock
+ *
+ * Reads from the open file into a buffer of length len.
+ *
+ * @param len the length of the block
+ * @param block a Reference to array of bytes
+ *
+ * @return readBytes Number of bytes read
+ */
+qint64 CryptFileDevice::readBlock( qint64 len, QByteArray &block )
+{
+    const int length = block.length();
+    block.resize( length + static_cast<int>( len ) );
+    const qint64 readBytes = this->readDecrypted( block.data() + length, len );
+    block.resize( length + static_cast<int>( readBytes ) );
+
+    return readBytes;
+}
+
+/**
+ * @brief CryptFileDevice::readDecrypted
+ *
+ * Reads up to len bytes from the open file into data and decrypts them in place,
+ * no intermediate buffer is needed. An authenticated file is read by CryptFileDevice::readChunks.
+ *
+ * @param data of the type char*, the destination
+ * @param len the length of the block
+ *
+ * @return readBytes Number of bytes read, -1 if a chunk is not authentic
+ */
+qint64 CryptFileDevice::readDecrypted( char *data, qint64 len )
+{
+    if ( m_authenticated )
+    {
+        return this->readChunks( data, len );
+    }
+
+    qint64 readBytes = 0;
+    {
+        CRYPTO_TRACE_SPAN( "device.read", "io" );
+        StatTimer ioTimer( m_stats.ioNsecs );
+        do
+        {
+            qint64 fileRead = m_device->read( data + readBytes, len - readBytes );
+            if ( fileRead <= 0 )
+            {
+                break;
+            }
+
+            readBytes += fileRead;
+        } while ( readBytes < len );
+    }
+
+    if ( readBytes == 0 )
+    {
+        return 0;
+    }
+
+    CRYPTO_TRACE_SPAN( "decrypt", "crypto" );
+    StatTimer cipherTimer( m_stats.cipherNsecs );
+    this->decrypt( data, readBytes );
+
+    return readBytes;
+}
+
+/**
+ * @brief CryptFileDevice::readChunks
+ *
+ * Reads up to length bytes of an authenticated file from the current position.
+ * Whole chunks are authenticated and decrypted straight into data, in parallel batches;
+ * the parts of the chunks at the edges of the range go through the cached chunk.
+ * Only the chunks of the range are authenticated.
+ *
+ * @param data of the type char*, the destination
+ * @param length of the type qint64
+ * @return the number of bytes read, -1 if a chunk is not authentic
+ */
+qint64 CryptFileDevice::readChunks( char *data, qint64 length )
+{
+    const qint64 batch = qMax( QThread::idealThreadCount(), 1 );
+    qint64 done = 0;
+    while ( done < length && m_plainPos < m_plainSize )
+    {
+        const qint64 index = m_plainPos / m_chunkSize;
+        const qint64 offset = m_plainPos - index * m_chunkSize;
+        const qint64 wanted = qMin( length - done, m_plainSize - m_plainPos );
+
+        qint64 count = 0;
+        qint64 bytes = 0;
+        while ( offset == 0 && count < batch && index + count < m_chunkCount
+                && bytes + this->chunkLength( index + count ) <= wanted )
+        {
+            bytes += this->chunkLength( index + count );
+            count++;
+        }
+
+        if ( count > 0 )
+        {
+            if ( !this->openChunks( index, count, data + done ) )
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            if ( index != m_chunkIndex )
+            {
+                m_chunkIndex = -1;
+                m_chunk.resize( static_cast<int>( this->chunkLength( index ) ) );
+                if ( !this->openChunks( index, 1, m_chunk.data() ) )
+                {
+                    return -1;
+                }
+                m_chunkIndex = index;
+            }
+            bytes = qMin( wanted, m_chunk.size() - offset );
+            memcpy( data + done, m_chunk.constData() + offset, bytes );
+        }
+
+        done += bytes;
+        m_plainPos += bytes;
+    }
+
+    return done;
+}
+
+/**
+ * @brief CryptFileDevice::writeChunks
+ *
+ * Collects the data of an authenticated file into chunks: whole chunks are sealed straight
+ * from data (CryptFileDevice::sealChunks), the rest waits for the next write or for close().
+ * The data is written in sequence, see CryptFileDevice::seek.
+ *
+ * @param data of the type char*
+ * @param length of the type qint64
+ * @return length, or -1 if an error occurred
+ */
+qint64 CryptFileDevice::writeChunks( const char *data, qint64 length )
+{
+    qint64 done = 0;
+    if ( !m_chunk.isEmpty() )
+    {
+        done = qMin( length, m_chunkSize - m_chunk.size() );
+        m_chunk.append( data, static_cast<int>( done ) );
+        if ( m_chunk.size() == m_chunkSize )
+        {
+            if ( !this->sealChunks( m_chunk.constData(), m_chunkSize ) )
+            {
+                return -1;
+            }
+            m_chunk.resize( 0 );
+        }
+    }
+
+    const qint64 whole = ( length - done ) / m_chunkSize * m_chunkSize;
+    if ( whole > 0 && !this->sealChunks( data + done, whole ) )
+    {
+        return -1;
+    }
+    done += whole;
+    m_chunk.append( data + done, static_cast<int>( length - done ) );
+
+    m_plainSize += length;
+    m_plainPos = m_plainSize;
+    return length;
+}
+
+/**
+ * @brief CryptFileDevice::readData
+ *
+ * Reimplemented from QIODevice::readData()
+ *
+ * Reads up to len bytes from the device into data,
+ * and returns the number of bytes read or -1 if an error occurred.
+ *
+ * @note
+ * - When reimplementing this function it is important that this function
+ * reads all the required data before returning.
+ * This is required in order for QDataStream to be able to operate on the class.
+ * QDataStream assumes all the requested information was read and
+ * therefore does not retry reading if there was a problem.
+ * - This function might be called with a len of 0,
+ * which can be used to perform post-reading operations.
+ *
+ * @param data of the type char*
+ * @param len the length of the data
+ *
+ * @return the number of bytes read or -1 if an error occurred.
+ */
+qint64 CryptFileDevice::readData( char *data, qint64 len )
+{
+    CRYPT_STAT_ADD( readCalls, 1 );
+    if ( !m_encrypted || len == 0 )
+    {
+        StatTimer ioTimer( m_stats.ioNsecs );
+        qint64 read = m_device->read( data, len );
+        CRYPT_STAT_ADD( readBytes, qMax( read, 0LL ) );
+        return read;
+    }
+
+    const qint64 read = this->readDecrypted( data, len );
+    CRYPT_STAT_ADD( readBytes, qMax( read, 0LL ) );
+
+    return read;
+}
+
+/**
+ * @brief CryptFileDevice::writeData
+ *
+ * Reimplemented from QIODevice::writeData().
+ *
+ * Writes up to length bytes from data to the device.
+ * Returns the number of bytes written, or -1 if an error occurred.
+ *
+ * @note When reimplementing this function it is important that this function
+ * writes all the data available before returning.
+ * This is required in order for QDataStream to be able to operate on the class.
+ * QDataStream assumes all the information was written and therefore does not retry
+ * writing if there was a problem.
+ *
+ * @param data of the type char*
+ * @param length the length of the data
+ * @return the number of bytes written, or -1 if an error occurred.
+ */
+qint64 CryptFileDevice::writeData( const char *data, qint64 length )
+{
+    CRYPT_STAT_ADD( writeCalls, 1 );
+    if ( !m_encrypted )
+    {
+        StatTimer ioTimer( m_stats.ioNsecs );
+        qint64 written = m_device->write( data, length );
+        CRYPT_STAT_ADD( writeBytes, qMax( written, 0LL ) );
+        return written;
+    }
+
+    if ( m_authenticated )
+    {
+        const qint64 written = this->writeChunks( data, length );
+        CRYPT_STAT_ADD( writeBytes, qMax( written, 0LL ) );
+        return written;
+    }
+
+    if ( !this->streamCovers( this->pos(), length ) )
+    {
+        this->setErrorString( QObject::tr( "The file is too large for the key stream" ) );
+        return -1;
+    }
+
+    PooledBuffer cipherText = BufferPool::instance().acquire( length );
+    if ( cipherText.isNull() )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "Buffer pool: bad allocation memory, execution terminating" );
+        emit errorMessage( QObject::tr( "Bad allocation memory, execution terminating.\n"
+                                        "Advice: try to reduce the size of the buffer!" ) );
+        return -1;
+    }
+    if ( !cipherText.isRecycled() )
+    {
+        CRYPT_STAT_ADD( allocations, 1 );
+    }
+    {
+        CRYPTO_TRACE_SPAN( "encrypt", "crypto" );
+        StatTimer cipherTimer( m_stats.cipherNsecs );
+        this->encrypt( data, cipherText.data(), length );
+    }
+    {
+        CRYPTO_TRACE_SPAN( "device.write", "io" );
+        StatTimer ioTimer( m_stats.ioNsecs );
+        m_device->write( cipherText.data(), length );
+    }
+    CRYPT_STAT_ADD( writeBytes, length );
+
+    if ( m_device->error() != 0 )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "Write Error: %1, code: %2" ).arg( m_device->errorString() ).arg( m_device->error() );
+        emit errorMessage( QObject::tr( "File: %1\nWrite Error: %2" ).arg( m_device->fileName() ).arg( m_device->errorString() ) );
+    }
+    return length;
+}
+
+/**
+ * @brief CryptFileDevice::initCtr
+ *
+ * Initializes specific parameters for AES encoding.
+ * And ends up calling the AES_encrypt(const unsigned char *in, unsigned char *out, const AES_KEY *key) function.
+ *
+ * @param state of the type CtrState*
+ * @param iv of the type unsigned char*
+ * @param position of the type qint64, position in the data (without the header)
+ */
+void CryptFileDevice::initCtr( CtrState *state, const unsigned char *iv, qint64 position )
+{
+    CRYPT_STAT_ADD( ctrInits, 1 );
+    this->ctrStateAt( state, iv, position );
+}
+
+/**
+ * @brief CryptFileDevice::ctrStateAt
+ *
+ * Computes the AES-CTR state of AES_ctr128_encrypt at position, without changing the device.
+ *
+ * @param state of the type CtrState*, receives the state
+ * @param iv of the type unsigned char*, the first 8 bytes are the prefix of the counter blocks
+ * @param position of the type qint64, position in the data (without the header)
+ */
+void CryptFileDevice::ctrStateAt( CtrState *state, const unsigned char *iv, qint64 position ) const
+{
+    state->num = position % AES_BLOCK_SIZE;
+
+    memset( state->ecount, 0, sizeof(state->ecount) );
+
+    /* Initialise counter in 'ivec' */
+    qint64 count = position / AES_BLOCK_SIZE;
+    if ( state->num > 0 )
+    {
+        count++;
+    }
+
+    qint64 newCount = count;
+    if ( newCount > 0 )
+    {
+        newCount = qToBigEndian(count);
+    }
+
+    int sizeOfIv = sizeof( state->ivec ) - sizeof( qint64 );
+    memcpy( state->ivec + sizeOfIv, &newCount, sizeof( newCount ) );
+
+    /* Copy IV into 'ivec' */
+    memcpy( state->ivec, iv, sizeOfIv );
+
+    if ( count > 0 )
+    {
+        count = qToBigEndian( count - 1 );
+        unsigned char prevIvec[ AES_BLOCK_SIZE ];
+        memcpy( prevIvec, state->ivec, sizeOfIv );
+
+        memcpy( prevIvec + sizeOfIv, &count, sizeof( count ) );
+
+        AES_encrypt( prevIvec, state->ecount, &m_aesKey );
+    }
+}
+
+/**
+ * @brief applyCipher
+ *
+ * XORs length bytes of in with the key stream of ctx into out. The buffers may be the same.
+ *
+ * @param ctx of the type EVP_CIPHER_CTX*
+ * @param in of the type unsigned char*
+ * @param out of the type unsigned char*
+ * @param length of the type qint64
+ */
+static void applyCipher( EVP_CIPHER_CTX *ctx, const unsigned char *in, unsigned char *out, qint64 length )
+{
+    while ( length > 0 )
+    {
+        const int part = static_cast<int>( qMin( length, static_cast<qint64>( std::numeric_limits<int>::max() ) ) );
+        int outLength = 0;
+        EVP_CipherUpdate( ctx, out, &outLength, in, part );
+        in += part;
+        out += part;
+        length -= part;
+    }
+}
+
+/**
+ * @brief cipherOf
+ * @param keyLength of the type CryptFileDevice::AesKeyLength
+ * @return the AES-CTR cipher of the key length
+ */
+static const EVP_CIPHER *cipherOf( CryptFileDevice::AesKeyLength keyLength )
+{
+    if ( keyLength == CryptFileDevice::AesKeyLength::kAesKeyLength128 )
+    {
+        return EVP_aes_128_ctr();
+    }
+    if ( keyLength == CryptFileDevice::AesKeyLength::kAesKeyLength192 )
+    {
+        return EVP_aes_192_ctr();
+    }
+    Q_ASSERT_X( keyLength == CryptFileDevice::AesKeyLength::kAesKeyLength256, Q_FUNC_INFO, "Unknown value of AesKeyLength" );
+    return EVP_aes_256_ctr();
+}
+
+/**
+ * @brief CryptFileDevice::initStream
+ *
+ * Positions the EVP key stream (ChaCha20Cipher, or AesCipher with the EvpBackend) at position
+ * of the data: the block counter is position / block length, the rest of the block is discarded.
+ * The AES counter blocks are the same as those of CryptFileDevice::initCtr.
+ *
+ * @param position of the type qint64, position in the data (without the header)
+ * @retval true if successful,
+ * @retval false if the cipher is not available or the position is beyond the key stream.
+ */
+bool CryptFileDevice::initStream( qint64 position )
+{
+    CRYPT_STAT_ADD( ctrInits, 1 );
+    if ( m_streamCtx == nullptr )
+    {
+        m_streamCtx = EVP_CIPHER_CTX_new();
+    }
+
+    return ( m_streamCtx != nullptr ) && this->streamAt( m_streamCtx, position );
+}
+
+/**
+ * @brief CryptFileDevice::streamAt
+ *
+ * Initialises ctx with the EVP key stream of the file at position, without changing the device.
+ *
+ * @param ctx of the type EVP_CIPHER_CTX*
+ * @param position of the type qint64, position in the data (without the header)
+ * @retval true if successful,
+ * @retval false if the cipher is not available or the position is beyond the key stream.
+ */
+bool CryptFileDevice::streamAt( EVP_CIPHER_CTX *ctx, qint64 position ) const
+{
+    const bool chacha = ( m_encMethod == ChaCha20Cipher );
+    const int blockLength = chacha ? kChaChaBlockLength : AES_BLOCK_SIZE;
+    const qint64 block = position / blockLength;
+    if ( position < 0 || ( chacha && position >= kChaChaStreamLength ) )
+    {
+        qWarning(cryptFileDev) << QObject::tr( "The position %1 is beyond the key stream" ).arg( position );
+        return false;
+    }
+
+    const EVP_CIPHER *cipher = nullptr;
+    unsigned char iv[AES_BLOCK_SIZE];
+    if ( chacha )
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+        cipher = EVP_chacha20();
+        qToLittleEndian<quint32>( static_cast<quint32>( block ), iv );
+        memcpy( iv + 4, m_fileIv, kChaChaNonceLength );
+#endif
+    }
+    else
+    {
+        cipher = cipherOf( m_aesKeyLength );
+        memcpy( iv, m_fileIv, AES_BLOCK_SIZE - sizeof( qint64 ) );
+        qToBigEndian<quint64>( static_cast<quint64>( block ), iv + AES_BLOCK_SIZE - sizeof( qint64 ) );
+    }
+
+    if ( cipher == nullptr || EVP_CipherInit_ex( ctx, cipher, nullptr, m_fileKey, iv, 1 ) != 1 )
+    {
+        qCritical(cryptFileDev) << QObject::tr( "Cannot initialise the cipher" );
+        return false;
+    }
+
+    const int skip = static_cast<int>( position % blockLength );
+    if ( skip > 0 )
+    {
+        unsigned char discard[kChaChaBlockLength] = {};
+        applyCipher( ctx, discard, discard, skip );
+    }
+
+    return true;
+}
+
+/**
+ * @brief CryptFileDevice::streamCovers
+ *
+ * Checks that the key stream covers length bytes at position. The block counter of ChaCha20Cipher
+ * has 32 bits, past the end of the key stream it would wrap and repeat the key stream of the start
+ * of the file, so such data is not transformed. The other methods have no limit within qint64.
+ *
+ * @param position of the type qint64, position in the data (without the header)
+ * @param length of the type qint64
+ * @retval true if the key stream covers the range,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::streamCovers( qint64 position, qint64 length ) const
+{
+    if ( m_encMethod != ChaCha20Cipher || ( position >= 0 && length >= 0 && length <= kChaChaStreamLength - position ) )
+    {
+        return true;
+    }
+
+    qWarning(cryptFileDev) << QObject::tr( "The data at %1 (%2 bytes) is beyond the key stream" ).arg( position ).arg( length );
+    return false;
+}
+
+/**
+ * @brief CryptFileDevice::applyStream
+ *
+ * XORs length bytes of in with the EVP key stream into out. The buffers may be the same.
+ *
+ * @param in of the type unsigned char*
+ * @param out of the type unsigned char*
+ * @param length of the type qint64
+ */
+void CryptFileDevice::applyStream( const unsigned char *in, unsigned char *out, qint64 length )
+{
+    applyCipher( m_streamCtx, in, out, length );
+}
+
+/**
+ * @brief xorBytes
+ *
+ * out = in XOR key, eight bytes at a time. The words are loaded with memcpy, so the buffers
+ * need no alignment and the compiler can vectorise the loop.
+ *
+ * @param in of the type unsigned char*
+ * @param key of the type unsigned char*
+ * @param out of the type unsigned char*, may be in
+ * @param length of the type qint64
+ */
+static inline void xorBytes( const unsigned char *in, const unsigned char *key, unsigned char *out, qint64 length )
+{
+    qint64 i = 0;
+    for ( ; i + 8 <= length; i += 8 )
+    {
+        quint64 word;
+        quint64 keyWord;
+        memcpy( &word, in + i, 8 );
+        memcpy( &keyWord, key + i, 8 );
+        word ^= keyWord;
+        memcpy( out + i, &word, 8 );
+    }
+    for ( ; i < length; i++ )
+    {
+        out[i] = in[i] ^ key[i];
+    }
+}
+
+/**
+ * @brief xorAt
+ *
+ * XORs length bytes of in with the key stream of XorCipher at position into out.
+ *
+ * @param table of the type unsigned char*, one period (kXorPeriod bytes) of the key stream
+ * @param restart of the type qint64, the key stream restarts every restart bytes (files of version 1.0), 0 never
+ * @param position of the type qint64, position of the first byte in the data
+ * @param in of the type unsigned char*
+ * @param out of the type unsigned char*, may be in
+ * @param length of the type qint64
+ */
+static void xorAt( const unsigned char *table, qint64 restart, qint64 position,
+                   const unsigned char *in, unsigned char *out, qint64 length )
+{
+    while ( length > 0 )
+    {
+        const qint64 key = ( restart > 0 ) ? position % restart : position;
+        qint64 part = qMin( length, kXorPeriod - key % kXorPeriod );
+        if ( restart > 0 )
+        {
+            part = qMin( part, restart - key );
+        }
+        xorBytes( in, table + key % kXorPeriod, out, part );
+        in += part;
+        out += part;
+        position += part;
+        length -= part;
+    }
+}
+
+/**
+ * @brief CryptFileDevice::transform
+ *
+ * The transform of a method and a backend: XORs length bytes of in with the key stream
+ * at the current position into out and advances the position. The buffers may be the same.
+ * The primary template is the EVP key stream (AesCipher with the EvpBackend, ChaCha20Cipher),
+ * see CryptFileDevice::initStream.
+ *
+ * @param in of the type unsigned char*
+ * @param out of the type unsigned char*
+ * @param length of the type qint64
+ */
+template <CryptFileDevice::EncryptionMethod kMethod, CryptFileDevice::Backend kBackend>
+void CryptFileDevice::transform( const unsigned char *in, unsigned char *out, qint64 length )
+{
+    Q_STATIC_ASSERT( kBackend == EvpBackend );
+    this->applyStream( in, out, length );
+}
+
+/**
+ * @brief CryptFileDevice::transform<AesCipher, PortableBackend>
+ *
+ * AES-CTR with AES_ctr128_encrypt and the counter state of CryptFileDevice::initCtr.
+ */
+template <>
+void CryptFileDevice::transform<CryptFileDevice::AesCipher, CryptFileDevice::PortableBackend>( const unsigned char *in,
+                                                                                              unsigned char *out,
+                                                                                              qint64 length )
+{
+    AES_ctr128_encrypt( in, out, static_cast<size_t>( length ), &m_aesKey, m_ctrState.ivec, m_ctrState.ecount, &m_ctrState.num );
+}
+
+/**
+ * @brief CryptFileDevice::transform<XorCipher, PortableBackend>
+ *
+ * The key stream of the byte at the position p is hash[p % 64] ^ ( p % 251 ), it repeats
+ * every kXorPeriod bytes and is read from the table built by CryptFileDevice::initTransform.
+ * The hash is SHA3-512 of the key and the IV of the file, so every file has its own key stream;
+ * files of version 1.0 and without a derived key (DirectKey) use the hash of the password.
+ */
+template <>
+void CryptFileDevice::transform<CryptFileDevice::XorCipher, CryptFileDevice::PortableBackend>( const unsigned char *in,
+                                                                                              unsigned char *out,
+                                                                                              qint64 length )
+{
+    xorAt( reinterpret_cast<const unsigned char *>( m_xorTable.constData() ), m_legacy ? m_legacyChunkSize : 0,
+           m_xorPos, in, out, length );
+    m_xorPos += length;
+}
+
+/**
+ * @brief CryptFileDevice::initTransform
+ *
+ * Selects the transform of the method and the backend (m_backend) once, when the file is opened,
+ * and positions its key stream at the start of the data. encrypt() and decrypt() call it
+ * through m_transform and do not branch on the method. AesGcmCipher seals whole chunks
+ * and has no transform.
+ *
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::initTransform( void )
+{
+    switch ( m_encMethod )
+    {
+    case XorCipher:
+    {
+        QByteArray hash;
+        if ( !m_legacy && m_keyScheme == HkdfKey )
+        {
+            QCryptographicHash material( QCryptographicHash::Sha3_512 );
+            material.addData( reinterpret_cast<const char *>( m_fileKey ), m_fileKeyBytes );
+            material.addData( reinterpret_cast<const char *>( m_fileIv ), AES_BLOCK_SIZE );
+            hash = material.result();
+        }
+        else
+        {
+            hash = QCryptographicHash::hash( m_password, QCryptographicHash::Sha3_512 );
+        }
+        Q_ASSERT( hash.size() == kXorHashLength );
+        m_xorTable.resize( static_cast<int>( kXorPeriod ) );
+        for ( int i = 0; i < kXorPeriod; i++ )
+        {
+            m_xorTable[i] = static_cast<char>( hash.at( i % kXorHashLength ) ^ ( i % 251 ) );
+        }
+        m_transform = &CryptFileDevice::transform<XorCipher, PortableBackend>;
+        break;
+    }
+    case AesCipher:
+        m_transform = ( m_backend == EvpBackend ) ? &CryptFileDevice::transform<AesCipher, EvpBackend>
+                                                  : &CryptFileDevice::transform<AesCipher, PortableBackend>;
+        break;
+    case ChaCha20Cipher:
+        m_transform = &CryptFileDevice::transform<ChaCha20Cipher, EvpBackend>;
+        break;
+    default:
+        m_transform = nullptr;
+        return true;
+    }
+
+    return this->initKeyStream( 0 );
+}
+
+/**
+ * @brief CryptFileDevice::initKeyStream
+ *
+ * Positions the key stream of the selected transform at position of the data.
+ *
+ * @param position of the type qint64, position in the data (without the header)
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::initKeyStream( qint64 position )
+{
+    if ( m_transform == &CryptFileDevice::transform<AesCipher, PortableBackend> )
+    {
+        this->initCtr( &m_ctrState, m_fileIv, position );
+        return true;
+    }
+    if ( m_transform == &CryptFileDevice::transform<XorCipher, PortableBackend> )
+    {
+        CRYPT_STAT_ADD( ctrInits, 1 );
+        m_xorPos = position;
+        return true;
+    }
+    return ( m_transform == nullptr ) || this->initStream( position );
+}
+
+/**
+ * @brief CryptFileDevice::transformAt
+ *
+ * Encrypts or decrypts length bytes at position with the transform of the open file.
+ * The key stream is computed locally, the state of the device is not changed,
+ * so the function can run in several threads at once. Nothing is read or written:
+ * Rekeyer decrypts with the device of the old key and encrypts with the device of the new one.
+ * An authenticated file has no key stream, the function fails.
+ *
+ * @param position of the type qint64, position in the data (without the header)
+ * @param in of the type unsigned char*
+ * @param out of the type unsigned char*, may be in
+ * @param length of the type qint64
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::transformAt( qint64 position, const unsigned char *in, unsigned char *out, qint64 length ) const
+{
+    if ( m_transform == &CryptFileDevice::transform<XorCipher, PortableBackend> )
+    {
+        xorAt( reinterpret_cast<const unsigned char *>( m_xorTable.constData() ), m_legacy ? m_legacyChunkSize : 0,
+               position, in, out, length );
+        return true;
+    }
+    if ( m_transform == &CryptFileDevice::transform<AesCipher, PortableBackend> )
+    {
+        CtrState state;
+        this->ctrStateAt( &state, m_fileIv, position );
+        AES_ctr128_encrypt( in, out, static_cast<size_t>( length ), &m_aesKey, state.ivec, state.ecount, &state.num );
+        return true;
+    }
+    if ( m_transform == nullptr )
+    {
+        return false;
+    }
+
+    if ( !this->streamCovers( position, length ) )
+    {
+        return false;
+    }
+
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    const bool ok = ( ctx != nullptr ) && this->streamAt( ctx, position );
+    if ( ok )
+    {
+        applyCipher( ctx, in, out, length );
+    }
+    EVP_CIPHER_CTX_free( ctx );
+    return ok;
+}
+
+/**
+ * @brief readFileAt
+ *
+ * Reads up to length bytes at offset of the file with positional I/O (pread, ReadFile with OVERLAPPED).
+ *
+ * @param device of the type QFileDevice*, an open file
+ * @param offset of the type qint64, offset in the file
+ * @param data of the type char*, the destination
+ * @param length of the type qint64
+ * @return number of bytes read, less than length at the end of the file; -1 on an error
+ */
+static qint64 readFileAt( const QFileDevice *device, qint64 offset, char *data, qint64 length )
+{
+    const int fd = device->handle();
+    if ( fd < 0 )
+    {
+        return -1;
+    }
+
+    qint64 done = 0;
+    while ( done < length )
+    {
+        const qint64 part = qMin( length - done, kMaxPositionalIo );
+#if defined( Q_OS_WIN )
+        HANDLE file = reinterpret_cast<HANDLE>( _get_osfhandle( fd ) );
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>( static_cast<quint64>( offset + done ) );
+        overlapped.OffsetHigh = static_cast<DWORD>( static_cast<quint64>( offset + done ) >> 32 );
+        DWORD count = 0;
+        if ( !ReadFile( file, data + done, static_cast<DWORD>( part ), &count, &overlapped ) )
+        {
+            if ( GetLastError() == ERROR_HANDLE_EOF )
+            {
+                break;
+            }
+            return -1;
+        }
+        const qint64 result = count;
+#else
+        const qint64 result = ::pread( fd, data + done, static_cast<size_t>( part ), static_cast<off_t>( offset + done ) );
+        if ( result < 0 && errno == EINTR )
+        {
+            continue;
+        }
+        if ( result < 0 )
+        {
+            return -1;
+        }
+#endif
+        if ( result == 0 )
+        {
+            break;
+        }
+        done += result;
+    }
+
+    return done;
+}
+
+/**
+ * @brief writeFileAt
+ *
+ * Writes length bytes at offset of the file with positional I/O (pwrite, WriteFile with OVERLAPPED).
+ *
+ * @param device of the type QFileDevice*, a file open for writing
+ * @param offset of the type qint64, offset in the file
+ * @param data of the type char*
+ * @param length of the type qint64
+ * @return length if successful, -1 on an error
+ */
+static qint64 writeFileAt( const QFileDevice *device, qint64 offset, const char *data, qint64 length )
+{
+    const int fd = device->handle();
+    if ( fd < 0 )
+    {
+        return -1;
+    }
+
+    qint64 done = 0;
+    while ( done < length )
+    {
+        const qint64 part = qMin( length - done, kMaxPositionalIo );
+#if defined( Q_OS_WIN )
+        HANDLE file = reinterpret_cast<HANDLE>( _get_osfhandle( fd ) );
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>( static_cast<quint64>( offset + done ) );
+        overlapped.OffsetHigh = static_cast<DWORD>( static_cast<quint64>( offset + done ) >> 32 );
+        DWORD count = 0;
+        if ( !WriteFile( file, data + done, static_cast<DWORD>( part ), &count, &overlapped ) )
+        {
+            return -1;
+        }
+        const qint64 result = count;
+#else
+        const qint64 result = ::pwrite( fd, data + done, static_cast<size_t>( part ), static_cast<off_t>( offset + done ) );
+        if ( result < 0 && errno == EINTR )
+        {
+            continue;
+        }
+#endif
+        if ( result <= 0 )
+        {
+            return -1;
+        }
+        done += result;
+    }
+
+    return done;
+}
+
+/**
+ * @brief CryptFileDevice::readAt
+ *
+ * Reads up to length bytes at offset of the data into data, like pread(). The position of the device
+ * (pos()) is not used and not changed, the key stream is computed from the offset. Several threads
+ * may call readAt and writeAt on the same open device at once.
+ * Chunks of an authenticated file are authenticated before they are returned.
+ *
+ * @note Data written with write() is seen after flush(). readAt and writeAt bypass the buffers
+ * of the device; on Windows they move the file pointer, so do not mix them with read() and write()
+ * without seek().
  *
- * @return readBytes Number of bytes read
+ * @param offset of the type qint64, position in the data (without the header)
+ * @param data of the type char*, the destination
+ * @param length of the type qint64
+ * @return number of bytes read, less than length at the end of the data; -1 on an error
  */
-qint64 CryptFileDevice::readBlock( qint64 len, QByteArray &block )
+qint64 CryptFileDevice::readAt( qint64 offset, char *data, qint64 length ) const
 {
-    int length = block.length();
-    qint64 readBytes = 0;
-    do
+    if ( !this->isReadable() || offset < 0 || length < 0 )
     {
-        qint64 fileRead = m_device->read( block.data() + block.length(), len - readBytes );
-        if ( fileRead <= 0 )
-        {
-            break;
-        }
-
-        readBytes += fileRead;
-    } while ( readBytes < len );
-
-    if ( readBytes == 0 )
+        return -1;
+    }
+    if ( m_authenticated )
     {
-        return 0;
+        return this->readChunksAt( offset, data, length );
     }
 
-    QScopedPointer<char> plaintext( decrypt( block.data() + length, readBytes ) );
-
-    block.append( plaintext.data(), readBytes );
+    const qint64 headerLength = m_encrypted ? m_headerLength : 0;
+    const qint64 readBytes = readFileAt( m_device, headerLength + offset, data, length );
+    if ( readBytes <= 0 || !m_encrypted )
+    {
+        return readBytes;
+    }
 
-    return readBytes;
+    unsigned char *text = reinterpret_cast<unsigned char *>( data );
+    return this->transformAt( offset, text, text, readBytes ) ? readBytes : -1;
 }
 
 /**
- * @brief CryptFileDevice::readData
- *
- * Reimplemented from QIODevice::readData()
- *
- * Reads up to len bytes from the device into data,
- * and returns the number of bytes read or -1 if an error occurred.
+ * @brief CryptFileDevice::writeAt
  *
- * @note
- * - When reimplementing this function it is important that this function
- * reads all the required data before returning.
- * This is required in order for QDataStream to be able to operate on the class.
- * QDataStream assumes all the requested information was read and
- * therefore does not retry reading if there was a problem.
- * - This function might be called with a len of 0,
- * which can be used to perform post-reading operations.
+ * Encrypts length bytes of data and writes them at offset of the data, like pwrite().
+ * The position of the device is not used and not changed. An authenticated file is written
+ * in sequence only and is rejected.
  *
+ * @param offset of the type qint64, position in the data (without the header)
  * @param data of the type char*
- * @param len the length of the data
- *
- * @return the number of bytes read or -1 if an error occurred.
+ * @param length of the type qint64
+ * @return length if successful, -1 on an error
  */
-qint64 CryptFileDevice::readData( char *data, qint64 len )
+qint64 CryptFileDevice::writeAt( qint64 offset, const char *data, qint64 length ) const
 {
+    if ( !this->isWritable() || offset < 0 || length < 0 )
+    {
+        return -1;
+    }
+    if ( m_authenticated )
+    {
+        qWarning(cryptFileDev) << QObject::tr( "An authenticated file is written in sequence, cannot write at %1" ).arg( offset );
+        return -1;
+    }
     if ( !m_encrypted )
     {
-        return m_device->read( data, len );
+        return writeFileAt( m_device, offset, data, length );
     }
 
-    if ( len == 0 )
+    PooledBuffer cipherText = BufferPool::instance().acquire( length );
+    if ( cipherText.isNull()
+         || !this->transformAt( offset, reinterpret_cast<const unsigned char *>( data ),
+                                reinterpret_cast<unsigned char *>( cipherText.data() ), length ) )
     {
-        return m_device->read( data, len );
+        return -1;
     }
 
-    QByteArray ba;
-    ba.reserve( len );
-    do
-    {
-        qint64 maxSize = len - ba.length();
+    return writeFileAt( m_device, m_headerLength + offset, cipherText.data(), length );
+}
 
-        qint64 size = readBlock(maxSize, ba);
+/**
+ * @brief CryptFileDevice::readChunksAt
+ *
+ * CryptFileDevice::readAt of an authenticated file: every chunk, which the range touches,
+ * is read with positional I/O, authenticated and decrypted into a buffer of the call.
+ *
+ * @param offset of the type qint64, position in the data
+ * @param data of the type char*, the destination
+ * @param length of the type qint64
+ * @return number of bytes read; -1 if a chunk cannot be read or is not authentic
+ */
+qint64 CryptFileDevice::readChunksAt( qint64 offset, char *data, qint64 length ) const
+{
+    length = qMax( Q_INT64_C( 0 ), qMin( length, m_plainSize - offset ) );
+    const qint64 stride = m_chunkSize + kTagLength;
+    PooledBuffer chunk = BufferPool::instance().acquire( stride );
+    if ( chunk.isNull() )
+    {
+        return -1;
+    }
 
-        if ( size == 0 )
+    unsigned char *raw = reinterpret_cast<unsigned char *>( chunk.data() );
+    qint64 done = 0;
+    while ( done < length )
+    {
+        const qint64 index = ( offset + done ) / m_chunkSize;
+        const qint64 chunkLength = this->chunkLength( index );
+        if ( readFileAt( m_device, kHeaderLength + index * stride, chunk.data(), chunkLength + kTagLength ) != chunkLength + kTagLength
+             || !gcmChunk( false, gcmCipherOf( m_aesKeyLength ), m_fileKey, m_fileIv, static_cast<quint64>( index ), false,
+                           raw, static_cast<int>( chunkLength ), raw, raw + chunkLength ) )
         {
-            break;
+            qWarning(cryptFileDev) << QObject::tr( "The chunk %1 of the file is not authentic" ).arg( index );
+            return -1;
         }
-    } while ( ba.length() < len );
 
-    if ( ba.isEmpty() )
-    {
-        return 0;
+        const qint64 skip = offset + done - index * m_chunkSize;
+        const qint64 part = qMin( chunkLength - skip, length - done );
+        memcpy( data + done, raw + skip, static_cast<size_t>( part ) );
+        done += part;
     }
 
-    memcpy( data, ba.data(), ba.length() );
-
-    return ba.length();
+    return done;
 }
 
 /**
- * @brief CryptFileDevice::writeData
+ * @brief CryptFileDevice::keyId
  *
- * Reimplemented from QIODevice::writeData().
+ * Identifies a derived key by a SHA-256 of its parameters and the password,
+ * the password itself is not kept in the cache.
  *
- * Writes up to length bytes from data to the device.
- * Returns the number of bytes written, or -1 if an error occurred.
+ * @return the identifier of the type QByteArray
+ */
+QByteArray CryptFileDevice::keyId( const QByteArray &password,
+                                   const QByteArray &salt,
+                                   KeyDerivation kdf,
+                                   int numRounds,
+                                   AesKeyLength keyLength )
+{
+    QByteArray parameters;
+    parameters += char( kdf );
+    parameters += char( keyLength );
+    parameters += QByteArray::number( numRounds );
+    parameters += char( salt.length() );
+
+    QCryptographicHash hash( QCryptographicHash::Sha256 );
+    hash.addData( parameters );
+    hash.addData( salt );
+    hash.addData( password );
+    return hash.result();
+}
+
+/**
+ * @brief CryptFileDevice::deriveKey
  *
- * @note When reimplementing this function it is important that this function
- * writes all the data available before returning.
- * This is required in order for QDataStream to be able to operate on the class.
- * QDataStream assumes all the information was written and therefore does not retry
- * writing if there was a problem.
+ * Derives the key and the IV, as a device with these settings does in open().
+ * The function does not use a device, it may be called in any thread (e.g. by QtConcurrent::run)
+ * to derive the key in advance; the result is handed to CryptFileDevice::cacheKey.
  *
- * @param data of the type char*
- * @param length the length of the data
- * @return the number of bytes written, or -1 if an error occurred.
+ * @param password of the type QByteArray &
+ * @param salt of the type QByteArray &, it is truncated as by CryptFileDevice::setSalt
+ * @param kdf of the type CryptFileDevice::KeyDerivation
+ * @param numRounds of the type int, the cost
+ * @param keyLength of the type CryptFileDevice::AesKeyLength
+ * @return the derived key, a null key on error
  */
-qint64 CryptFileDevice::writeData( const char *data, qint64 length )
+DerivedKey CryptFileDevice::deriveKey( const QByteArray &password,
+                                       const QByteArray &salt,
+                                       KeyDerivation kdf,
+                                       int numRounds,
+                                       AesKeyLength keyLength )
 {
-    if ( !m_encrypted )
-    {
-        return m_device->write( data, length );
-    }
+    const QByteArray usedSalt = salt.mid( 0, kSaltMaxLength );
+    const EVP_CIPHER *cipher = cipherOf( keyLength );
+    unsigned char key[EVP_MAX_KEY_LENGTH];
+    unsigned char iv[EVP_MAX_IV_LENGTH];
 
-    QScopedPointer<char, QScopedPointerArrayDeleter<char> > cipherText( this->encrypt( data, length ) );
-    if ( cipherText.isNull() )
+    DerivedKey derived;
+    if ( deriveKeyMaterial( kdf, password, usedSalt, numRounds, cipher, key, iv ) )
     {
-        return -1;
+        derived.id = keyId( password, usedSalt, kdf, numRounds, keyLength );
+        derived.key = QByteArray( reinterpret_cast<const char *>( key ), EVP_CIPHER_key_length( cipher ) );
+        derived.iv = QByteArray( reinterpret_cast<const char *>( iv ), EVP_CIPHER_iv_length( cipher ) );
+        derived.numRounds = numRounds;
     }
-    m_device->write( cipherText.data(), length );
+    OPENSSL_cleanse( key, sizeof( key ) );
 
-    if ( m_device->error() != 0 )
-    {
-        qCritical(cryptFileDev) << QObject::tr( "Write Error: %1, code: %2" ).arg( m_device->errorString() ).arg( m_device->error() );
-        emit errorMessage( QObject::tr( "File: %1\nWrite Error: %2" ).arg( m_device->fileName() ).arg( m_device->errorString() ) );
-    }
-    return length;
+    return derived;
 }
 
 /**
- * @brief CryptFileDevice::initCtr
+ * @brief CryptFileDevice::cacheKey
  *
- * Initializes specific parameters for AES encoding.
- * And ends up calling the AES_encrypt(const unsigned char *in, unsigned char *out, const AES_KEY *key) function.
+ * Keeps a key derived in advance, the next device with the same password and settings
+ * uses it instead of deriving the key again. Only the last few keys are kept.
  *
- * @param state of the type CtrState*
- * @param iv of the type unsigned char*
+ * @param key of the type DerivedKey &, the result of CryptFileDevice::deriveKey
  */
-void CryptFileDevice::initCtr( CtrState *state, const unsigned char *iv )
+void CryptFileDevice::cacheKey( const DerivedKey &key )
 {
-    qint64 position = pos();
-
-    state->num = position % AES_BLOCK_SIZE;
-
-    memset( state->ecount, 0, sizeof(state->ecount) );
-
-    /* Initialise counter in 'ivec' */
-    qint64 count = position / AES_BLOCK_SIZE;
-    if ( state->num > 0 )
+    if ( key.isNull() )
     {
-        count++;
+        return;
     }
 
-    qint64 newCount = count;
-    if ( newCount > 0 )
+    QMutexLocker locker( &s_keyCacheMutex );
+    for ( int i = s_keyCache.size() - 1; i >= 0; i-- )
     {
-        newCount = qToBigEndian(count);
+        if ( s_keyCache.at( i ).id == key.id )
+        {
+            s_keyCache.removeAt( i );
+        }
     }
+    s_keyCache.prepend( key );
+    while ( s_keyCache.size() > kKeyCacheSize )
+    {
+        s_keyCache.removeLast();
+    }
+}
 
-    int sizeOfIv = sizeof( state->ivec ) - sizeof( qint64 );
-    memcpy( state->ivec + sizeOfIv, &newCount, sizeof( newCount ) );
-
-    /* Copy IV into 'ivec' */
-    memcpy( state->ivec, iv, sizeOfIv );
+/**
+ * @brief CryptFileDevice::clearKeyCache
+ *
+ * Forgets all keys derived in advance.
+ */
+void CryptFileDevice::clearKeyCache( void )
+{
+    QMutexLocker locker( &s_keyCacheMutex );
+    s_keyCache.clear();
+}
 
-    if ( count > 0 )
+/**
+ * @brief CryptFileDevice::randomSalt
+ *
+ * @return a random salt of the maximal length, empty if the random generator fails
+ */
+QByteArray CryptFileDevice::randomSalt( void )
+{
+    QByteArray salt( kSaltMaxLength, '\0' );
+    if ( RAND_bytes( reinterpret_cast<unsigned char *>( salt.data() ), salt.size() ) != 1 )
     {
-        count = qToBigEndian( count - 1 );
-        unsigned char prevIvec[ AES_BLOCK_SIZE ];
-        memcpy( prevIvec, state->ivec, sizeOfIv );
+        qCritical(cryptFileDev) << QObject::tr( "Cannot generate a salt" );
+        return QByteArray();
+    }
 
-        memcpy( prevIvec + sizeOfIv, &count, sizeof( count ) );
+    return salt;
+}
 
-        AES_encrypt( prevIvec, state->ecount, &m_aesKey );
+/**
+ * @brief CryptFileDevice::findCachedKey
+ * @param id of the type QByteArray &, see CryptFileDevice::keyId
+ * @return the cached key, a null key if there is none
+ */
+DerivedKey CryptFileDevice::findCachedKey( const QByteArray &id )
+{
+    QMutexLocker locker( &s_keyCacheMutex );
+    foreach ( const DerivedKey &key, s_keyCache )
+    {
+        if ( key.id == id )
+        {
+            return key;
+        }
     }
+
+    return DerivedKey();
 }
 
 /**
  * @brief CryptFileDevice::initCipher
  *
- * This function is required to check the plausibility of the entered keys and parameters.
- * Prepares the IV from various parameters and calls the OpenSSL library function EVP_BytesToKey().
- *
- * int EVP_BytesToKey( const EVP_CIPHER *type,const EVP_MD *md,
- *                     const unsigned char *salt,
- *                     const unsigned char *data, int datal, int count,
- *                     unsigned char *key,unsigned char *iv);
- *
- * EVP_BytesToKey() derives a key and IV from various parameters.
- * - type is the cipher to derive the key and IV for.
- * - md is the message digest to use.
- * - The salt parameter is used as a salt in the derivation: it should point to an 8 byte buffer or NULL if no salt is used.
- * - data is a buffer containing datal bytes which is used to derive the keying data.
- * - count is the iteration count to use.
- * - The derived key and IV will be written to key and iv respectively.
+ * Derives the master key and IV from the password, the salt and the cost with the selected
+ * key derivation function (see deriveKeyMaterial):
+ * - Pbkdf2Sha256 (default): PKCS5_PBKDF2_HMAC with SHA-256, the cost is the iteration count.
+ * - Scrypt: EVP_PBE_scrypt, the cost is log2 of N; only with OpenSSL 1.1.0 or newer.
+ * - BytesToKey: EVP_BytesToKey with SHA-256, kept to read files of older versions.
  * .
- * Return values:
- * If data is NULL, then EVP_BytesToKey() returns the number of bytes needed to store the derived key.
- * Otherwise, EVP_BytesToKey() returns the size of the derived key in bytes, or 0 on error.
+ * The function and its cost are stored in the header of every file, CryptFileDevice::calibrate
+ * chooses a cost for a wanted unlock time.
+ *
+ * The derived key and IV are kept until one of the parameters changes, and in a small
+ * process-wide cache (CryptFileDevice::cacheKey), so all devices of a job derive the master key once.
+ * The key of every file is derived from it by CryptFileDevice::initFileKey, the counter is initialised
+ * by CryptFileDevice::open after the nonce of the file is known.
  *
- * @note
- * - A typical application of this function is to derive keying material for an encryption algorithm from a password in the data parameter.
- * - Increasing the count parameter slows down the algorithm which makes it harder for an attacker to peform a brute force attack using a large number of candidate passwords.
- * - If the total key and IV length is less than the digest length and MD5 is used then the derivation algorithm is compatible with PKCS#5 v1.5 otherwise a non standard extension is used to derive the extra data.
- * - Newer applications should use a more modern algorithm such as PBKDF2 as defined in PKCS#5v2.1 and provided by PKCS5_PBKDF2_HMAC.
- * .
  * @retval true if success;
  * @retval false otherwise.
  */
 bool CryptFileDevice::initCipher( void )
 {
-    const EVP_CIPHER *cipher = EVP_enc_null();
-    if ( m_aesKeyLength == AesKeyLength::kAesKeyLength128 )
-    {
-        cipher = EVP_aes_128_ctr();
-    }
-    else if ( m_aesKeyLength == AesKeyLength::kAesKeyLength192 )
+    if ( m_keyValid )
     {
-        cipher = EVP_aes_192_ctr();
-    }
-    else if ( m_aesKeyLength == AesKeyLength::kAesKeyLength256 )
-    {
-        cipher = EVP_aes_256_ctr();
-    }
-    else
-    {
-        Q_ASSERT_X( false, Q_FUNC_INFO, "Unknown value of AesKeyLength" );
+        return true;
     }
 
-    EVP_CIPHER_CTX ctx;
-
-    EVP_CIPHER_CTX_init( &ctx );
-    EVP_EncryptInit_ex( &ctx, cipher, nullptr, nullptr, nullptr );
-    int keyLength = EVP_CIPHER_CTX_key_length( &ctx );
-    int ivLength = EVP_CIPHER_CTX_iv_length( &ctx );
-
-    unsigned char key[ keyLength ];
-    unsigned char iv[ ivLength ];
+    const EVP_CIPHER *cipher = cipherOf( m_aesKeyLength );
+    const int keyLength = EVP_CIPHER_key_length( cipher );
+    const int ivLength = EVP_CIPHER_iv_length( cipher );
 
-    int ok = EVP_BytesToKey( cipher,
-                             EVP_sha256(),
-                             m_salt.isEmpty() ? nullptr : reinterpret_cast<unsigned char *>(m_salt.data()),
-                             reinterpret_cast<unsigned char *>(m_password.data()),
-                             m_password.length(),
-                             m_numRounds,
-                             key,
-                             iv );
-
-    EVP_CIPHER_CTX_cleanup( &ctx );
-
-    if ( ok == 0 )
-    {
-        return false;
-    }
-
-    int res = AES_set_encrypt_key( key, keyLength * 8, &m_aesKey );
-    if ( res != 0 )
+    // A master key derived before (by any device, or in advance, see CryptFileDevice::cacheKey)
+    // saves the derivation; a new one is cached for the other devices of the job.
+    DerivedKey derived = findCachedKey( keyId( m_password, m_salt, m_kdf, m_numRounds, m_aesKeyLength ) );
+    if ( derived.isNull() )
     {
-        return false;
+        CRYPTO_TRACE_SPAN( "kdf", "crypto" );
+        CRYPT_STAT_ADD( keyDerivations, 1 );
+        derived = deriveKey( m_password, m_salt, m_kdf, m_numRounds, m_aesKeyLength );
+        if ( derived.isNull() )
+        {
+            qCritical(cryptFileDev) << QObject::tr( "Key derivation failed" );
+            return false;
+        }
+        cacheKey( derived );
     }
+    const unsigned char *key = reinterpret_cast<const unsigned char *>( derived.key.constData() );
+    const unsigned char *iv = reinterpret_cast<const unsigned char *>( derived.iv.constData() );
 
-    initCtr( &m_ctrState, iv );
+    memcpy( m_iv, iv, qMin( ivLength, static_cast<int>( sizeof( m_iv ) ) ) );
+    m_keyBytes = qMin( keyLength, static_cast<int>( sizeof( m_key ) ) );
+    memcpy( m_key, key, m_keyBytes );
+    m_keyValid = true;
 
     return true;
 }
 
 /**
  * @brief CryptFileDevice::encrypt
+ *
+ * Encrypts length bytes of plainText into cipherText. The buffers may be the same.
+ *
  * @param plainText
+ * @param cipher
  * @param length
- * @return
  */
-char *CryptFileDevice::encrypt( const char *plainText, qint64 length )
+void CryptFileDevice::encrypt( const char *plainText, char *cipher, qint64 length )
 {
-    unsigned char *cipherText = new (std::nothrow) unsigned char[length];
-    if ( cipherText == nullptr )
-    {
-        qCritical(cryptFileDev) << QObject::tr( "Operator new: bad allocation memory, execution terminating" );
-        emit errorMessage( QObject::tr( "Bad allocation memory, execution terminating.\n"
-                                        "Advice: try to reduce the size of the buffer!" ) );
-        return nullptr;
-    }
-
-    if ( m_encMethod == AesCipher )
-    {
-        AES_ctr128_encrypt(reinterpret_cast<const unsigned char *>(plainText),
-                           cipherText,
-                           length,
-                           &m_aesKey,
-                           m_ctrState.ivec,
-                           m_ctrState.ecount,
-                           &m_ctrState.num);
-    }
-    else if ( m_encMethod == XorCipher )
-    {
-        QByteArray passwordHash = QCryptographicHash::hash( m_password, QCryptographicHash::Sha3_512 );
-        unsigned char *pass = reinterpret_cast<unsigned char *>( passwordHash.data() );
-
-        for ( qint64 i = 0; i < length; i++ )
-        {
-            *(cipherText + i) = *(plainText + i) ^ *(pass + i%64) ^ i%251;
-        }
-    }
-    else
+    Q_ASSERT_X( m_transform != nullptr, Q_FUNC_INFO, "No transform of the EncryptionMethod" );
+    if ( m_transform != nullptr )
     {
-        Q_ASSERT_X( false, Q_FUNC_INFO, "Unknown value of EncryptionMethod" );
+        ( this->*m_transform )( reinterpret_cast<const unsigned char *>( plainText ),
+                                reinterpret_cast<unsigned char *>( cipher ),
+                                length );
     }
-
-    return reinterpret_cast<char *>( cipherText );
 }
 
 /**
  * @brief CryptFileDevice::decrypt
- * @param cipherText
+ *
+ * Decrypts len bytes in place with the transform of the method.
+ *
+ * @param data
  * @param len
- * @return
  */
-char *CryptFileDevice::decrypt( const char *cipherText, qint64 len )
+void CryptFileDevice::decrypt( char *data, qint64 len )
 {
-    unsigned char *plainText = new unsigned char[ len ];
-
-    qint64 processLen = 0;
-    do {
-        int maxPlainLen = len > std::numeric_limits<int>::max() ? std::numeric_limits<int>::max() : len;
-
-        AES_ctr128_encrypt(reinterpret_cast<const unsigned char *>(cipherText) + processLen,
-                           plainText + processLen,
-                           maxPlainLen,
-                           &m_aesKey,
-                           m_ctrState.ivec,
-                           m_ctrState.ecount,
-                           &m_ctrState.num);
-
-        processLen += maxPlainLen;
-        len -= maxPlainLen;
-    } while ( len > 0 );
-
-    return reinterpret_cast<char *>( plainText );
+    Q_ASSERT_X( m_transform != nullptr, Q_FUNC_INFO, "No transform of the EncryptionMethod" );
+    if ( m_transform != nullptr )
+    {
+        unsigned char *text = reinterpret_cast<unsigned char *>( data );
+        ( this->*m_transform )( text, text, len );
+    }
 }
 
 /**
@@ -904,6 +3177,8 @@ qint64 CryptFileDevice::pos( void ) const
  * Do not forget that you need to take into account the header of the encoded file.
  * The size of which is stored in the constant kHeaderLength.
  *
+ * An authenticated file is written in sequence: while writing, only the current position is accepted.
+ *
  * @note Seeking beyond the end of a file:
  * If the position is beyond the end of a file, then seek() will not immediately extend the file.
  * If a write is performed at this position, then the file will be extended.
@@ -916,11 +3191,23 @@ qint64 CryptFileDevice::pos( void ) const
  */
 bool CryptFileDevice::seek( qint64 pos )
 {
+    CRYPT_STAT_ADD( seeks, 1 );
+    if ( m_authenticated )
+    {
+        if ( this->isWritable() && pos != m_plainPos )
+        {
+            qWarning(cryptFileDev) << QObject::tr( "An authenticated file is written in sequence, cannot seek to %1" ).arg( pos );
+            return false;
+        }
+        m_plainPos = pos;
+        return QIODevice::seek( pos );
+    }
+
     bool result = QIODevice::seek( pos );
     if ( m_encrypted )
     {
-        m_device->seek( kHeaderLength + pos );
-        initCtr(&m_ctrState, m_ctrState.ivec);
+        m_device->seek( m_headerLength + pos );
+        result = this->initKeyStream( pos ) && result;
     }
     else
     {
@@ -960,7 +3247,12 @@ qint64 CryptFileDevice::size( void ) const
         return m_device->size();
     }
 
-    return m_device->size() - kHeaderLength;
+    if ( m_authenticated )
+    {
+        return m_plainSize;
+    }
+
+    return m_device->size() - m_headerLength;
 }
 
 /**
@@ -1073,3 +3365,115 @@ bool CryptFileDevice::rename( const QString &newName )
     return ok;
 }
 
+
+/**
+ * @brief get-function for the performance counters of the device
+ *
+ * @return a snapshot of the counters of the type CryptStatistics
+ */
+CryptStatistics CryptFileDevice::statistics( void ) const
+{
+    return m_stats;
+}
+
+/**
+ * @brief CryptFileDevice::resetStatistics
+ *
+ * Resets the performance counters of the device.
+ * The counters which have already been published remain in the process-wide counters.
+ */
+void CryptFileDevice::resetStatistics( void )
+{
+    this->publishStatistics();
+    m_stats = CryptStatistics();
+    m_statsPublished = CryptStatistics();
+}
+
+/**
+ * @brief get-function for the number of bytes returned by readData()
+ * @return value of the type quint64
+ */
+quint64 CryptFileDevice::readBytes( void ) const
+{
+    return m_stats.readBytes;
+}
+
+/**
+ * @brief get-function for the number of bytes accepted by writeData()
+ * @return value of the type quint64
+ */
+quint64 CryptFileDevice::writeBytes( void ) const
+{
+    return m_stats.writeBytes;
+}
+
+/**
+ * @brief get-function for the time spent in the cipher, in ns
+ * @return value of the type quint64
+ */
+quint64 CryptFileDevice::cipherNsecs( void ) const
+{
+    return m_stats.cipherNsecs;
+}
+
+/**
+ * @brief get-function for the time spent in the I/O of the underlying device, in ns
+ * @return value of the type quint64
+ */
+quint64 CryptFileDevice::ioNsecs( void ) const
+{
+    return m_stats.ioNsecs;
+}
+
+/**
+ * @brief CryptFileDevice::setStatisticsEnabled
+ *
+ * Enables or disables the performance counters of all devices of the process.
+ * While disabled, the data path only pays for one relaxed atomic load per counter update.
+ *
+ * @param enable of the type bool
+ */
+void CryptFileDevice::setStatisticsEnabled( bool enable )
+{
+    s_statsEnabled.store( enable ? 1 : 0 );
+}
+
+/**
+ * @brief CryptFileDevice::statisticsEnabled
+ *
+ * @retval true if the performance counters are enabled;
+ * @retval false otherwise.
+ */
+bool CryptFileDevice::statisticsEnabled( void )
+{
+    return s_statsEnabled.load() != 0;
+}
+
+/**
+ * @brief CryptFileDevice::globalStatistics
+ *
+ * Returns the sum of the counters of all devices of the process.
+ * The counters of a device are added when it is closed or destroyed.
+ *
+ * @return a snapshot of the counters of the type CryptStatistics
+ */
+CryptStatistics CryptFileDevice::globalStatistics( void )
+{
+    QMutexLocker locker( &s_globalStatsMutex );
+    return s_globalStats;
+}
+
+/**
+ * @brief CryptFileDevice::publishStatistics
+ *
+ * Adds the counters, which have changed since the last call, to the process-wide counters.
+ */
+void CryptFileDevice::publishStatistics( void )
+{
+    CryptStatistics delta = m_stats;
+    delta -= m_statsPublished;
+    m_statsPublished = m_stats;
+
+    QMutexLocker locker( &s_globalStatsMutex );
+    s_globalStats += delta;
+}
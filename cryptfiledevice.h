@@ -21,6 +21,7 @@
 //------------------------------------------------------------------------------
 #include <QIODevice>
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 
 //------------------------------------------------------------------------------
 // Types
@@ -41,6 +42,61 @@ struct CtrState
     unsigned char ecount[AES_BLOCK_SIZE];
 };
 
+/**
+ * @struct CryptStatistics
+ *
+ * @brief The CryptStatistics structure
+ *
+ * The structure contains the performance counters of a CryptFileDevice.
+ * The counters are only maintained while CryptFileDevice::setStatisticsEnabled( true ) is in effect.
+ */
+struct CryptStatistics
+{
+    //! Number of calls of readData().
+    quint64 readCalls = 0;
+    //! Number of bytes returned by readData().
+    quint64 readBytes = 0;
+    //! Number of calls of writeData().
+    quint64 writeCalls = 0;
+    //! Number of bytes accepted by writeData().
+    quint64 writeBytes = 0;
+    //! Time spent in the cipher (encrypt/decrypt), in ns.
+    quint64 cipherNsecs = 0;
+    //! Time spent in the I/O of the underlying device, in ns.
+    quint64 ioNsecs = 0;
+    //! Number of calls of seek().
+    quint64 seeks = 0;
+    //! Number of re-initialisations of the CTR counter.
+    quint64 ctrInits = 0;
+    //! Number of key derivations.
+    quint64 keyDerivations = 0;
+    //! Number of buffer allocations in the data path.
+    quint64 allocations = 0;
+
+    CryptStatistics &operator+=( const CryptStatistics &other );
+    CryptStatistics &operator-=( const CryptStatistics &other );
+};
+
+/**
+ * @struct DerivedKey
+ *
+ * @brief The DerivedKey structure contains a key and an IV derived from a password,
+ * see CryptFileDevice::deriveKey.
+ */
+struct DerivedKey
+{
+    //! Identifies the password and the parameters, see CryptFileDevice::keyId.
+    QByteArray id;
+    //! The AES key.
+    QByteArray key;
+    //! The IV.
+    QByteArray iv;
+    //! Cost with which the key was derived.
+    int numRounds = 0;
+
+    bool isNull( void ) const { return key.isEmpty(); }
+};
+
 /**
  * @class CryptFileDevice
  *
@@ -80,18 +136,75 @@ struct CtrState
  * If there is not enough space, an error message will appear.
  *
  * The class also has other important functionality.
- * The methods of the class CryptFileDevice::insertHeader and CryptFileDevice::tryParseHeader allow you
- * to provide the files being encoded with a special 1024 bit header (variable kHeaderLength).
- * Which contains AES encryption options, as well as a hash of the sum
- * of the password and salt.
- * In the next version, the header of the encrypted file will be backed up with a CRC checksum.
+ * Every encrypted file starts with a versioned header of kHeaderLength bytes
+ * (CryptFileDevice::insertHeader, CryptFileDevice::tryParseHeader), protected by a CRC-32.
+ * It contains the encryption method, the AES key length, the key derivation function with its cost
+ * and salt, a random nonce of the file and a key check value (HMAC of the header, keyed with the derived key).
+ * When an existing file is opened, the parameters of the header replace the settings of the device
+ * and a wrong password is rejected by open() before any data is read.
+ * The header is not part of the data: pos(), seek() and size() do not count it.
+ *
+ * The method AesGcmCipher also protects the integrity of the data. The data is split into chunks of 64 KiB,
+ * every chunk is sealed with AES-GCM and followed by its tag; the index of the chunk is part of the nonce
+ * and of the authenticated data, so chunks cannot be reordered. A trailer after the last chunk seals
+ * the size of the data, a truncated file is rejected by open(). Chunks are sealed and opened
+ * in parallel batches (QtConcurrent), a read only authenticates the chunks it touches,
+ * CryptFileDevice::verify authenticates the whole file. An authenticated file is written in sequence
+ * and cannot be modified: it is opened with ReadOnly, or rewritten with Truncate.
+ *
+ * The method ChaCha20Cipher (OpenSSL 1.1.0 or newer) is a stream cipher like AES-CTR and is faster
+ * on machines without AES instructions. Its key stream is addressed by the position as well:
+ * the block counter is pos() / 64, so seek() and writes at any position work the same way.
+ * It always uses a 256-bit key of the file, derived with HKDF from the master key; the 32-bit
+ * block counter limits a file to 256 GiB.
+ *
+ * The implementation of a method (Backend) is selected for all devices with CryptFileDevice::setBackend,
+ * usually from the measurements of BackendProbe (CryptFileDevice::benchmark). AesCipher runs either
+ * on the portable AES_ctr128_encrypt or on EVP, which uses the AES instructions of the processor;
+ * both give the same key stream, so the choice does not change the files.
+ * The transform of the method and the backend (a specialisation of CryptFileDevice::transform)
+ * is selected once by open(); encrypt() and decrypt() call it through a pointer without branching.
+ * The key stream of every method, XorCipher included, is addressed by the position in the data.
+ *
+ * Besides the cursor of QIODevice, an open device offers positional I/O like pread() and pwrite():
+ * CryptFileDevice::readAt and CryptFileDevice::writeAt compute the key stream from the offset
+ * and use positional I/O of the underlying file, so many threads can read (and write disjoint
+ * ranges of) one open file at the same time without seeking or locking.
  *
- * @note All functions in this class are reentrant.
+ * Each device keeps performance counters (CryptStatistics): calls and bytes of readData/writeData,
+ * the time spent in the cipher and in the I/O of the underlying device, seeks, counter
+ * re-initialisations, key derivations and allocations. They are read with CryptFileDevice::statistics
+ * and are added to the process-wide counters (CryptFileDevice::globalStatistics) when the device is closed.
+ * The counters are disabled by default, see CryptFileDevice::setStatisticsEnabled.
+ *
+ * The key is derived with PBKDF2-HMAC-SHA256 or scrypt (CryptFileDevice::setKeyDerivation);
+ * CryptFileDevice::calibrate measures the machine and returns the cost for a wanted unlock time.
+ *
+ * Files of version 1.0 have no header: the data starts at the first byte and is encrypted with the key
+ * of EVP_BytesToKey. They look like any other data, so they are only read if the device is told so
+ * (CryptFileDevice::setLegacyFormat); Rekeyer converts them to the current format.
+ *
+ * The key derived from the password is a master key. The key and IV of every file are derived from it
+ * and a random nonce in the header with HKDF-SHA256, so every file has its own key stream while
+ * the expensive derivation runs once per password and salt. Master keys are kept in a small
+ * process-wide cache; a key can also be derived in advance in any thread (CryptFileDevice::deriveKey)
+ * and handed to CryptFileDevice::cacheKey, open() then skips the derivation.
+ *
+ * The derived key is cached until the password, the salt, the key length or the number of rounds
+ * change, so that a long-lived device can be moved from file to file with CryptFileDevice::reset
+ * (or CryptFileDevice::setFileName) without repeating the key derivation or reallocating the file object.
+ *
+ * @note All functions in this class are reentrant. CryptFileDevice::readAt and CryptFileDevice::writeAt
+ * are thread-safe while the device stays open.
  */
 class CryptFileDevice : public QIODevice
 {
     Q_OBJECT
     Q_DISABLE_COPY( CryptFileDevice )
+    Q_PROPERTY( quint64 readBytes READ readBytes )
+    Q_PROPERTY( quint64 writeBytes READ writeBytes )
+    Q_PROPERTY( quint64 cipherNsecs READ cipherNsecs )
+    Q_PROPERTY( quint64 ioNsecs READ ioNsecs )
 
 public:
     /// Selection of the key length between 128, 192, 256 bits.
@@ -101,13 +214,33 @@ public:
         kAesKeyLength192,
         kAesKeyLength256
     };
-    /// Selection of the encryption method XOR or AES.
+    /// Selection of the encryption method XOR, AES (CTR), AES-GCM (authenticated chunks) or ChaCha20.
     enum EncryptionMethod
     {
         XorCipher,
-        AesCipher
+        AesCipher,
+        AesGcmCipher,
+        ChaCha20Cipher
+    };
+    /// Implementation of the cipher of a method, selected for all devices (CryptFileDevice::setBackend).
+    enum Backend
+    {
+        PortableBackend,    ///< AES_ctr128_encrypt and the loop of XorCipher, without processor-specific code
+        EvpBackend          ///< the EVP interface of OpenSSL, which uses AES-NI, VAES, AVX2 ... if available
+    };
+    /// Selection of the key derivation function, the value is stored in the header.
+    enum KeyDerivation
+    {
+        BytesToKey,     ///< EVP_BytesToKey, only to read files of older versions
+        Pbkdf2Sha256,   ///< PBKDF2-HMAC-SHA256, the cost is the iteration count
+        Scrypt          ///< scrypt (OpenSSL 1.1.0 or newer), the cost is log2 of N
     };
 
+    /// size of the header of an encrypted file, in bytes.
+    static const int kHeaderLength = 128;
+    /// default size of the buffer of version 1.0, the key stream of XorCipher restarted with every buffer.
+    static const qint64 kLegacyChunkSize = 5 * 1024 * 1024;
+
     explicit CryptFileDevice( QObject *parent = 0 );
     explicit CryptFileDevice( QFileDevice *device, QObject *parent = 0 );
     explicit CryptFileDevice( QFileDevice *device,
@@ -125,16 +258,34 @@ public:
 
     void setFileName( const QString &fileName );
     QString fileName( void ) const;
+    bool reset( const QString &fileName );
+    using QIODevice::reset;
 
     void setFileDevice( QFileDevice *device );
 
     void setPassword( const QByteArray &password );
     void setSalt( const QByteArray &salt );
     void setKeyLength( AesKeyLength keyLength );
+    AesKeyLength keyLength( void ) const;
     void setNumRounds( int numRounds );
+    int numRounds( void ) const;
+    void setKeyDerivation( KeyDerivation kdf );
+    KeyDerivation keyDerivation( void ) const;
     void setEncryptionMethod( EncryptionMethod enc );
+    void setLegacyFormat( bool legacy );
+    bool legacyFormat( void ) const;
+    void setLegacyChunkSize( qint64 chunkSize );
+    EncryptionMethod encryptionMethod( void ) const;
 
     bool isEncrypted( void ) const;
+    bool passwordRejected( void ) const;
+    QByteArray digestKey( void ) const;
+    bool isAuthenticated( void ) const;
+    bool verify( void );
+
+    qint64 readAt( qint64 offset, char *data, qint64 length ) const;
+    qint64 writeAt( qint64 offset, const char *data, qint64 length ) const;
+    bool transformAt( qint64 position, const unsigned char *in, unsigned char *out, qint64 length ) const;
     qint64 size( void ) const override;
 
     bool atEnd( void ) const override;
@@ -142,10 +293,41 @@ public:
     qint64 pos( void ) const override;
     bool seek( qint64 pos ) override;
     bool flush( void );
+    bool finish( void );
     bool remove( void );
     bool exists( void ) const;
     bool rename( const QString &newName );
 
+    CryptStatistics statistics( void ) const;
+    void resetStatistics( void );
+    quint64 readBytes( void ) const;
+    quint64 writeBytes( void ) const;
+    quint64 cipherNsecs( void ) const;
+    quint64 ioNsecs( void ) const;
+
+    static void setStatisticsEnabled( bool enable );
+    static bool statisticsEnabled( void );
+    static CryptStatistics globalStatistics( void );
+
+    static bool isMethodSupported( EncryptionMethod method );
+    static bool isBackendSupported( EncryptionMethod method, Backend backend );
+    static bool setBackend( EncryptionMethod method, Backend backend );
+    static Backend backend( EncryptionMethod method );
+    static QString backendName( Backend backend );
+    static double benchmark( EncryptionMethod method, Backend backend, qint64 length );
+    static bool isKeyDerivationSupported( KeyDerivation kdf );
+    static int calibrate( KeyDerivation kdf, int targetMsecs );
+
+    static DerivedKey deriveKey( const QByteArray &password,
+                                 const QByteArray &salt,
+                                 KeyDerivation kdf,
+                                 int numRounds,
+                                 AesKeyLength keyLength );
+    static void cacheKey( const DerivedKey &key );
+    static void clearKeyCache( void );
+    static QByteArray randomSalt( void );
+    static bool hasHeader( QIODevice *device );
+
 signals:
     void errorMessage( const QVariant &msg ) const;
 
@@ -154,28 +336,103 @@ protected:
     qint64 writeData( const char *data, qint64 length ) override;
 
     qint64 readBlock( qint64 length, QByteArray &block );
+    qint64 readDecrypted( char *data, qint64 length );
+    qint64 readChunks( char *data, qint64 length );
+    qint64 writeChunks( const char *data, qint64 length );
 
 private:
     bool initCipher( void );
-    void initCtr( CtrState *state, const unsigned char *iv );
-    char *encrypt( const char *plainText, qint64 length );
-    char *decrypt( const char *cipherText, qint64 length );
+    void initCtr( CtrState *state, const unsigned char *iv, qint64 position );
+    void ctrStateAt( CtrState *state, const unsigned char *iv, qint64 position ) const;
+    bool initStream( qint64 position );
+    bool streamAt( EVP_CIPHER_CTX *ctx, qint64 position ) const;
+    bool streamCovers( qint64 position, qint64 length ) const;
+    qint64 readChunksAt( qint64 offset, char *data, qint64 length ) const;
+    bool initTransform( void );
+    bool initKeyStream( qint64 position );
+    template <EncryptionMethod kMethod, Backend kBackend>
+    void transform( const unsigned char *in, unsigned char *out, qint64 length );
+    void applyStream( const unsigned char *in, unsigned char *out, qint64 length );
+    void encrypt( const char *plainText, char *cipherText, qint64 length );
+    void decrypt( char *data, qint64 length );
 
-    void insertHeader( void );
+    bool insertHeader( void );
     bool tryParseHeader( void );
+    bool keyCheckValue( const unsigned char *header, unsigned char *check ) const;
+    bool initFileKey( const unsigned char *header );
+    bool openAuthenticated( void );
+    bool openLegacy( OpenMode mode );
+    bool openChunks( qint64 first, qint64 count, char *plainText );
+    bool sealChunks( const char *plainText, qint64 length );
+    bool finishChunks( void );
+    qint64 chunkLength( qint64 index ) const;
+    void publishStatistics( void );
+
+    static QByteArray keyId( const QByteArray &password,
+                             const QByteArray &salt,
+                             KeyDerivation kdf,
+                             int numRounds,
+                             AesKeyLength keyLength );
+    static DerivedKey findCachedKey( const QByteArray &id );
 
     QFileDevice *m_device = nullptr;
     bool m_deviceOwner = false;
     bool m_encrypted = false;
+    /// the file has no header (version 1.0), see CryptFileDevice::setLegacyFormat.
+    bool m_legacy = false;
+    qint64 m_legacyChunkSize = kLegacyChunkSize;
+    /// offset of the data in the file: kHeaderLength, 0 for a file without a header.
+    qint64 m_headerLength = kHeaderLength;
 
     QByteArray m_password;
     QByteArray m_salt;
     EncryptionMethod m_encMethod;
+    /// backend of the open file, taken from CryptFileDevice::backend by open().
+    Backend m_backend = PortableBackend;
+    /// transform of the method and the backend, selected by open() (CryptFileDevice::initTransform).
+    typedef void ( CryptFileDevice::*Transform )( const unsigned char *in, unsigned char *out, qint64 length );
+    Transform m_transform = nullptr;
+    /// one period of the key stream of XorCipher and the position of the next byte.
+    QByteArray m_xorTable;
+    qint64 m_xorPos = 0;
     AesKeyLength m_aesKeyLength = AesKeyLength::kAesKeyLength256;
-    int m_numRounds = 5;
+    KeyDerivation m_kdf = Pbkdf2Sha256;
+    int m_numRounds = 10000;
 
     CtrState m_ctrState = {};
     AES_KEY m_aesKey = {};
+    /// the master key m_key and m_iv are derived from the current password, salt, key length and rounds.
+    bool m_keyValid = false;
+    unsigned char m_key[32] = {};
+    int m_keyBytes = 0;
+    unsigned char m_iv[AES_BLOCK_SIZE] = {};
+    /// key and IV of the open file, derived from the master key and the nonce; m_aesKey is its schedule.
+    unsigned char m_fileKey[32] = {};
+    int m_fileKeyBytes = 0;
+    unsigned char m_fileIv[AES_BLOCK_SIZE] = {};
+    /// key scheme of the open file (HkdfKey or DirectKey), see CryptFileDevice::initFileKey.
+    quint8 m_keyScheme = 0;
+    /// state of the EVP key stream at the current position (EvpBackend), allocated on first use.
+    EVP_CIPHER_CTX *m_streamCtx = nullptr;
+
+    /// the last open() found a valid header, whose key check value does not match the password.
+    bool m_passwordRejected = false;
+    /// the written file is complete (CryptFileDevice::finish) and the result of its completion.
+    bool m_finished = false;
+    bool m_finishOk = true;
+    /// the open file is in the authenticated format (AesGcmCipher).
+    bool m_authenticated = false;
+    qint64 m_chunkSize = 0;
+    /// number of chunks of the file, while writing: the number of sealed chunks.
+    qint64 m_chunkCount = 0;
+    qint64 m_plainSize = 0;
+    qint64 m_plainPos = 0;
+    /// reading: the plain data of the chunk m_chunkIndex; writing: the data of the next chunk.
+    QByteArray m_chunk;
+    qint64 m_chunkIndex = -1;
+
+    CryptStatistics m_stats;
+    CryptStatistics m_statsPublished;
 };
 
 #endif // CRYPTFILEDEVICE_H
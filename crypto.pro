@@ -15,6 +15,7 @@
 
 QT       += core gui
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+QT       += concurrent
 CONFIG += c++11
 CONFIG += debug_and_release
 
@@ -38,12 +39,40 @@ INCLUDEPATH += .
 SOURCES += main.cpp\
         mainwindow.cpp \
     settingsdialog.cpp \
-    cryptfiledevice.cpp
+    cryptfiledevice.cpp \
+    tracer.cpp \
+    runreport.cpp \
+    jobmonitor.cpp \
+    throughputpanel.cpp \
+    buffertuner.cpp \
+    bufferpool.cpp \
+    compressiondevice.cpp \
+    packarchive.cpp \
+    logsink.cpp \
+    treeverifier.cpp \
+    cpufeatures.cpp \
+    backendprobe.cpp \
+    rekeyer.cpp \
+    jobinput.cpp
 
 HEADERS  += mainwindow.h \
     settingsdialog.h \
     settings.h \
-    cryptfiledevice.h
+    cryptfiledevice.h \
+    tracer.h \
+    runreport.h \
+    jobmonitor.h \
+    throughputpanel.h \
+    buffertuner.h \
+    bufferpool.h \
+    compressiondevice.h \
+    packarchive.h \
+    logsink.h \
+    treeverifier.h \
+    cpufeatures.h \
+    backendprobe.h \
+    rekeyer.h \
+    jobinput.h
 
 FORMS    += mainwindow.ui \
     settingsdialog.ui \
@@ -64,6 +93,9 @@ win32 {
 INCLUDEPATH += c:/OpenSSL-Win32/include
 LIBS += -Lc:/OpenSSL-Win32/bin -llibeay32
 }
+win32 {
+LIBS += -lpsapi
+}
 linux|macx {
 LIBS += -lcrypto
 #LIBS += -L/usr/local/ssl/lib -lcrypto
@@ -0,0 +1,66 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file jobinput.cpp
+ *
+ * @brief This file contains the definition of methods of the JobInput class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "jobinput.h"
+#include "compressiondevice.h"
+#include "packarchive.h"
+#include <QFileInfo>
+
+/**
+ * @brief JobInput::classify
+ *
+ * Opens fileName through device (ReadOnly) and classifies its content.
+ * The device stays open at the start of the data for every kind except PlainData,
+ * the caller reads the plain data from it and closes it.
+ *
+ * @param device of the type CryptFileDevice*, configured with the password of the job
+ * @param fileName of the type QString&, path to the file
+ *
+ * @return the kind of the content.
+ */
+JobInput::Kind JobInput::classify( CryptFileDevice *device, const QString &fileName )
+{
+    Q_ASSERT_X( device != nullptr, Q_FUNC_INFO, "Null pointer" );
+    // an empty file has no header, it would open as encrypted data without content
+    if ( QFileInfo( fileName ).size() == 0 )
+    {
+        return PlainData;
+    }
+
+    device->setFileName( fileName );
+    if ( !device->open( QIODevice::ReadOnly ) )
+    {
+        return device->passwordRejected() ? WrongPassword : PlainData;
+    }
+    if ( !device->isEncrypted() )
+    {
+        device->close();
+        return PlainData;
+    }
+
+    if ( CompressionDevice::isCompressed( device ) )
+    {
+        return CompressedData;
+    }
+    if ( PackArchive::isPack( device ) )
+    {
+        return PackData;
+    }
+    return EncryptedData;
+}
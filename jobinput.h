@@ -0,0 +1,55 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file jobinput.h
+ *
+ * @brief This file contains the declaration of the class JobInput
+ */
+#ifndef JOBINPUT_H
+#define JOBINPUT_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "cryptfiledevice.h"
+#include <QString>
+
+/**
+ * @class JobInput
+ *
+ * @brief The JobInput class decides, what a job does with a file: encrypt it, or restore its plain data.
+ *
+ * The file is opened through a CryptFileDevice, which is configured like the device of the job,
+ * which reads encrypted files. A file, whose header is accepted with the password, is encrypted;
+ * its content is a compressed stream, a container of a packed directory or the plain data itself.
+ * A file with a header, which rejects the password, is encrypted with another password;
+ * it is neither decrypted nor encrypted again. Every other file (no header, empty) is plain data.
+ *
+ * @note Files of version 1.0 have no header and are classified as plain data,
+ * they are converted with Rekeyer (crypto --migrate) first.
+ */
+class JobInput
+{
+public:
+    /// Content of a file.
+    enum Kind
+    {
+        PlainData,      ///< not encrypted with the password, the file is encrypted
+        EncryptedData,  ///< encrypted plain data, the file is decrypted
+        CompressedData, ///< an encrypted compressed stream, the file is decrypted and decompressed
+        PackData,       ///< an encrypted container, the directory is unpacked
+        WrongPassword   ///< encrypted with another password, the file fails and is left unchanged
+    };
+
+    static Kind classify( CryptFileDevice *device, const QString &fileName );
+};
+
+#endif // JOBINPUT_H
@@ -0,0 +1,160 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file jobmonitor.cpp
+ *
+ * @brief This file contains the definition of methods of the JobMonitor class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "jobmonitor.h"
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+QAtomicInt JobMonitor::s_running( 0 );
+QAtomicInteger<qint64> JobMonitor::s_bytesTotal( 0 );
+QAtomicInteger<qint64> JobMonitor::s_bytesDone( 0 );
+QAtomicInteger<qint64> JobMonitor::s_filesTotal( 0 );
+QAtomicInteger<qint64> JobMonitor::s_filesDone( 0 );
+QAtomicInteger<qint64> JobMonitor::s_pending( 0 );
+QAtomicInteger<qint64> JobMonitor::s_reading( 0 );
+QAtomicInteger<qint64> JobMonitor::s_writing( 0 );
+QAtomicInteger<qint64> JobMonitor::s_workers( 0 );
+
+/**
+ * @brief JobMonitor::begin
+ *
+ * Resets the counters for a new job. All files of the job are pending.
+ *
+ * @param bytesTotal of the type qint64, size of the data of the job
+ * @param filesTotal of the type qint64, number of files of the job
+ */
+void JobMonitor::begin( qint64 bytesTotal, qint64 filesTotal )
+{
+    s_bytesTotal.store( bytesTotal );
+    s_bytesDone.store( 0 );
+    s_filesTotal.store( filesTotal );
+    s_filesDone.store( 0 );
+    s_pending.store( filesTotal );
+    s_reading.store( 0 );
+    s_writing.store( 0 );
+    s_workers.store( 0 );
+    s_running.store( 1 );
+}
+
+/**
+ * @brief JobMonitor::end
+ *
+ * Marks the job as finished. The counters keep their last values.
+ */
+void JobMonitor::end( void )
+{
+    s_pending.store( 0 );
+    s_running.store( 0 );
+}
+
+/**
+ * @brief JobMonitor::addBytes
+ * @param bytes of the type qint64, number of processed bytes
+ */
+void JobMonitor::addBytes( qint64 bytes )
+{
+    s_bytesDone.fetchAndAddRelaxed( bytes );
+}
+
+/**
+ * @brief JobMonitor::fileDone
+ *
+ * Counts a finished file (successful or not).
+ */
+void JobMonitor::fileDone( void )
+{
+    s_filesDone.fetchAndAddRelaxed( 1 );
+}
+
+/**
+ * @brief JobMonitor::enter
+ *
+ * Enters a stage, the queue depth of the stage grows by one.
+ *
+ * @param stage of the type JobMonitor::Stage
+ */
+void JobMonitor::enter( Stage stage )
+{
+    counter( stage )->fetchAndAddRelaxed( 1 );
+}
+
+/**
+ * @brief JobMonitor::leave
+ * @param stage of the type JobMonitor::Stage
+ */
+void JobMonitor::leave( Stage stage )
+{
+    counter( stage )->fetchAndAddRelaxed( -1 );
+}
+
+/**
+ * @brief JobMonitor::workerStarted
+ */
+void JobMonitor::workerStarted( void )
+{
+    s_workers.fetchAndAddRelaxed( 1 );
+}
+
+/**
+ * @brief JobMonitor::workerFinished
+ */
+void JobMonitor::workerFinished( void )
+{
+    s_workers.fetchAndAddRelaxed( -1 );
+}
+
+/**
+ * @brief JobMonitor::snapshot
+ *
+ * @return the current values of all counters.
+ */
+JobSnapshot JobMonitor::snapshot( void )
+{
+    JobSnapshot snap;
+    snap.running = ( s_running.load() != 0 );
+    snap.bytesTotal = s_bytesTotal.load();
+    snap.bytesDone = s_bytesDone.load();
+    snap.filesTotal = s_filesTotal.load();
+    snap.filesDone = s_filesDone.load();
+    snap.filesPending = s_pending.load();
+    snap.reading = s_reading.load();
+    snap.writing = s_writing.load();
+    snap.workers = s_workers.load();
+    return snap;
+}
+
+/**
+ * @brief The function returns the counter of a stage.
+ * @param stage of the type JobMonitor::Stage
+ * @return pointer to the counter
+ */
+QAtomicInteger<qint64> *JobMonitor::counter( Stage stage )
+{
+    switch ( stage )
+    {
+    case Pending:
+        return &s_pending;
+    case Reading:
+        return &s_reading;
+    case Writing:
+        return &s_writing;
+    }
+    return &s_pending;
+}
@@ -0,0 +1,131 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file jobmonitor.h
+ *
+ * @brief This file contains the declaration of the class JobMonitor
+ */
+#ifndef JOBMONITOR_H
+#define JOBMONITOR_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QAtomicInteger>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @struct JobSnapshot
+ *
+ * @brief The JobSnapshot structure holds the values of the JobMonitor counters at one moment.
+ */
+struct JobSnapshot
+{
+    //! The job is running.
+    bool running;
+    //! Number of bytes of the job.
+    qint64 bytesTotal;
+    //! Number of processed bytes.
+    qint64 bytesDone;
+    //! Number of files of the job.
+    qint64 filesTotal;
+    //! Number of finished files.
+    qint64 filesDone;
+    //! Number of files waiting to be opened.
+    qint64 filesPending;
+    //! Number of reads in progress.
+    qint64 reading;
+    //! Number of encryptions (cipher + write) in progress.
+    qint64 writing;
+    //! Number of active workers.
+    qint64 workers;
+};
+
+/**
+ * @class JobMonitor
+ *
+ * @brief The JobMonitor class provides low-overhead atomic progress counters of the running job.
+ *
+ * The data path updates the counters with relaxed atomic operations only, the user interface
+ * samples them with JobMonitor::snapshot on a timer (see ThroughputPanel).
+ * The counters of the stages are queue depths: the number of files or buffers currently
+ * waiting for or being processed by that stage.
+ *
+ * @note All functions in this class are thread-safe.
+ */
+class JobMonitor
+{
+public:
+    //! The stages of the processing of a file.
+    enum Stage
+    {
+        //! A file is waiting to be opened.
+        Pending,
+        //! A buffer is being read from the source file.
+        Reading,
+        //! A buffer is being encrypted and written.
+        Writing
+    };
+
+    static void begin( qint64 bytesTotal, qint64 filesTotal );
+    static void end( void );
+
+    static void addBytes( qint64 bytes );
+    static void fileDone( void );
+    static void enter( Stage stage );
+    static void leave( Stage stage );
+    static void workerStarted( void );
+    static void workerFinished( void );
+
+    static JobSnapshot snapshot( void );
+
+private:
+    static QAtomicInteger<qint64> *counter( Stage stage );
+
+    static QAtomicInt s_running;
+    static QAtomicInteger<qint64> s_bytesTotal;
+    static QAtomicInteger<qint64> s_bytesDone;
+    static QAtomicInteger<qint64> s_filesTotal;
+    static QAtomicInteger<qint64> s_filesDone;
+    static QAtomicInteger<qint64> s_pending;
+    static QAtomicInteger<qint64> s_reading;
+    static QAtomicInteger<qint64> s_writing;
+    static QAtomicInteger<qint64> s_workers;
+};
+
+/**
+ * @class JobStage
+ *
+ * @brief The JobStage class counts its lifetime as one entry of a stage of the JobMonitor.
+ */
+class JobStage
+{
+public:
+    explicit JobStage( JobMonitor::Stage stage ) :
+        m_stage( stage )
+    {
+        JobMonitor::enter( m_stage );
+    }
+
+    ~JobStage()
+    {
+        JobMonitor::leave( m_stage );
+    }
+
+private:
+    Q_DISABLE_COPY( JobStage )
+
+    JobMonitor::Stage m_stage;
+};
+
+#endif // JOBMONITOR_H
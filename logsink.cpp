@@ -0,0 +1,657 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file logsink.cpp
+ *
+ * @brief This file contains the definition of methods of the LogSink class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "logsink.h"
+#include <QAtomicPointer>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QScopedPointer>
+#include <QFile>
+#include <cstdio>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/// default interval between two flushes of the log file, in ms.
+static int const kDefaultFlushInterval = 200;
+/// default maximum number of queued messages.
+static int const kDefaultCapacity = 65536;
+/// number of queued messages, which wakes the writer before the flush interval expires.
+static int const kWakeThreshold = 512;
+/// size of the formatted batch, which is written to the file at once, in bytes.
+static int const kBatchBytes = 64 * 1024;
+
+/**
+ * @struct LogRecord
+ *
+ * @brief The LogRecord structure holds one queued message.
+ *
+ * A record with the flag marker is not a message, it is queued by LogSink::flush
+ * and acknowledged by the writer when all messages before it are written.
+ */
+struct LogRecord
+{
+    QAtomicPointer<LogRecord> next;
+    qint64 msecs = 0;
+    QtMsgType type = QtDebugMsg;
+    const char *category = nullptr;
+    const char *file = nullptr;
+    int line = 0;
+    const char *function = nullptr;
+    QString text;
+    bool marker = false;
+    bool done = false;
+};
+
+/**
+ * @class LogQueue
+ *
+ * @brief The LogQueue class is an intrusive, lock-free queue with many producers and one consumer.
+ *
+ * A producer exchanges the head with one atomic operation and then links its predecessor,
+ * so that push() never waits. The consumer owns the tail; pop() returns nullptr if the queue
+ * is empty or if the next record is still being linked by a producer.
+ */
+class LogQueue
+{
+public:
+    LogQueue( void ) :
+        m_head( &m_stub ),
+        m_tail( &m_stub )
+    {
+    }
+
+    void push( LogRecord *record )
+    {
+        record->next.store( nullptr );
+        LogRecord *prev = m_head.fetchAndStoreAcquireRelease( record );
+        prev->next.storeRelease( record );
+    }
+
+    LogRecord *pop( void )
+    {
+        LogRecord *tail = m_tail;
+        LogRecord *next = tail->next.loadAcquire();
+        if ( tail == &m_stub )
+        {
+            if ( next == nullptr )
+            {
+                return nullptr;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->next.loadAcquire();
+        }
+        if ( next != nullptr )
+        {
+            m_tail = next;
+            return tail;
+        }
+        if ( tail != m_head.loadAcquire() )
+        {
+            return nullptr;
+        }
+        this->push( &m_stub );
+        next = tail->next.loadAcquire();
+        if ( next != nullptr )
+        {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    Q_DISABLE_COPY( LogQueue )
+
+    LogRecord m_stub;
+    QAtomicPointer<LogRecord> m_head;
+    LogRecord *m_tail;
+};
+
+/**
+ * @class LogWriter
+ *
+ * @brief The LogWriter class is the thread, which drains the queue into the log file.
+ */
+class LogWriter : public QThread
+{
+public:
+    explicit LogWriter( QFile *file ) :
+        m_file( file ),
+        m_size( file->size() ),
+        m_openedAt( QDateTime::currentMSecsSinceEpoch() ),
+        m_second( -1 ),
+        m_reported( 0 )
+    {
+    }
+
+    void drain( void );
+    void setReported( int dropped )
+    {
+        m_reported = dropped;
+    }
+
+protected:
+    void run( void ) override;
+
+private:
+    void format( const LogRecord *record, QByteArray &out, QByteArray &console );
+    void write( const QByteArray &data );
+    void rotate( void );
+
+    QScopedPointer<QFile> m_file;
+    qint64 m_size;
+    qint64 m_openedAt;
+    qint64 m_second;
+    QByteArray m_stamp;
+    int m_reported;
+};
+
+static LogQueue s_queue;
+static QAtomicPointer<LogWriter> s_writer;
+static QMutex s_controlMutex;
+static QMutex s_mutex;
+static QWaitCondition s_wake;
+static QWaitCondition s_written;
+static QAtomicInt s_stopping( 0 );
+static QAtomicInt s_pending( 0 );
+static QAtomicInt s_flushRequests( 0 );
+static QAtomicInt s_dropped( 0 );
+static QAtomicInt s_flushInterval( kDefaultFlushInterval );
+static QAtomicInt s_capacity( kDefaultCapacity );
+static QAtomicInt s_policy( LogSink::DropNewest );
+// the rotation is guarded by s_mutex
+static qint64 s_rotateBytes = 0;
+static qint64 s_rotateMsecs = 0;
+static int s_archives = 0;
+
+/**
+ * @brief LogWriter::run
+ *
+ * Sleeps for the flush interval, or until a batch of messages or a flush is waiting,
+ * and writes the queued messages.
+ */
+void LogWriter::run( void )
+{
+    while ( s_stopping.loadAcquire() == 0 )
+    {
+        s_mutex.lock();
+        if ( s_pending.loadAcquire() < kWakeThreshold && s_flushRequests.loadAcquire() == 0 && s_stopping.loadAcquire() == 0 )
+        {
+            s_wake.wait( &s_mutex, static_cast<unsigned long>( s_flushInterval.loadAcquire() ) );
+        }
+        s_mutex.unlock();
+
+        this->drain();
+    }
+    this->drain();
+}
+
+/**
+ * @brief LogWriter::drain
+ *
+ * Formats all queued messages, writes them to the file and to the console in batches
+ * and flushes the file once. A flush marker is acknowledged after the messages before it are written.
+ */
+void LogWriter::drain( void )
+{
+    QByteArray out;
+    QByteArray console;
+    bool written = false;
+
+    const int dropped = s_dropped.loadAcquire();
+    if ( dropped != m_reported )
+    {
+        LogRecord record;
+        record.msecs = QDateTime::currentMSecsSinceEpoch();
+        record.type = QtWarningMsg;
+        record.category = "LogSink";
+        record.text = QObject::tr( "%1 messages were dropped, the log queue was full" ).arg( dropped - m_reported );
+        this->format( &record, out, console );
+        m_reported = dropped;
+    }
+
+    LogRecord *record;
+    while ( ( record = s_queue.pop() ) != nullptr )
+    {
+        s_pending.fetchAndAddRelease( -1 );
+        if ( record->marker )
+        {
+            this->write( out );
+            m_file->flush();
+            fwrite( console.constData(), 1, static_cast<size_t>( console.size() ), stdout );
+            fflush( stdout );
+            out.clear();
+            console.clear();
+            written = false;
+
+            s_flushRequests.fetchAndAddRelease( -1 );
+            QMutexLocker locker( &s_mutex );
+            record->done = true;
+            s_written.wakeAll();
+            continue;
+        }
+
+        this->format( record, out, console );
+        delete record;
+        if ( out.size() >= kBatchBytes )
+        {
+            this->write( out );
+            out.clear();
+            written = true;
+        }
+    }
+
+    if ( !out.isEmpty() || written )
+    {
+        this->write( out );
+        m_file->flush();
+    }
+    if ( !console.isEmpty() )
+    {
+        // Output messages to the terminal console. Only for debugging purposes.
+        fwrite( console.constData(), 1, static_cast<size_t>( console.size() ), stdout );
+        fflush( stdout );
+    }
+}
+
+/**
+ * @brief LogWriter::write
+ *
+ * Writes a batch to the log file. The file is rotated before, if the batch would exceed
+ * the maximum size or if the file is older than the maximum age.
+ *
+ * @param data of the type QByteArray &
+ */
+void LogWriter::write( const QByteArray &data )
+{
+    if ( data.isEmpty() )
+    {
+        return;
+    }
+
+    qint64 maxBytes, maxMsecs;
+    {
+        QMutexLocker locker( &s_mutex );
+        maxBytes = s_rotateBytes;
+        maxMsecs = s_rotateMsecs;
+    }
+    if ( m_size > 0 &&
+         ( ( maxBytes > 0 && m_size + data.size() > maxBytes ) ||
+           ( maxMsecs > 0 && QDateTime::currentMSecsSinceEpoch() - m_openedAt >= maxMsecs ) ) )
+    {
+        this->rotate();
+    }
+
+    if ( m_file->isOpen() )
+    {
+        m_file->write( data );
+        m_size += data.size();
+    }
+}
+
+/**
+ * @brief LogWriter::rotate
+ *
+ * Closes the log file, shifts the archives (log.1 becomes log.2 and so on, the oldest one
+ * is removed), renames the log file to log.1 and starts a new, empty log file.
+ * Without archives the log file is just truncated.
+ */
+void LogWriter::rotate( void )
+{
+    int archives;
+    {
+        QMutexLocker locker( &s_mutex );
+        archives = s_archives;
+    }
+
+    const QString fileName = m_file->fileName();
+    m_file->close();
+    if ( archives > 0 )
+    {
+        QFile::remove( LogSink::archiveName( fileName, archives ) );
+        for ( int i = archives - 1; i >= 1; i-- )
+        {
+            QFile::rename( LogSink::archiveName( fileName, i ), LogSink::archiveName( fileName, i + 1 ) );
+        }
+        QFile::rename( fileName, LogSink::archiveName( fileName, 1 ) );
+    }
+
+    if ( !m_file->open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+    {
+        fprintf( stderr, "Cannot open the log file %s\n", qPrintable( fileName ) );
+    }
+    m_size = 0;
+    m_openedAt = QDateTime::currentMSecsSinceEpoch();
+}
+
+/**
+ * @brief LogWriter::format
+ *
+ * Appends a record in the format of the log file to out and the bare message to console.
+ * The date and time up to the seconds is formatted once per second.
+ *
+ * @param record of the type LogRecord*
+ * @param out of the type QByteArray &, the lines of the log file
+ * @param console of the type QByteArray &, the lines of the console
+ */
+void LogWriter::format( const LogRecord *record, QByteArray &out, QByteArray &console )
+{
+    const qint64 second = record->msecs / 1000;
+    if ( second != m_second )
+    {
+        m_second = second;
+        m_stamp = QDateTime::fromMSecsSinceEpoch( second * 1000 ).toString( "yyyy-MM-dd hh:mm:ss" ).toLatin1();
+    }
+    const int msecs = static_cast<int>( record->msecs % 1000 );
+    out += m_stamp;
+    out += '.';
+    out += char( '0' + msecs / 100 );
+    out += char( '0' + msecs / 10 % 10 );
+    out += char( '0' + msecs % 10 );
+
+    switch ( record->type )
+    {
+    case QtDebugMsg:
+        out += " DBG ";
+        break;
+    case QtInfoMsg:
+        out += " INF ";
+        break;
+    case QtWarningMsg:
+        out += " WRN ";
+        break;
+    case QtCriticalMsg:
+        out += " CRT ";
+        break;
+    case QtFatalMsg:
+        out += " FTL ";
+        break;
+    default :
+        out += " ERR ";
+    }
+
+    const QByteArray localMsg = record->text.toLocal8Bit();
+    out += record->category;
+    out += ": ";
+    out += localMsg;
+#ifdef DEBUG_OUTPUT
+    out += " (";
+    out += record->file;
+    out += ':';
+    out += QByteArray::number( record->line );
+    out += ", ";
+    out += record->function;
+    out += ')';
+#endif
+    out += "<br />\n";
+
+    console += localMsg;
+    console += '\n';
+}
+
+/**
+ * @brief LogSink::start
+ *
+ * Opens the log file and starts the writer thread. A running writer is stopped first.
+ *
+ * @param fileName of the type QString &, path to the log file
+ * @param append of the type bool, appends to the file if true, truncates it otherwise
+ * @retval true if the log file was opened,
+ * @retval false otherwise.
+ */
+bool LogSink::start( const QString &fileName, bool append )
+{
+    LogSink::stop();
+
+    QMutexLocker locker( &s_controlMutex );
+    QScopedPointer<QFile> file( new QFile( fileName ) );
+    const QIODevice::OpenMode mode = append ? QIODevice::Append : QIODevice::WriteOnly;
+    if ( !file->open( mode | QIODevice::Text ) )
+    {
+        return false;
+    }
+
+    s_stopping.storeRelease( 0 );
+    LogWriter *writer = new LogWriter( file.take() );
+    writer->setReported( s_dropped.loadAcquire() );
+    writer->start( QThread::LowPriority );
+    s_writer.storeRelease( writer );
+
+    return true;
+}
+
+/**
+ * @brief LogSink::stop
+ *
+ * Writes all queued messages, stops the writer thread and closes the log file.
+ * The message handler should be uninstalled before.
+ */
+void LogSink::stop( void )
+{
+    QMutexLocker locker( &s_controlMutex );
+    LogWriter *writer = s_writer.fetchAndStoreOrdered( nullptr );
+    if ( writer == nullptr )
+    {
+        return;
+    }
+
+    s_mutex.lock();
+    s_stopping.storeRelease( 1 );
+    s_wake.wakeAll();
+    s_mutex.unlock();
+
+    writer->wait();
+    // messages posted while the writer was stopping
+    writer->drain();
+    delete writer;
+}
+
+/**
+ * @brief LogSink::isRunning
+ *
+ * @retval true if the writer thread is running,
+ * @retval false otherwise.
+ */
+bool LogSink::isRunning( void )
+{
+    return s_writer.loadAcquire() != nullptr;
+}
+
+/**
+ * @brief LogSink::post
+ *
+ * Queues a message for the writer thread. The call does not wait for the file,
+ * unless the queue is full and the overflow policy is Block, or the message is fatal.
+ * If the sink is not running, the message is only written to the console.
+ *
+ * @param type of the type QtMsgType
+ * @param context of the type QMessageLogContext &, the strings must be literals
+ * @param msg of the type QString &
+ */
+void LogSink::post( QtMsgType type, const QMessageLogContext &context, const QString &msg )
+{
+    LogWriter *writer = s_writer.loadAcquire();
+    if ( writer == nullptr )
+    {
+        fprintf( stdout, "%s\n", msg.toLocal8Bit().constData() );
+        return;
+    }
+
+    const int pending = s_pending.fetchAndAddAcquire( 1 ) + 1;
+    if ( pending > s_capacity.loadAcquire() && type != QtFatalMsg )
+    {
+        // The writer must not wait for itself.
+        if ( s_policy.loadAcquire() == DropNewest || QThread::currentThread() == writer )
+        {
+            s_pending.fetchAndAddRelease( -1 );
+            s_dropped.fetchAndAddRelease( 1 );
+            return;
+        }
+        while ( s_pending.loadAcquire() > s_capacity.loadAcquire() && LogSink::isRunning() )
+        {
+            s_wake.wakeOne();
+            QThread::msleep( 1 );
+        }
+    }
+
+    LogRecord *record = new LogRecord;
+    record->msecs = QDateTime::currentMSecsSinceEpoch();
+    record->type = type;
+    record->category = context.category ? context.category : "default";
+    record->file = context.file ? context.file : "";
+    record->line = context.line;
+    record->function = context.function ? context.function : "";
+    record->text = msg;
+    s_queue.push( record );
+
+    if ( pending == kWakeThreshold )
+    {
+        s_wake.wakeOne();
+    }
+    if ( type == QtFatalMsg )
+    {
+        // the application aborts after the handler returns
+        LogSink::flush();
+    }
+}
+
+/**
+ * @brief LogSink::flush
+ *
+ * Waits until all messages, which were queued before the call, are written and flushed.
+ */
+void LogSink::flush( void )
+{
+    LogWriter *writer = s_writer.loadAcquire();
+    if ( writer == nullptr || QThread::currentThread() == writer )
+    {
+        return;
+    }
+
+    LogRecord marker;
+    marker.marker = true;
+    s_pending.fetchAndAddAcquire( 1 );
+    s_flushRequests.fetchAndAddAcquire( 1 );
+
+    QMutexLocker locker( &s_mutex );
+    s_queue.push( &marker );
+    s_wake.wakeOne();
+    while ( !marker.done )
+    {
+        s_written.wait( &s_mutex, 100 );
+    }
+}
+
+/**
+ * @brief set-function for the flushInterval
+ * @param msecs of the type int, the longest time a message waits in the queue, in ms
+ */
+void LogSink::setFlushInterval( int msecs )
+{
+    s_flushInterval.storeRelease( qMax( 1, msecs ) );
+}
+
+/**
+ * @brief get-function for the flushInterval
+ * @return flushInterval of the type int, in ms
+ */
+int LogSink::flushInterval( void )
+{
+    return s_flushInterval.loadAcquire();
+}
+
+/**
+ * @brief set-function for the capacity
+ * @param capacity of the type int, the maximum number of queued messages
+ */
+void LogSink::setCapacity( int capacity )
+{
+    s_capacity.storeRelease( qMax( 1, capacity ) );
+}
+
+/**
+ * @brief get-function for the capacity
+ * @return capacity of the type int
+ */
+int LogSink::capacity( void )
+{
+    return s_capacity.loadAcquire();
+}
+
+/**
+ * @brief set-function for the overflowPolicy
+ * @param policy of the type LogSink::OverflowPolicy
+ */
+void LogSink::setOverflowPolicy( LogSink::OverflowPolicy policy )
+{
+    s_policy.storeRelease( policy );
+}
+
+/**
+ * @brief get-function for the overflowPolicy
+ * @return overflowPolicy of the type LogSink::OverflowPolicy
+ */
+LogSink::OverflowPolicy LogSink::overflowPolicy( void )
+{
+    return static_cast<OverflowPolicy>( s_policy.loadAcquire() );
+}
+
+/**
+ * @brief LogSink::setRotation
+ *
+ * Sets the rotation of the log file, which is checked before every batch is written.
+ * The changes take effect with the next batch, also while a job is running.
+ *
+ * @param maxBytes of the type qint64, the file is rotated before it exceeds this size, 0 disables it
+ * @param maxAgeSecs of the type int, the file is rotated after it was written for this time, 0 disables it
+ * @param archives of the type int, number of the kept archives fileName.1 ... fileName.archives
+ */
+void LogSink::setRotation( qint64 maxBytes, int maxAgeSecs, int archives )
+{
+    QMutexLocker locker( &s_mutex );
+    s_rotateBytes = qMax( Q_INT64_C( 0 ), maxBytes );
+    s_rotateMsecs = qMax( 0, maxAgeSecs ) * Q_INT64_C( 1000 );
+    s_archives = qMax( 0, archives );
+}
+
+/**
+ * @brief LogSink::archiveName
+ *
+ * @param fileName of the type QString &, path to the log file
+ * @param index of the type int, number of the archive, 1 is the newest one
+ * @return path to the archive of the type QString
+ */
+QString LogSink::archiveName( const QString &fileName, int index )
+{
+    return fileName + '.' + QString::number( index );
+}
+
+/**
+ * @brief LogSink::dropped
+ * @return number of messages discarded because the queue was full
+ */
+quint64 LogSink::dropped( void )
+{
+    return static_cast<quint64>( s_dropped.loadAcquire() );
+}
@@ -0,0 +1,97 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file logsink.h
+ *
+ * @brief This file contains the declaration of the class LogSink
+ */
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QString>
+#include <QtGlobal>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @class LogSink
+ *
+ * @brief The LogSink class writes the messages of the application to the log file
+ * in a background thread.
+ *
+ * The message handler (logMessageOutput in main.cpp) only calls LogSink::post, which stamps
+ * the message with the current time and appends it to a lock-free queue (many producers,
+ * one consumer). The writer thread formats the queued messages, writes them to the log file
+ * and to the console in one batch and flushes the file once per batch. It wakes up every
+ * flush interval, or earlier if a batch of messages is waiting.
+ *
+ * The queue is bounded. If it is full, the overflow policy decides:
+ * - DropNewest: the message is discarded and counted, the writer reports the number
+ *   of discarded messages in the log. The thread which logs never waits.
+ * - Block: the thread which logs waits until the writer has made room.
+ * .
+ * Fatal messages are written synchronously, because the application aborts after them.
+ *
+ * The log file is rotated while the application runs (LogSink::setRotation): before a batch
+ * would exceed the maximum size, or when the file was written for longer than the maximum age,
+ * the file is renamed to fileName.1 (the older archives are shifted to fileName.2 ...,
+ * the oldest one is removed) and a new log file is started.
+ *
+ * @code
+ * LogSink::setFlushInterval( 200 );
+ * LogSink::setRotation( 10 * 1024 * 1024, 24 * 3600, 5 );
+ * if ( LogSink::start( "crypto.log", true ) )
+ * {
+ *     qInstallMessageHandler( logMessageOutput );   // calls LogSink::post
+ * }
+ * ...
+ * qInstallMessageHandler( 0 );
+ * LogSink::stop();
+ * @endcode
+ *
+ * @note All functions in this class are thread-safe. The category, file and function
+ * of a QMessageLogContext are stored as pointers, they must be string literals
+ * (as they are for Q_LOGGING_CATEGORY and the qDebug() family).
+ */
+class LogSink
+{
+public:
+    /// Behaviour of LogSink::post if the queue is full.
+    enum OverflowPolicy
+    {
+        DropNewest,
+        Block
+    };
+
+    static bool start( const QString &fileName, bool append );
+    static void stop( void );
+    static bool isRunning( void );
+
+    static void post( QtMsgType type, const QMessageLogContext &context, const QString &msg );
+    static void flush( void );
+
+    static void setFlushInterval( int msecs );
+    static int flushInterval( void );
+    static void setCapacity( int capacity );
+    static int capacity( void );
+    static void setOverflowPolicy( OverflowPolicy policy );
+    static OverflowPolicy overflowPolicy( void );
+    static void setRotation( qint64 maxBytes, int maxAgeSecs, int archives );
+    static QString archiveName( const QString &fileName, int index );
+
+    static quint64 dropped( void );
+};
+
+#endif // LOGSINK_H
@@ -32,10 +32,18 @@
 //------------------------------------------------------------------------------
 #include "mainwindow.h"
 #include "settings.h"
+#include "logsink.h"
+#include "treeverifier.h"
+#include "rekeyer.h"
+#include "runreport.h"
+#include "backendprobe.h"
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QLoggingCategory>
-#include <QDateTime>
 #include <QFile>
+#include <QDir>
+#include <climits>
+#include <cstdio>
 
 //------------------------------------------------------------------------------
 // Types
@@ -43,13 +51,16 @@
 #define ONEKB 1024
 Q_LOGGING_CATEGORY(logMain, "main")
 
-// Smart pointer an the log-file
-static QScopedPointer<QFile> m_logFile;
-
 //------------------------------------------------------------------------------
 // Function Prototypes
 //------------------------------------------------------------------------------
 void logMessageOutput( const QtMsgType type, const QMessageLogContext &context, const QString &msg );
+int verifyTree( const QStringList &paths, const QString &method, const QString &reportPath );
+int rekeyTree( const QStringList &paths, const QString &reportPath );
+int migrateTree( const QStringList &paths, const QString &method, const QString &bufferSize,
+                 const QByteArray &salt, const QString &reportPath );
+int runRekeyer( Rekeyer &rekeyer, const QStringList &paths, const char *job, const QString &reportPath );
+QByteArray readPassword( const char *variable, const QString &prompt );
 
 /**
  * @brief main function
@@ -57,8 +68,8 @@ void logMessageOutput( const QtMsgType type, const QMessageLogContext &context,
  * In this function, an instance of a GUI Qt application app is executed and
  * set up with the parameters entered.
  *
- * @param argc this parameter is ignored because it is a GUI application.
- * @param argv this parameter is ignored because it is a GUI application.
+ * @param argc number of the command line arguments.
+ * @param argv the command line arguments, see the options below.
  *
  * @return value of the function QApplication::exec()
  * Enters the main event loop and waits until exit() is called.
@@ -66,7 +77,22 @@ void logMessageOutput( const QtMsgType type, const QMessageLogContext &context,
  * via quit()).
  *
  * @note
- * The program parameters (argc, argv) are ignored.
+ * The command line options:
+ * - --report <path> writes a JSON report of every job to the file path, or to stdout if path is "-".
+ * - --verify <path> verifies the encrypted files or directories without the GUI (see verifyTree()),
+ *   the option can be repeated. The password is read from the environment variable CRYPTO_PASSWORD
+ *   or from the standard input.
+ * - --method <aes|aes-gcm|chacha20|xor> selects the encryption method of --verify, aes by default;
+ *   the method of a file with a header is taken from the header.
+ * - --rekey <path> encrypts the files or directories with a new password without the GUI (see rekeyTree()),
+ *   the option can be repeated. The passwords are read from the environment variables CRYPTO_PASSWORD
+ *   and CRYPTO_NEW_PASSWORD or from the standard input.
+ * - --migrate <path> converts the files of version 1.0 (without a header) to the current format
+ *   without the GUI (see migrateTree()), the option can be repeated. The files are read with
+ *   --method (aes or xor), --legacy-buffer and --salt; the password is read like for --verify.
+ * - --legacy-buffer <MiB> the size of the buffer, with which the files of version 1.0 were encrypted, 5 by default.
+ * - --salt <text> the salt of version 1.0: the build time (hh:mm:ss) of the program, which encrypted the files.
+ * .
  * @warning
  * none
  */
@@ -80,23 +106,77 @@ int main(int argc, char *argv[])
     app.setApplicationDisplayName( "Crypto - Advanced File Encryptor." );
     app.setApplicationVersion( "1.0.1.0, built on: " + QString(__DATE__).simplified() );
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription( QObject::tr( "Crypto - Advanced File Encryptor" ) );
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption reportOption( "report",
+                                     QObject::tr( "Write a JSON report of every job to <path> (\"-\" for stdout)." ),
+                                     QObject::tr( "path" ) );
+    parser.addOption( reportOption );
+    QCommandLineOption verifyOption( "verify",
+                                     QObject::tr( "Verify the encrypted files or directories at <path> against their manifests and exit." ),
+                                     QObject::tr( "path" ) );
+    parser.addOption( verifyOption );
+    QCommandLineOption methodOption( "method",
+                                     QObject::tr( "Encryption method of --verify: aes (default), aes-gcm, chacha20 or xor." ),
+                                     QObject::tr( "method" ),
+                                     "aes" );
+    parser.addOption( methodOption );
+    QCommandLineOption rekeyOption( "rekey",
+                                    QObject::tr( "Encrypt the files or directories at <path> with a new password and exit." ),
+                                    QObject::tr( "path" ) );
+    parser.addOption( rekeyOption );
+    QCommandLineOption migrateOption( "migrate",
+                                      QObject::tr( "Convert the files of version 1.0 at <path> to the current format and exit." ),
+                                      QObject::tr( "path" ) );
+    parser.addOption( migrateOption );
+    QCommandLineOption legacyBufferOption( "legacy-buffer",
+                                           QObject::tr( "Size of the buffer of version 1.0 for --migrate, in MiB (5 by default)." ),
+                                           QObject::tr( "MiB" ),
+                                           "5" );
+    parser.addOption( legacyBufferOption );
+    QCommandLineOption saltOption( "salt",
+                                   QObject::tr( "Salt of version 1.0 for --migrate: the build time (hh:mm:ss) of the program." ),
+                                   QObject::tr( "text" ) );
+    parser.addOption( saltOption );
+    parser.process( app );
+
+    if ( parser.isSet( verifyOption ) )
+    {
+        return verifyTree( parser.values( verifyOption ), parser.value( methodOption ), parser.value( reportOption ) );
+    }
+    if ( parser.isSet( rekeyOption ) )
+    {
+        return rekeyTree( parser.values( rekeyOption ), parser.value( reportOption ) );
+    }
+    if ( parser.isSet( migrateOption ) )
+    {
+        return migrateTree( parser.values( migrateOption ), parser.value( methodOption ), parser.value( legacyBufferOption ),
+                            parser.isSet( saltOption ) ? parser.value( saltOption ).toLatin1() : MainWindow::salt(),
+                            parser.value( reportOption ) );
+    }
+
     MainWindow w;
+    if ( parser.isSet( reportOption ) )
+    {
+        w.setReportPath( parser.value( reportOption ) );
+    }
     w.show();
 
     bool errorFlag = false;
     if( w.getSettings()->enableLog )
     {
-        // Set the log file in the work directory
-        m_logFile.reset( new QFile( w.getSettings()->pathToLog ) );
-
-        if ( m_logFile.data()->size() < w.getSettings()->maxSizeLog * ONEKB )
-        {
-            errorFlag = m_logFile.data()->open( QIODevice::Append | QIODevice::Text );
-        }
-        else
-        {
-            errorFlag = m_logFile.data()->open( QIODevice::WriteOnly | QIODevice::Text );
-        }
+        // Set the log file in the work directory, the messages are written by a background thread,
+        // which also rotates the file when it is full
+        const Settings *settings = w.getSettings();
+        LogSink::setFlushInterval( static_cast<int>( settings->logFlushInterval ) );
+        LogSink::setCapacity( static_cast<int>( qMin( settings->logQueueCapacity, quint32( INT_MAX ) ) ) );
+        LogSink::setOverflowPolicy( settings->logBlockWhenFull ? LogSink::Block : LogSink::DropNewest );
+        LogSink::setRotation( static_cast<qint64>( settings->maxSizeLog ) * ONEKB,
+                              static_cast<int>( qMin( settings->logRotateHours, quint32( INT_MAX / 3600 ) ) ) * 3600,
+                              static_cast<int>( qMin( settings->logArchives, quint32( 100 ) ) ) );
+        errorFlag = LogSink::start( settings->pathToLog, true );
 
         if ( errorFlag )
         {
@@ -105,22 +185,30 @@ int main(int argc, char *argv[])
         else
         {
             qInstallMessageHandler( 0 );
-            qCritical( logMain ) << QObject::tr( "To the log file %1 can not be added." ).arg( m_logFile.data()->fileName() );
-            w.wErrorMessage( QObject::tr( "To the log file %1 can not be added." ).arg( m_logFile.data()->fileName() ) );
-            m_logFile.reset();
+            qCritical( logMain ) << QObject::tr( "To the log file %1 can not be added." ).arg( settings->pathToLog );
+            w.wErrorMessage( QObject::tr( "To the log file %1 can not be added." ).arg( settings->pathToLog ) );
         }
     }
 
     qInfo( logMain ) << QObject::tr( "App Crypto is running, ver%1" ).arg( app.applicationVersion() );
+    // select the fastest cipher backends, the measurements of an earlier start are reused
+    BackendProbe::select();
 
-    return app.exec();
+    const int ret = app.exec();
+    // write the remaining messages before the application exits
+    qInstallMessageHandler( 0 );
+    LogSink::stop();
+
+    return ret;
 }
 
 /**
  * @brief The function logMessageOutput is a message handler.
  *
  * This function redirects the messages by their category (QtDebugMsg,
- * QtInfoMsg, QtWarningMsg, QtCriticalMsg, QtFatalMsg) to the log file (m_logFile).
+ * QtInfoMsg, QtWarningMsg, QtCriticalMsg, QtFatalMsg) to the log file.
+ * The message is only queued (LogSink::post), the background thread of LogSink formats it
+ * and writes it in a batch, so that logging does not stall the encryption.
  * The message handler is a function that prints out debug messages,
  * warnings, critical and fatal error messages. The Qt library (debug mode)
  * contains hundreds of warning messages that are printed when internal errors
@@ -135,6 +223,7 @@ int main(int argc, char *argv[])
  *
  * @note
  * - The output of messages is also output to the terminal console. This is for debugging purposes.
+ * - A fatal message is written synchronously before the application aborts.
  * - Additional information, such as a line of code, the name of the source file, function names
  * cannot be displayed for the release of the program.
  *
@@ -147,37 +236,234 @@ int main(int argc, char *argv[])
  */
 void logMessageOutput( const QtMsgType type, const QMessageLogContext &context, const QString &msg )
 {
-    QTextStream out( m_logFile.data() );
-    // Write the date of the recording
-    out << QDateTime::currentDateTime().toString( "yyyy-MM-dd hh:mm:ss.zzz " );
-
-    QByteArray localMsg = msg.toLocal8Bit();
-    switch ( type )
-    {
-    case QtDebugMsg:
-        out << "DBG ";
-        break;
-    case QtInfoMsg:
-        out << "INF ";
-        break;
-    case QtWarningMsg:
-        out << "WRN ";
-        break;
-    case QtCriticalMsg:
-        out << "CRT ";
-        break;
-    case QtFatalMsg:
-        out << "FTL ";
-        break;
-    default :
-        out << "ERR ";
-    }
-#ifdef DEBUG_OUTPUT
-    out << context.category << ": " << msg << " (" << context.file << ":" << context.line << ", " << context.function << ")" << "<br />" << endl;
-#else // only for release
-    out << context.category << ": " << msg << "<br />" << endl;
-#endif
-    out.flush();
-    // Output messages to the terminal console. Only for debugging purposes.
-    fprintf( stdout, "%s\n", localMsg.constData() );
+    LogSink::post( type, context, msg );
+}
+
+/**
+ * @brief The function verifyTree verifies encrypted data from the command line.
+ *
+ * The files are decrypted in memory and compared with the digests of the manifests
+ * (see TreeVerifier), one line per file is printed to the standard output:
+ * OK, MISMATCH, UNREADABLE or NODIGEST and the path.
+ *
+ * @param[in] paths of the type QStringList, encrypted files and directories (recursively)
+ * @param[in] method of the type QString, "aes", "aes-gcm", "chacha20" or "xor", see MainWindow::methodFromName
+ * @param[in] reportPath of the type QString, path to the JSON report, no report if empty
+ *
+ * @return 0 if all files with a digest are verified, 1 if a file fails, 2 on wrong parameters.
+ */
+int verifyTree( const QStringList &paths, const QString &method, const QString &reportPath )
+{
+    CryptFileDevice::EncryptionMethod encMethod = CryptFileDevice::AesCipher;
+    if ( !MainWindow::methodFromName( method, encMethod ) )
+    {
+        fprintf( stderr, "%s\n", qPrintable( QObject::tr( "Unknown encryption method: %1" ).arg( method ) ) );
+        return 2;
+    }
+    BackendProbe::select();
+
+    const QByteArray password = readPassword( "CRYPTO_PASSWORD", QObject::tr( "Password: " ) );
+    if ( password.isEmpty() )
+    {
+        fprintf( stderr, "%s\n", qPrintable( QObject::tr( "Password not entered!" ) ) );
+        return 2;
+    }
+
+    const QStringList files = TreeVerifier::collectFiles( paths, true );
+    RunReport report( "verify" );
+    report.setParameter( "method", method.toLower() );
+    report.start();
+
+    TreeVerifier verifier( password, MainWindow::salt(), encMethod );
+    int failed = 0;
+    foreach ( const VerifyResult &result, verifier.verify( files ) )
+    {
+        const char *status = "OK";
+        RunReport::FileStatus fileStatus = RunReport::Success;
+        switch ( result.status )
+        {
+        case VerifyResult::Ok:
+            break;
+        case VerifyResult::Mismatch:
+            status = "MISMATCH";
+            fileStatus = RunReport::Error;
+            failed++;
+            break;
+        case VerifyResult::Unreadable:
+            status = "UNREADABLE";
+            fileStatus = RunReport::Failed;
+            failed++;
+            break;
+        case VerifyResult::NoDigest:
+            status = "NODIGEST";
+            break;
+        }
+        fprintf( stdout, "%-10s %s\n", status, qPrintable( QDir::toNativeSeparators( result.fileName ) ) );
+        if ( result.status != VerifyResult::NoDigest )
+        {
+            report.addFile( result.fileName, result.size, result.durationNsecs, fileStatus );
+        }
+    }
+    fflush( stdout );
+
+    report.finish();
+    if ( !reportPath.isEmpty() )
+    {
+        report.write( reportPath );
+    }
+
+    return ( failed == 0 ) ? 0 : 1;
+}
+
+/**
+ * @brief The function readPassword reads a password for the command line modes.
+ *
+ * @param[in] variable of the type char*, name of the environment variable with the password
+ * @param[in] prompt of the type QString, printed to the standard error before a line is read from the standard input
+ *
+ * @return the password, empty if none was entered.
+ */
+QByteArray readPassword( const char *variable, const QString &prompt )
+{
+    QByteArray password = qgetenv( variable );
+    if ( password.isEmpty() )
+    {
+        fprintf( stderr, "%s", qPrintable( prompt ) );
+        // unbuffered, so that the next password remains in stdin
+        QFile input;
+        if ( input.open( stdin, QIODevice::ReadOnly | QIODevice::Text | QIODevice::Unbuffered ) )
+        {
+            password = input.readLine().trimmed();
+        }
+    }
+
+    return password;
+}
+
+/**
+ * @brief The function rekeyTree encrypts encrypted data with a new password from the command line.
+ *
+ * The files are re-encrypted without writing the plain data (see Rekeyer), one line per file
+ * is printed to the standard output: OK, RESUMED, SKIPPED or FAILED and the path.
+ * An interrupted run is completed by running it again with the same passwords.
+ *
+ * @param[in] paths of the type QStringList, encrypted files and directories (recursively)
+ * @param[in] reportPath of the type QString, path to the JSON report, no report if empty
+ *
+ * @return 0 if all files are rekeyed, 1 if a file fails, 2 on wrong parameters.
+ */
+int rekeyTree( const QStringList &paths, const QString &reportPath )
+{
+    BackendProbe::select();
+
+    const QByteArray oldPassword = readPassword( "CRYPTO_PASSWORD", QObject::tr( "Password: " ) );
+    const QByteArray newPassword = oldPassword.isEmpty()
+                                   ? QByteArray()
+                                   : readPassword( "CRYPTO_NEW_PASSWORD", QObject::tr( "New password: " ) );
+    if ( oldPassword.isEmpty() || newPassword.isEmpty() )
+    {
+        fprintf( stderr, "%s\n", qPrintable( QObject::tr( "Password not entered!" ) ) );
+        return 2;
+    }
+
+    Rekeyer rekeyer( oldPassword, newPassword, MainWindow::salt() );
+    return runRekeyer( rekeyer, paths, "rekey", reportPath );
+}
+
+/**
+ * @brief The function migrateTree converts encrypted data of version 1.0 from the command line.
+ *
+ * The files of version 1.0 have no header, they are read with the given method, buffer size and salt
+ * and replaced by files with a header, encrypted with the same password (see Rekeyer::setLegacyFormat).
+ * Files with a header are skipped. One line per file is printed like by rekeyTree().
+ *
+ * @param[in] paths of the type QStringList, encrypted files and directories (recursively)
+ * @param[in] method of the type QString, "aes" or "xor"
+ * @param[in] bufferSize of the type QString, the size of the buffer of version 1.0, in MiB
+ * @param[in] salt of the type QByteArray, the salt of version 1.0
+ * @param[in] reportPath of the type QString, path to the JSON report, no report if empty
+ *
+ * @return 0 if all files are converted or skipped, 1 if a file fails, 2 on wrong parameters.
+ */
+int migrateTree( const QStringList &paths, const QString &method, const QString &bufferSize,
+                 const QByteArray &salt, const QString &reportPath )
+{
+    CryptFileDevice::EncryptionMethod encMethod = CryptFileDevice::AesCipher;
+    if ( !MainWindow::methodFromName( method, encMethod )
+         || ( encMethod != CryptFileDevice::AesCipher && encMethod != CryptFileDevice::XorCipher ) )
+    {
+        fprintf( stderr, "%s\n", qPrintable( QObject::tr( "Unknown encryption method of version 1.0: %1" ).arg( method ) ) );
+        return 2;
+    }
+    bool ok = false;
+    const qint64 chunkSize = bufferSize.toLongLong( &ok ) * ONEKB * ONEKB;
+    if ( !ok || chunkSize <= 0 )
+    {
+        fprintf( stderr, "%s\n", qPrintable( QObject::tr( "Wrong size of the buffer: %1" ).arg( bufferSize ) ) );
+        return 2;
+    }
+    BackendProbe::select();
+
+    const QByteArray password = readPassword( "CRYPTO_PASSWORD", QObject::tr( "Password: " ) );
+    if ( password.isEmpty() )
+    {
+        fprintf( stderr, "%s\n", qPrintable( QObject::tr( "Password not entered!" ) ) );
+        return 2;
+    }
+
+    Rekeyer rekeyer( password, password, salt );
+    rekeyer.setLegacyFormat( encMethod, chunkSize );
+    return runRekeyer( rekeyer, paths, "migrate", reportPath );
+}
+
+/**
+ * @brief The function runRekeyer rekeys the files and prints the results.
+ *
+ * @param[in] rekeyer of the type Rekeyer&, configured with the passwords
+ * @param[in] paths of the type QStringList, encrypted files and directories (recursively)
+ * @param[in] job of the type char*, name of the job in the JSON report
+ * @param[in] reportPath of the type QString, path to the JSON report, no report if empty
+ *
+ * @return 0 if all files are rekeyed, 1 if a file fails.
+ */
+int runRekeyer( Rekeyer &rekeyer, const QStringList &paths, const char *job, const QString &reportPath )
+{
+    const QStringList files = Rekeyer::collectFiles( paths, true );
+    RunReport report( job );
+    report.start();
+
+    int failed = 0;
+    foreach ( const RekeyResult &result, rekeyer.rekey( files ) )
+    {
+        const char *status = result.resumed ? "RESUMED" : "OK";
+        RunReport::FileStatus fileStatus = RunReport::Success;
+        switch ( result.status )
+        {
+        case RekeyResult::Ok:
+            break;
+        case RekeyResult::Skipped:
+            status = "SKIPPED";
+            break;
+        case RekeyResult::Failed:
+            status = "FAILED";
+            fileStatus = RunReport::Failed;
+            failed++;
+            break;
+        }
+        fprintf( stdout, "%-10s %s\n", status, qPrintable( QDir::toNativeSeparators( result.fileName ) ) );
+        if ( result.status == RekeyResult::Failed )
+        {
+            fprintf( stderr, "%s\n", qPrintable( result.errorString ) );
+        }
+        report.addFile( result.fileName, result.size, result.durationNsecs, fileStatus );
+    }
+    fflush( stdout );
+
+    report.finish();
+    if ( !reportPath.isEmpty() )
+    {
+        report.write( reportPath );
+    }
+
+    return ( failed == 0 ) ? 0 : 1;
 }
@@ -19,15 +19,29 @@
 //------------------------------------------------------------------------------
 #include <QtGui>
 #include <QTextCodec>
+#include <QMessageAuthenticationCode>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QFontDialog>
+#include <QDockWidget>
+#include <QtConcurrent>
 #include <QtDebug>
 #include <limits>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "settingsdialog.h"
 #include "cryptfiledevice.h"
+#include "tracer.h"
+#include "runreport.h"
+#include "jobmonitor.h"
+#include "throughputpanel.h"
+#include "buffertuner.h"
+#include "bufferpool.h"
+#include "compressiondevice.h"
+#include "packarchive.h"
+#include "jobinput.h"
+#include "treeverifier.h"
+#include "backendprobe.h"
 
 //------------------------------------------------------------------------------
 // Types
@@ -46,12 +60,20 @@ Q_LOGGING_CATEGORY(logMainWindow, "MainWin")
 MainWindow::MainWindow( QWidget *parent ) :
     QMainWindow( parent ),
     ui( new Ui::MainWindow ),
-    fullSize( 0LL )
+    fullSize( 0LL ),
+    keyGeneration( 0 ),
+    keyPending( -1 )
 {
+    this->newJobSalt();
     ui->setupUi( this );
     this->settings = new SettingsDialog( this );
     this->currentSettings = settings->getSettings();
 
+    // The key is derived in the background as soon as the passwords match
+    this->keyWatcher = new QFutureWatcher<DerivedKey>( this );
+    QObject::connect(keyWatcher, SIGNAL(finished()),
+                     this, SLOT(keyDerived()));
+
     QTextCodec *codec = QTextCodec::codecForName( "UTF-8" );
     QTextCodec::setCodecForLocale( codec );
 
@@ -83,9 +105,14 @@ MainWindow::MainWindow( QWidget *parent ) :
     ui->clearList->setStatusTip( QObject::tr("Clear the entire list in one click") );
     ui->overwriteData->setStatusTip( QObject::tr("Overwrite the selected data in encrypted form"));
     ui->recurseDirs->setStatusTip( QObject::tr("Process all subdirectories recursively"));
-    ui->bufferSize->setStatusTip( QObject::tr("Set the size of the buffer for processing"));
+    ui->packDirs->setStatusTip( QObject::tr("Store all files of a directory in one encrypted container (<dir>.pack)"));
+    ui->compressData->setStatusTip( QObject::tr("Compress the data before the encryption, compressed files are decompressed on decryption"));
+    ui->bufferSize->setStatusTip( QObject::tr("Set the size of the buffer for processing, Auto measures the throughput and selects the size"));
     ui->xorCrypt->setStatusTip( QObject::tr("Simple XOR encryption method (less reliable)"));
     ui->aesCrypt->setStatusTip( QObject::tr("AES encryption method (more reliable)"));
+    ui->gcmCrypt->setStatusTip( QObject::tr("AES-GCM encryption method, detects damaged or modified files"));
+    ui->chachaCrypt->setStatusTip( QObject::tr("ChaCha20 encryption method, faster than AES on processors without AES instructions"));
+    ui->chachaCrypt->setEnabled( CryptFileDevice::isMethodSupported( CryptFileDevice::ChaCha20Cipher ) );
     ui->passLine->setStatusTip( QObject::tr("Permitted only main letters(Aa-Zz) and numbers"));
 
     ui->targetsList->addAction(editItemAction);
@@ -111,6 +138,16 @@ MainWindow::MainWindow( QWidget *parent ) :
     this->status->setStyleSheet( QString("color: blue") );
     ui->statusBar->addPermanentWidget( status, 0 );
     this->updateStatusBar();
+
+    // Dockable live panel of the throughput and the queue depths
+    this->throughputDock = new QDockWidget( QObject::tr( "Live throughput" ), this );
+    this->throughputDock->setObjectName( "throughputDock" );
+    this->throughputDock->setWidget( new ThroughputPanel( throughputDock ) );
+    this->addDockWidget( Qt::BottomDockWidgetArea, throughputDock );
+    QAction *toggleDock = this->throughputDock->toggleViewAction();
+    toggleDock->setStatusTip( QObject::tr("Show or hide the live throughput panel") );
+    ui->menuProcessing->addAction( toggleDock );
+    this->throughputDock->setVisible( QSettings().value( "Geometry/throughputDock", false ).toBool() );
 }
 
 /**
@@ -118,6 +155,8 @@ MainWindow::MainWindow( QWidget *parent ) :
  */
 MainWindow::~MainWindow()
 {
+    this->keyWatcher->waitForFinished();
+    CryptFileDevice::clearKeyCache();
     delete ui;
 }
 
@@ -130,6 +169,83 @@ Settings *MainWindow::getSettings() const
     return currentSettings;
 }
 
+/**
+ * @brief get-function for the default salt of the passwords
+ *
+ * New files are encrypted with a random salt per job (jobSalt) which is stored in their header.
+ * This salt is only used for headers without a salt.
+ *
+ * @return salt of the type QByteArray
+ */
+QByteArray MainWindow::salt( void )
+{
+    //! \todo Password salt is taken from the release time of the program, taken in microseconds.
+    return QByteArray( __TIME__ );
+}
+
+/**
+ * @brief MainWindow::methodName
+ * @param method of the type CryptFileDevice::EncryptionMethod
+ * @return the name of the method in reports and on the command line: "xor", "aes", "aes-gcm" or "chacha20"
+ */
+QString MainWindow::methodName( CryptFileDevice::EncryptionMethod method )
+{
+    switch ( method )
+    {
+    case CryptFileDevice::XorCipher:
+        return QStringLiteral( "xor" );
+    case CryptFileDevice::AesGcmCipher:
+        return QStringLiteral( "aes-gcm" );
+    case CryptFileDevice::ChaCha20Cipher:
+        return QStringLiteral( "chacha20" );
+    default:
+        return QStringLiteral( "aes" );
+    }
+}
+
+/**
+ * @brief MainWindow::methodFromName
+ * @param name of the type QString&, see MainWindow::methodName, the case is ignored
+ * @param method of the type CryptFileDevice::EncryptionMethod&, receives the method
+ * @retval true if the name is known,
+ * @retval false otherwise.
+ */
+bool MainWindow::methodFromName( const QString &name, CryptFileDevice::EncryptionMethod &method )
+{
+    for ( int i = CryptFileDevice::XorCipher; i <= CryptFileDevice::ChaCha20Cipher; i++ )
+    {
+        const CryptFileDevice::EncryptionMethod candidate = static_cast<CryptFileDevice::EncryptionMethod>( i );
+        if ( name.compare( MainWindow::methodName( candidate ), Qt::CaseInsensitive ) == 0 )
+        {
+            method = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief get-function for the encryption method selected in the window
+ * @return method of the type CryptFileDevice::EncryptionMethod
+ */
+CryptFileDevice::EncryptionMethod MainWindow::encryptionMethod( void ) const
+{
+    if ( ui->xorCrypt->isChecked() )
+    {
+        return CryptFileDevice::XorCipher;
+    }
+    if ( ui->gcmCrypt->isChecked() )
+    {
+        return CryptFileDevice::AesGcmCipher;
+    }
+    if ( ui->chachaCrypt->isChecked() )
+    {
+        return CryptFileDevice::ChaCha20Cipher;
+    }
+    return CryptFileDevice::AesCipher;
+}
+
 /**
  * @brief Critical error message in a separate window.
  * @param message of the type QString, error message.
@@ -167,6 +283,8 @@ QStringList MainWindow::getDirFiles( const QString &dirPath ) const
     Q_ASSERT( dir.exists() );
     QStringList fileNames;
     QStringList fileList = dir.entryList(QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+    // the manifests of the digests are not processed
+    fileList.removeAll( QLatin1String( TreeVerifier::kManifestName ) );
     foreach( const QString &fit, fileList )
     {
         fileNames.append(dir.absolutePath() + QDir::separator() + fit );
@@ -218,9 +336,33 @@ void MainWindow::readSettings( void )
     ui->recurseDirs->setChecked(recurseDirs);
     int bufferSize = settings.value("bufferSize", 5).toInt();
     ui->bufferSize->setValue(bufferSize);
+    this->bufferBudget = settings.value("bufferBudget", 256).toLongLong();
+    this->smallFileLimit = settings.value("smallFileLimit", 1024).toLongLong();
+    this->writeDigests = settings.value("writeDigests", false).toBool();
+    bool compressData = settings.value("compressData", false).toBool();
+    ui->compressData->setChecked(compressData);
+    this->compressLevel = settings.value("compressLevel", 6).toInt();
+    const QString kdf = settings.value("kdf", "pbkdf2").toString();
+    this->kdf = ( kdf == "scrypt" ) ? CryptFileDevice::Scrypt : CryptFileDevice::Pbkdf2Sha256;
+    if ( !CryptFileDevice::isKeyDerivationSupported( this->kdf ) )
+    {
+        qWarning(logMainWindow) << QObject::tr( "The key derivation %1 is not supported, PBKDF2 is used" ).arg( kdf );
+        this->kdf = CryptFileDevice::Pbkdf2Sha256;
+    }
+    this->kdfMsecs = settings.value("kdfMsecs", 500).toInt();
+    // the cost is calibrated per key derivation, an iteration count of PBKDF2 is no cost of scrypt
+    const QString kdfName = ( this->kdf == CryptFileDevice::Scrypt ) ? "scrypt" : "pbkdf2";
+    this->kdfCost = settings.value("kdfCost/" + kdfName, 0).toInt();
+    bool packDirs = settings.value("packDirs", false).toBool();
+    ui->packDirs->setChecked(packDirs);
     bool xorCrypt = settings.value("xorCrypt", false).toBool();
+    bool gcmCrypt = settings.value("gcmCrypt", false).toBool();
+    bool chachaCrypt = settings.value("chachaCrypt", false).toBool()
+                       && CryptFileDevice::isMethodSupported( CryptFileDevice::ChaCha20Cipher );
     ui->xorCrypt->setChecked(xorCrypt);
-    ui->aesCrypt->setChecked(!xorCrypt);
+    ui->gcmCrypt->setChecked(!xorCrypt && gcmCrypt);
+    ui->chachaCrypt->setChecked(!xorCrypt && !gcmCrypt && chachaCrypt);
+    ui->aesCrypt->setChecked(!xorCrypt && !gcmCrypt && !chachaCrypt);
     QString lastUsedPath = settings.value("lastUsedPath", QStandardPaths::writableLocation(QStandardPaths::HomeLocation)).toString();
     this->lastUsedPath = lastUsedPath;
     QString lastUsedDir = settings.value("lastUsedDir", QStandardPaths::writableLocation(QStandardPaths::HomeLocation)).toString();
@@ -234,6 +376,24 @@ void MainWindow::readSettings( void )
     this->getSettings()->pathToLog = pathToLog;
     quint32 maxSizeLog = settings.value("maxSizeLog", 10U).toUInt();
     this->getSettings()->maxSizeLog = maxSizeLog;
+    quint32 logRotateHours = settings.value("logRotateHours", 24U).toUInt();
+    this->getSettings()->logRotateHours = logRotateHours;
+    quint32 logArchives = settings.value("logArchives", 5U).toUInt();
+    this->getSettings()->logArchives = logArchives;
+    quint32 logFlushInterval = settings.value("logFlushInterval", 200U).toUInt();
+    this->getSettings()->logFlushInterval = logFlushInterval;
+    quint32 logQueueCapacity = settings.value("logQueueCapacity", 65536U).toUInt();
+    this->getSettings()->logQueueCapacity = logQueueCapacity;
+    bool logBlockWhenFull = settings.value("logBlockWhenFull", false).toBool();
+    this->getSettings()->logBlockWhenFull = logBlockWhenFull;
+    bool enableStatistics = settings.value("enableStatistics", false).toBool();
+    this->getSettings()->enableStatistics = enableStatistics;
+    CryptFileDevice::setStatisticsEnabled( enableStatistics );
+    QString pathToTrace = settings.value("pathToTrace", QString()).toString();
+    this->getSettings()->pathToTrace = pathToTrace;
+    QString pathToReport = settings.value("pathToReport", QString()).toString();
+    this->getSettings()->pathToReport = pathToReport;
+    this->reportPath = pathToReport;
     settings.endGroup();
 }
 
@@ -252,6 +412,7 @@ void MainWindow::writeSettings( void ) const
     settings.beginGroup("Geometry");
     settings.setValue("pos", pos());
     settings.setValue("size", size());
+    settings.setValue("throughputDock", this->throughputDock->isVisible());
     settings.endGroup();
 
     settings.beginGroup("Font");
@@ -262,7 +423,19 @@ void MainWindow::writeSettings( void ) const
     settings.setValue("overwriteData", ui->overwriteData->isChecked());
     settings.setValue("recurseDirs", ui->recurseDirs->isChecked());
     settings.setValue("bufferSize", ui->bufferSize->value());
+    settings.setValue("bufferBudget", this->bufferBudget);
+    settings.setValue("smallFileLimit", this->smallFileLimit);
+    settings.setValue("writeDigests", this->writeDigests);
+    settings.setValue("compressData", ui->compressData->isChecked());
+    settings.setValue("compressLevel", this->compressLevel);
+    const QString kdfName = ( this->kdf == CryptFileDevice::Scrypt ) ? "scrypt" : "pbkdf2";
+    settings.setValue("kdf", kdfName);
+    settings.setValue("kdfMsecs", this->kdfMsecs);
+    settings.setValue("kdfCost/" + kdfName, this->kdfCost);
+    settings.setValue("packDirs", ui->packDirs->isChecked());
     settings.setValue("xorCrypt", ui->xorCrypt->isChecked());
+    settings.setValue("gcmCrypt", ui->gcmCrypt->isChecked());
+    settings.setValue("chachaCrypt", ui->chachaCrypt->isChecked());
     settings.setValue("lastUsedPath", this->lastUsedPath);
     settings.setValue("lastUsedDir", this->lastUsedDir);
     settings.endGroup();
@@ -271,6 +444,14 @@ void MainWindow::writeSettings( void ) const
     settings.setValue("enableLog", this->getSettings()->enableLog);
     settings.setValue("pathToLog", this->getSettings()->pathToLog);
     settings.setValue("maxSizeLog", this->getSettings()->maxSizeLog);
+    settings.setValue("logRotateHours", this->getSettings()->logRotateHours);
+    settings.setValue("logArchives", this->getSettings()->logArchives);
+    settings.setValue("logFlushInterval", this->getSettings()->logFlushInterval);
+    settings.setValue("logQueueCapacity", this->getSettings()->logQueueCapacity);
+    settings.setValue("logBlockWhenFull", this->getSettings()->logBlockWhenFull);
+    settings.setValue("enableStatistics", this->getSettings()->enableStatistics);
+    settings.setValue("pathToTrace", this->getSettings()->pathToTrace);
+    settings.setValue("pathToReport", this->getSettings()->pathToReport);
     settings.endGroup();
 }
 
@@ -434,6 +615,7 @@ void MainWindow::addFiles( void )
 
     ui->execButton->setEnabled(!(ui->targetsList->rowCount() == 0));
     ui->actionEncryption->setEnabled(!(ui->targetsList->rowCount() == 0));
+    ui->actionVerify->setEnabled(!(ui->targetsList->rowCount() == 0));
 }
 
 /**
@@ -485,6 +667,7 @@ void MainWindow::addDirs( void )
 
     ui->execButton->setEnabled(!(ui->targetsList->rowCount() == 0));
     ui->actionEncryption->setEnabled(!(ui->targetsList->rowCount() == 0));
+    ui->actionVerify->setEnabled(!(ui->targetsList->rowCount() == 0));
     qInfo(logMainWindow) << QObject::tr( "Added a new directory to the list: %1" ).arg( dirPath );
 }
 
@@ -495,8 +678,14 @@ void MainWindow::addDirs( void )
  */
 MainWindow::ProcessStatus MainWindow::fileProcessing( const QString &f )
 {
+    JobMonitor::leave( JobMonitor::Pending );
     QFile file(f);
-    if ( !file.open( QIODevice::ReadOnly ) )
+    bool opened;
+    {
+        CRYPTO_TRACE_SPAN( "open", "file", f );
+        opened = file.open( QIODevice::ReadOnly );
+    }
+    if ( !opened )
     {
         int ret = QMessageBox::critical( this,
                                          QObject::tr( "Critical" ),
@@ -511,24 +700,89 @@ MainWindow::ProcessStatus MainWindow::fileProcessing( const QString &f )
         return PROCESS_STATUS_CONTINUE;
     }
 
+    // An encrypted file is decrypted into a plain file (and decompressed, if it is a compressed stream),
+    // all other files are encrypted (and compressed, if selected).
+    Q_ASSERT_X( decryptFile != nullptr, Q_FUNC_INFO, "Null pointer" );
+    QScopedPointer<CompressionDevice> compression;
+    JobInput::Kind kind = JobInput::classify( decryptFile, f );
+    if ( kind == JobInput::WrongPassword )
+    {
+        // encrypting it again would hide the file under a second password
+        file.close();
+        qCritical(logMainWindow) << QObject::tr( "Wrong password for the file: %1" ).arg( f );
+        int ret = QMessageBox::critical( this,
+                                         QObject::tr( "Critical" ),
+                                         QObject::tr( "The file %1 is encrypted with another password, it is left unchanged.\n"
+                                                      "Do you want to continue execution for next data?" ).arg( f ),
+                                         QMessageBox::Abort | QMessageBox::Ok );
+        if ( ret == QMessageBox::Abort )
+        {
+            return PROCESS_STATUS_BREAK;
+        }
+        return PROCESS_STATUS_CONTINUE;
+    }
+    if ( kind == JobInput::PackData )
+    {
+        file.close();
+        return this->unpackProcessing( f );
+    }
+    if ( kind == JobInput::CompressedData )
+    {
+        compression.reset( new CompressionDevice( decryptFile ) );
+        if ( !compression->open( QIODevice::ReadOnly ) )
+        {
+            compression.reset();
+            decryptFile->close();
+            kind = JobInput::PlainData;
+        }
+    }
+    const bool decompress = !compression.isNull();
+    const bool decrypt = ( kind != JobInput::PlainData );
+
     //! \todo Make an extension for encrypted files! ( ".enc" )
-    QString extension( ".enc" );
+    QString extension( decrypt ? ".dec" : ".enc" );
     if ( ui->overwriteData->isChecked() )
     {
         qsrand( QDateTime::currentDateTime().toTime_t() );
         extension.clear();
         extension = ".tmp" + QString::number(qrand() % 65535);
     }
+    const QString outputName = f + extension;
+    QFile plainFile( outputName );
     Q_ASSERT_X( encryptFile != nullptr, Q_FUNC_INFO, "Null pointer" );
-    encryptFile->setFileName( f + extension );
-    if ( !encryptFile->open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    if ( decrypt )
+    {
+        CRYPTO_TRACE_SPAN( "open", "file", outputName );
+        opened = plainFile.open( QIODevice::WriteOnly | QIODevice::Truncate );
+    }
+    else
+    {
+        encryptFile->setFileName( outputName );
+        {
+            CRYPTO_TRACE_SPAN( "open+kdf", "file", outputName );
+            opened = encryptFile->open( QIODevice::WriteOnly | QIODevice::Truncate );
+        }
+        if ( opened && ui->compressData->isChecked() )
+        {
+            compression.reset( new CompressionDevice( encryptFile ) );
+            compression->setLevel( this->compressLevel );
+            opened = compression->open( QIODevice::WriteOnly );
+            if ( !opened )
+            {
+                encryptFile->close();
+            }
+        }
+    }
+    if ( !opened )
     {
         int ret = QMessageBox::critical( this,
                                          QObject::tr("Critical"),
                                          QObject::tr("Unable to write encrypted file %1\n"
-                                                     "Do you want to continue execution for next data?" ).arg( encryptFile->fileName() ),
+                                                     "Do you want to continue execution for next data?" ).arg( outputName ),
                                          QMessageBox::Abort | QMessageBox::Ok );
-        qCritical(logMainWindow) << QObject::tr( "Unable to write encrypted file: %1" ).arg( encryptFile->fileName() );
+        qCritical(logMainWindow) << QObject::tr( "Unable to write encrypted file: %1" ).arg( outputName );
+        compression.reset();
+        decryptFile->close();
         file.close();
         if ( ret == QMessageBox::Abort )
         {
@@ -537,49 +791,410 @@ MainWindow::ProcessStatus MainWindow::fileProcessing( const QString &f )
         return PROCESS_STATUS_CONTINUE;
     }
 
-    ui->progressFileBar->reset();
-    ui->progressFileBar->setRange( 1, file.size() );
+    QIODevice *input = decompress ? static_cast<QIODevice *>( compression.data() )
+                                  : ( decrypt ? static_cast<QIODevice *>( decryptFile ) : &file );
+    QIODevice *output = decrypt ? static_cast<QIODevice *>( &plainFile )
+                                : ( compression.isNull() ? static_cast<QIODevice *>( encryptFile ) : compression.data() );
 
-    const qint64 bufferSize = static_cast<qint64>(ui->bufferSize->value()) * COEFF;
-    qint64 ret, sum = 0LL;
-    do {
-        try
+    // Cleanup after a failed transfer: the partial output is discarded.
+    auto discard = [&]() -> ProcessStatus
+    {
+        compression.reset();
+        decryptFile->close();
+        file.close();
+        encryptFile->close();
+        plainFile.close();
+        QFile::remove( outputName );
+        ui->progressFileBar->reset();
+        return PROCESS_STATUS_BREAK;
+    };
+
+    // The digest of the plain data is computed on the buffers which are encrypted, without an extra read.
+    // It is keyed (HMAC), the manifest is written in the clear next to the file.
+    const bool hashing = !decrypt && this->writeDigests;
+    QMessageAuthenticationCode digest( QCryptographicHash::Sha256, hashing ? encryptFile->digestKey() : QByteArray() );
+
+    const qint64 fileSize = file.size();
+    qint64 ret, sum = 0LL, consumed = 0LL;
+    // Fast path for small files: one read and one write through a pooled buffer,
+    // without the tuner and without the per-chunk progress of the file.
+    // If the pool cannot provide the buffer, the file goes through the chunk loop.
+    PooledBuffer whole;
+    if ( output == encryptFile && fileSize <= this->smallFileLimit * ONEKB )
+    {
+        whole = BufferPool::instance().acquire( qMax( fileSize, 1LL ) );
+    }
+    if ( !whole.isNull() )
+    {
         {
-            ret = encryptFile->write(file.read(bufferSize));
+            CRYPTO_TRACE_SPAN( "read", "io" );
+            JobStage stage( JobMonitor::Reading );
+            ret = file.read( whole.data(), fileSize );
         }
-        catch ( std::bad_alloc &ba )
+        if ( ret != fileSize )
         {
-            qCritical(logMainWindow) << QObject::tr( "Bad allocation memory, execution terminating: %1" ).arg( ba.what() );
-            QMessageBox::critical( this, QObject::tr("Error"), QObject::tr( "Bad allocation memory, execution terminating: %1\n"
-                                                                            "Advice: try to reduce the size of the buffer!" ).arg( ba.what() ));
-            ret = -1;
+            qCritical(logMainWindow) << QObject::tr( "Read Error: %1" ).arg( file.errorString() );
+            return discard();
         }
-        if ( processError || ret < 0 )
+        if ( ret > 0 )
         {
-            file.close();
-            encryptFile->close();
-            encryptFile->remove();
-            ui->progressFileBar->reset();
-            return PROCESS_STATUS_BREAK;
+            CRYPTO_TRACE_SPAN( "write", "io" );
+            JobStage stage( JobMonitor::Writing );
+            if ( hashing )
+            {
+                digest.addData( whole.data(), static_cast<int>( fileSize ) );
+            }
+            ret = encryptFile->write( whole.data(), fileSize );
         }
-        sum += ret;
-        ui->progressFileBar->setValue(sum);
-        qApp->processEvents( QEventLoop::ExcludeUserInputEvents );
+        if ( processError || ret != fileSize )
+        {
+            return discard();
+        }
+        sum = consumed = fileSize;
+        JobMonitor::addBytes( fileSize );
+    }
+    else
+    {
+        ui->progressFileBar->reset();
+        ui->progressFileBar->setRange( 1, fileSize );
+
+        // The value 0 of the spin box is the automatic mode (special value text "Auto")
+        BufferTuner *tuner = ( ui->bufferSize->value() == 0 ) ? this->bufferTuner( f ) : nullptr;
+        qint64 bufferSize = static_cast<qint64>(ui->bufferSize->value()) * COEFF;
+        do {
+            if ( tuner != nullptr )
+            {
+                bufferSize = tuner->chunkSize();
+            }
+            QElapsedTimer chunkTimer;
+            chunkTimer.start();
+            try
+            {
+                PooledBuffer chunk = BufferPool::instance().acquire( bufferSize );
+                if ( chunk.isNull() )
+                {
+                    throw std::bad_alloc();
+                }
+                qint64 chunkSize;
+                {
+                    CRYPTO_TRACE_SPAN( "read", "io" );
+                    JobStage stage( JobMonitor::Reading );
+                    chunkSize = input->read( chunk.data(), bufferSize );
+                }
+                if ( chunkSize == 0 )
+                {
+                    break;
+                }
+                if ( chunkSize < 0 )
+                {
+                    qCritical(logMainWindow) << QObject::tr( "Read Error: %1" ).arg( input->errorString() );
+                    ret = -1;
+                }
+                else
+                {
+                    CRYPTO_TRACE_SPAN( "write", "io" );
+                    JobStage stage( JobMonitor::Writing );
+                    if ( hashing )
+                    {
+                        digest.addData( chunk.data(), static_cast<int>( chunkSize ) );
+                    }
+                    ret = output->write( chunk.data(), chunkSize );
+                }
+            }
+            catch ( std::bad_alloc &ba )
+            {
+                if ( tuner != nullptr )
+                {
+                    // retry the chunk with a smaller buffer
+                    tuner->allocationFailed();
+                    if ( tuner->chunkSize() < bufferSize && input->seek( sum ) )
+                    {
+                        continue;
+                    }
+                }
+                qCritical(logMainWindow) << QObject::tr( "Bad allocation memory, execution terminating: %1" ).arg( ba.what() );
+                QMessageBox::critical( this, QObject::tr("Error"), QObject::tr( "Bad allocation memory, execution terminating: %1\n"
+                                                                                "Advice: try to reduce the size of the buffer!" ).arg( ba.what() ));
+                ret = -1;
+            }
+            if ( processError || ret < 0 )
+            {
+                return discard();
+            }
+            if ( tuner != nullptr )
+            {
+                tuner->addSample( ret, chunkTimer.nsecsElapsed() );
+            }
+            sum += ret;
+            // the progress is measured in bytes of the source file
+            const qint64 position = decrypt ? decryptFile->pos() : file.pos();
+            JobMonitor::addBytes( position - consumed );
+            consumed = position;
+            ui->progressFileBar->setValue(consumed);
+            qApp->processEvents( QEventLoop::ExcludeUserInputEvents );
 
-    } while ( sum < file.size() );
+        } while ( !input->atEnd() );
+    }
 
-    file.close();
-    encryptFile->close();
+    bool finished = true;
+    {
+        CRYPTO_TRACE_SPAN( "close", "file", f );
+        if ( !compression.isNull() )
+        {
+            finished = compression->finish();
+            if ( !decompress && finished )
+            {
+                qInfo(logMainWindow) << QObject::tr( "Compressed %1 to %2 bytes" ).arg( sum ).arg( compression->compressedSize() );
+            }
+            compression->close();
+            compression.reset();
+        }
+        decryptFile->close();
+        file.close();
+        finished = encryptFile->finish() && finished;
+        encryptFile->close();
+        if ( plainFile.isOpen() )
+        {
+            finished = plainFile.flush() && finished;
+        }
+        plainFile.close();
+    }
+    // the original is only replaced by a complete output
+    if ( !finished )
+    {
+        qCritical(logMainWindow) << QObject::tr( "Unable to complete the file: %1" ).arg( outputName );
+        return discard();
+    }
     if ( ui->overwriteData->isChecked() )
     {
+        CRYPTO_TRACE_SPAN( "replace", "file", f );
         file.remove();
-        encryptFile->rename( f );
+        QFile::rename( outputName, f );
+    }
+
+    if ( hashing )
+    {
+        this->recordDigest( ui->overwriteData->isChecked() ? f : outputName, digest.result().toHex() );
+    }
+    else if ( decrypt && ui->overwriteData->isChecked() )
+    {
+        // the file is plain again, its digest is stale
+        this->recordDigest( f, QByteArray() );
     }
 
-    qInfo(logMainWindow) << QObject::tr( "Encryption was successfully complete file: %1" ).arg( file.fileName() );
+    if ( decompress )
+    {
+        qInfo(logMainWindow) << QObject::tr( "Decompression was successfully complete file: %1" ).arg( file.fileName() );
+    }
+    else if ( decrypt )
+    {
+        qInfo(logMainWindow) << QObject::tr( "Decryption was successfully complete file: %1" ).arg( file.fileName() );
+    }
+    else
+    {
+        qInfo(logMainWindow) << QObject::tr( "Encryption was successfully complete file: %1" ).arg( file.fileName() );
+    }
     return PROCESS_STATUS_SUCCESS;
 }
 
+/**
+ * @brief The function packs the files of a directory into one encrypted container.
+ *
+ * The container is written to <dir>.pack, so that the key derivation and the open / close
+ * of the encrypted file are paid once for all files. If the data is overwritten,
+ * the packed files are removed.
+ *
+ * @param dirPath of the type QString&, path to the directory.
+ * @param files of the type QStringList&, files of the directory.
+ * @return status of the packing process.
+ */
+MainWindow::ProcessStatus MainWindow::packProcessing( const QString &dirPath, const QStringList &files )
+{
+    const QDir dir( dirPath );
+    const QString packName = QDir::cleanPath( dir.absolutePath() ) + ".pack";
+    Q_ASSERT_X( encryptFile != nullptr, Q_FUNC_INFO, "Null pointer" );
+    encryptFile->setFileName( packName );
+    bool opened;
+    {
+        CRYPTO_TRACE_SPAN( "open+kdf", "file", packName );
+        opened = encryptFile->open( QIODevice::WriteOnly | QIODevice::Truncate );
+    }
+    PackArchive archive( encryptFile );
+    if ( !opened || !archive.create() )
+    {
+        encryptFile->close();
+        int ret = QMessageBox::critical( this,
+                                         QObject::tr("Critical"),
+                                         QObject::tr("Unable to write encrypted file %1\n"
+                                                     "Do you want to continue execution for next data?" ).arg( packName ),
+                                         QMessageBox::Abort | QMessageBox::Ok );
+        qCritical(logMainWindow) << QObject::tr( "Unable to write encrypted file: %1" ).arg( packName );
+        if ( ret == QMessageBox::Abort )
+        {
+            return PROCESS_STATUS_BREAK;
+        }
+        return PROCESS_STATUS_CONTINUE;
+    }
+
+    ProcessStatus status = PROCESS_STATUS_SUCCESS;
+    QStringList packed;
+    ui->progressFileBar->reset();
+    ui->progressFileBar->setRange( 0, files.size() );
+    // the events are processed periodically, not per file
+    QElapsedTimer uiTimer;
+    uiTimer.start();
+    for ( int i = 0; i < files.size(); i++ )
+    {
+        JobMonitor::leave( JobMonitor::Pending );
+        const QString fileName = dir.absoluteFilePath( files.at( i ) );
+        const qint64 before = encryptFile->pos();
+        bool ok;
+        {
+            JobStage stage( JobMonitor::Writing );
+            ok = archive.addFile( fileName, dir.relativeFilePath( fileName ) );
+        }
+        JobMonitor::addBytes( encryptFile->pos() - before );
+        JobMonitor::fileDone();
+        if ( processError )
+        {
+            status = PROCESS_STATUS_BREAK;
+            break;
+        }
+        if ( ok )
+        {
+            packed.append( fileName );
+        }
+        else
+        {
+            status = PROCESS_STATUS_CONTINUE;
+        }
+        if ( uiTimer.elapsed() > 100 )
+        {
+            ui->progressFileBar->setValue( i + 1 );
+            qApp->processEvents( QEventLoop::ExcludeUserInputEvents );
+            uiTimer.restart();
+        }
+    }
+
+    // the packed files are only removed, if the container is complete
+    if ( status != PROCESS_STATUS_BREAK && ( !archive.finish() || !encryptFile->finish() ) )
+    {
+        qCritical(logMainWindow) << QObject::tr( "Unable to complete the container: %1" ).arg( packName );
+        status = PROCESS_STATUS_BREAK;
+    }
+    {
+        CRYPTO_TRACE_SPAN( "close", "file", packName );
+        encryptFile->close();
+    }
+    if ( status == PROCESS_STATUS_BREAK )
+    {
+        QFile::remove( packName );
+        ui->progressFileBar->reset();
+        return PROCESS_STATUS_BREAK;
+    }
+
+    if ( ui->overwriteData->isChecked() )
+    {
+        CRYPTO_TRACE_SPAN( "replace", "file", packName );
+        foreach ( const QString &fileName, packed )
+        {
+            QFile::remove( fileName );
+        }
+    }
+
+    qInfo(logMainWindow) << QObject::tr( "Packing was successfully complete directory: %1, %2 of %3 files" )
+                            .arg( dirPath ).arg( packed.size() ).arg( files.size() );
+    return status;
+}
+
+/**
+ * @brief The function extracts all members of an encrypted container.
+ *
+ * The members are written to the directory of the container without the ".pack" suffix.
+ * If the data is overwritten, the container is removed.
+ *
+ * @note The container is open in decryptFile and is closed by this function.
+ *
+ * @param f of the type QString&, path to the container.
+ * @return status of the extraction process.
+ */
+MainWindow::ProcessStatus MainWindow::unpackProcessing( const QString &f )
+{
+    PackArchive archive( decryptFile );
+    if ( !archive.load() )
+    {
+        decryptFile->close();
+        int ret = QMessageBox::critical( this,
+                                         QObject::tr( "Critical" ),
+                                         QObject::tr( "Cannot read container %1: %2\n"
+                                                      "Do you want to continue execution for next data?").arg( f ).arg( archive.errorString() ),
+                                         QMessageBox::Abort | QMessageBox::Ok );
+        if ( ret == QMessageBox::Abort )
+        {
+            return PROCESS_STATUS_BREAK;
+        }
+        return PROCESS_STATUS_CONTINUE;
+    }
+
+    const QString targetDir = f.endsWith( ".pack" ) ? f.left( f.size() - 5 ) : f + ".unpacked";
+    const QVector<PackEntry> &entries = archive.entries();
+    ProcessStatus status = PROCESS_STATUS_SUCCESS;
+    ui->progressFileBar->reset();
+    ui->progressFileBar->setRange( 0, entries.size() );
+    QElapsedTimer uiTimer;
+    uiTimer.start();
+    for ( int i = 0; i < entries.size(); i++ )
+    {
+        bool ok;
+        {
+            JobStage stage( JobMonitor::Reading );
+            ok = archive.extract( i, targetDir );
+        }
+        JobMonitor::addBytes( entries.at( i ).length );
+        if ( !ok )
+        {
+            status = PROCESS_STATUS_CONTINUE;
+        }
+        if ( uiTimer.elapsed() > 100 )
+        {
+            ui->progressFileBar->setValue( i + 1 );
+            qApp->processEvents( QEventLoop::ExcludeUserInputEvents );
+            uiTimer.restart();
+        }
+    }
+    decryptFile->close();
+
+    if ( status == PROCESS_STATUS_SUCCESS && ui->overwriteData->isChecked() )
+    {
+        CRYPTO_TRACE_SPAN( "replace", "file", f );
+        QFile::remove( f );
+    }
+
+    qInfo(logMainWindow) << QObject::tr( "Extraction was successfully complete container: %1, %2 files" )
+                            .arg( f ).arg( entries.size() );
+    return status;
+}
+
+/**
+ * @brief The function returns the buffer tuner of the storage device of a file.
+ *
+ * The tuners live for the duration of one job (see MainWindow::execute), their
+ * winners are saved in QSettings at the end of the job.
+ *
+ * @param f of the type QString&, path to the file.
+ * @return the tuner of the type BufferTuner*
+ */
+BufferTuner *MainWindow::bufferTuner( const QString &f )
+{
+    const QString key = BufferTuner::storageKey( f );
+    QSharedPointer<BufferTuner> &tuner = this->bufferTuners[key];
+    if ( tuner.isNull() )
+    {
+        tuner.reset( new BufferTuner( key, this->bufferBudget * COEFF ) );
+    }
+    return tuner.data();
+}
+
 /**
  * @brief The helper performs the data encryption / decryption.
  *
@@ -615,24 +1230,34 @@ void MainWindow::execute( void )
     }
     ui->lockEncrypt->setChecked( true );
 
+    if ( !this->getSettings()->pathToTrace.isEmpty() )
+    {
+        Tracer::start( this->getSettings()->pathToTrace );
+    }
+    QScopedPointer<TraceSpan> jobSpan( new TraceSpan( "execute", "job" ) );
+
     QList<QStringList> fileLists;
 
-    for (int i = 0; i < ui->targetsList->rowCount(); i++)
     {
-        if ( this->targets.at(i).first == File )
+        CRYPTO_TRACE_SPAN( "scan", "job" );
+        for (int i = 0; i < ui->targetsList->rowCount(); i++)
         {
-            fileLists.append( QStringList( ui->targetsList->item(i, 0)->text()) );
-        }
-        else if ( this->targets.at(i).first == Dir )
-        {
-            if ( !ui->recurseDirs->isChecked() )
+            if ( this->targets.at(i).first == File )
             {
-                QStringList fDirList = QDir( ui->targetsList->item(i, 0)->text()).entryList(QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
-                fileLists.append(fDirList);
+                fileLists.append( QStringList( ui->targetsList->item(i, 0)->text()) );
             }
-            else
+            else if ( this->targets.at(i).first == Dir )
             {
-                fileLists.append( getDirFiles( ui->targetsList->item(i, 0)->text() ));
+                if ( !ui->recurseDirs->isChecked() )
+                {
+                    QStringList fDirList = QDir( ui->targetsList->item(i, 0)->text()).entryList(QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+                    fDirList.removeAll( QLatin1String( TreeVerifier::kManifestName ) );
+                    fileLists.append(fDirList);
+                }
+                else
+                {
+                    fileLists.append( getDirFiles( ui->targetsList->item(i, 0)->text() ));
+                }
             }
         }
     }
@@ -646,13 +1271,48 @@ void MainWindow::execute( void )
     CryptFileDevice encryptedFile;
     this->encryptFile = &encryptedFile;
     encryptedFile.setPassword( ui->passLine->text().toLatin1() );
-    //! \todo Password salt is taken from the release time of the program, taken in microseconds.
-    encryptedFile.setSalt( __TIME__ );
-    encryptedFile.setEncryptionMethod( (ui->aesCrypt->isChecked() ? CryptFileDevice::AesCipher : CryptFileDevice::XorCipher ) );
+    encryptedFile.setSalt( this->jobSalt );
+    encryptedFile.setEncryptionMethod( this->encryptionMethod() );
+    // A key derivation started while the password was typed is awaited instead of repeated.
+    if ( this->keyPending == this->keyGeneration )
+    {
+        this->keyWatcher->waitForFinished();
+        this->keyDerived();
+    }
+    // The cost of the key derivation is measured once for the wanted unlock time (kdfMsecs) and kept in the settings.
+    if ( this->kdfCost <= 0 )
+    {
+        this->kdfCost = CryptFileDevice::calibrate( this->kdf, this->kdfMsecs );
+    }
+    encryptedFile.setKeyDerivation( this->kdf );
+    encryptedFile.setNumRounds( this->kdfCost );
+    // reads compressed streams back
+    CryptFileDevice decryptedFile;
+    this->decryptFile = &decryptedFile;
+    decryptedFile.setPassword( ui->passLine->text().toLatin1() );
+    decryptedFile.setSalt( MainWindow::salt() );
+    decryptedFile.setEncryptionMethod( this->encryptionMethod() );
     QObject::connect(&encryptedFile, SIGNAL(errorMessage(QVariant)),
                      this, SLOT(wErrorMessage(QVariant)));
-    QTime timer;
-    timer.start();
+
+    RunReport report( "encrypt" );
+    report.setParameter( "method", MainWindow::methodName( this->encryptionMethod() ) );
+    report.setParameter( "kdf", ( this->kdf == CryptFileDevice::Scrypt ) ? "scrypt" : "pbkdf2" );
+    report.setParameter( "kdfCost", this->kdfCost );
+    report.setParameter( "bufferSize", ( ui->bufferSize->value() == 0 ) ? QVariant( "auto" ) : QVariant( static_cast<qint64>(ui->bufferSize->value()) * COEFF ) );
+    report.setParameter( "overwrite", ui->overwriteData->isChecked() );
+    report.setParameter( "compress", ui->compressData->isChecked() ? QVariant( this->compressLevel ) : QVariant( false ) );
+    report.setParameter( "recurse", ui->recurseDirs->isChecked() );
+    report.setParameter( "pack", ui->packDirs->isChecked() );
+    report.start();
+
+    qint64 filesTotal = 0;
+    foreach( const QStringList &flist, fileLists )
+    {
+        filesTotal += flist.size();
+    }
+    JobMonitor::begin( this->fullSize, filesTotal );
+    JobMonitor::workerStarted();
 
     int counterTargets = 0;
     foreach( const QStringList &flist, fileLists )
@@ -662,31 +1322,70 @@ void MainWindow::execute( void )
             break;
         }
         ProcessStatus retVal = PROCESS_STATUS_SUCCESS;
-        foreach( const QString &f, flist )
+        if ( ui->packDirs->isChecked() && this->targets.at( counterTargets ).first == Dir )
         {
-            retVal = fileProcessing( f );
-            if ( retVal == PROCESS_STATUS_SUCCESS )
-            {
-
-            }
-            else if ( retVal == PROCESS_STATUS_CONTINUE )
-            {
-                errorFlag = retVal;
-                continue;
-            }
-            else if ( retVal == PROCESS_STATUS_BREAK )
+            const QString dirPath = ui->targetsList->item( counterTargets, 0 )->text();
+            const qint64 size = this->targets.at( counterTargets ).second;
+            QElapsedTimer packTimer;
+            packTimer.start();
+            retVal = this->packProcessing( dirPath, flist );
+            const RunReport::FileStatus status = ( retVal == PROCESS_STATUS_SUCCESS ) ? RunReport::Success
+                                               : ( retVal == PROCESS_STATUS_BREAK ) ? RunReport::Aborted : RunReport::Error;
+            report.addFile( dirPath, size, packTimer.nsecsElapsed(), status );
+            if ( retVal != PROCESS_STATUS_SUCCESS )
             {
                 errorFlag = retVal;
-                break;
             }
-            else if ( retVal == PROCESS_STATUS_STATE_ERROR )
+            ui->progressFullBar->setValue( ui->progressFullBar->value() + ( (this->fullSize > INT_MAX) ? (int)((double)size/ONEKB+0.5) : size ) );
+        }
+        else
+        {
+            // Small files finish faster than the eye can follow, the UI is refreshed every 100 ms.
+            QElapsedTimer uiTimer;
+            uiTimer.start();
+            foreach( const QString &f, flist )
             {
-                ui->progressFullBar->reset();
-                return;
+                const qint64 size = QFileInfo( f ).size();
+                QElapsedTimer fileTimer;
+                fileTimer.start();
+                retVal = fileProcessing( f );
+                const qint64 fileNsecs = fileTimer.nsecsElapsed();
+                JobMonitor::fileDone();
+                if ( retVal == PROCESS_STATUS_SUCCESS )
+                {
+                    report.addFile( f, size, fileNsecs, RunReport::Success );
+                }
+                else if ( retVal == PROCESS_STATUS_CONTINUE )
+                {
+                    report.addFile( f, size, fileNsecs, RunReport::Error );
+                    errorFlag = retVal;
+                    continue;
+                }
+                else if ( retVal == PROCESS_STATUS_BREAK )
+                {
+                    report.addFile( f, size, fileNsecs, RunReport::Aborted );
+                    errorFlag = retVal;
+                    break;
+                }
+                else if ( retVal == PROCESS_STATUS_STATE_ERROR )
+                {
+                    report.addFile( f, size, fileNsecs, RunReport::Failed );
+                    JobMonitor::workerFinished();
+                    JobMonitor::end();
+                    ui->progressFullBar->reset();
+                    jobSpan.reset();
+                    Tracer::stop();
+                    this->writeManifests();
+                    this->writeReport( report );
+                    return;
+                }
+                ui->progressFullBar->setValue( ui->progressFullBar->value() + ( (this->fullSize > INT_MAX) ? (int)((double)size/ONEKB+0.5) : size ) );
+                if ( uiTimer.elapsed() > 100 )
+                {
+                    qApp->processEvents( QEventLoop::ExcludeUserInputEvents );
+                    uiTimer.restart();
+                }
             }
-            const qint64 size = QFileInfo( f ).size();
-            ui->progressFullBar->setValue( ui->progressFullBar->value() + ( (this->fullSize > INT_MAX) ? (int)((double)size/ONEKB+0.5) : size ) );
-            qApp->processEvents( QEventLoop::ExcludeUserInputEvents );
         }
 
         Q_ASSERT_X( counterTargets <= ui->targetsList->rowCount(), Q_FUNC_INFO, "Index out of range");
@@ -704,14 +1403,46 @@ void MainWindow::execute( void )
         counterTargets++;
     }
 
-    int time = timer.elapsed();
+    JobMonitor::workerFinished();
+    JobMonitor::end();
+    // the next job gets a new master key, it is derived in the background
+    this->newJobSalt();
+    this->prepareKey();
+    foreach ( const QSharedPointer<BufferTuner> &tuner, this->bufferTuners )
+    {
+        tuner->save();
+    }
+    this->bufferTuners.clear();
+    const BufferPoolStatistics poolStats = BufferPool::instance().statistics();
+    qInfo(logMainWindow) << QObject::tr( "Buffer pool: %1 requests, %2 allocations, %3 refused, peak %4 Kb" )
+                            .arg( poolStats.acquires ).arg( poolStats.misses ).arg( poolStats.failures )
+                            .arg( poolStats.bytesPeak / 1024 );
+    BufferPool::instance().trim();
+    report.finish();
+    const qint64 elapsedNsecs = report.elapsedNsecs();
+    const int time = static_cast<int>( elapsedNsecs / 1000000 );
+    jobSpan.reset();
+    Tracer::stop();
+    this->writeManifests();
+    this->writeReport( report );
+    if ( CryptFileDevice::statisticsEnabled() )
+    {
+        const CryptStatistics stats = encryptedFile.statistics();
+        qInfo(logMainWindow) << QObject::tr( "Statistics: read %1 bytes in %2 calls, written %3 bytes in %4 calls, "
+                                             "cipher %5 ms, I/O %6 ms, seeks %7, counter inits %8, key derivations %9, allocations %10" )
+                                .arg( stats.readBytes ).arg( stats.readCalls )
+                                .arg( stats.writeBytes ).arg( stats.writeCalls )
+                                .arg( stats.cipherNsecs / 1000000 ).arg( stats.ioNsecs / 1000000 )
+                                .arg( stats.seeks ).arg( stats.ctrInits )
+                                .arg( stats.keyDerivations ).arg( stats.allocations );
+    }
     if ( errorFlag == PROCESS_STATUS_SUCCESS )
     {
         QMessageBox::information( this,
                                   QObject::tr("Info" ),
                                   QObject::tr("Data encryption was successfully completed\n"
                                               "Process duration: %1 ( mm:ss.ms )\n"
-                                              "Performance: %2 Mb/s").arg(QTime::fromMSecsSinceStartOfDay(time).toString("mm:ss.zzz")).arg((static_cast<double>(this->fullSize)/time)*1000/COEFF));
+                                              "Performance: %2 Mb/s").arg(QTime::fromMSecsSinceStartOfDay(time).toString("mm:ss.zzz")).arg(report.throughput(), 0, 'f', 2));
     }
     else if( errorFlag == PROCESS_STATUS_CONTINUE )
     {
@@ -725,6 +1456,152 @@ void MainWindow::execute( void )
     ui->progressFullBar->reset();
 }
 
+/**
+ * @brief The function verifies the encrypted data of the list.
+ *
+ * The files are decrypted in parallel into pooled buffers and compared with the digests
+ * of the manifests (TreeVerifier), nothing is written to the disk. Mismatches and unreadable
+ * files are logged and marked in the list.
+ */
+void MainWindow::verify( void )
+{
+    if ( ui->passLine->text().isEmpty() )
+    {
+        QMessageBox::critical( this, QObject::tr("Error"), QObject::tr("Password not entered!") );
+        return;
+    }
+
+    QStringList paths;
+    for ( int i = 0; i < ui->targetsList->rowCount(); i++ )
+    {
+        paths.append( ui->targetsList->item(i, 0)->text() );
+    }
+    const QStringList files = TreeVerifier::collectFiles( paths, ui->recurseDirs->isChecked() );
+
+    RunReport report( "verify" );
+    report.setParameter( "method", MainWindow::methodName( this->encryptionMethod() ) );
+    report.setParameter( "recurse", ui->recurseDirs->isChecked() );
+    report.start();
+
+    TreeVerifier verifier( ui->passLine->text().toLatin1(),
+                           MainWindow::salt(),
+                           this->encryptionMethod() );
+    QFuture<VerifyResult> future = verifier.start( files );
+    ui->progressFullBar->reset();
+    ui->progressFullBar->setRange( 0, files.size() );
+    while ( !future.isFinished() )
+    {
+        ui->progressFullBar->setValue( future.progressValue() );
+        qApp->processEvents( QEventLoop::ExcludeUserInputEvents, 100 );
+        QThread::msleep( 20 );
+    }
+
+    int counts[ VerifyResult::Unreadable + 1 ] = {};
+    foreach ( const VerifyResult &result, future.results() )
+    {
+        counts[ result.status ]++;
+        switch ( result.status )
+        {
+        case VerifyResult::Ok:
+            report.addFile( result.fileName, result.size, result.durationNsecs, RunReport::Success );
+            break;
+        case VerifyResult::Mismatch:
+            qWarning(logMainWindow) << QObject::tr( "Verification failed, the digest does not match: %1" ).arg( result.fileName );
+            report.addFile( result.fileName, result.size, result.durationNsecs, RunReport::Error );
+            break;
+        case VerifyResult::NoDigest:
+            qInfo(logMainWindow) << QObject::tr( "No digest in the manifest: %1" ).arg( result.fileName );
+            break;
+        case VerifyResult::Unreadable:
+            qWarning(logMainWindow) << QObject::tr( "Verification failed, %1: %2" ).arg( result.errorString ).arg( result.fileName );
+            report.addFile( result.fileName, result.size, result.durationNsecs, RunReport::Failed );
+            break;
+        }
+    }
+    this->writeReport( report );
+    ui->progressFullBar->reset();
+
+    const QString summary = QObject::tr( "Verified files: %1\n"
+                                         "Mismatches: %2\n"
+                                         "Unreadable: %3\n"
+                                         "Without digest: %4" )
+                            .arg( counts[ VerifyResult::Ok ] ).arg( counts[ VerifyResult::Mismatch ] )
+                            .arg( counts[ VerifyResult::Unreadable ] ).arg( counts[ VerifyResult::NoDigest ] );
+    qInfo(logMainWindow) << summary.simplified();
+    if ( counts[ VerifyResult::Mismatch ] + counts[ VerifyResult::Unreadable ] > 0 )
+    {
+        QMessageBox::warning( this, QObject::tr("Warning"), summary );
+    }
+    else
+    {
+        QMessageBox::information( this, QObject::tr("Info"), summary );
+    }
+}
+
+/**
+ * @brief The function writes the JSON report of a job.
+ *
+ * The report is written to the file given by the setting pathToReport or by the
+ * command line option --report, and to the standard output if the path is "-".
+ * Nothing is written, if no path is set.
+ *
+ * @param report of the type RunReport&, the finished report of the job
+ */
+void MainWindow::writeReport( RunReport &report ) const
+{
+    report.finish();
+    if ( this->reportPath.isEmpty() )
+    {
+        return;
+    }
+    if ( !report.write( this->reportPath ) )
+    {
+        qWarning(logMainWindow) << QObject::tr( "Cannot write the report to: %1" ).arg( this->reportPath );
+    }
+}
+
+/**
+ * @brief The function remembers the digest of the plain data of an encrypted file.
+ *
+ * @param fileName of the type QString&, path to the encrypted file
+ * @param digest of the type QByteArray&, HMAC-SHA256 of the plain data, hex encoded, empty if the file is no longer encrypted
+ */
+void MainWindow::recordDigest( const QString &fileName, const QByteArray &digest )
+{
+    const QFileInfo info( fileName );
+    this->digests[ info.absolutePath() ].insert( info.fileName(), digest );
+}
+
+/**
+ * @brief The function merges the recorded digests into the manifest of every directory.
+ *
+ * The manifests are read by TreeVerifier, so a tree can be verified without the plain data.
+ */
+void MainWindow::writeManifests( void )
+{
+    CRYPTO_TRACE_SPAN( "manifests", "job" );
+    for ( QHash<QString, QHash<QString, QByteArray>>::const_iterator it = this->digests.constBegin(); it != this->digests.constEnd(); ++it )
+    {
+        if ( !TreeVerifier::updateManifest( it.key(), it.value() ) )
+        {
+            qWarning(logMainWindow) << QObject::tr( "Cannot update the manifest of: %1" ).arg( it.key() );
+        }
+    }
+    this->digests.clear();
+}
+
+/**
+ * @brief set-function for the path of the JSON report of the jobs
+ *
+ * This path overrides the setting pathToReport for the current session only.
+ *
+ * @param path of the type QString&, a file path, "-" for the standard output
+ */
+void MainWindow::setReportPath( const QString &path )
+{
+    this->reportPath = path;
+}
+
 /**
  * @brief The function of editing an item from the list.
  */
@@ -828,6 +1705,7 @@ void MainWindow::deleteItem( void )
 
     ui->execButton->setEnabled( !(ui->targetsList->rowCount() == 0) );
     ui->actionEncryption->setEnabled( !(ui->targetsList->rowCount() == 0) );
+    ui->actionVerify->setEnabled( !(ui->targetsList->rowCount() == 0) );
     qInfo(logMainWindow) << QObject::tr( "Delete a item from the list" );
 }
 
@@ -838,9 +1716,15 @@ void MainWindow::deleteItem( void )
  * - The date and release number of the program.
  * - Licensing restrictions and distribution of the program.
  * - Links to third-party libraries.
+ * - The processor and the selected cipher backends (BackendProbe::summary).
  */
 void MainWindow::about( void )
 {
+    QStringList backends = BackendProbe::summary();
+    for ( int i = 0; i < backends.size(); i++ )
+    {
+        backends[i] = backends.at( i ).toHtmlEscaped();
+    }
     QMessageBox::about(this,
                        QObject::tr("About program"),
                        QObject::tr("<h2>Crypto</h2><br />"
@@ -848,7 +1732,8 @@ void MainWindow::about( void )
                                    "The Advanced Encryption Standard (AES) is a specification for the encryption of electronic data established by the U.S. National Institute of Standards and Technology (NIST).<br />"
                                    "Certification AES by: CRYPTREC, NESSIE, NSA.<br /><b>Version</b> %1<br /><b>Copyright</b> © 2018 sergej1@email.ua<br /><br />"
                                    "The program is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.<br /><br />"
-                                   "This product includes software developed by the OpenSSL Project for use in the OpenSSL Toolkit. (<a href=\"http://www.openssl.org/\">http://www.openssl.org/</a>)").arg(qApp->applicationVersion()));
+                                   "This product includes software developed by the OpenSSL Project for use in the OpenSSL Toolkit. (<a href=\"http://www.openssl.org/\">http://www.openssl.org/</a>)"
+                                   "<br /><br /><b>Cipher backends</b><br />%2").arg(qApp->applicationVersion()).arg(backends.join("<br />")));
 }
 
 /**
@@ -883,6 +1768,14 @@ void MainWindow::on_actionEncryption_triggered( void )
     this->execute();
 }
 
+/**
+ * @brief Slot for the verification of encrypted data.
+ */
+void MainWindow::on_actionVerify_triggered( void )
+{
+    this->verify();
+}
+
 /**
  * @brief A slot for issuing information about the Qt-Framework used.
  */
@@ -1006,6 +1899,7 @@ void MainWindow::on_passConfirmLine_textChanged( const QString &arg )
         ui->passLine->setStyleSheet("QLineEdit{lineedit-password-character: 9679; color: black;}");
         ui->passConfirmLine->setStyleSheet("QLineEdit{lineedit-password-character: 9679; color: red;}");
     }
+    this->prepareKey();
 }
 
 /**
@@ -1025,6 +1919,76 @@ void MainWindow::on_passLine_textChanged( const QString &arg )
         ui->passLine->setStyleSheet("QLineEdit{lineedit-password-character: 9679; color: black;}");
         ui->passConfirmLine->setStyleSheet("QLineEdit{lineedit-password-character: 9679; color: red;}");
     }
+    this->prepareKey();
+}
+
+/**
+ * @brief The function starts the derivation of the key in the background.
+ *
+ * The key derivation is expensive by design. It starts on a worker thread as soon as
+ * both passwords match, so that the key is ready when the job starts. Every edit
+ * of a password cancels the pending derivation: its result is discarded.
+ */
+void MainWindow::prepareKey( void )
+{
+    this->keyGeneration++;
+    const QString password = ui->passLine->text();
+    if ( password.isEmpty() || password != ui->passConfirmLine->text() )
+    {
+        return;
+    }
+
+    this->keyPending = this->keyGeneration;
+    const QByteArray passwordData = password.toLatin1();
+    const QByteArray salt = this->jobSalt;
+    const CryptFileDevice::KeyDerivation kdf = this->kdf;
+    const int cost = this->kdfCost;
+    const int msecs = this->kdfMsecs;
+    this->keyWatcher->setFuture( QtConcurrent::run( [=]() -> DerivedKey
+    {
+        CRYPTO_TRACE_SPAN( "kdf.prepare", "crypto" );
+        const int rounds = ( cost > 0 ) ? cost : CryptFileDevice::calibrate( kdf, msecs );
+        return CryptFileDevice::deriveKey( passwordData, salt, kdf, rounds,
+                                           CryptFileDevice::AesKeyLength::kAesKeyLength256 );
+    } ) );
+}
+
+/**
+ * @brief The function chooses the random salt of the master key of the next job.
+ */
+void MainWindow::newJobSalt( void )
+{
+    this->jobSalt = CryptFileDevice::randomSalt();
+    if ( this->jobSalt.isEmpty() )
+    {
+        this->jobSalt = MainWindow::salt();
+    }
+}
+
+/**
+ * @brief Slot for the end of the derivation of the key in the background.
+ *
+ * The key is cached for the next job, unless a password was edited in the meantime.
+ */
+void MainWindow::keyDerived( void )
+{
+    if ( this->keyPending != this->keyGeneration || this->keyWatcher->isCanceled() )
+    {
+        return;
+    }
+    this->keyPending = -1;
+
+    const DerivedKey key = this->keyWatcher->result();
+    if ( key.isNull() )
+    {
+        return;
+    }
+    if ( this->kdfCost <= 0 )
+    {
+        this->kdfCost = key.numRounds;
+    }
+    CryptFileDevice::cacheKey( key );
+    qDebug(logMainWindow) << QObject::tr( "The key is prepared" );
 }
 
 /**
@@ -1040,6 +2004,7 @@ void MainWindow::on_clearList_clicked( void )
 
     ui->execButton->setEnabled( !(ui->targetsList->rowCount() == 0) );
     ui->actionEncryption->setEnabled( !(ui->targetsList->rowCount() == 0) );
+    ui->actionVerify->setEnabled( !(ui->targetsList->rowCount() == 0) );
     ui->lockEncrypt->setChecked( false );
     qInfo(logMainWindow) << QObject::tr( "Clear list" );
 }
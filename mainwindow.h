@@ -20,9 +20,14 @@
 // Includes
 //------------------------------------------------------------------------------
 #include <QMainWindow>
+#include <QSharedPointer>
+#include <QHash>
+#include <QFutureWatcher>
+#include "cryptfiledevice.h"
 
 class QLabel;
 class QHeaderView;
+class QDockWidget;
 
 namespace Ui {
 class MainWindow;
@@ -30,7 +35,8 @@ class MainWindow;
 
 class Settings;
 class SettingsDialog;
-class CryptFileDevice;
+class RunReport;
+class BufferTuner;
 
 /**
  * @class MainWindow
@@ -71,6 +77,11 @@ public:
     ~MainWindow();
 
     Settings *getSettings( void ) const;
+    void setReportPath( const QString &path );
+
+    static QByteArray salt( void );
+    static QString methodName( CryptFileDevice::EncryptionMethod method );
+    static bool methodFromName( const QString &name, CryptFileDevice::EncryptionMethod &method );
 
 public slots:
     void wErrorMessage( const QVariant &message );
@@ -90,6 +101,8 @@ private slots:
     // Encrypt data
     void on_execButton_clicked( void );
     void on_actionEncryption_triggered( void );
+    // Verify encrypted data
+    void on_actionVerify_triggered( void );
     // Program settings
     void on_actionSettings_triggered( void );
     // About Qt...
@@ -111,6 +124,8 @@ private slots:
     // compare between passwordLine and confirmLine
     void on_passLine_textChanged( const QString &arg );
     void on_passConfirmLine_textChanged( const QString &arg );
+    // the key derived in the background is ready
+    void keyDerived( void );
     // Clear the entire list in one click
     void on_clearList_clicked( void );
     // Process all subdirectories recursively
@@ -121,9 +136,11 @@ private slots:
 private:
     Ui::MainWindow *ui;
     QLabel *status;
+    QDockWidget *throughputDock;
     Settings *currentSettings;
     SettingsDialog *settings;
     CryptFileDevice *encryptFile;
+    CryptFileDevice *decryptFile;
 
     QAction *editItemAction;
     QAction *deleteItemAction;
@@ -146,6 +163,35 @@ private:
 
     bool processError;
     ProcessStatus fileProcessing( const QString &file );
+    ProcessStatus packProcessing( const QString &dirPath, const QStringList &files );
+    ProcessStatus unpackProcessing( const QString &file );
+
+    QString reportPath;
+    void writeReport( RunReport &report ) const;
+
+    bool writeDigests;
+    /// directory -> name of a file -> digest of the plain data, hex encoded (empty: removed)
+    QHash<QString, QHash<QString, QByteArray>> digests;
+    void recordDigest( const QString &fileName, const QByteArray &digest );
+    void writeManifests( void );
+
+    qint64 bufferBudget;
+    qint64 smallFileLimit;
+    int compressLevel;
+    CryptFileDevice::KeyDerivation kdf;
+    int kdfMsecs;
+    int kdfCost;
+    QFutureWatcher<DerivedKey> *keyWatcher;
+    int keyGeneration;
+    int keyPending;
+    /// salt of the master key of the next job
+    QByteArray jobSalt;
+    void prepareKey( void );
+    void newJobSalt( void );
+    QHash<QString, QSharedPointer<BufferTuner>> bufferTuners;
+    BufferTuner *bufferTuner( const QString &f );
+
+    CryptFileDevice::EncryptionMethod encryptionMethod( void ) const;
 
     void readSettings( void );
     void writeSettings( void ) const;
@@ -153,6 +199,7 @@ private:
     void addFiles( void );
     void addDirs( void );
     void execute( void );
+    void verify( void );
     void about( void );
 };
 
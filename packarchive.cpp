@@ -0,0 +1,435 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file packarchive.cpp
+ *
+ * @brief This file contains the definition of methods of the PackArchive class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "packarchive.h"
+#include "bufferpool.h"
+#include "tracer.h"
+#include <QIODevice>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QtEndian>
+#include <QLoggingCategory>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logPackArchive, "Pack")
+/// magic number at the beginning of the container.
+static char const kMagic[] = { 'C', 'P', 'K' };
+/// version of the container format.
+static quint8 const kVersion = 0x01;
+/// length of the container header: magic, version, reserved.
+static int const kHeaderLength = 8;
+/// magic number at the end of the trailer.
+static char const kTrailerMagic[] = { 'C', 'P', 'K', 'E' };
+/// length of the trailer: index offset, index length, magic.
+static int const kTrailerLength = 16;
+/// size of the chunks, in which the data of a member is copied, in bytes.
+static qint64 const kCopyChunk = 1024 * 1024;
+
+/**
+ * @brief The constructor of the class PackArchive
+ *
+ * @param device of the type QIODevice*, the container, usually a CryptFileDevice.
+ * The device must be open; the container starts at its current position.
+ */
+PackArchive::PackArchive( QIODevice *device ) :
+    m_device( device ),
+    m_base( 0 )
+{
+}
+
+/**
+ * @brief PackArchive::create
+ *
+ * Starts a new container, writes the header.
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool PackArchive::create( void )
+{
+    if ( m_device == nullptr || !m_device->isWritable() )
+    {
+        return this->fail( QObject::tr( "The container is not open for writing" ) );
+    }
+
+    m_base = m_device->pos();
+    m_entries.clear();
+    m_lookup.clear();
+
+    char header[kHeaderLength] = {};
+    memcpy( header, kMagic, sizeof( kMagic ) );
+    header[3] = static_cast<char>( kVersion );
+    if ( m_device->write( header, kHeaderLength ) != kHeaderLength )
+    {
+        return this->fail( QObject::tr( "Cannot write the container header: %1" ).arg( m_device->errorString() ) );
+    }
+    return true;
+}
+
+/**
+ * @brief PackArchive::addFile
+ *
+ * Appends a file to the container.
+ *
+ * @param fileName of the type QString&, path of the file to pack
+ * @param path of the type QString&, path of the member in the container
+ *
+ * @retval true if successful;
+ * @retval false otherwise. If the file cannot be read, the member is left out and the container stays consistent.
+ */
+bool PackArchive::addFile( const QString &fileName, const QString &path )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+    {
+        return this->fail( QObject::tr( "Cannot open file %1: %2" ).arg( fileName ).arg( file.errorString() ) );
+    }
+
+    CRYPTO_TRACE_SPAN( "pack", "file", fileName );
+    PackEntry entry;
+    entry.path = QDir::fromNativeSeparators( path );
+    entry.offset = m_device->pos() - m_base;
+    entry.mode = static_cast<quint32>( file.permissions() );
+    entry.modified = QFileInfo( file ).lastModified().toMSecsSinceEpoch();
+
+    if ( !this->copy( &file, m_device, file.size() ) )
+    {
+        // the member is dropped, the data written so far stays unused in the container
+        return false;
+    }
+    entry.length = m_device->pos() - m_base - entry.offset;
+
+    m_lookup.insert( entry.path, m_entries.size() );
+    m_entries.append( entry );
+    return true;
+}
+
+/**
+ * @brief PackArchive::addData
+ *
+ * Appends a member from memory to the container.
+ *
+ * @param path of the type QString&, path of the member in the container
+ * @param data of the type QByteArray&, content of the member
+ * @param mode of the type quint32, permissions of the member
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool PackArchive::addData( const QString &path, const QByteArray &data, quint32 mode )
+{
+    PackEntry entry;
+    entry.path = QDir::fromNativeSeparators( path );
+    entry.offset = m_device->pos() - m_base;
+    entry.length = data.size();
+    entry.mode = mode;
+    entry.modified = QDateTime::currentMSecsSinceEpoch();
+    if ( m_device->write( data ) != data.size() )
+    {
+        return this->fail( QObject::tr( "Cannot write the container: %1" ).arg( m_device->errorString() ) );
+    }
+
+    m_lookup.insert( entry.path, m_entries.size() );
+    m_entries.append( entry );
+    return true;
+}
+
+/**
+ * @brief PackArchive::finish
+ *
+ * Writes the index and the trailer. The device is not closed.
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool PackArchive::finish( void )
+{
+    QByteArray index;
+    {
+        QDataStream stream( &index, QIODevice::WriteOnly );
+        stream.setVersion( QDataStream::Qt_5_0 );
+        stream << static_cast<quint32>( m_entries.size() );
+        foreach ( const PackEntry &entry, m_entries )
+        {
+            stream << entry.path << entry.offset << entry.length << entry.mode << entry.modified;
+        }
+    }
+
+    uchar trailer[kTrailerLength];
+    qToBigEndian( static_cast<quint64>( m_device->pos() - m_base ), trailer );
+    qToBigEndian( static_cast<quint32>( index.size() ), trailer + 8 );
+    memcpy( trailer + 12, kTrailerMagic, sizeof( kTrailerMagic ) );
+
+    if ( m_device->write( index ) != index.size()
+         || m_device->write( reinterpret_cast<const char *>( trailer ), kTrailerLength ) != kTrailerLength )
+    {
+        return this->fail( QObject::tr( "Cannot write the container index: %1" ).arg( m_device->errorString() ) );
+    }
+    qInfo(logPackArchive) << QObject::tr( "Packed %1 files, index %2 bytes" ).arg( m_entries.size() ).arg( index.size() );
+    return true;
+}
+
+/**
+ * @brief PackArchive::load
+ *
+ * Reads the trailer and the index of a container.
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool PackArchive::load( void )
+{
+    if ( m_device == nullptr || !m_device->isReadable() )
+    {
+        return this->fail( QObject::tr( "The container is not open for reading" ) );
+    }
+    if ( !isPack( m_device ) )
+    {
+        return this->fail( QObject::tr( "The data is not a container" ) );
+    }
+
+    m_base = m_device->pos();
+    m_entries.clear();
+    m_lookup.clear();
+
+    const qint64 size = m_device->size() - m_base;
+    uchar trailer[kTrailerLength];
+    if ( size < kHeaderLength + kTrailerLength
+         || !m_device->seek( m_base + size - kTrailerLength )
+         || m_device->read( reinterpret_cast<char *>( trailer ), kTrailerLength ) != kTrailerLength
+         || memcmp( trailer + 12, kTrailerMagic, sizeof( kTrailerMagic ) ) != 0 )
+    {
+        return this->fail( QObject::tr( "The container is truncated" ) );
+    }
+
+    const qint64 indexOffset = static_cast<qint64>( qFromBigEndian<quint64>( trailer ) );
+    const qint64 indexLength = qFromBigEndian<quint32>( trailer + 8 );
+    if ( indexOffset < kHeaderLength || indexOffset + indexLength + kTrailerLength != size
+         || !m_device->seek( m_base + indexOffset ) )
+    {
+        return this->fail( QObject::tr( "The container index is corrupted" ) );
+    }
+
+    const QByteArray index = m_device->read( indexLength );
+    QDataStream stream( index );
+    stream.setVersion( QDataStream::Qt_5_0 );
+    quint32 count;
+    stream >> count;
+    for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++ )
+    {
+        PackEntry entry;
+        stream >> entry.path >> entry.offset >> entry.length >> entry.mode >> entry.modified;
+        if ( entry.offset < kHeaderLength || entry.length < 0 || entry.offset + entry.length > indexOffset )
+        {
+            break;
+        }
+        m_lookup.insert( entry.path, m_entries.size() );
+        m_entries.append( entry );
+    }
+    if ( stream.status() != QDataStream::Ok || static_cast<quint32>( m_entries.size() ) != count )
+    {
+        m_entries.clear();
+        m_lookup.clear();
+        return this->fail( QObject::tr( "The container index is corrupted" ) );
+    }
+    return true;
+}
+
+/**
+ * @brief get-function for the members
+ * @return the members of the container, in the order of packing.
+ */
+const QVector<PackEntry> &PackArchive::entries( void ) const
+{
+    return m_entries;
+}
+
+/**
+ * @brief PackArchive::find
+ * @param path of the type QString&, path of the member
+ * @return the index of the member, or -1 if the container has no such member.
+ */
+int PackArchive::find( const QString &path ) const
+{
+    return m_lookup.value( QDir::fromNativeSeparators( path ), -1 );
+}
+
+/**
+ * @brief PackArchive::read
+ *
+ * Reads the content of a member, only the data of this member is decrypted.
+ *
+ * @param index of the type int, index of the member
+ * @return the content, empty on an error.
+ */
+QByteArray PackArchive::read( int index )
+{
+    if ( index < 0 || index >= m_entries.size() )
+    {
+        this->fail( QObject::tr( "Invalid member index: %1" ).arg( index ) );
+        return QByteArray();
+    }
+    const PackEntry &entry = m_entries.at( index );
+    if ( !m_device->seek( m_base + entry.offset ) )
+    {
+        this->fail( QObject::tr( "Cannot seek in the container: %1" ).arg( m_device->errorString() ) );
+        return QByteArray();
+    }
+    return m_device->read( entry.length );
+}
+
+/**
+ * @brief PackArchive::extract
+ *
+ * Extracts a member into a directory, the subdirectories of its path are created.
+ *
+ * @param index of the type int, index of the member
+ * @param targetDir of the type QString&, the directory
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool PackArchive::extract( int index, const QString &targetDir )
+{
+    if ( index < 0 || index >= m_entries.size() )
+    {
+        return this->fail( QObject::tr( "Invalid member index: %1" ).arg( index ) );
+    }
+    const PackEntry &entry = m_entries.at( index );
+
+    // a member must not leave the target directory
+    const QString path = QDir::cleanPath( entry.path );
+    if ( path.isEmpty() || QDir::isAbsolutePath( path ) || path == ".." || path.startsWith( "../" ) )
+    {
+        return this->fail( QObject::tr( "Invalid member path: %1" ).arg( entry.path ) );
+    }
+
+    const QString fileName = QDir( targetDir ).filePath( path );
+    if ( !QDir().mkpath( QFileInfo( fileName ).absolutePath() ) )
+    {
+        return this->fail( QObject::tr( "Cannot create directory for %1" ).arg( fileName ) );
+    }
+    QFile file( fileName );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        return this->fail( QObject::tr( "Cannot open file %1: %2" ).arg( fileName ).arg( file.errorString() ) );
+    }
+    if ( !m_device->seek( m_base + entry.offset ) )
+    {
+        return this->fail( QObject::tr( "Cannot seek in the container: %1" ).arg( m_device->errorString() ) );
+    }
+
+    CRYPTO_TRACE_SPAN( "unpack", "file", fileName );
+    if ( !this->copy( m_device, &file, entry.length ) )
+    {
+        file.close();
+        file.remove();
+        return false;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    file.setFileTime( QDateTime::fromMSecsSinceEpoch( entry.modified ), QFileDevice::FileModificationTime );
+#endif
+    file.close();
+    file.setPermissions( QFileDevice::Permissions( QFlag( static_cast<int>( entry.mode ) ) ) );
+    return true;
+}
+
+/**
+ * @brief get-function for the description of the last error
+ * @return the description
+ */
+QString PackArchive::errorString( void ) const
+{
+    return m_errorString;
+}
+
+/**
+ * @brief PackArchive::isPack
+ *
+ * Checks, whether the data at the current position of an open device is a container.
+ * The position of the device is not changed.
+ *
+ * @param device of the type QIODevice*
+ *
+ * @retval true if the container header is found;
+ * @retval false otherwise.
+ */
+bool PackArchive::isPack( QIODevice *device )
+{
+    if ( device == nullptr || !device->isReadable() )
+    {
+        return false;
+    }
+    const QByteArray header = device->peek( kHeaderLength );
+    return ( header.size() == kHeaderLength )
+            && ( memcmp( header.constData(), kMagic, sizeof( kMagic ) ) == 0 )
+            && ( static_cast<quint8>( header.at( 3 ) ) == kVersion );
+}
+
+/**
+ * @brief The function copies data between devices through a pooled buffer.
+ *
+ * @param from of the type QIODevice*
+ * @param to of the type QIODevice*
+ * @param length of the type qint64, number of bytes to copy
+ *
+ * @retval true if successful;
+ * @retval false otherwise.
+ */
+bool PackArchive::copy( QIODevice *from, QIODevice *to, qint64 length )
+{
+    PooledBuffer buffer = BufferPool::instance().acquire( qMin( qMax( length, Q_INT64_C( 1 ) ), kCopyChunk ) );
+    if ( buffer.isNull() )
+    {
+        return this->fail( QObject::tr( "Bad allocation memory" ) );
+    }
+
+    qint64 done = 0;
+    while ( done < length )
+    {
+        const qint64 n = from->read( buffer.data(), qMin( length - done, buffer.capacity() ) );
+        if ( n <= 0 )
+        {
+            return this->fail( QObject::tr( "Read Error: %1" ).arg( from->errorString() ) );
+        }
+        if ( to->write( buffer.data(), n ) != n )
+        {
+            return this->fail( QObject::tr( "Write Error: %1" ).arg( to->errorString() ) );
+        }
+        done += n;
+    }
+    return true;
+}
+
+/**
+ * @brief The function records an error.
+ * @param message of the type QString&
+ * @return false
+ */
+bool PackArchive::fail( const QString &message )
+{
+    m_errorString = message;
+    qCritical(logPackArchive) << message;
+    return false;
+}
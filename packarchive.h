@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file packarchive.h
+ *
+ * @brief This file contains the declaration of the class PackArchive
+ */
+#ifndef PACKARCHIVE_H
+#define PACKARCHIVE_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+class QIODevice;
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @struct PackEntry
+ *
+ * @brief The PackEntry structure describes a member of a PackArchive.
+ */
+struct PackEntry
+{
+    //! Path of the member, relative to the packed directory, with '/' as separator.
+    QString path;
+    //! Offset of the data of the member in the container, in bytes.
+    qint64 offset = 0;
+    //! Size of the member, in bytes.
+    qint64 length = 0;
+    //! Permissions of the member, QFileDevice::Permissions.
+    quint32 mode = 0;
+    //! Time of the last modification, ms since the epoch.
+    qint64 modified = 0;
+};
+
+/**
+ * @class PackArchive
+ *
+ * @brief The PackArchive class stores many small files in one encrypted container.
+ *
+ * The container is written through a CryptFileDevice, so that the key derivation,
+ * the cipher setup and the open / close of the encrypted file are paid once for a whole
+ * directory instead of once per file. The container consists of
+ * - a header with the magic number and the format version,
+ * - the data of the members, one after another,
+ * - the index (path, offset, length, mode and time of every member),
+ * - a trailer with the position and the length of the index.
+ * .
+ * Everything, including the index, is encrypted. The counter mode of CryptFileDevice
+ * allows to seek to any offset, so that a single member is extracted without
+ * decrypting the rest of the container.
+ *
+ * @code
+ * PackArchive archive( &cryptDevice );   // cryptDevice is open for writing
+ * archive.create();
+ * archive.addFile( "/data/logs/a.log", "logs/a.log" );
+ * archive.finish();
+ *
+ * PackArchive archive( &cryptDevice );   // cryptDevice is open for reading
+ * archive.load();
+ * archive.extract( archive.find( "logs/a.log" ), "/tmp/restore" );
+ * @endcode
+ */
+class PackArchive
+{
+public:
+    explicit PackArchive( QIODevice *device );
+
+    bool create( void );
+    bool addFile( const QString &fileName, const QString &path );
+    bool addData( const QString &path, const QByteArray &data, quint32 mode );
+    bool finish( void );
+
+    bool load( void );
+    const QVector<PackEntry> &entries( void ) const;
+    int find( const QString &path ) const;
+    QByteArray read( int index );
+    bool extract( int index, const QString &targetDir );
+
+    QString errorString( void ) const;
+
+    static bool isPack( QIODevice *device );
+
+private:
+    bool copy( QIODevice *from, QIODevice *to, qint64 length );
+    bool fail( const QString &message );
+
+    QIODevice *m_device;
+    qint64 m_base;
+    QVector<PackEntry> m_entries;
+    QHash<QString, int> m_lookup;
+    QString m_errorString;
+};
+
+#endif // PACKARCHIVE_H
@@ -0,0 +1,716 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file rekeyer.cpp
+ *
+ * @brief This file contains the definition of methods of the Rekeyer class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "rekeyer.h"
+#include "treeverifier.h"
+#include "bufferpool.h"
+#include "tracer.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QFileInfo>
+#include <QFile>
+#include <QSet>
+#include <QLoggingCategory>
+#include <cstring>
+#if defined( Q_OS_WIN )
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logRekeyer, "Rekey")
+/// default size of the steps, in which a file is re-encrypted, in bytes.
+static qint64 const kDefaultStepSize = 4 * 1024 * 1024;
+/// suffix of the new file while it is written.
+static const char *const kPartSuffix = ".part";
+/// the journal: the new header, then kJournalMagic, the size of the steps and two slots.
+static const char kJournalMagic[8] = { 'C', 'R', 'Y', 'P', 'T', 'R', 'K', '1' };
+static qint64 const kPreambleLength = 16;
+/// a slot: sequence, position and length of the step (big endian), SHA-256 of these and of the image,
+/// padding, then the old content of the step (the image).
+static qint64 const kSlotHeaderLength = 64;
+static int const kSlotFieldsLength = 24;
+static int const kSlotDigestLength = 32;
+
+const char *const Rekeyer::kJournalSuffix = ".rekey";
+const char *const Rekeyer::kReplacementSuffix = ".rekeyed";
+
+/**
+ * @struct RekeyTask
+ *
+ * @brief The RekeyTask structure is the functor of QtConcurrent::mapped.
+ */
+struct RekeyTask
+{
+    typedef RekeyResult result_type;
+
+    explicit RekeyTask( const Rekeyer *rekeyer ) :
+        m_rekeyer( rekeyer )
+    {
+    }
+
+    RekeyResult operator()( const QString &fileName ) const
+    {
+        return m_rekeyer->rekeyFile( fileName );
+    }
+
+    const Rekeyer *m_rekeyer;
+};
+
+/**
+ * @struct JournalSlot
+ *
+ * @brief The JournalSlot structure describes the step, which was being written.
+ */
+struct JournalSlot
+{
+    bool valid = false;
+    quint64 sequence = 0;
+    qint64 position = 0;
+    qint64 length = 0;
+};
+
+/**
+ * @brief syncFile
+ *
+ * Flushes the buffers of the file and waits until the operating system has written it to the disk.
+ *
+ * @param file of the type QFileDevice*, a file open for writing
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+static bool syncFile( QFileDevice *file )
+{
+    if ( !file->flush() )
+    {
+        return false;
+    }
+#if defined( Q_OS_WIN )
+    return FlushFileBuffers( reinterpret_cast<HANDLE>( _get_osfhandle( file->handle() ) ) ) != 0;
+#else
+    return ::fsync( file->handle() ) == 0;
+#endif
+}
+
+/**
+ * @brief slotDigest
+ * @param fields of the type unsigned char*, kSlotFieldsLength bytes
+ * @param image of the type char*, the old content of the step
+ * @param length of the type qint64
+ * @return SHA-256 of the fields and the image
+ */
+static QByteArray slotDigest( const unsigned char *fields, const char *image, qint64 length )
+{
+    QCryptographicHash hash( QCryptographicHash::Sha256 );
+    hash.addData( reinterpret_cast<const char *>( fields ), kSlotFieldsLength );
+    hash.addData( image, static_cast<int>( length ) );
+    return hash.result();
+}
+
+/**
+ * @brief writeSlot
+ *
+ * Writes a step to one of the two slots of the journal and syncs the journal.
+ * The other slot keeps the previous step, in case this write is torn.
+ *
+ * @param journal of the type QFile &
+ * @param offset of the type qint64, offset of the slot in the journal
+ * @param slot of the type JournalSlot &
+ * @param image of the type char*, the old content of the step, slot.length bytes
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+static bool writeSlot( QFile &journal, qint64 offset, const JournalSlot &slot, const char *image )
+{
+    unsigned char header[kSlotHeaderLength] = {};
+    qToBigEndian<quint64>( slot.sequence, header );
+    qToBigEndian<qint64>( slot.position, header + 8 );
+    qToBigEndian<qint64>( slot.length, header + 16 );
+    const QByteArray digest = slotDigest( header, image, slot.length );
+    memcpy( header + kSlotFieldsLength, digest.constData(), kSlotDigestLength );
+
+    return journal.seek( offset )
+           && journal.write( reinterpret_cast<const char *>( header ), kSlotHeaderLength ) == kSlotHeaderLength
+           && ( slot.length == 0 || journal.write( image, slot.length ) == slot.length )
+           && syncFile( &journal );
+}
+
+/**
+ * @brief readSlot
+ * @param journal of the type QFile &
+ * @param offset of the type qint64, offset of the slot in the journal
+ * @param stepSize of the type qint64, capacity of the slot
+ * @param image of the type QByteArray*, receives the old content of the step
+ * @return the slot, not valid if it was never written or its write was torn
+ */
+static JournalSlot readSlot( QFile &journal, qint64 offset, qint64 stepSize, QByteArray *image )
+{
+    JournalSlot slot;
+    unsigned char header[kSlotHeaderLength];
+    if ( !journal.seek( offset )
+         || journal.read( reinterpret_cast<char *>( header ), kSlotHeaderLength ) != kSlotHeaderLength )
+    {
+        return slot;
+    }
+    slot.sequence = qFromBigEndian<quint64>( header );
+    slot.position = qFromBigEndian<qint64>( header + 8 );
+    slot.length = qFromBigEndian<qint64>( header + 16 );
+    if ( slot.position < 0 || slot.length < 0 || slot.length > stepSize )
+    {
+        return slot;
+    }
+
+    *image = journal.read( slot.length );
+    slot.valid = ( image->size() == slot.length )
+                 && slotDigest( header, image->constData(), slot.length )
+                    == QByteArray::fromRawData( reinterpret_cast<const char *>( header + kSlotFieldsLength ), kSlotDigestLength );
+    return slot;
+}
+
+/**
+ * @brief finishReplacement
+ *
+ * Replaces a file with its new version (Rekeyer::kReplacementSuffix), which is complete and synced.
+ *
+ * @param fileName of the type QString &
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+static bool finishReplacement( const QString &fileName )
+{
+    const QString replacementName = fileName + Rekeyer::kReplacementSuffix;
+    return ( !QFile::exists( fileName ) || QFile::remove( fileName ) ) && QFile::rename( replacementName, fileName );
+}
+
+/**
+ * @brief The constructor of the class Rekeyer
+ *
+ * The new headers get a random salt; if none is available, salt.
+ *
+ * @param oldPassword of the type QByteArray &, the current password of the files
+ * @param newPassword of the type QByteArray &
+ * @param salt of the type QByteArray &, the salt of files without a salt in the header
+ */
+Rekeyer::Rekeyer( const QByteArray &oldPassword,
+                  const QByteArray &newPassword,
+                  const QByteArray &salt ) :
+    m_oldPassword( oldPassword ),
+    m_newPassword( newPassword ),
+    m_salt( salt ),
+    m_newSalt( CryptFileDevice::randomSalt() ),
+    m_stepSize( kDefaultStepSize )
+{
+    if ( m_newSalt.isEmpty() )
+    {
+        m_newSalt = salt;
+    }
+}
+
+/**
+ * @brief set-function for the stepSize
+ *
+ * Every step is synced twice and costs its size in the journal; larger steps are faster
+ * and lose more work on a crash. An interrupted file keeps the size of its journal.
+ *
+ * @param stepSize of the type qint64, size of the steps, in bytes
+ */
+void Rekeyer::setStepSize( qint64 stepSize )
+{
+    m_stepSize = qBound( Q_INT64_C( 4096 ), stepSize, Q_INT64_C( 1 ) << 30 );
+}
+
+/**
+ * @brief get-function for the stepSize
+ * @return stepSize of the type qint64
+ */
+qint64 Rekeyer::stepSize( void ) const
+{
+    return m_stepSize;
+}
+
+/**
+ * @brief set-function for the legacyFormat
+ *
+ * The files are migrated from version 1.0: they are read without a header, with the method
+ * and the key of version 1.0 (EVP_BytesToKey of the old password and the salt of the constructor).
+ * Version 1.0 did not record the method, the size of the buffer nor the salt, they must be given.
+ *
+ * @param method of the type CryptFileDevice::EncryptionMethod, XorCipher or AesCipher
+ * @param chunkSize of the type qint64, the size of the buffer of version 1.0, in bytes (XorCipher)
+ */
+void Rekeyer::setLegacyFormat( CryptFileDevice::EncryptionMethod method, qint64 chunkSize )
+{
+    m_legacy = true;
+    m_legacyMethod = method;
+    m_legacyChunkSize = chunkSize;
+}
+
+/**
+ * @brief Rekeyer::start
+ *
+ * Starts the rekeying in the global thread pool. The progress of the returned future
+ * counts the finished files.
+ *
+ * @param files of the type QStringList &, paths to the encrypted files
+ * @return future of the results, in the order of files
+ */
+QFuture<RekeyResult> Rekeyer::start( const QStringList &files )
+{
+    return QtConcurrent::mapped( files, RekeyTask( this ) );
+}
+
+/**
+ * @brief Rekeyer::rekey
+ *
+ * Rekeys the files and waits for the results.
+ *
+ * @param files of the type QStringList &, paths to the encrypted files
+ * @return results, in the order of files
+ */
+QList<RekeyResult> Rekeyer::rekey( const QStringList &files )
+{
+    QFuture<RekeyResult> future = this->start( files );
+    future.waitForFinished();
+    return future.results();
+}
+
+/**
+ * @brief Rekeyer::rekeyFile
+ *
+ * Encrypts a file with the new password, or completes an interrupted rekeying of the file.
+ *
+ * @param fileName of the type QString &, path to the encrypted file
+ * @return result of the rekeying
+ */
+RekeyResult Rekeyer::rekeyFile( const QString &fileName ) const
+{
+    CRYPTO_TRACE_SPAN( "rekey", "file", fileName );
+    QElapsedTimer timer;
+    timer.start();
+
+    RekeyResult result;
+    result.fileName = fileName;
+
+    // a complete new file only waits for the rename, if it opens with the new password
+    const QString replacementName = fileName + kReplacementSuffix;
+    if ( QFile::exists( replacementName ) )
+    {
+        CryptFileDevice replacement( replacementName, m_newPassword, m_salt );
+        result.resumed = true;
+        if ( !replacement.open( QIODevice::ReadOnly ) )
+        {
+            result.errorString = QObject::tr( "Cannot decrypt the new file with the new password" );
+        }
+        else
+        {
+            result.size = replacement.size();
+            replacement.close();
+            result.status = finishReplacement( fileName ) ? RekeyResult::Ok : RekeyResult::Failed;
+            result.errorString = ( result.status == RekeyResult::Ok ) ? QString() : QObject::tr( "Cannot replace the file" );
+        }
+        result.durationNsecs = timer.nsecsElapsed();
+        return result;
+    }
+    QFile::remove( replacementName + kPartSuffix );
+
+    if ( QFile::exists( fileName + kJournalSuffix ) )
+    {
+        result.resumed = true;
+        result.status = this->rekeyInPlace( fileName, result ) ? RekeyResult::Ok : RekeyResult::Failed;
+        result.durationNsecs = timer.nsecsElapsed();
+        return result;
+    }
+
+    if ( QFileInfo( fileName ).size() == 0 )
+    {
+        result.status = RekeyResult::Skipped;
+        result.durationNsecs = timer.nsecsElapsed();
+        return result;
+    }
+
+    CryptFileDevice source( fileName, m_oldPassword, m_salt );
+    if ( m_legacy )
+    {
+        // a file with a header was migrated before, or is of another password
+        QFile file( fileName );
+        if ( !file.open( QIODevice::ReadOnly ) || CryptFileDevice::hasHeader( &file ) )
+        {
+            result.status = file.isOpen() ? RekeyResult::Skipped : RekeyResult::Failed;
+            result.errorString = file.isOpen() ? QString() : QObject::tr( "Cannot open the file" );
+            result.durationNsecs = timer.nsecsElapsed();
+            return result;
+        }
+        file.close();
+        source.setEncryptionMethod( m_legacyMethod );
+        source.setLegacyFormat( true );
+        source.setLegacyChunkSize( m_legacyChunkSize );
+    }
+    if ( !source.open( QIODevice::ReadOnly ) )
+    {
+        result.errorString = QObject::tr( "Cannot decrypt the file with the old password" );
+        result.durationNsecs = timer.nsecsElapsed();
+        return result;
+    }
+
+    bool ok;
+    // a file without a header grows by the header, it cannot be rewritten in place
+    if ( source.isAuthenticated() || source.legacyFormat() )
+    {
+        ok = this->replaceFile( source, fileName, result );
+    }
+    else
+    {
+        source.close();
+        ok = this->rekeyInPlace( fileName, result );
+    }
+    result.status = ok ? RekeyResult::Ok : RekeyResult::Failed;
+    result.durationNsecs = timer.nsecsElapsed();
+    return result;
+}
+
+/**
+ * @brief Rekeyer::collectFiles
+ *
+ * Expands the paths to a list of files like TreeVerifier::collectFiles. A journal or a new file
+ * of an interrupted rekeying stands for the file, which was being rekeyed.
+ *
+ * @param paths of the type QStringList &, files and directories
+ * @param recurse of the type bool, includes the subdirectories
+ * @return absolute paths to the files
+ */
+QStringList Rekeyer::collectFiles( const QStringList &paths, bool recurse )
+{
+    const QString partSuffix = QString::fromLatin1( kReplacementSuffix ) + QLatin1String( kPartSuffix );
+    QStringList files;
+    QSet<QString> names;
+    foreach ( QString fileName, TreeVerifier::collectFiles( paths, recurse ) )
+    {
+        if ( fileName.endsWith( partSuffix ) )
+        {
+            fileName.chop( partSuffix.size() );
+        }
+        else if ( fileName.endsWith( QLatin1String( kReplacementSuffix ) ) )
+        {
+            fileName.chop( static_cast<int>( qstrlen( kReplacementSuffix ) ) );
+        }
+        else if ( fileName.endsWith( QLatin1String( kJournalSuffix ) ) )
+        {
+            fileName.chop( static_cast<int>( qstrlen( kJournalSuffix ) ) );
+        }
+
+        if ( !names.contains( fileName ) )
+        {
+            names.insert( fileName );
+            files.append( fileName );
+        }
+    }
+
+    return files;
+}
+
+/**
+ * @brief Rekeyer::rekeyInPlace
+ *
+ * Re-encrypts a file of a stream cipher in place. Every step is decrypted with the key stream
+ * of the old header and encrypted with the one of the new header at the same position:
+ *
+ * 1. the old content of the step is written to a slot of the journal, the journal is synced;
+ * 2. the step is re-encrypted and written, the file is synced.
+ * .
+ * After the last step a slot without content marks the end, then the new header
+ * replaces the old one and the journal is removed. If a journal exists, the step of its
+ * newest valid slot is restored first and the rekeying continues from there.
+ *
+ * @param fileName of the type QString &, path to the encrypted file
+ * @param result of the type RekeyResult &, receives the size and the error
+ * @retval true if successful,
+ * @retval false otherwise, the file is either unchanged or its journal is kept.
+ */
+bool Rekeyer::rekeyInPlace( const QString &fileName, RekeyResult &result ) const
+{
+    const QString journalName = fileName + kJournalSuffix;
+    result.inPlace = true;
+
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadWrite ) || file.size() < CryptFileDevice::kHeaderLength )
+    {
+        result.errorString = QObject::tr( "Cannot open the file" );
+        return false;
+    }
+    const qint64 size = file.size() - CryptFileDevice::kHeaderLength;
+
+    // the state of an interrupted rekeying
+    QFile journal( journalName );
+    qint64 stepSize = m_stepSize;
+    JournalSlot last;
+    if ( journal.open( QIODevice::ReadOnly ) )
+    {
+        char preamble[kPreambleLength];
+        if ( journal.seek( CryptFileDevice::kHeaderLength )
+             && journal.read( preamble, kPreambleLength ) == kPreambleLength
+             && memcmp( preamble, kJournalMagic, sizeof( kJournalMagic ) ) == 0 )
+        {
+            stepSize = qFromBigEndian<qint64>( reinterpret_cast<const uchar *>( preamble + 8 ) );
+            QByteArray lastImage;
+            for ( int i = 0; i < 2 && stepSize > 0 && stepSize <= ( Q_INT64_C( 1 ) << 30 ); i++ )
+            {
+                QByteArray image;
+                const JournalSlot slot = readSlot( journal, CryptFileDevice::kHeaderLength + kPreambleLength
+                                                            + i * ( kSlotHeaderLength + stepSize ), stepSize, &image );
+                if ( slot.valid && ( !last.valid || slot.sequence > last.sequence ) )
+                {
+                    last = slot;
+                    lastImage = image;
+                }
+            }
+
+            // only the newest step may be torn, the steps before it are complete
+            if ( last.valid && last.length > 0
+                 && ( last.position + last.length > size
+                      || !file.seek( CryptFileDevice::kHeaderLength + last.position )
+                      || file.write( lastImage ) != last.length
+                      || !syncFile( &file ) ) )
+            {
+                result.errorString = QObject::tr( "Cannot restore the file from the journal" );
+                return false;
+            }
+        }
+        journal.close();
+
+        if ( last.valid )
+        {
+            qInfo(logRekeyer) << QObject::tr( "Resuming the rekeying of %1 at %2" ).arg( fileName ).arg( last.position );
+        }
+        else
+        {
+            // the journal was interrupted before the first step, the file is unchanged
+            QFile::remove( journalName );
+            stepSize = m_stepSize;
+        }
+    }
+
+    const bool finished = last.valid && last.length == 0;
+    CryptFileDevice source( fileName, m_oldPassword, m_salt );
+    if ( !finished && !source.open( QIODevice::ReadOnly ) )
+    {
+        result.errorString = QObject::tr( "Cannot decrypt the file with the old password" );
+        return false;
+    }
+
+    if ( !last.valid )
+    {
+        // the journal starts with the new header, written by a device of the new password
+        CryptFileDevice newHeader( journalName, m_newPassword, m_newSalt );
+        this->configure( newHeader, source );
+        bool ok = newHeader.open( QIODevice::WriteOnly | QIODevice::Truncate );
+        newHeader.close();
+
+        char preamble[kPreambleLength];
+        memcpy( preamble, kJournalMagic, sizeof( kJournalMagic ) );
+        qToBigEndian<qint64>( stepSize, reinterpret_cast<uchar *>( preamble + 8 ) );
+        ok = ok && journal.open( QIODevice::ReadWrite )
+             && journal.size() == CryptFileDevice::kHeaderLength
+             && journal.seek( CryptFileDevice::kHeaderLength )
+             && journal.write( preamble, kPreambleLength ) == kPreambleLength
+             && syncFile( &journal );
+        if ( !ok )
+        {
+            journal.close();
+            QFile::remove( journalName );
+            result.errorString = QObject::tr( "Cannot write the journal" );
+            return false;
+        }
+    }
+    else if ( !journal.open( QIODevice::ReadWrite ) )
+    {
+        result.errorString = QObject::tr( "Cannot write the journal" );
+        return false;
+    }
+
+    CryptFileDevice target( journalName, m_newPassword, m_salt );
+    if ( !target.open( QIODevice::ReadOnly ) || target.isAuthenticated() )
+    {
+        result.errorString = QObject::tr( "Cannot decrypt the journal with the new password" );
+        return false;
+    }
+
+    JournalSlot slot;
+    slot.sequence = last.valid ? last.sequence + 1 : 0;
+    slot.position = last.valid ? last.position : 0;
+    if ( !finished )
+    {
+        PooledBuffer step = BufferPool::instance().acquire( stepSize );
+        if ( step.isNull() )
+        {
+            result.errorString = QObject::tr( "Not enough memory" );
+            return false;
+        }
+
+        unsigned char *text = reinterpret_cast<unsigned char *>( step.data() );
+        while ( slot.position < size )
+        {
+            slot.length = qMin( stepSize, size - slot.position );
+            const qint64 offset = CryptFileDevice::kHeaderLength + slot.position;
+            const qint64 slotOffset = CryptFileDevice::kHeaderLength + kPreambleLength
+                                      + static_cast<qint64>( slot.sequence % 2 ) * ( kSlotHeaderLength + stepSize );
+            // the plain data of the step only exists in the buffer, between the two transforms
+            const bool ok = file.seek( offset )
+                            && file.read( step.data(), slot.length ) == slot.length
+                            && writeSlot( journal, slotOffset, slot, step.data() )
+                            && source.transformAt( slot.position, text, text, slot.length )
+                            && target.transformAt( slot.position, text, text, slot.length )
+                            && file.seek( offset )
+                            && file.write( step.data(), slot.length ) == slot.length
+                            && syncFile( &file );
+            if ( !ok )
+            {
+                result.errorString = QObject::tr( "Cannot re-encrypt the file at %1" ).arg( slot.position );
+                return false;
+            }
+            slot.position += slot.length;
+            slot.sequence++;
+        }
+
+        slot.length = 0;
+        if ( !writeSlot( journal, CryptFileDevice::kHeaderLength + kPreambleLength
+                                  + static_cast<qint64>( slot.sequence % 2 ) * ( kSlotHeaderLength + stepSize ), slot, nullptr ) )
+        {
+            result.errorString = QObject::tr( "Cannot write the journal" );
+            return false;
+        }
+    }
+    source.close();
+    target.close();
+
+    // the new header makes the file readable with the new password
+    const QByteArray header = journal.seek( 0 ) ? journal.read( CryptFileDevice::kHeaderLength ) : QByteArray();
+    const bool ok = header.size() == CryptFileDevice::kHeaderLength
+                    && file.seek( 0 )
+                    && file.write( header ) == CryptFileDevice::kHeaderLength
+                    && syncFile( &file );
+    journal.close();
+    file.close();
+    if ( !ok )
+    {
+        result.errorString = QObject::tr( "Cannot write the new header" );
+        return false;
+    }
+
+    QFile::remove( journalName );
+    result.size = size;
+    return true;
+}
+
+/**
+ * @brief Rekeyer::replaceFile
+ *
+ * Writes an authenticated file (or a file without a header) again with the new password next to the old one and replaces it,
+ * after the new file was synced and opened with the new password.
+ *
+ * @param source of the type CryptFileDevice &, the file open with the old password
+ * @param fileName of the type QString &, path to the encrypted file
+ * @param result of the type RekeyResult &, receives the size and the error
+ * @retval true if successful,
+ * @retval false otherwise, the file is unchanged.
+ */
+bool Rekeyer::replaceFile( CryptFileDevice &source, const QString &fileName, RekeyResult &result ) const
+{
+    const QString replacementName = fileName + kReplacementSuffix;
+    const QString partName = replacementName + kPartSuffix;
+
+    PooledBuffer step = BufferPool::instance().acquire( m_stepSize );
+    if ( step.isNull() )
+    {
+        result.errorString = QObject::tr( "Not enough memory" );
+        return false;
+    }
+
+    bool ok;
+    {
+        CryptFileDevice target( partName, m_newPassword, m_newSalt );
+        this->configure( target, source );
+        ok = target.open( QIODevice::WriteOnly | QIODevice::Truncate );
+        while ( ok )
+        {
+            const qint64 read = source.read( step.data(), m_stepSize );
+            if ( read <= 0 )
+            {
+                ok = ( read == 0 );
+                break;
+            }
+            ok = ( target.write( step.data(), read ) == read );
+            result.size += read;
+        }
+        ok = ok && target.finish();
+        target.close();
+    }
+
+    QFile part( partName );
+    ok = ok && part.open( QIODevice::ReadWrite ) && syncFile( &part );
+    part.close();
+    if ( ok )
+    {
+        CryptFileDevice check( partName, m_newPassword, m_salt );
+        ok = check.open( QIODevice::ReadOnly ) && check.size() == source.size();
+    }
+    source.close();
+
+    if ( !ok || !QFile::rename( partName, replacementName ) )
+    {
+        QFile::remove( partName );
+        result.errorString = QObject::tr( "Cannot write the new file" );
+        return false;
+    }
+    if ( !finishReplacement( fileName ) )
+    {
+        result.errorString = QObject::tr( "Cannot replace the file" );
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Rekeyer::configure
+ *
+ * Gives the device of the new password the parameters of the old header. Files derived
+ * with EVP_BytesToKey get PBKDF2 with the default cost of the device.
+ *
+ * @param target of the type CryptFileDevice &, the device of the new password
+ * @param source of the type CryptFileDevice &, the open device of the old password
+ */
+void Rekeyer::configure( CryptFileDevice &target, const CryptFileDevice &source ) const
+{
+    target.setEncryptionMethod( source.encryptionMethod() );
+    target.setKeyLength( source.keyLength() );
+    if ( source.keyDerivation() != CryptFileDevice::BytesToKey )
+    {
+        target.setKeyDerivation( source.keyDerivation() );
+        target.setNumRounds( source.numRounds() );
+    }
+}
@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file rekeyer.h
+ *
+ * @brief This file contains the declaration of the class Rekeyer
+ */
+#ifndef REKEYER_H
+#define REKEYER_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "cryptfiledevice.h"
+#include <QString>
+#include <QStringList>
+#include <QFuture>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @struct RekeyResult
+ *
+ * @brief The RekeyResult structure contains the outcome of the rekeying of one file.
+ */
+struct RekeyResult
+{
+    /// Outcome of the rekeying.
+    enum Status
+    {
+        Ok,         ///< the file is encrypted with the new password
+        Skipped,    ///< the file is empty, there is nothing to encrypt, or it has a header already (migration)
+        Failed      ///< the file is unchanged, or its journal is kept for the next run
+    };
+
+    //! Path to the encrypted file.
+    QString fileName;
+    //! Outcome of the rekeying.
+    Status status = Failed;
+    //! The file was rewritten in place (stream ciphers), not replaced by a new file (AesGcmCipher).
+    bool inPlace = false;
+    //! An interrupted rekeying of the file was completed.
+    bool resumed = false;
+    //! Number of the re-encrypted bytes.
+    qint64 size = 0;
+    //! Time of the rekeying, in ns.
+    qint64 durationNsecs = 0;
+    //! Reason, if the rekeying failed.
+    QString errorString;
+};
+
+/**
+ * @class Rekeyer
+ *
+ * @brief The Rekeyer class encrypts existing files with a new password, without writing the plain data.
+ *
+ * Every file is read through a CryptFileDevice with the old password and written through one with
+ * the new password in a single pass; the plain data only exists in a pooled buffer.
+ * The new header has a new nonce and key check value, the method, the key length and the cost
+ * of the key derivation are taken from the old header.
+ *
+ * Files of the stream ciphers (XorCipher, AesCipher, ChaCha20Cipher) are rewritten in place,
+ * step by step, with CryptFileDevice::transformAt of both devices. A journal next to the file
+ * (kJournalSuffix) holds the new header and, before a step is overwritten, its old content;
+ * the journal and the file are synced to the disk before and after every step and the new
+ * header is written last. An interrupted rekeying is rolled back to the last complete step and
+ * resumed by the next call with the same passwords.
+ *
+ * Files of AesGcmCipher cannot be rewritten in place, since a chunk must never be sealed twice
+ * with the same nonce: the new file is written next to the old one (kReplacementSuffix) and
+ * replaces it after it was synced.
+ *
+ * Files of version 1.0 have no header (see CryptFileDevice::setLegacyFormat). After Rekeyer::setLegacyFormat
+ * they are read in that format and replaced by a file with a header (like AesGcmCipher), which is
+ * encrypted with the new password, the current key derivation and a new salt. Files, which have a header
+ * already, are skipped, so a migration can be run again over a tree.
+ *
+ * The files are rekeyed in parallel (QtConcurrent, one file per task), like TreeVerifier.
+ *
+ * @code
+ * Rekeyer rekeyer( oldPassword, newPassword, salt );
+ * QList<RekeyResult> results = rekeyer.rekey( Rekeyer::collectFiles( paths, true ) );
+ * @endcode
+ *
+ * @note The rekeyer must outlive the QFuture returned by Rekeyer::start. A file must not be
+ * opened by anyone else while it is rekeyed.
+ */
+class Rekeyer
+{
+public:
+    Rekeyer( const QByteArray &oldPassword,
+             const QByteArray &newPassword,
+             const QByteArray &salt );
+
+    void setStepSize( qint64 stepSize );
+    qint64 stepSize( void ) const;
+    void setLegacyFormat( CryptFileDevice::EncryptionMethod method, qint64 chunkSize );
+
+    QFuture<RekeyResult> start( const QStringList &files );
+    QList<RekeyResult> rekey( const QStringList &files );
+    RekeyResult rekeyFile( const QString &fileName ) const;
+
+    static QStringList collectFiles( const QStringList &paths, bool recurse );
+
+    /// suffix of the journal of a file, which is rekeyed in place.
+    static const char *const kJournalSuffix;
+    /// suffix of the new file, which replaces an authenticated file.
+    static const char *const kReplacementSuffix;
+
+private:
+    bool rekeyInPlace( const QString &fileName, RekeyResult &result ) const;
+    bool replaceFile( CryptFileDevice &source, const QString &fileName, RekeyResult &result ) const;
+    void configure( CryptFileDevice &target, const CryptFileDevice &source ) const;
+
+    QByteArray m_oldPassword;
+    QByteArray m_newPassword;
+    QByteArray m_salt;
+    /// salt of the new headers
+    QByteArray m_newSalt;
+    qint64 m_stepSize;
+    /// the files have no header (version 1.0), see Rekeyer::setLegacyFormat
+    bool m_legacy = false;
+    CryptFileDevice::EncryptionMethod m_legacyMethod = CryptFileDevice::AesCipher;
+    qint64 m_legacyChunkSize = CryptFileDevice::kLegacyChunkSize;
+};
+
+#endif // REKEYER_H
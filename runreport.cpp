@@ -0,0 +1,312 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file runreport.cpp
+ *
+ * @brief This file contains the definition of methods of the RunReport class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "runreport.h"
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <algorithm>
+#include <cstdio>
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logRunReport, "Report")
+#define COEFF 1048576
+
+/**
+ * @brief The constructor of the class RunReport
+ *
+ * @param operation of the type QString &, name of the operation (encrypt, verify, etc.)
+ */
+RunReport::RunReport( const QString &operation ) :
+    m_operation( operation )
+{
+
+}
+
+/**
+ * @brief set-function for a parameter of the job (method, buffer size, etc.)
+ *
+ * @param name of the type QString &
+ * @param value of the type QVariant &
+ */
+void RunReport::setParameter( const QString &name, const QVariant &value )
+{
+    m_parameters.insert( name, value );
+}
+
+/**
+ * @brief RunReport::start
+ *
+ * Starts the monotonic clock of the job and discards the results of a previous job.
+ */
+void RunReport::start( void )
+{
+    m_files.clear();
+    m_startTime = QDateTime::currentDateTimeUtc();
+    m_elapsedNsecs = 0;
+    m_timer.start();
+}
+
+/**
+ * @brief RunReport::addFile
+ *
+ * Adds the result of one file to the report.
+ *
+ * @param path of the type QString &, path to the file
+ * @param size of the type qint64, size of the file in bytes
+ * @param durationNsecs of the type qint64, processing time of the file in ns
+ * @param status of the type RunReport::FileStatus
+ */
+void RunReport::addFile( const QString &path, qint64 size, qint64 durationNsecs, FileStatus status )
+{
+    FileEntry entry;
+    entry.path = path;
+    entry.size = size;
+    entry.durationNsecs = durationNsecs;
+    entry.status = status;
+    m_files.append( entry );
+}
+
+/**
+ * @brief RunReport::finish
+ *
+ * Stops the clock of the job.
+ */
+void RunReport::finish( void )
+{
+    m_elapsedNsecs = m_timer.isValid() ? m_timer.nsecsElapsed() : 0;
+}
+
+/**
+ * @brief get-function for the duration of the job
+ *
+ * @return the duration in ns, measured from start() to finish() (or to now, if not yet finished).
+ */
+qint64 RunReport::elapsedNsecs( void ) const
+{
+    if ( m_elapsedNsecs > 0 || !m_timer.isValid() )
+    {
+        return m_elapsedNsecs;
+    }
+    return m_timer.nsecsElapsed();
+}
+
+/**
+ * @brief get-function for the number of successfully processed bytes
+ *
+ * @return the size of all successfully processed files, in bytes.
+ */
+qint64 RunReport::bytes( void ) const
+{
+    qint64 sum = 0LL;
+    foreach ( const FileEntry &entry, m_files )
+    {
+        if ( entry.status == Success )
+        {
+            sum += entry.size;
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief get-function for the aggregate throughput of the job
+ *
+ * @return the throughput in Mb/s
+ */
+double RunReport::throughput( void ) const
+{
+    const qint64 ns = this->elapsedNsecs();
+    return ( ns > 0 ) ? static_cast<double>( this->bytes() ) / COEFF * 1e9 / ns : 0.0;
+}
+
+/**
+ * @brief RunReport::toJson
+ *
+ * @return the report as an indented JSON document.
+ */
+QByteArray RunReport::toJson( void ) const
+{
+    QJsonArray files;
+    QVector<qint64> durations;
+    durations.reserve( m_files.size() );
+    QMap<QString, int> counts;
+    qint64 totalSize = 0LL;
+    foreach ( const FileEntry &entry, m_files )
+    {
+        QJsonObject file;
+        file.insert( "path", entry.path );
+        file.insert( "size", static_cast<double>( entry.size ) );
+        file.insert( "duration_ns", static_cast<double>( entry.durationNsecs ) );
+        file.insert( "throughput_mbs", entry.durationNsecs > 0 ? static_cast<double>( entry.size ) / COEFF * 1e9 / entry.durationNsecs : 0.0 );
+        file.insert( "status", statusName( entry.status ) );
+        files.append( file );
+
+        durations.append( entry.durationNsecs );
+        counts[ statusName( entry.status ) ]++;
+        totalSize += entry.size;
+    }
+    std::sort( durations.begin(), durations.end() );
+
+    QJsonObject latency;
+    latency.insert( "min", static_cast<double>( durations.isEmpty() ? 0 : durations.first() ) );
+    latency.insert( "p50", static_cast<double>( percentile( durations, 50 ) ) );
+    latency.insert( "p90", static_cast<double>( percentile( durations, 90 ) ) );
+    latency.insert( "p99", static_cast<double>( percentile( durations, 99 ) ) );
+    latency.insert( "p999", static_cast<double>( percentile( durations, 99.9 ) ) );
+    latency.insert( "max", static_cast<double>( durations.isEmpty() ? 0 : durations.last() ) );
+
+    QJsonObject errors;
+    errors.insert( "error", counts.value( statusName( Error ) ) );
+    errors.insert( "aborted", counts.value( statusName( Aborted ) ) );
+    errors.insert( "failed", counts.value( statusName( Failed ) ) );
+
+    const qint64 ns = this->elapsedNsecs();
+    QJsonObject aggregate;
+    aggregate.insert( "files", m_files.size() );
+    aggregate.insert( "succeeded", counts.value( statusName( Success ) ) );
+    aggregate.insert( "bytes", static_cast<double>( totalSize ) );
+    aggregate.insert( "bytes_succeeded", static_cast<double>( this->bytes() ) );
+    aggregate.insert( "duration_ns", static_cast<double>( ns ) );
+    aggregate.insert( "throughput_mbs", this->throughput() );
+    aggregate.insert( "files_per_s", ns > 0 ? m_files.size() * 1e9 / ns : 0.0 );
+
+    QJsonObject root;
+    root.insert( "application", QCoreApplication::applicationName() );
+    root.insert( "version", QCoreApplication::applicationVersion() );
+    root.insert( "operation", m_operation );
+    root.insert( "start_utc", m_startTime.toString( Qt::ISODateWithMs ) );
+    root.insert( "parameters", QJsonObject::fromVariantMap( m_parameters ) );
+    root.insert( "aggregate", aggregate );
+    root.insert( "latency_ns", latency );
+    root.insert( "errors", errors );
+    root.insert( "peak_memory", static_cast<double>( peakMemory() ) );
+    root.insert( "files", files );
+
+    return QJsonDocument( root ).toJson( QJsonDocument::Indented );
+}
+
+/**
+ * @brief RunReport::write
+ *
+ * Writes the report to a file, or to the standard output if the path is "-".
+ *
+ * @param path of the type QString &
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+bool RunReport::write( const QString &path ) const
+{
+    const QByteArray json = this->toJson();
+    if ( path == "-" )
+    {
+        fwrite( json.constData(), 1, json.size(), stdout );
+        fflush( stdout );
+        return true;
+    }
+
+    QFile file( path );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        qCritical(logRunReport) << QObject::tr( "Cannot write the report file: %1" ).arg( path );
+        return false;
+    }
+    bool ok = ( file.write( json ) == json.size() );
+    file.close();
+
+    return ok;
+}
+
+/**
+ * @brief RunReport::peakMemory
+ *
+ * @return the peak resident set size of the process in bytes, or 0 if unknown.
+ */
+qint64 RunReport::peakMemory( void )
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if ( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+    {
+        return static_cast<qint64>( counters.PeakWorkingSetSize );
+    }
+    return 0LL;
+#elif defined(Q_OS_MACOS)
+    struct rusage usage;
+    return ( getrusage( RUSAGE_SELF, &usage ) == 0 ) ? static_cast<qint64>( usage.ru_maxrss ) : 0LL;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    return ( getrusage( RUSAGE_SELF, &usage ) == 0 ) ? static_cast<qint64>( usage.ru_maxrss ) * 1024 : 0LL;
+#else
+    return 0LL;
+#endif
+}
+
+/**
+ * @brief The function returns the name of a status, as used in the report.
+ *
+ * @param status of the type RunReport::FileStatus
+ * @return the name of the status
+ */
+QString RunReport::statusName( FileStatus status )
+{
+    switch ( status )
+    {
+    case Success:
+        return "success";
+    case Error:
+        return "error";
+    case Aborted:
+        return "aborted";
+    case Failed:
+        return "failed";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief The function returns the p-th percentile (nearest rank) of a sorted sample.
+ *
+ * Used for the latency distribution of the report and by the benchmarks.
+ *
+ * @param sorted of the type QVector<qint64>&, the sorted sample
+ * @param p of the type double, percentile in the range 0..100
+ * @return value of the percentile, 0 for an empty sample.
+ */
+qint64 RunReport::percentile( const QVector<qint64> &sorted, double p )
+{
+    if ( sorted.isEmpty() )
+    {
+        return 0LL;
+    }
+    int rank = static_cast<int>( p / 100.0 * sorted.size() + 0.5 );
+    rank = qBound( 1, rank, sorted.size() );
+    return sorted.at( rank - 1 );
+}
@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file runreport.h
+ *
+ * @brief This file contains the declaration of the class RunReport
+ */
+#ifndef RUNREPORT_H
+#define RUNREPORT_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QString>
+#include <QVector>
+#include <QVariantMap>
+#include <QElapsedTimer>
+#include <QDateTime>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @class RunReport
+ *
+ * @brief The RunReport class collects the results of one job and writes them as a JSON document.
+ *
+ * The report contains the size, duration, throughput and status of every processed file,
+ * the aggregate throughput, the latency distribution of the files, the error counts
+ * per status and the peak memory (resident set size) of the process.
+ * All durations are measured with a monotonic clock (QElapsedTimer) in nanoseconds.
+ *
+ * @code
+ * RunReport report( "encrypt" );
+ * report.start();
+ * report.addFile( path, size, durationNsecs, RunReport::Success );
+ * report.finish();
+ * report.write( "-" ); // stdout
+ * @endcode
+ */
+class RunReport
+{
+public:
+    //! The status of a processed file.
+    enum FileStatus
+    {
+        //! The file was processed.
+        Success,
+        //! The file was skipped after an error, the job was continued.
+        Error,
+        //! The job was aborted at this file.
+        Aborted,
+        //! The file failed with a state error (bad allocation, etc.).
+        Failed
+    };
+
+    explicit RunReport( const QString &operation );
+
+    void setParameter( const QString &name, const QVariant &value );
+
+    void start( void );
+    void addFile( const QString &path, qint64 size, qint64 durationNsecs, FileStatus status );
+    void finish( void );
+
+    qint64 elapsedNsecs( void ) const;
+    qint64 bytes( void ) const;
+    double throughput( void ) const;
+
+    QByteArray toJson( void ) const;
+    bool write( const QString &path ) const;
+
+    static qint64 peakMemory( void );
+    static QString statusName( FileStatus status );
+    static qint64 percentile( const QVector<qint64> &sorted, double p );
+
+private:
+    /**
+     * @struct FileEntry
+     *
+     * @brief The FileEntry structure holds the result of one file.
+     */
+    struct FileEntry
+    {
+        QString path;
+        qint64 size;
+        qint64 durationNsecs;
+        FileStatus status;
+    };
+
+    QString m_operation;
+    QVariantMap m_parameters;
+    QVector<FileEntry> m_files;
+    QDateTime m_startTime;
+    QElapsedTimer m_timer;
+    qint64 m_elapsedNsecs = 0;
+};
+
+#endif // RUNREPORT_H
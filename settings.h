@@ -42,8 +42,24 @@ struct Settings
     bool enableLog;
     //! Path to the log/debug file
     QString pathToLog;
-    //! This field determines the maximum size of the log file (in Kb)
+    //! This field determines the maximum size of the log file (in Kb), the file is rotated when it is full
     quint32 maxSizeLog;
+    //! The log file is rotated after it was written for this time (in hours), 0 disables it
+    quint32 logRotateHours;
+    //! Number of the kept archives of the log file (crypto.log.1, crypto.log.2, ...)
+    quint32 logArchives;
+    //! Longest time a message waits in the queue of the log writer (in ms)
+    quint32 logFlushInterval;
+    //! Maximum number of messages in the queue of the log writer
+    quint32 logQueueCapacity;
+    //! Wait for the log writer if its queue is full, instead of dropping the message
+    bool logBlockWhenFull;
+    //! Enables / disables the performance counters of CryptFileDevice
+    bool enableStatistics;
+    //! Path to the Chrome trace-event file of a job, the tracing is disabled if empty
+    QString pathToTrace;
+    //! Path to the JSON report of a job ("-" for stdout), no report is written if empty
+    QString pathToReport;
 };
 
 #endif // SETTINGS
@@ -19,12 +19,26 @@
 //------------------------------------------------------------------------------
 #include "settingsdialog.h"
 #include "ui_settingsdialog.h"
+#include "logsink.h"
 #include <QLoggingCategory>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTimer>
+#include <QFile>
+#include <climits>
 
 //------------------------------------------------------------------------------
 // Types
 //------------------------------------------------------------------------------
 Q_LOGGING_CATEGORY(logSettingsDialog, "settings")
+/// part of the log file, which is shown when the viewer is opened, in bytes.
+static qint64 const kTailBytes = 256 * 1024;
+/// maximum number of bytes read from the log file per update of the viewer.
+static qint64 const kReadBytes = 256 * 1024;
+/// maximum number of lines kept by the viewer.
+static int const kMaxLines = 5000;
+/// interval of the updates of the viewer, in ms.
+static int const kTailInterval = 500;
 
 /**
  * @brief The constructor of the class SettingsDialog
@@ -35,7 +49,9 @@ Q_LOGGING_CATEGORY(logSettingsDialog, "settings")
  */
 SettingsDialog::SettingsDialog( QWidget *parent ) :
     QDialog( parent ),
-    ui( new Ui::SettingsDialog )
+    ui( new Ui::SettingsDialog ),
+    logTimer( new QTimer( this ) ),
+    logOffset( -1 )
 {
     Q_ASSERT( parent != nullptr );
     ui->setupUi( this );
@@ -43,6 +59,11 @@ SettingsDialog::SettingsDialog( QWidget *parent ) :
     this->fillSettings();
     ui->logBrowser->setLineWrapMode(QTextEdit::NoWrap);
     ui->logBrowser->setStyleSheet( QString("font: 14px; color: blue") );
+    ui->logBrowser->document()->setUndoRedoEnabled( false );
+    ui->logBrowser->document()->setMaximumBlockCount( kMaxLines );
+
+    this->logTimer->setInterval( kTailInterval );
+    connect( this->logTimer, &QTimer::timeout, this, &SettingsDialog::tailLog );
 }
 
 /**
@@ -101,13 +122,81 @@ void SettingsDialog::fillSettingsUi( void )
     ui->maxSizeLog->setEnabled( currentSettings.enableLog );
     ui->logBox->setTitle( QString( "Log file %1").arg( currentSettings.pathToLog ));
     ui->logBrowser->setEnabled( currentSettings.enableLog );
-    if ( ui->logBrowser->source().isEmpty())
+    if ( currentSettings.enableLog )
+    {
+        if ( this->logFileName != currentSettings.pathToLog )
+        {
+            this->logFileName = currentSettings.pathToLog;
+            this->logOffset = -1;
+        }
+        this->tailLog();
+        this->logTimer->start();
+    }
+}
+
+/**
+ * @brief The tailLog slot appends the new lines of the log file to the viewer.
+ *
+ * The first call shows the last kTailBytes of the file, every further call reads only
+ * the bytes appended since, at most kReadBytes at a time, so that the UI never waits for
+ * a large log file. If the file got shorter, it was rotated and the viewer starts over.
+ * The timer stops when the dialog is hidden.
+ */
+void SettingsDialog::tailLog( void )
+{
+    if ( !this->isVisible() && this->sender() == this->logTimer )
+    {
+        this->logTimer->stop();
+        return;
+    }
+
+    QFile file( this->logFileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
     {
-        ui->logBrowser->setSource( QUrl::fromLocalFile( currentSettings.pathToLog ));
+        return;
     }
-    else if ( currentSettings.enableLog )
+
+    const qint64 size = file.size();
+    if ( this->logOffset < 0 || size < this->logOffset )
+    {
+        ui->logBrowser->clear();
+        this->logOffset = qMax( Q_INT64_C( 0 ), size - kTailBytes );
+        if ( this->logOffset > 0 )
+        {
+            // start with a complete line
+            file.seek( this->logOffset );
+            file.readLine();
+            this->logOffset = file.pos();
+        }
+    }
+    if ( size <= this->logOffset || !file.seek( this->logOffset ) )
+    {
+        return;
+    }
+
+    QByteArray data = file.read( qMin( size - this->logOffset, kReadBytes ) );
+    // only complete lines, unless a single line is longer than the read
+    int end = data.lastIndexOf( '\n' ) + 1;
+    if ( end == 0 && data.size() < kReadBytes )
+    {
+        return;
+    }
+    if ( end == 0 )
+    {
+        end = data.size();
+    }
+    data.truncate( end );
+    this->logOffset += end;
+    data.replace( "<br />", "" );
+
+    QScrollBar *scrollBar = ui->logBrowser->verticalScrollBar();
+    const bool atBottom = ( scrollBar->value() == scrollBar->maximum() );
+    QTextCursor cursor( ui->logBrowser->document() );
+    cursor.movePosition( QTextCursor::End );
+    cursor.insertText( QString::fromLocal8Bit( data ) );
+    if ( atBottom )
     {
-        ui->logBrowser->reload();
+        scrollBar->setValue( scrollBar->maximum() );
     }
 }
 
@@ -125,6 +214,10 @@ void SettingsDialog::on_buttonBox_accepted( void )
         qInfo( logSettingsDialog ) << "logging enabled";
     }
     this->updateSettings();
+    // the rotation of the running log takes effect immediately
+    LogSink::setRotation( static_cast<qint64>( currentSettings.maxSizeLog ) * 1024,
+                          static_cast<int>( qMin( currentSettings.logRotateHours, quint32( INT_MAX / 3600 ) ) ) * 3600,
+                          static_cast<int>( qMin( currentSettings.logArchives, quint32( 100 ) ) ) );
     this->hide();
 }
 
@@ -19,6 +19,8 @@
 #include <QDialog>
 #include "settings.h"
 
+class QTimer;
+
 namespace Ui {
 class SettingsDialog;
 }
@@ -30,6 +32,9 @@ class SettingsDialog;
  *
  *  The SettingsDialog class provides the user with a number of Back-End functions
  *  that handle user events and reactions to these events.
+ *
+ *  The log viewer shows the tail of the log file and follows it while the dialog is visible:
+ *  only the appended bytes are read, and the viewer keeps at most a fixed number of lines.
  */
 class SettingsDialog : public QDialog
 {
@@ -48,10 +53,16 @@ private slots:
 
     void on_enableLog_clicked( bool checked );
 
+    void tailLog( void );
+
 private:
     Ui::SettingsDialog *ui;
     Settings currentSettings;
 
+    QTimer *logTimer;
+    QString logFileName;
+    qint64 logOffset;
+
     void fillSettings( void );
     void updateSettings( void );
 };
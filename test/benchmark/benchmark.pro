@@ -0,0 +1,46 @@
+#-------------------------------------------------
+#
+# Seek and random-read latency benchmark for CryptFileDevice
+#
+#-------------------------------------------------
+
+QT       += concurrent
+QT       -= gui
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+CONFIG   += release
+
+TARGET = seekbench
+TEMPLATE = app
+
+QMAKE_CXXFLAGS_RELEASE += -O3
+DEFINES += QT_NO_DEBUG_OUTPUT
+
+SRCPATH = $$PWD/../..
+
+INCLUDEPATH += $$SRCPATH
+
+SOURCES += seekbench.cpp \
+    $$SRCPATH/cryptfiledevice.cpp \
+    $$SRCPATH/tracer.cpp \
+    $$SRCPATH/bufferpool.cpp \
+    $$SRCPATH/runreport.cpp
+
+HEADERS  += \
+    $$SRCPATH/cryptfiledevice.h \
+    $$SRCPATH/tracer.h \
+    $$SRCPATH/bufferpool.h \
+    $$SRCPATH/runreport.h
+
+#openssl libraly
+win32 {
+INCLUDEPATH += c:/OpenSSL-Win32/include
+LIBS += -Lc:/OpenSSL-Win32/bin -llibeay32
+}
+win32 {
+LIBS += -lpsapi
+}
+linux|macx {
+LIBS += -lcrypto
+QMAKE_LFLAGS += "-Wl,-rpath,\'\$$ORIGIN/lib\'"
+}
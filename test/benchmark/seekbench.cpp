@@ -0,0 +1,389 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file seekbench.cpp
+ *
+ * @brief Seek and random-read latency benchmark for the CryptFileDevice class.
+ *
+ * The benchmark creates a large encrypted file through CryptFileDevice and then
+ * issues random or strided seek+read requests against it. For every pass the
+ * latency distribution (p50/p90/p99/p999) of seek() alone and of seek()+read()
+ * as well as the resulting IOPS are reported. Each pattern is measured once with
+ * a cold page cache and once with a warm page cache, so that the cost of
+ * CryptFileDevice::initCtr and CryptFileDevice::readBlock on the random-access
+ * path is visible separately from the cost of the storage.
+ *
+ * Example:
+ * @code
+ * seekbench --size 1024 --reads 20000 --block 4096 --pattern random
+ * seekbench --pattern strided --stride 1048576 --block 65536
+ * @endcode
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+#include <QFile>
+#include <QDir>
+#include <algorithm>
+#include <random>
+#include "cryptfiledevice.h"
+#include "runreport.h"
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+#define ONEKB 1024
+#define COEFF 1048576
+
+/**
+ * @struct BenchOptions
+ *
+ * @brief The BenchOptions structure holds the parameters of one benchmark run.
+ */
+struct BenchOptions
+{
+    //! Path to the encrypted test file.
+    QString fileName;
+    //! Size of the encrypted test file, in Mb.
+    qint64 fileSize;
+    //! Number of seek+read requests per pass.
+    int reads;
+    //! Number of bytes read after every seek.
+    qint64 block;
+    //! Distance between two consecutive requests of the strided pattern.
+    qint64 stride;
+    //! The access pattern: "random", "strided" or "both".
+    QString pattern;
+    //! Seed of the pseudo random generator.
+    quint32 seed;
+    //! Keep the test file after the run.
+    bool keep;
+};
+
+/**
+ * @struct PassResult
+ *
+ * @brief The PassResult structure holds the latencies measured during one pass.
+ */
+struct PassResult
+{
+    //! Latency of CryptFileDevice::seek(), in ns.
+    QVector<qint64> seekNs;
+    //! Latency of CryptFileDevice::seek() + CryptFileDevice::read(), in ns.
+    QVector<qint64> totalNs;
+    //! Wall clock duration of the whole pass, in ns.
+    qint64 elapsedNs;
+    //! Number of bytes read during the pass.
+    qint64 bytes;
+};
+
+static QTextStream out( stdout );
+
+//------------------------------------------------------------------------------
+// Function Prototypes
+//------------------------------------------------------------------------------
+static bool createTestFile( CryptFileDevice &device, const BenchOptions &opt );
+static bool dropPageCache( QFile &file );
+static void warmPageCache( QFile &file );
+static QVector<qint64> makeOffsets( const QString &pattern, const BenchOptions &opt, qint64 size );
+static PassResult runPass( CryptFileDevice &device, const QVector<qint64> &offsets, qint64 block );
+static void report( const QString &title, PassResult &result );
+
+/**
+ * @brief main function of the benchmark.
+ *
+ * @param argc number of the command line arguments
+ * @param argv the command line arguments
+ *
+ * @return 0 if the benchmark was successfully completed, 1 otherwise.
+ */
+int main( int argc, char *argv[] )
+{
+    QCoreApplication app( argc, argv );
+    app.setApplicationName( "seekbench" );
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription( "Seek and random-read latency benchmark for CryptFileDevice" );
+    parser.addHelpOption();
+    parser.addOption( QCommandLineOption( "file", "Path to the encrypted test file.", "path",
+                                          QDir::tempPath() + "/seekbench.encrypted" ) );
+    parser.addOption( QCommandLineOption( "size", "Size of the test file, in Mb.", "mb", "256" ) );
+    parser.addOption( QCommandLineOption( "reads", "Number of seek+read requests per pass.", "n", "10000" ) );
+    parser.addOption( QCommandLineOption( "block", "Number of bytes read after every seek.", "bytes", "4096" ) );
+    parser.addOption( QCommandLineOption( "stride", "Distance between requests of the strided pattern.", "bytes", "1048576" ) );
+    parser.addOption( QCommandLineOption( "pattern", "Access pattern: random, strided or both.", "name", "both" ) );
+    parser.addOption( QCommandLineOption( "seed", "Seed of the pseudo random generator.", "n", "20180101" ) );
+    parser.addOption( QCommandLineOption( "keep", "Keep the test file after the run." ) );
+    parser.process( app );
+
+    BenchOptions opt;
+    opt.fileName = parser.value( "file" );
+    opt.fileSize = parser.value( "size" ).toLongLong() * COEFF;
+    opt.reads = parser.value( "reads" ).toInt();
+    opt.block = parser.value( "block" ).toLongLong();
+    opt.stride = parser.value( "stride" ).toLongLong();
+    opt.pattern = parser.value( "pattern" );
+    opt.seed = parser.value( "seed" ).toUInt();
+    opt.keep = parser.isSet( "keep" );
+
+    if ( opt.fileSize <= opt.block || opt.block <= 0 || opt.reads <= 0 || opt.stride <= 0 )
+    {
+        out << "Invalid parameters, see --help" << endl;
+        return 1;
+    }
+
+    QFile file( opt.fileName );
+    CryptFileDevice device( &file,
+                            "01234567890123456789012345678901",
+                            "0123456789012345" );
+    //! @note The device which produced the file is kept open (ReadWrite) for the measurements,
+    //! the header is parsed and the key is derived once, the passes measure only the seeks and the reads.
+    if ( !device.open( QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered ) )
+    {
+        out << "Cannot create the test file " << opt.fileName << endl;
+        return 1;
+    }
+
+    out << "Creating " << opt.fileSize / COEFF << " Mb encrypted test file " << opt.fileName << endl;
+    if ( !createTestFile( device, opt ) )
+    {
+        out << "Cannot write the test file " << opt.fileName << endl;
+        device.close();
+        file.remove();
+        return 1;
+    }
+
+    QStringList patterns;
+    if ( opt.pattern == "both" )
+    {
+        patterns << "random" << "strided";
+    }
+    else
+    {
+        patterns << opt.pattern;
+    }
+
+    out << "reads per pass: " << opt.reads << ", block: " << opt.block << " bytes";
+    if ( patterns.contains( "strided" ) )
+    {
+        out << ", stride: " << opt.stride << " bytes";
+    }
+    out << endl;
+
+    foreach ( const QString &pattern, patterns )
+    {
+        const QVector<qint64> offsets = makeOffsets( pattern, opt, device.size() );
+        if ( offsets.isEmpty() )
+        {
+            out << "Unknown pattern " << pattern << endl;
+            continue;
+        }
+
+        const bool cold = dropPageCache( file );
+        PassResult coldResult = runPass( device, offsets, opt.block );
+        report( QString( "%1 %2" ).arg( pattern, cold ? "cold" : "cold(n/a)" ), coldResult );
+
+        warmPageCache( file );
+        PassResult warmResult = runPass( device, offsets, opt.block );
+        report( QString( "%1 warm" ).arg( pattern ), warmResult );
+    }
+
+    device.close();
+    if ( !opt.keep )
+    {
+        file.remove();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief The function fills the encrypted test file with pseudo random data.
+ *
+ * @param device of the type CryptFileDevice&, the opened device
+ * @param opt of the type BenchOptions&, parameters of the run
+ * @retval true if successful,
+ * @retval false otherwise.
+ */
+static bool createTestFile( CryptFileDevice &device, const BenchOptions &opt )
+{
+    std::mt19937 gen( opt.seed );
+    QByteArray chunk( COEFF, '\0' );
+    qint64 written = 0LL;
+    while ( written < opt.fileSize )
+    {
+        quint32 *p = reinterpret_cast<quint32 *>( chunk.data() );
+        for ( int i = 0; i < chunk.size() / int( sizeof( quint32 ) ); i++ )
+        {
+            p[i] = gen();
+        }
+        const qint64 len = qMin( qint64( chunk.size() ), opt.fileSize - written );
+        if ( device.write( chunk.constData(), len ) != len )
+        {
+            return false;
+        }
+        written += len;
+    }
+
+    return device.flush();
+}
+
+/**
+ * @brief The function evicts the test file from the page cache of the operating system.
+ *
+ * @param file of the type QFile&, the underlying file of the device
+ * @retval true if the cache was dropped,
+ * @retval false if this is not supported on the platform.
+ */
+static bool dropPageCache( QFile &file )
+{
+#if defined(Q_OS_LINUX)
+    file.flush();
+    const int fd = file.handle();
+    if ( fd < 0 || ::fdatasync( fd ) != 0 )
+    {
+        return false;
+    }
+    return ::posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED ) == 0;
+#else
+    Q_UNUSED( file );
+    return false;
+#endif
+}
+
+/**
+ * @brief The function reads the whole test file once, so that it resides in the page cache.
+ *
+ * @param file of the type QFile&, the underlying file of the device
+ */
+static void warmPageCache( QFile &file )
+{
+    const qint64 pos = file.pos();
+    QFile reader( file.fileName() );
+    if ( reader.open( QIODevice::ReadOnly ) )
+    {
+        QByteArray chunk( COEFF, '\0' );
+        while ( reader.read( chunk.data(), chunk.size() ) > 0 )
+        {
+        }
+        reader.close();
+    }
+    file.seek( pos );
+}
+
+/**
+ * @brief The function generates the offsets of one pass.
+ *
+ * @param pattern of the type QString&, "random" or "strided"
+ * @param opt of the type BenchOptions&, parameters of the run
+ * @param size of the type qint64, size of the decrypted data
+ * @return offsets of the requests, or an empty list for an unknown pattern.
+ */
+static QVector<qint64> makeOffsets( const QString &pattern, const BenchOptions &opt, qint64 size )
+{
+    QVector<qint64> offsets;
+    const qint64 range = size - opt.block;
+    if ( pattern == "random" )
+    {
+        std::mt19937_64 gen( opt.seed );
+        std::uniform_int_distribution<qint64> dist( 0, range );
+        offsets.reserve( opt.reads );
+        for ( int i = 0; i < opt.reads; i++ )
+        {
+            offsets.append( dist( gen ) );
+        }
+    }
+    else if ( pattern == "strided" )
+    {
+        offsets.reserve( opt.reads );
+        qint64 pos = 0LL;
+        for ( int i = 0; i < opt.reads; i++ )
+        {
+            offsets.append( pos );
+            pos = ( pos + opt.stride ) % ( range + 1 );
+        }
+    }
+
+    return offsets;
+}
+
+/**
+ * @brief The function executes one pass of seek+read requests and measures their latency.
+ *
+ * @param device of the type CryptFileDevice&, the opened device
+ * @param offsets of the type QVector<qint64>&, offsets of the requests
+ * @param block of the type qint64, number of bytes read after every seek
+ * @return the measured latencies.
+ */
+static PassResult runPass( CryptFileDevice &device, const QVector<qint64> &offsets, qint64 block )
+{
+    PassResult result;
+    result.seekNs.reserve( offsets.size() );
+    result.totalNs.reserve( offsets.size() );
+    result.bytes = 0LL;
+
+    QByteArray buffer( block, '\0' );
+    QElapsedTimer pass, timer;
+    pass.start();
+    foreach ( const qint64 pos, offsets )
+    {
+        timer.start();
+        device.seek( pos );
+        const qint64 seekNs = timer.nsecsElapsed();
+        const qint64 read = device.read( buffer.data(), block );
+        const qint64 totalNs = timer.nsecsElapsed();
+
+        result.seekNs.append( seekNs );
+        result.totalNs.append( totalNs );
+        result.bytes += qMax( read, 0LL );
+    }
+    result.elapsedNs = pass.nsecsElapsed();
+
+    return result;
+}
+
+/**
+ * @brief The function prints the latency distribution and IOPS of one pass.
+ *
+ * @param title of the type QString&, name of the pass
+ * @param result of the type PassResult&, the measured latencies
+ */
+static void report( const QString &title, PassResult &result )
+{
+    std::sort( result.seekNs.begin(), result.seekNs.end() );
+    std::sort( result.totalNs.begin(), result.totalNs.end() );
+
+    const double seconds = static_cast<double>( result.elapsedNs ) / 1e9;
+    const double iops = seconds > 0 ? result.totalNs.size() / seconds : 0.0;
+    const double mbs = seconds > 0 ? result.bytes / seconds / COEFF : 0.0;
+
+    out << qSetFieldWidth( 16 ) << left << title << qSetFieldWidth( 0 )
+        << "IOPS " << QString::number( iops, 'f', 0 )
+        << ", " << QString::number( mbs, 'f', 1 ) << " Mb/s" << endl;
+    out << "    seek      (us) p50 " << RunReport::percentile( result.seekNs, 50 ) / 1000.0
+        << "  p90 " << RunReport::percentile( result.seekNs, 90 ) / 1000.0
+        << "  p99 " << RunReport::percentile( result.seekNs, 99 ) / 1000.0
+        << "  p999 " << RunReport::percentile( result.seekNs, 99.9 ) / 1000.0 << endl;
+    out << "    seek+read (us) p50 " << RunReport::percentile( result.totalNs, 50 ) / 1000.0
+        << "  p90 " << RunReport::percentile( result.totalNs, 90 ) / 1000.0
+        << "  p99 " << RunReport::percentile( result.totalNs, 99 ) / 1000.0
+        << "  p999 " << RunReport::percentile( result.totalNs, 99.9 ) / 1000.0 << endl;
+}
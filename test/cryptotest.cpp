@@ -1,10 +1,30 @@
 #include <QString>
 #include <QtTest>
 #include "../cryptfiledevice.h"
+#include "../bufferpool.h"
+#include "../compressiondevice.h"
+#include "../packarchive.h"
+#include "../logsink.h"
+#include "../treeverifier.h"
+#include "../cpufeatures.h"
+#include "../backendprobe.h"
+#include "../rekeyer.h"
+#include "../jobinput.h"
+#include "../tracer.h"
+#include "../runreport.h"
+#include "../jobmonitor.h"
+#include "../buffertuner.h"
 #include <QFile>
 #include <QDebug>
 #include <QDateTime>
 #include <QDataStream>
+#include <QTemporaryDir>
+#include <QtConcurrent>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSettings>
+#include <openssl/evp.h>
 
 class CryptoTest : public QObject
 {
@@ -32,6 +52,31 @@ private Q_SLOTS:
     void testCase16();
     void testCase17();
     void testCase18();
+    void testCase19();
+    void testCase20();
+    void testCase21();
+    void testCase22();
+    void testCase23();
+    void testCase24();
+    void testCase25();
+    void testCase26();
+    void testCase27();
+    void testCase28();
+    void testCase29();
+    void testCase30();
+    void testCase31();
+    void testCase32();
+    void testCase33();
+    void testCase34();
+    void testCase35();
+    void testCase36();
+    void testCase37();
+    void testCase38();
+    void testCase39();
+    void testCase40();
+    void testCase41();
+    void testCase42();
+    void testCase43();
 };
 
 static QTime timer;
@@ -588,6 +633,1618 @@ void CryptoTest::testCase18()
     qDebug() << ">> >> >>";
 }
 
+/**
+ * @brief CryptoTest::testCase19
+ */
+void CryptoTest::testCase19()
+{
+    bool ok = true;
+
+    qDebug() << "Performance counters";
+    QFile file( QDir::currentPath() + "/testfile.stats" );
+    CryptFileDevice device( &file,
+                            "01234567890123456789012345678901",
+                            "0123456789012345" );
+    // the master key of the earlier tests must not be taken from the cache
+    CryptFileDevice::clearKeyCache();
+    CryptFileDevice::setStatisticsEnabled( true );
+    const CryptStatistics before = CryptFileDevice::globalStatistics();
+
+    QByteArray data = generateRandomData( 4096 );
+    if ( !device.open( QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered ) )
+    {
+        CryptFileDevice::setStatisticsEnabled( false );
+        QVERIFY2( false, "Open test file failed" );
+        return;
+    }
+    device.write( data );
+    device.seek( 0 );
+    QByteArray read = device.read( data.size() );
+    CryptStatistics stats = device.statistics();
+    device.close();
+    file.remove();
+    CryptFileDevice::setStatisticsEnabled( false );
+
+    ok = ok && ( read == data );
+    ok = ok && ( stats.writeBytes == quint64( data.size() ) ) && ( stats.writeCalls == 1 );
+    ok = ok && ( stats.readBytes == quint64( data.size() ) ) && ( stats.readCalls >= 1 );
+    ok = ok && ( stats.seeks >= 1 ) && ( stats.keyDerivations == 1 );
+    ok = ok && ( device.property( "writeBytes" ).toULongLong() == stats.writeBytes );
+
+    const CryptStatistics after = CryptFileDevice::globalStatistics();
+    ok = ok && ( after.writeBytes - before.writeBytes >= stats.writeBytes );
+
+    QVERIFY2( ok, "Performance counters are wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Performance counters are wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase20
+ */
+void CryptoTest::testCase20()
+{
+    bool ok = true;
+
+    qDebug() << "Buffer pool";
+    BufferPool pool( 4 * BufferPool::kMinClassSize );
+    {
+        PooledBuffer first = pool.acquire( 100000 );
+        ok = ok && !first.isNull() && !first.isRecycled();
+        ok = ok && ( first.capacity() >= 100000 );
+        ok = ok && ( reinterpret_cast<quintptr>( first.data() ) % BufferPool::kAlignment == 0 );
+    }
+    {
+        // same size class, the buffer is reused
+        PooledBuffer second = pool.acquire( 2 * BufferPool::kMinClassSize );
+        ok = ok && !second.isNull() && second.isRecycled();
+
+        // the capacity is exhausted
+        PooledBuffer third = pool.acquire( 4 * BufferPool::kMinClassSize );
+        ok = ok && third.isNull();
+    }
+    // the idle buffer is evicted to make room
+    PooledBuffer fourth = pool.acquire( 4 * BufferPool::kMinClassSize );
+    ok = ok && !fourth.isNull();
+    fourth.release();
+
+    const BufferPoolStatistics stats = pool.statistics();
+    ok = ok && ( stats.acquires == 3 ) && ( stats.hits == 1 ) && ( stats.misses == 2 );
+    ok = ok && ( stats.failures == 1 ) && ( stats.evictions == 1 ) && ( stats.bytesInUse == 0 );
+    ok = ok && ( stats.bytesPeak <= pool.capacity() );
+
+    QVERIFY2( ok, "Buffer pool is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Buffer pool is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase21
+ */
+void CryptoTest::testCase21()
+{
+    bool ok = true;
+
+    qDebug() << "Compression before encryption";
+    QFile file( QDir::currentPath() + "/testfile.compressed" );
+    CryptFileDevice device( &file,
+                            "01234567890123456789012345678901",
+                            "0123456789012345" );
+    if ( !device.open( QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered ) )
+    {
+        QVERIFY2( false, "Open test file failed" );
+        return;
+    }
+
+    // compressible text with a random part, several frames
+    QByteArray data;
+    while ( data.size() < 600 * 1024 )
+    {
+        data += "timestamp;level;message;" + QByteArray::number( qrand() % 1000 ) + "\r\n";
+    }
+
+    CompressionDevice writer( &device );
+    writer.setLevel( 6 );
+    writer.setFrameSize( 64 * 1024 );
+    ok = ok && writer.open( QIODevice::WriteOnly );
+    ok = ok && ( writer.write( data ) == data.size() );
+    writer.close();
+    ok = ok && device.isOpen() && ( device.size() < data.size() / 2 );
+
+    device.seek( 0 );
+    ok = ok && CompressionDevice::isCompressed( &device );
+    CompressionDevice reader( &device );
+    ok = ok && reader.open( QIODevice::ReadOnly );
+    ok = ok && ( reader.level() == 6 ) && ( reader.frameSize() == 64 * 1024 );
+    ok = ok && ( reader.size() == data.size() );
+    ok = ok && ( reader.readAll() == data );
+
+    // random access decodes only the frames of the requested range
+    for ( int i = 0; ok && i < 50; i++ )
+    {
+        const qint64 pos = qrand() % data.size();
+        const qint64 maxlen = qrand() % 100000;
+        ok = ok && reader.seek( pos );
+        ok = ok && ( reader.read( maxlen ) == data.mid( pos, maxlen ) );
+    }
+    reader.close();
+    device.close();
+    file.remove();
+
+    // a stream, which cannot be completed, is reported by finish() and stays failed after close()
+    QFile broken( QDir::currentPath() + "/testfile.broken" );
+    ok = ok && broken.open( QIODevice::WriteOnly | QIODevice::Truncate );
+    CompressionDevice failing( &broken );
+    ok = ok && failing.open( QIODevice::WriteOnly ) && ( failing.write( data.left( 1000 ) ) == 1000 );
+    broken.close();
+    ok = ok && !failing.finish() && failing.hasFailed();
+    failing.close();
+    ok = ok && failing.hasFailed();
+    broken.remove();
+
+    QVERIFY2( ok, "Compressed content is different" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Compressed content is different" );
+}
+
+/**
+ * @brief CryptoTest::testCase22
+ */
+void CryptoTest::testCase22()
+{
+    bool ok = true;
+
+    qDebug() << "Pack container";
+    QTemporaryDir tree;
+    QTemporaryDir restore;
+    ok = ok && tree.isValid() && restore.isValid() && QDir( tree.path() ).mkpath( "sub/dir" );
+    QStringList names;
+    names << "a.txt" << "sub/b.bin" << "sub/dir/c.csv" << "sub/dir/empty";
+    QList<QByteArray> contents;
+    for ( int i = 0; ok && i < names.size(); i++ )
+    {
+        contents.append( ( i == names.size() - 1 ) ? QByteArray() : generateRandomData( qrand() % 5000 + 1 ) );
+        QFile member( QDir( tree.path() ).filePath( names.at( i ) ) );
+        ok = ok && member.open( QIODevice::WriteOnly ) && ( member.write( contents.last() ) == contents.last().size() );
+    }
+
+    QFile file( QDir::currentPath() + "/testfile.pack" );
+    CryptFileDevice device( &file,
+                            "01234567890123456789012345678901",
+                            "0123456789012345" );
+    if ( !ok || !device.open( QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered ) )
+    {
+        QVERIFY2( false, "Open test file failed" );
+        return;
+    }
+
+    PackArchive writer( &device );
+    ok = ok && writer.create();
+    foreach ( const QString &name, names )
+    {
+        ok = ok && writer.addFile( QDir( tree.path() ).filePath( name ), name );
+    }
+    ok = ok && writer.addData( "../escape", QByteArray( "x" ), 0x6000 );
+    ok = ok && writer.finish();
+
+    device.seek( 0 );
+    ok = ok && PackArchive::isPack( &device );
+    PackArchive reader( &device );
+    ok = ok && reader.load();
+    ok = ok && ( reader.entries().size() == names.size() + 1 );
+
+    // random extraction of single members
+    for ( int i = names.size() - 1; ok && i >= 0; i-- )
+    {
+        const int index = reader.find( names.at( i ) );
+        ok = ok && ( index == i ) && ( reader.read( index ) == contents.at( i ) );
+        ok = ok && reader.extract( index, restore.path() );
+        QFile member( QDir( restore.path() ).filePath( names.at( i ) ) );
+        ok = ok && member.open( QIODevice::ReadOnly ) && ( member.readAll() == contents.at( i ) );
+    }
+    // a member must not leave the target directory
+    ok = ok && !reader.extract( reader.find( "../escape" ), restore.path() );
+
+    device.close();
+    file.remove();
+
+    QVERIFY2( ok, "Pack container is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Pack container is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase23
+ */
+void CryptoTest::testCase23()
+{
+    bool ok = true;
+
+    qDebug() << "Retarget a device to many small files";
+    CryptFileDevice device( QDir::currentPath() + "/testfile.small0",
+                            "01234567890123456789012345678901",
+                            "0123456789012345" );
+    CryptFileDevice::clearKeyCache();
+    CryptFileDevice::setStatisticsEnabled( true );
+
+    QList<QByteArray> cipherTexts;
+    QByteArray data = generateRandomData( 1000 );
+    for ( int i = 0; ok && i < 4; i++ )
+    {
+        const QString name = QDir::currentPath() + "/testfile.small" + QString::number( i );
+        if ( i == 3 )
+        {
+            // new credentials must not reuse the cached key
+            device.setPassword( "98765432109876543210987654321098" );
+        }
+        ok = ok && device.reset( name ) && ( device.fileName() == name );
+        ok = ok && device.open( QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered );
+        ok = ok && ( device.write( data ) == data.size() );
+        ok = ok && device.seek( 0 ) && ( device.read( data.size() ) == data );
+        device.close();
+
+        QFile file( name );
+        ok = ok && file.open( QIODevice::ReadOnly );
+        cipherTexts.append( file.readAll() );
+        file.close();
+        file.remove();
+    }
+    const CryptStatistics stats = device.statistics();
+    CryptFileDevice::setStatisticsEnabled( false );
+
+    ok = ok && ( stats.keyDerivations == 2 );
+    // the nonce of every file gives another cipher text of the same data
+    ok = ok && ( cipherTexts.size() == 4 ) && ( cipherTexts.at( 0 ).size() == data.size() + CryptFileDevice::kHeaderLength );
+    ok = ok && ( cipherTexts.at( 0 ).mid( CryptFileDevice::kHeaderLength ) != cipherTexts.at( 2 ).mid( CryptFileDevice::kHeaderLength ) );
+    ok = ok && ( cipherTexts.at( 0 ) != data ) && ( cipherTexts.at( 3 ) != cipherTexts.at( 0 ) );
+
+    QVERIFY2( ok, "Retargeted device is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Retargeted device is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase24
+ */
+void CryptoTest::testCase24()
+{
+    bool ok = true;
+
+    qDebug() << "Background log writer";
+    const QString fileName = QDir::currentPath() + "/testfile.log";
+    LogSink::setFlushInterval( 50 );
+    LogSink::setCapacity( 1000000 );
+    LogSink::setOverflowPolicy( LogSink::Block );
+    if ( !LogSink::start( fileName, false ) )
+    {
+        QVERIFY2( false, "Open test file failed" );
+        return;
+    }
+
+    // four producers at once
+    const int kMessages = 5000;
+    QList<int> producers;
+    producers << 0 << 1 << 2 << 3;
+    QtConcurrent::blockingMap( producers, [kMessages]( const int &producer )
+    {
+        QMessageLogContext context( __FILE__, __LINE__, Q_FUNC_INFO, "test" );
+        for ( int i = 0; i < kMessages; i++ )
+        {
+            LogSink::post( QtInfoMsg, context, QString( "producer %1 message %2" ).arg( producer ).arg( i ) );
+        }
+    } );
+    LogSink::flush();
+
+    QFile file( fileName );
+    ok = ok && file.open( QIODevice::ReadOnly | QIODevice::Text );
+    const QList<QByteArray> lines = file.readAll().split( '\n' );
+    file.close();
+    ok = ok && ( lines.size() == producers.size() * kMessages + 1 ) && lines.last().isEmpty();
+    ok = ok && lines.first().contains( " INF test: producer " ) && lines.first().endsWith( "<br />" );
+
+    LogSink::stop();
+    ok = ok && !LogSink::isRunning() && ( LogSink::dropped() == 0 );
+    file.remove();
+
+    QVERIFY2( ok, "Log writer is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Log writer is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase25
+ */
+void CryptoTest::testCase25()
+{
+    bool ok = true;
+
+    qDebug() << "Rotation of the log file";
+    const QString fileName = QDir::currentPath() + "/testfile.log";
+    for ( int i = 1; i <= 3; i++ )
+    {
+        QFile::remove( LogSink::archiveName( fileName, i ) );
+    }
+    const qint64 maxBytes = 4096;
+    LogSink::setRotation( maxBytes, 0, 2 );
+    if ( !LogSink::start( fileName, false ) )
+    {
+        QVERIFY2( false, "Open test file failed" );
+        return;
+    }
+
+    // every flush writes one batch of about 1 KB, the file is rotated several times
+    QMessageLogContext context( __FILE__, __LINE__, Q_FUNC_INFO, "test" );
+    for ( int batch = 0; batch < 20; batch++ )
+    {
+        for ( int i = 0; i < 10; i++ )
+        {
+            LogSink::post( QtInfoMsg, context, QString( "batch %1 message %2 " ).arg( batch ).arg( i ) + QString( 40, 'x' ) );
+        }
+        LogSink::flush();
+    }
+    LogSink::stop();
+    LogSink::setRotation( 0, 0, 0 );
+
+    ok = ok && QFile::exists( LogSink::archiveName( fileName, 1 ) ) && QFile::exists( LogSink::archiveName( fileName, 2 ) );
+    ok = ok && !QFile::exists( LogSink::archiveName( fileName, 3 ) );
+    ok = ok && ( QFileInfo( fileName ).size() <= maxBytes ) && ( QFileInfo( LogSink::archiveName( fileName, 1 ) ).size() <= maxBytes );
+
+    // the newest messages are in the log file, the older ones in the archives
+    QFile file( fileName );
+    ok = ok && file.open( QIODevice::ReadOnly | QIODevice::Text ) && file.readAll().contains( "batch 19 message 9 " );
+    file.close();
+    QFile archive( LogSink::archiveName( fileName, 1 ) );
+    ok = ok && archive.open( QIODevice::ReadOnly | QIODevice::Text ) && !archive.readAll().contains( "batch 19 " );
+    archive.close();
+
+    file.remove();
+    for ( int i = 1; i <= 2; i++ )
+    {
+        QFile::remove( LogSink::archiveName( fileName, i ) );
+    }
+
+    QVERIFY2( ok, "Rotation of the log file is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Rotation of the log file is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase26
+ */
+void CryptoTest::testCase26()
+{
+    bool ok = true;
+
+    qDebug() << "Verification against the manifest";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid() && QDir( tree.path() ).mkpath( "sub" );
+    const QDir dir( tree.path() );
+    QStringList names;
+    names << "a.bin" << "b.bin" << "sub/c.bin";
+    QList<QByteArray> contents;
+    for ( int i = 0; ok && i < names.size(); i++ )
+    {
+        contents.append( generateRandomData( qrand() % 100000 + 1 ) );
+        QFile member( dir.filePath( names.at( i ) ) );
+        ok = ok && member.open( QIODevice::WriteOnly ) && ( member.write( contents.last() ) == contents.last().size() );
+    }
+
+    // a.bin matches, b.bin does not, sub/c.bin has no digest, d.bin does not exist
+    QFile manifest( dir.filePath( TreeVerifier::kManifestName ) );
+    ok = ok && manifest.open( QIODevice::WriteOnly | QIODevice::Text );
+    // without a password the key of the digests is empty
+    manifest.write( QMessageAuthenticationCode::hash( contents.at( 0 ), QByteArray(), QCryptographicHash::Sha256 ).toHex() + "  a.bin\n" );
+    manifest.write( QMessageAuthenticationCode::hash( contents.at( 0 ), QByteArray(), QCryptographicHash::Sha256 ).toHex() + " *b.bin\n" );
+    manifest.write( QMessageAuthenticationCode::hash( QByteArray(), QByteArray(), QCryptographicHash::Sha256 ).toHex() + "  d.bin\n" );
+    manifest.write( "not a digest  e.bin\n" );
+    manifest.close();
+    ok = ok && ( TreeVerifier::readManifest( tree.path() ).size() == 3 );
+
+    QStringList files = TreeVerifier::collectFiles( QStringList( tree.path() ), true );
+    ok = ok && ( files.size() == names.size() );
+    ok = ok && ( TreeVerifier::collectFiles( QStringList( tree.path() ), false ).size() == 2 );
+    files.sort();
+    files.append( dir.filePath( "d.bin" ) );
+
+    // without a password the data is read as it is
+    TreeVerifier verifier( QByteArray(), QByteArray(), CryptFileDevice::AesCipher );
+    verifier.setChunkSize( 4096 );
+    const QList<VerifyResult> results = verifier.verify( files );
+    ok = ok && ( results.size() == 4 );
+    ok = ok && ( results.at( 0 ).status == VerifyResult::Ok ) && ( results.at( 0 ).size == contents.at( 0 ).size() );
+    ok = ok && ( results.at( 1 ).status == VerifyResult::Mismatch ) && ( results.at( 1 ).actual != results.at( 1 ).expected );
+    ok = ok && ( results.at( 2 ).status == VerifyResult::NoDigest );
+    ok = ok && ( results.at( 3 ).status == VerifyResult::Unreadable );
+
+    QVERIFY2( ok, "Verification is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Verification is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase27
+ */
+void CryptoTest::testCase27()
+{
+    bool ok = true;
+
+    qDebug() << "Updating the manifest";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QByteArray digestA = QCryptographicHash::hash( "a", QCryptographicHash::Sha256 ).toHex();
+    const QByteArray digestB = QCryptographicHash::hash( "b", QCryptographicHash::Sha256 ).toHex();
+    const QByteArray digestC = QCryptographicHash::hash( "c", QCryptographicHash::Sha256 ).toHex();
+
+    QHash<QString, QByteArray> update;
+    update.insert( "a.bin", digestA );
+    update.insert( "b.bin", digestB );
+    ok = ok && TreeVerifier::updateManifest( tree.path(), update );
+    ok = ok && ( TreeVerifier::readManifest( tree.path() ) == update );
+
+    // b.bin is replaced, a.bin is removed, c.bin is added
+    update.clear();
+    update.insert( "a.bin", QByteArray() );
+    update.insert( "b.bin", digestC );
+    update.insert( "c.bin", digestA );
+    ok = ok && TreeVerifier::updateManifest( tree.path(), update );
+    QHash<QString, QByteArray> manifest = TreeVerifier::readManifest( tree.path() );
+    ok = ok && ( manifest.size() == 2 ) && !manifest.contains( "a.bin" );
+    ok = ok && ( manifest.value( "b.bin" ) == digestC ) && ( manifest.value( "c.bin" ) == digestA );
+
+    // an empty manifest is removed
+    update.clear();
+    update.insert( "b.bin", QByteArray() );
+    update.insert( "c.bin", QByteArray() );
+    ok = ok && TreeVerifier::updateManifest( tree.path(), update );
+    ok = ok && !QFile::exists( QDir( tree.path() ).filePath( TreeVerifier::kManifestName ) );
+
+    QVERIFY2( ok, "Manifest is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Manifest is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase28
+ */
+void CryptoTest::testCase28()
+{
+    bool ok = true;
+
+    qDebug() << "Header of encrypted files";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QString name = QDir( tree.path() ).filePath( "a.bin" );
+    const QByteArray password( "01234567890123456789012345678901" );
+    const QByteArray salt( "0123456789012345" );
+    const QByteArray data = generateRandomData( 100000 );
+    {
+        CryptFileDevice writer( name, password, salt );
+        writer.setKeyLength( CryptFileDevice::AesKeyLength::kAesKeyLength128 );
+        writer.setNumRounds( 3 );
+        ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+        ok = ok && ( writer.write( data ) == data.size() );
+    }
+    ok = ok && ( QFileInfo( name ).size() == data.size() + CryptFileDevice::kHeaderLength );
+
+    // the parameters are taken from the header
+    {
+        CryptFileDevice reader( name, password, salt );
+        ok = ok && reader.open( QIODevice::ReadOnly ) && reader.isEncrypted();
+        ok = ok && ( reader.size() == data.size() ) && ( reader.readAll() == data );
+    }
+
+    // a wrong password is rejected by open()
+    {
+        CryptFileDevice reader( name, "98765432109876543210987654321098", salt );
+        ok = ok && !reader.open( QIODevice::ReadOnly ) && !reader.isOpen();
+    }
+
+    // the decrypted data is verified against the manifest, the digest is keyed by the password
+    QByteArray digestKey;
+    {
+        CryptFileDevice reader( name, password, salt );
+        ok = ok && reader.open( QIODevice::ReadOnly );
+        digestKey = reader.digestKey();
+    }
+    ok = ok && ( digestKey.size() == 32 );
+    QFile manifest( QDir( tree.path() ).filePath( TreeVerifier::kManifestName ) );
+    ok = ok && manifest.open( QIODevice::WriteOnly | QIODevice::Text );
+    manifest.write( QCryptographicHash::hash( data, QCryptographicHash::Sha256 ).toHex() + "  a.bin\n" );
+    manifest.close();
+    TreeVerifier verifier( password, salt, CryptFileDevice::AesCipher );
+    ok = ok && ( verifier.verify( QStringList( name ) ).value( 0 ).status == VerifyResult::Mismatch );
+    ok = ok && manifest.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text );
+    manifest.write( QMessageAuthenticationCode::hash( data, digestKey, QCryptographicHash::Sha256 ).toHex() + "  a.bin\n" );
+    manifest.close();
+    ok = ok && ( verifier.verify( QStringList( name ) ).value( 0 ).status == VerifyResult::Ok );
+    TreeVerifier wrong( "98765432109876543210987654321098", salt, CryptFileDevice::AesCipher );
+    ok = ok && ( wrong.verify( QStringList( name ) ).value( 0 ).status == VerifyResult::Unreadable );
+
+    // a damaged header is rejected
+    QFile raw( name );
+    ok = ok && raw.open( QIODevice::ReadWrite ) && raw.seek( 5 ) && raw.putChar( 0x7f );
+    raw.close();
+    {
+        CryptFileDevice reader( name, password, salt );
+        ok = ok && !reader.open( QIODevice::ReadOnly );
+    }
+
+    QVERIFY2( ok, "Header is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Header is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase29
+ */
+void CryptoTest::testCase29()
+{
+    bool ok = true;
+
+    qDebug() << "Key derivation functions";
+    ok = ok && ( CryptFileDevice::calibrate( CryptFileDevice::Pbkdf2Sha256, 20 ) >= 10000 );
+
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QString name = QDir( tree.path() ).filePath( "a.bin" );
+    const QByteArray password( "01234567890123456789012345678901" );
+    const QByteArray data = generateRandomData( 10000 );
+
+    QList<QPair<CryptFileDevice::KeyDerivation, int>> kdfs;
+    kdfs << qMakePair( CryptFileDevice::BytesToKey, 5 ) << qMakePair( CryptFileDevice::Pbkdf2Sha256, 1000 );
+    if ( CryptFileDevice::isKeyDerivationSupported( CryptFileDevice::Scrypt ) )
+    {
+        kdfs << qMakePair( CryptFileDevice::Scrypt, 10 );
+    }
+    for ( int i = 0; ok && i < kdfs.size(); i++ )
+    {
+        {
+            CryptFileDevice writer( name, password, "0123456789012345" );
+            writer.setKeyDerivation( kdfs.at( i ).first );
+            writer.setNumRounds( kdfs.at( i ).second );
+            ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+            ok = ok && ( writer.write( data ) == data.size() );
+        }
+
+        // the function, the cost and the salt are taken from the header
+        CryptFileDevice reader( name, password, "another salt" );
+        ok = ok && reader.open( QIODevice::ReadOnly ) && ( reader.readAll() == data );
+        ok = ok && ( reader.keyDerivation() == kdfs.at( i ).first ) && ( reader.numRounds() == kdfs.at( i ).second );
+    }
+
+    QVERIFY2( ok, "Key derivation is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Key derivation is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase30
+ */
+void CryptoTest::testCase30()
+{
+    bool ok = true;
+
+    qDebug() << "Key derived in advance";
+    const QString name = QDir::currentPath() + "/testfile.prepared";
+    const QByteArray password( "prepared0123456789" );
+    const QByteArray salt( "0123456789012345" );
+    const QByteArray data = generateRandomData( 1000 );
+    CryptFileDevice::clearKeyCache();
+    CryptFileDevice::setStatisticsEnabled( true );
+
+    QFuture<DerivedKey> future = QtConcurrent::run( []() -> DerivedKey
+    {
+        return CryptFileDevice::deriveKey( "prepared0123456789", "0123456789012345",
+                                           CryptFileDevice::Pbkdf2Sha256, 10000,
+                                           CryptFileDevice::AesKeyLength::kAesKeyLength256 );
+    } );
+    CryptFileDevice::cacheKey( future.result() );
+    ok = ok && !future.result().isNull();
+
+    CryptStatistics prepared;
+    {
+        CryptFileDevice writer( name, password, salt );
+        ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+        ok = ok && ( writer.write( data ) == data.size() );
+        prepared = writer.statistics();
+    }
+
+    // without the cache the key is derived again, and it is the same key
+    CryptFileDevice::clearKeyCache();
+    CryptStatistics derived;
+    {
+        CryptFileDevice reader( name, password, salt );
+        ok = ok && reader.open( QIODevice::ReadOnly ) && ( reader.readAll() == data );
+        derived = reader.statistics();
+    }
+    CryptFileDevice::setStatisticsEnabled( false );
+    QFile::remove( name );
+
+    ok = ok && ( prepared.keyDerivations == 0 ) && ( derived.keyDerivations == 1 );
+
+    QVERIFY2( ok, "Prepared key is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Prepared key is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase31
+ */
+void CryptoTest::testCase31()
+{
+    bool ok = true;
+
+    qDebug() << "Master key and keys of the files";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QByteArray password( "master0123456789" );
+    const QByteArray salt = CryptFileDevice::randomSalt();
+    const QByteArray data = generateRandomData( 5000 );
+    ok = ok && ( salt.size() == 16 );
+    CryptFileDevice::clearKeyCache();
+    CryptFileDevice::setStatisticsEnabled( true );
+
+    QStringList names;
+    CryptFileDevice writer( QDir( tree.path() ).filePath( "0.bin" ), password, salt );
+    for ( int i = 0; ok && i < 3; i++ )
+    {
+        names.append( QDir( tree.path() ).filePath( QString::number( i ) + ".bin" ) );
+        ok = ok && writer.reset( names.last() );
+        ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+        ok = ok && ( writer.write( data ) == data.size() );
+        writer.close();
+    }
+
+    // the master key is derived once, the other devices take it from the cache
+    QList<QByteArray> cipherTexts;
+    quint64 readerDerivations = 0;
+    foreach ( const QString &name, names )
+    {
+        CryptFileDevice reader( name, password, QByteArray() );
+        ok = ok && reader.open( QIODevice::ReadOnly ) && ( reader.readAll() == data );
+        readerDerivations += reader.statistics().keyDerivations;
+        reader.close();
+
+        QFile file( name );
+        ok = ok && file.open( QIODevice::ReadOnly );
+        cipherTexts.append( file.readAll().mid( CryptFileDevice::kHeaderLength ) );
+    }
+    CryptFileDevice::setStatisticsEnabled( false );
+
+    ok = ok && ( writer.statistics().keyDerivations == 1 ) && ( readerDerivations == 0 );
+    ok = ok && ( cipherTexts.size() == 3 ) && ( cipherTexts.toSet().size() == 3 );
+
+    // the key stream of XorCipher is derived from the key of the file as well
+    QList<QByteArray> xorTexts;
+    writer.setEncryptionMethod( CryptFileDevice::XorCipher );
+    for ( int i = 0; ok && i < 2; i++ )
+    {
+        const QString name = QDir( tree.path() ).filePath( QString( "xor%1.bin" ).arg( i ) );
+        ok = ok && writer.reset( name );
+        ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+        ok = ok && ( writer.write( data ) == data.size() );
+        writer.close();
+
+        CryptFileDevice reader( name, password, QByteArray() );
+        ok = ok && reader.open( QIODevice::ReadOnly ) && ( reader.encryptionMethod() == CryptFileDevice::XorCipher );
+        ok = ok && ( reader.readAll() == data );
+        reader.close();
+
+        QFile file( name );
+        ok = ok && file.open( QIODevice::ReadOnly );
+        xorTexts.append( file.readAll().mid( CryptFileDevice::kHeaderLength ) );
+    }
+    ok = ok && ( xorTexts.size() == 2 ) && ( xorTexts.at( 0 ).size() == data.size() ) && ( xorTexts.at( 0 ) != xorTexts.at( 1 ) );
+
+    QVERIFY2( ok, "Keys of the files are wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Keys of the files are wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase32
+ */
+void CryptoTest::testCase32()
+{
+    bool ok = true;
+
+    qDebug() << "Authenticated chunks";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QString name = QDir( tree.path() ).filePath( "gcm.bin" );
+    const QString emptyName = QDir( tree.path() ).filePath( "empty.bin" );
+    const QByteArray password( "gcm0123456789" );
+    const int chunk = 64 * 1024;
+    const int tag = 16;
+    const QByteArray data = generateRandomData( 3 * chunk + 1000 );
+
+    // small writes, a write of several chunks and the rest
+    CryptFileDevice writer( name, password, QByteArray( "salt" ) );
+    writer.setEncryptionMethod( CryptFileDevice::AesGcmCipher );
+    ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+    ok = ok && writer.isAuthenticated();
+    ok = ok && ( writer.write( data.left( 100 ) ) == 100 );
+    ok = ok && ( writer.write( data.mid( 100, 2 * chunk ) ) == 2 * chunk );
+    ok = ok && ( writer.write( data.mid( 100 + 2 * chunk ) ) == data.size() - 100 - 2 * chunk );
+    ok = ok && !writer.seek( 10 );
+    // the trailer is written once, close() does not repeat it
+    ok = ok && writer.finish() && writer.finish();
+    writer.close();
+    ok = ok && writer.finish();
+    ok = ok && ( QFileInfo( name ).size() == CryptFileDevice::kHeaderLength + data.size() + 4 * tag + 24 );
+    ok = ok && writer.reset( emptyName ) && writer.open( QIODevice::WriteOnly | QIODevice::Truncate );
+    writer.close();
+
+    // the method is taken from the header
+    CryptFileDevice reader( name, password, QByteArray() );
+    reader.setEncryptionMethod( CryptFileDevice::AesCipher );
+    ok = ok && reader.open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+    ok = ok && reader.isAuthenticated() && ( reader.size() == data.size() ) && reader.verify();
+    ok = ok && ( reader.readAll() == data );
+    ok = ok && reader.seek( chunk - 10 ) && ( reader.read( 20 ) == data.mid( chunk - 10, 20 ) );
+    reader.close();
+    ok = ok && reader.reset( emptyName ) && reader.open( QIODevice::ReadOnly );
+    ok = ok && reader.isAuthenticated() && ( reader.size() == 0 ) && reader.readAll().isEmpty() && reader.verify();
+    reader.close();
+
+    // an authenticated file is not modified in place
+    ok = ok && reader.reset( name ) && !reader.open( QIODevice::ReadWrite );
+
+    // a damaged chunk only fails the reads which touch it
+    QFile file( name );
+    const qint64 damaged = CryptFileDevice::kHeaderLength + 2 * ( chunk + tag ) + 5;
+    ok = ok && file.open( QIODevice::ReadWrite ) && file.seek( damaged );
+    const QByteArray byte = file.read( 1 );
+    ok = ok && ( byte.size() == 1 ) && file.seek( damaged ) && ( file.write( QByteArray( 1, byte.at( 0 ) ^ 0x01 ) ) == 1 );
+    file.close();
+    ok = ok && reader.open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+    ok = ok && ( reader.read( 2 * chunk ) == data.left( 2 * chunk ) );
+    ok = ok && reader.seek( 3 * chunk ) && ( reader.read( 1000 ) == data.mid( 3 * chunk ) );
+    ok = ok && reader.seek( 2 * chunk ) && reader.read( 10 ).isEmpty();
+    ok = ok && !reader.verify();
+    reader.close();
+
+    // without a digest, the tags are verified
+    TreeVerifier verifier( password, QByteArray(), CryptFileDevice::AesCipher );
+    const QList<VerifyResult> results = verifier.verify( QStringList() << name << emptyName );
+    ok = ok && ( results.size() == 2 );
+    ok = ok && ( results.value( 0 ).status == VerifyResult::Unreadable );
+    ok = ok && ( results.value( 1 ).status == VerifyResult::Ok );
+
+    // a truncated file is rejected by open()
+    ok = ok && file.resize( CryptFileDevice::kHeaderLength + 3 * ( chunk + tag ) );
+    ok = ok && !reader.open( QIODevice::ReadOnly );
+
+    QVERIFY2( ok, "Authenticated chunks are wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Authenticated chunks are wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase33
+ */
+void CryptoTest::testCase33()
+{
+    bool ok = true;
+
+    qDebug() << "Footer index of the compressed stream";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    QByteArray data;
+    while ( data.size() < 300 * 1024 )
+    {
+        data += "offset;" + QByteArray::number( qrand() % 100000 ) + ";" + generateRandomData( 8 ).toHex() + "\n";
+    }
+
+    // an authenticated file, the frames are found with the index
+    CryptFileDevice device( QDir( tree.path() ).filePath( "indexed.bin" ), "index0123456789", QByteArray( "salt" ) );
+    device.setEncryptionMethod( CryptFileDevice::AesGcmCipher );
+    CompressionDevice writer( &device );
+    writer.setFrameSize( 4096 );
+    ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate );
+    ok = ok && ( writer.write( data ) == data.size() );
+    writer.close();
+
+    CryptFileDevice::setStatisticsEnabled( true );
+    device.resetStatistics();
+    CompressionDevice reader( &device );
+    ok = ok && reader.open( QIODevice::ReadOnly ) && reader.isIndexed();
+    ok = ok && ( reader.size() == data.size() );
+    const quint64 indexReads = device.statistics().readCalls;
+    ok = ok && ( indexReads < 10 ) && ( data.size() / 4096 > 50 );
+    for ( int i = 0; ok && i < 50; i++ )
+    {
+        const qint64 pos = qrand() % data.size();
+        const qint64 maxlen = qrand() % 20000;
+        ok = ok && reader.seek( pos ) && ( reader.read( maxlen ) == data.mid( pos, maxlen ) );
+    }
+    reader.close();
+    CryptFileDevice::setStatisticsEnabled( false );
+
+    // a stream without an index and a stream with a damaged index are scanned
+    QFile plain( QDir( tree.path() ).filePath( "plain.bin" ) );
+    for ( int indexed = 0; indexed < 2; indexed++ )
+    {
+        CompressionDevice plainWriter( &plain );
+        plainWriter.setFrameSize( 4096 );
+        plainWriter.setIndexed( indexed != 0 );
+        ok = ok && plainWriter.open( QIODevice::WriteOnly | QIODevice::Truncate );
+        ok = ok && ( plainWriter.write( data ) == data.size() );
+        plainWriter.close();
+        if ( indexed != 0 )
+        {
+            ok = ok && plain.open( QIODevice::ReadWrite ) && plain.seek( plain.size() - 1 ) && ( plain.write( "?" ) == 1 );
+            plain.close();
+        }
+
+        CompressionDevice plainReader( &plain );
+        ok = ok && plainReader.open( QIODevice::ReadOnly ) && ( plainReader.isIndexed() == ( indexed != 0 ) );
+        ok = ok && ( plainReader.size() == data.size() ) && plainReader.seek( 1000 );
+        ok = ok && ( plainReader.read( 5000 ) == data.mid( 1000, 5000 ) );
+        plainReader.close();
+    }
+
+    QVERIFY2( ok, "Index of the compressed stream is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Index of the compressed stream is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase34
+ */
+void CryptoTest::testCase34()
+{
+    if ( !CryptFileDevice::isMethodSupported( CryptFileDevice::ChaCha20Cipher ) )
+    {
+        QSKIP( "ChaCha20 needs OpenSSL 1.1.0 or newer" );
+    }
+    bool ok = true;
+
+    qDebug() << "ChaCha20 key stream";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QString name = QDir( tree.path() ).filePath( "chacha.bin" );
+    const QString aesName = QDir( tree.path() ).filePath( "aes.bin" );
+    const QByteArray password( "chacha0123456789" );
+    const QByteArray data = generateRandomData( 200 * 1000 + 37 );
+
+    // a 128-bit master key still gives a 256-bit key of the file
+    CryptFileDevice writer( name, password, QByteArray( "salt" ) );
+    writer.setKeyLength( CryptFileDevice::AesKeyLength::kAesKeyLength128 );
+    writer.setEncryptionMethod( CryptFileDevice::ChaCha20Cipher );
+    ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+    ok = ok && ( writer.write( data.left( 99 ) ) == 99 );
+    ok = ok && ( writer.write( data.mid( 99 ) ) == data.size() - 99 );
+    writer.close();
+    ok = ok && ( QFileInfo( name ).size() == CryptFileDevice::kHeaderLength + data.size() );
+    writer.setEncryptionMethod( CryptFileDevice::AesCipher );
+    ok = ok && writer.reset( aesName ) && writer.open( QIODevice::WriteOnly | QIODevice::Truncate );
+    ok = ok && ( writer.write( data ) == data.size() );
+    writer.close();
+
+    QFile chachaFile( name );
+    QFile aesFile( aesName );
+    ok = ok && chachaFile.open( QIODevice::ReadOnly ) && aesFile.open( QIODevice::ReadOnly );
+    const QByteArray cipherText = chachaFile.readAll().mid( CryptFileDevice::kHeaderLength );
+    ok = ok && ( cipherText != data.left( cipherText.size() ) );
+    ok = ok && ( cipherText != aesFile.readAll().mid( CryptFileDevice::kHeaderLength ) );
+    chachaFile.close();
+    aesFile.close();
+
+    // the method is taken from the header, every position decrypts on its own
+    CryptFileDevice reader( name, password, QByteArray() );
+    reader.setEncryptionMethod( CryptFileDevice::AesCipher );
+    ok = ok && reader.open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+    ok = ok && ( reader.readAll() == data );
+    for ( int i = 0; i < 50 && ok; i++ )
+    {
+        const qint64 position = qrand() % data.size();
+        const int length = qrand() % 300;
+        ok = reader.seek( position ) && ( reader.read( length ) == data.mid( position, length ) );
+    }
+    reader.close();
+
+    // writes in the middle of the file
+    QByteArray expected = data;
+    expected.replace( 1000, 70, QByteArray( 70, 'x' ) );
+    ok = ok && reader.open( QIODevice::ReadWrite | QIODevice::Unbuffered );
+    ok = ok && reader.seek( 1000 ) && ( reader.write( QByteArray( 70, 'x' ) ) == 70 );
+    ok = ok && reader.seek( 0 ) && ( reader.readAll() == expected );
+
+    // the 32-bit block counter must not wrap: the key stream ends after 2^32 blocks of 64 bytes
+    const qint64 streamEnd = Q_INT64_C( 0x100000000 ) * 64;
+    unsigned char text[128] = {};
+    ok = ok && reader.transformAt( streamEnd - 128, text, text, 128 );
+    ok = ok && !reader.transformAt( streamEnd - 64, text, text, 128 );
+    ok = ok && !reader.transformAt( streamEnd, text, text, 1 );
+    reader.close();
+
+    QVERIFY2( ok, "ChaCha20 key stream is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "ChaCha20 key stream is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase35
+ */
+void CryptoTest::testCase35()
+{
+    bool ok = true;
+
+    qDebug() << "Cipher backends" << CpuFeatures::names( CpuFeatures::detect() );
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QByteArray password( "backend0123456789" );
+    const QByteArray data = generateRandomData( 100 * 1000 + 11 );
+    const CryptFileDevice::Backend saved = CryptFileDevice::backend( CryptFileDevice::AesCipher );
+
+    // only the supported backends are selected
+    ok = ok && !CryptFileDevice::setBackend( CryptFileDevice::XorCipher, CryptFileDevice::EvpBackend );
+    ok = ok && !CryptFileDevice::setBackend( CryptFileDevice::AesGcmCipher, CryptFileDevice::PortableBackend );
+    ok = ok && ( CryptFileDevice::backend( CryptFileDevice::XorCipher ) == CryptFileDevice::PortableBackend );
+    ok = ok && ( CryptFileDevice::benchmark( CryptFileDevice::XorCipher, CryptFileDevice::EvpBackend, 4096 ) == 0.0 );
+
+    // both AES backends give the same key stream, at every position
+    for ( int b = CryptFileDevice::PortableBackend; b <= CryptFileDevice::EvpBackend; b++ )
+    {
+        const CryptFileDevice::Backend backend = static_cast<CryptFileDevice::Backend>( b );
+        const QString name = QDir( tree.path() ).filePath( CryptFileDevice::backendName( backend ) );
+        ok = ok && CryptFileDevice::setBackend( CryptFileDevice::AesCipher, backend );
+        ok = ok && ( CryptFileDevice::benchmark( CryptFileDevice::AesCipher, backend, 64 * 1024 ) > 0.0 );
+
+        CryptFileDevice device( name, password, QByteArray( "salt" ) );
+        device.setEncryptionMethod( CryptFileDevice::AesCipher );
+        ok = ok && device.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+        ok = ok && ( device.write( data.left( 17 ) ) == 17 ) && ( device.write( data.mid( 17 ) ) == data.size() - 17 );
+        device.close();
+        ok = ok && device.open( QIODevice::ReadWrite | QIODevice::Unbuffered );
+        ok = ok && device.seek( 5003 ) && ( device.read( 100 ) == data.mid( 5003, 100 ) );
+        ok = ok && device.seek( 777 ) && ( device.write( data.mid( 777, 50 ) ) == 50 );
+        device.close();
+
+        // the file is decrypted with the other backend
+        CryptFileDevice::setBackend( CryptFileDevice::AesCipher,
+                                     ( backend == CryptFileDevice::EvpBackend ) ? CryptFileDevice::PortableBackend
+                                                                                : CryptFileDevice::EvpBackend );
+        ok = ok && device.open( QIODevice::ReadOnly | QIODevice::Unbuffered ) && ( device.readAll() == data );
+        device.close();
+    }
+    CryptFileDevice::setBackend( CryptFileDevice::AesCipher, saved );
+
+    // every supported method is measured
+    const QList<BackendProbe::Result> results = BackendProbe::measure( 64 * 1024 );
+    ok = ok && ( results.size() >= 4 );
+    foreach ( const BackendProbe::Result &result, results )
+    {
+        ok = ok && ( result.megabytesPerSec > 0.0 );
+    }
+    ok = ok && !BackendProbe::signature().isEmpty();
+
+    QVERIFY2( ok, "Cipher backends are wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Cipher backends are wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase36
+ */
+void CryptoTest::testCase36()
+{
+    bool ok = true;
+
+    qDebug() << "XOR key stream at every position";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QString name = QDir( tree.path() ).filePath( "xor.bin" );
+    const QByteArray password( "xor0123456789" );
+    const QByteArray data = generateRandomData( 3 * 16064 + 501 );
+
+    // written in pieces, which do not start at a multiple of the period
+    CryptFileDevice writer( name, password, QByteArray( "salt" ) );
+    writer.setEncryptionMethod( CryptFileDevice::XorCipher );
+    ok = ok && writer.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered );
+    for ( int offset = 0; offset < data.size(); offset += 7777 )
+    {
+        ok = ok && ( writer.write( data.mid( offset, 7777 ) ) == data.mid( offset, 7777 ).size() );
+    }
+    writer.close();
+
+    // the key stream of the byte at the position i is hash[i % 64] ^ ( i % 251 ),
+    // the hash is taken from the key of the file, not from the password
+    QFile file( name );
+    ok = ok && file.open( QIODevice::ReadOnly );
+    const QByteArray cipherText = file.readAll().mid( CryptFileDevice::kHeaderLength );
+    file.close();
+    ok = ok && ( cipherText.size() == data.size() );
+    const QByteArray keyStream = calculateXor( cipherText, data );
+    for ( int i = 0; i < keyStream.size() && ok; i++ )
+    {
+        ok = ( static_cast<char>( keyStream.at( i ) ^ ( i % 251 ) ) == static_cast<char>( keyStream.at( i % 64 ) ^ ( i % 64 ) ) );
+    }
+    QByteArray fileHash = keyStream.left( 64 );
+    for ( int i = 0; i < fileHash.size(); i++ )
+    {
+        fileHash[i] = static_cast<char>( fileHash.at( i ) ^ i );
+    }
+    ok = ok && ( fileHash.size() == 64 )
+         && ( fileHash != QCryptographicHash::hash( password, QCryptographicHash::Sha3_512 ) );
+
+    // decrypted with the method of the header, at random positions
+    CryptFileDevice reader( name, password, QByteArray() );
+    reader.setEncryptionMethod( CryptFileDevice::AesCipher );
+    ok = ok && reader.open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+    ok = ok && ( reader.readAll() == data );
+    for ( int i = 0; i < 50 && ok; i++ )
+    {
+        const qint64 position = qrand() % data.size();
+        const int length = qrand() % 20000;
+        ok = reader.seek( position ) && ( reader.read( length ) == data.mid( position, length ) );
+    }
+    reader.close();
+
+    QVERIFY2( ok, "XOR key stream is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "XOR key stream is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase37
+ */
+void CryptoTest::testCase37()
+{
+    bool ok = true;
+
+    qDebug() << "Positional reads and writes from several threads";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QByteArray password( "positional0123456789" );
+    const QByteArray data = generateRandomData( 300 * 1000 + 123 );
+    QList<int> tasks;
+    for ( int i = 0; i < 64; i++ )
+    {
+        tasks.append( i );
+    }
+
+    QList<CryptFileDevice::EncryptionMethod> methods;
+    methods << CryptFileDevice::XorCipher << CryptFileDevice::AesCipher << CryptFileDevice::AesGcmCipher;
+    if ( CryptFileDevice::isMethodSupported( CryptFileDevice::ChaCha20Cipher ) )
+    {
+        methods << CryptFileDevice::ChaCha20Cipher;
+    }
+    foreach ( const CryptFileDevice::EncryptionMethod method, methods )
+    {
+        const QString name = QDir( tree.path() ).filePath( QString( "file%1.bin" ).arg( method ) );
+        CryptFileDevice device( name, password, QByteArray( "salt" ) );
+        device.setEncryptionMethod( method );
+        ok = ok && device.open( QIODevice::WriteOnly | QIODevice::Truncate );
+        ok = ok && ( device.write( data ) == data.size() );
+        device.close();
+
+        // every task reads its own range, the position of the device is not used
+        QAtomicInt failures( 0 );
+        ok = ok && device.open( QIODevice::ReadOnly ) && device.seek( 10 );
+        QtConcurrent::blockingMap( tasks, [&device, &data, &failures]( const int &task )
+        {
+            const qint64 offset = ( task * Q_INT64_C( 7919 ) * 13 ) % data.size();
+            const qint64 length = ( task * 631 ) % 70000;
+            QByteArray buffer( static_cast<int>( length ), '\0' );
+            const qint64 read = device.readAt( offset, buffer.data(), length );
+            if ( read != qMin( length, data.size() - offset ) || buffer.left( static_cast<int>( read ) ) != data.mid( offset, length ) )
+            {
+                failures.ref();
+            }
+        } );
+        ok = ok && ( failures.load() == 0 ) && ( device.pos() == 10 ) && ( device.read( 5 ) == data.mid( 10, 5 ) );
+        char byte = 0;
+        ok = ok && ( device.readAt( data.size(), &byte, 1 ) == 0 ) && ( device.writeAt( 0, &byte, 1 ) == -1 );
+        device.close();
+        if ( method == CryptFileDevice::AesGcmCipher )
+        {
+            continue;
+        }
+
+        // disjoint ranges are written at once
+        QByteArray expected = data;
+        ok = ok && device.open( QIODevice::ReadWrite );
+        QtConcurrent::blockingMap( tasks, [&device, &failures]( const int &task )
+        {
+            const QByteArray block( 1000, static_cast<char>( 'A' + task % 26 ) );
+            if ( device.writeAt( task * Q_INT64_C( 3000 ) + 7, block.constData(), block.size() ) != block.size() )
+            {
+                failures.ref();
+            }
+        } );
+        for ( int task = 0; task < tasks.size(); task++ )
+        {
+            expected.replace( task * 3000 + 7, 1000, QByteArray( 1000, static_cast<char>( 'A' + task % 26 ) ) );
+        }
+        device.close();
+        ok = ok && ( failures.load() == 0 );
+        ok = ok && device.open( QIODevice::ReadOnly ) && ( device.readAll() == expected );
+        device.close();
+    }
+
+    QVERIFY2( ok, "Positional I/O is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Positional I/O is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase38
+ */
+void CryptoTest::testCase38()
+{
+    bool ok = true;
+
+    qDebug() << "Rekeying of files with a new password";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid() && QDir( tree.path() ).mkpath( "sub" );
+    const QDir dir( tree.path() );
+    const QByteArray oldPassword( "old password 0123" );
+    const QByteArray newPassword( "new password 4567" );
+
+    QList<CryptFileDevice::EncryptionMethod> methods;
+    methods << CryptFileDevice::XorCipher << CryptFileDevice::AesCipher << CryptFileDevice::AesGcmCipher;
+    if ( CryptFileDevice::isMethodSupported( CryptFileDevice::ChaCha20Cipher ) )
+    {
+        methods << CryptFileDevice::ChaCha20Cipher;
+    }
+    QStringList names;
+    QList<QByteArray> contents;
+    for ( int i = 0; ok && i < methods.size(); i++ )
+    {
+        names.append( QString( "sub/file%1.bin" ).arg( i ) );
+        contents.append( generateRandomData( 200 * 1000 + qrand() % 100000 ) );
+        CryptFileDevice device( dir.filePath( names.last() ), oldPassword, QByteArray( "salt" ) );
+        device.setEncryptionMethod( methods.at( i ) );
+        ok = ok && device.open( QIODevice::WriteOnly | QIODevice::Truncate );
+        ok = ok && ( device.write( contents.last() ) == contents.last().size() );
+        device.close();
+    }
+    QFile empty( dir.filePath( "empty.bin" ) );
+    ok = ok && empty.open( QIODevice::WriteOnly );
+    empty.close();
+
+    // a journal, which was interrupted before the first step, does not change the file
+    QFile journal( dir.filePath( names.at( 1 ) + Rekeyer::kJournalSuffix ) );
+    ok = ok && journal.open( QIODevice::WriteOnly ) && ( journal.write( QByteArray( 100, 'x' ) ) == 100 );
+    journal.close();
+
+    Rekeyer rekeyer( oldPassword, newPassword, QByteArray( "salt" ) );
+    rekeyer.setStepSize( 64 * 1024 );
+    const QStringList files = Rekeyer::collectFiles( QStringList() << tree.path(), true );
+    ok = ok && ( files.size() == names.size() + 1 );
+    foreach ( const RekeyResult &result, rekeyer.rekey( files ) )
+    {
+        const bool isEmpty = result.fileName.endsWith( "empty.bin" );
+        ok = ok && ( result.status == ( isEmpty ? RekeyResult::Skipped : RekeyResult::Ok ) );
+    }
+
+    for ( int i = 0; i < names.size(); i++ )
+    {
+        CryptFileDevice oldDevice( dir.filePath( names.at( i ) ), oldPassword, QByteArray( "salt" ) );
+        ok = ok && !oldDevice.open( QIODevice::ReadOnly );
+        CryptFileDevice newDevice( dir.filePath( names.at( i ) ), newPassword, QByteArray( "salt" ) );
+        ok = ok && newDevice.open( QIODevice::ReadOnly ) && ( newDevice.encryptionMethod() == methods.at( i ) );
+        ok = ok && ( newDevice.readAll() == contents.at( i ) );
+        newDevice.close();
+    }
+    ok = ok && ( dir.entryList( QStringList() << "*.rekey*", QDir::Files ).isEmpty() );
+    ok = ok && ( QDir( dir.filePath( "sub" ) ).entryList( QStringList() << "*.rekey*", QDir::Files ).isEmpty() );
+
+    // an authenticated file, which was written again but not yet renamed, is replaced by the next run
+    const QString name = dir.filePath( names.at( 2 ) );
+    ok = ok && QFile::copy( name, name + ".tmp" );
+    Rekeyer back( newPassword, oldPassword, QByteArray( "salt" ) );
+    ok = ok && ( back.rekeyFile( name ).status == RekeyResult::Ok );
+    ok = ok && QFile::rename( name + ".tmp", name + Rekeyer::kReplacementSuffix );
+    {
+        // the file is on the old password again, the new file on the new password
+        const RekeyResult result = rekeyer.rekeyFile( name );
+        ok = ok && ( result.status == RekeyResult::Ok ) && result.resumed && !QFile::exists( name + Rekeyer::kReplacementSuffix );
+        CryptFileDevice device( name, newPassword, QByteArray( "salt" ) );
+        ok = ok && device.open( QIODevice::ReadOnly ) && ( device.readAll() == contents.at( 2 ) );
+    }
+
+    QVERIFY2( ok, "Rekeying is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Rekeying is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase39
+ */
+void CryptoTest::testCase39()
+{
+    bool ok = true;
+
+    qDebug() << "Decryption of the jobs and of files of version 1.0";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QDir dir( tree.path() );
+    const QByteArray password( "job password 0123" );
+    // the salt of the program (MainWindow::salt), the jobs encrypt with a random salt
+    const QByteArray salt( "12:34:56" );
+    const QByteArray data = generateRandomData( 100 * 1000 + qrand() % 1000 );
+
+    // the devices of a job: new files are encrypted with the salt of the job,
+    // the device, which reads, has the salt of the program
+    CryptFileDevice decryptor;
+    decryptor.setPassword( password );
+    decryptor.setSalt( salt );
+    decryptor.setEncryptionMethod( CryptFileDevice::AesCipher );
+    QList<CryptFileDevice::EncryptionMethod> methods;
+    methods << CryptFileDevice::XorCipher << CryptFileDevice::AesCipher << CryptFileDevice::AesGcmCipher;
+    if ( CryptFileDevice::isMethodSupported( CryptFileDevice::ChaCha20Cipher ) )
+    {
+        methods << CryptFileDevice::ChaCha20Cipher;
+    }
+    foreach ( const CryptFileDevice::EncryptionMethod method, methods )
+    {
+        const QString name = dir.filePath( QString( "job%1.bin" ).arg( method ) );
+        CryptFileDevice encryptor;
+        encryptor.setPassword( password );
+        encryptor.setSalt( CryptFileDevice::randomSalt() );
+        encryptor.setEncryptionMethod( method );
+        encryptor.setNumRounds( 1000 );
+        encryptor.setFileName( name );
+        ok = ok && encryptor.open( QIODevice::WriteOnly | QIODevice::Truncate );
+        ok = ok && ( encryptor.write( data ) == data.size() );
+        encryptor.close();
+
+        // an encrypted file is decrypted, not encrypted again
+        ok = ok && ( JobInput::classify( &decryptor, name ) == JobInput::EncryptedData );
+        ok = ok && ( decryptor.readAll() == data );
+        decryptor.close();
+
+        // a compressed stream
+        encryptor.setFileName( name );
+        CompressionDevice compression( &encryptor );
+        ok = ok && encryptor.open( QIODevice::WriteOnly | QIODevice::Truncate )
+             && compression.open( QIODevice::WriteOnly ) && ( compression.write( data ) == data.size() );
+        compression.close();
+        encryptor.close();
+        ok = ok && ( JobInput::classify( &decryptor, name ) == JobInput::CompressedData );
+        decryptor.close();
+    }
+
+    // plain and empty files are encrypted
+    QFile plain( dir.filePath( "plain.bin" ) );
+    ok = ok && plain.open( QIODevice::WriteOnly ) && ( plain.write( data ) == data.size() );
+    plain.close();
+    QFile empty( dir.filePath( "empty.bin" ) );
+    ok = ok && empty.open( QIODevice::WriteOnly );
+    empty.close();
+    ok = ok && ( JobInput::classify( &decryptor, plain.fileName() ) == JobInput::PlainData ) && !decryptor.isOpen();
+    ok = ok && ( JobInput::classify( &decryptor, empty.fileName() ) == JobInput::PlainData ) && !decryptor.isOpen();
+    CryptFileDevice other;
+    other.setPassword( "another password" );
+    other.setSalt( salt );
+    // a file of another password is neither decrypted nor encrypted again
+    ok = ok && ( JobInput::classify( &other, dir.filePath( "job1.bin" ) ) == JobInput::WrongPassword );
+    ok = ok && other.passwordRejected() && !other.isOpen();
+    ok = ok && ( JobInput::classify( &other, plain.fileName() ) == JobInput::PlainData ) && !other.passwordRejected();
+
+    // version 1.0: AES-CTR without a header, the key of EVP_BytesToKey (5 rounds), the counter in the last 8 bytes of the IV
+    unsigned char key[32];
+    unsigned char iv[16];
+    ok = ok && ( EVP_BytesToKey( EVP_aes_256_ctr(), EVP_sha256(), reinterpret_cast<const unsigned char *>( salt.constData() ),
+                                 reinterpret_cast<const unsigned char *>( password.constData() ), password.size(),
+                                 5, key, iv ) == 32 );
+    memset( iv + 8, 0, 8 );
+    QByteArray legacyAes( data.size(), '\0' );
+    int length = 0;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    ok = ok && ( ctx != nullptr ) && ( EVP_EncryptInit_ex( ctx, EVP_aes_256_ctr(), nullptr, key, iv ) == 1 )
+         && ( EVP_EncryptUpdate( ctx, reinterpret_cast<unsigned char *>( legacyAes.data() ), &length,
+                                 reinterpret_cast<const unsigned char *>( data.constData() ), data.size() ) == 1 )
+         && ( length == data.size() );
+    EVP_CIPHER_CTX_free( ctx );
+    // version 1.0: XOR, the key stream restarts with every buffer
+    const int buffer = 40000;
+    const QByteArray hash = QCryptographicHash::hash( password, QCryptographicHash::Sha3_512 );
+    QByteArray legacyXor( data.size(), '\0' );
+    for ( int i = 0; i < data.size(); i++ )
+    {
+        legacyXor[i] = static_cast<char>( data.at( i ) ^ hash.at( ( i % buffer ) % 64 ) ^ ( ( i % buffer ) % 251 ) );
+    }
+
+    const QString aesName = dir.filePath( "legacy/aes.bin" );
+    const QString xorName = dir.filePath( "legacy/xor.bin" );
+    ok = ok && dir.mkpath( "legacy" );
+    QFile legacy( aesName );
+    ok = ok && legacy.open( QIODevice::WriteOnly ) && ( legacy.write( legacyAes ) == data.size() );
+    legacy.close();
+    legacy.setFileName( xorName );
+    ok = ok && legacy.open( QIODevice::WriteOnly ) && ( legacy.write( legacyXor ) == data.size() );
+    legacy.close();
+
+    // they look like plain data, they are read only in the format of version 1.0
+    ok = ok && ( JobInput::classify( &decryptor, aesName ) == JobInput::PlainData );
+    CryptFileDevice reader( aesName, password, salt );
+    reader.setEncryptionMethod( CryptFileDevice::AesCipher );
+    reader.setLegacyFormat( true );
+    ok = ok && !reader.open( QIODevice::ReadWrite );
+    ok = ok && reader.open( QIODevice::ReadOnly ) && ( reader.size() == data.size() ) && ( reader.readAll() == data );
+    ok = ok && reader.seek( 777 ) && ( reader.read( 1000 ) == data.mid( 777, 1000 ) );
+    reader.close();
+    ok = ok && reader.reset( xorName );
+    reader.setEncryptionMethod( CryptFileDevice::XorCipher );
+    reader.setLegacyChunkSize( buffer );
+    ok = ok && reader.open( QIODevice::ReadOnly ) && ( reader.readAll() == data );
+    ok = ok && reader.seek( buffer - 10 ) && ( reader.read( 100 ) == data.mid( buffer - 10, 100 ) );
+    reader.close();
+
+    // the migration gives them a header, the jobs decrypt them afterwards; a second run skips them
+    Rekeyer aesMigration( password, password, salt );
+    aesMigration.setLegacyFormat( CryptFileDevice::AesCipher, CryptFileDevice::kLegacyChunkSize );
+    ok = ok && ( aesMigration.rekeyFile( aesName ).status == RekeyResult::Ok );
+    ok = ok && ( aesMigration.rekeyFile( aesName ).status == RekeyResult::Skipped );
+    Rekeyer xorMigration( password, password, salt );
+    xorMigration.setLegacyFormat( CryptFileDevice::XorCipher, buffer );
+    ok = ok && ( xorMigration.rekeyFile( xorName ).status == RekeyResult::Ok );
+    foreach ( const QString &name, QStringList() << aesName << xorName )
+    {
+        ok = ok && ( JobInput::classify( &decryptor, name ) == JobInput::EncryptedData );
+        ok = ok && ( decryptor.readAll() == data );
+        decryptor.close();
+    }
+
+    QVERIFY2( ok, "Decryption of the jobs is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Decryption of the jobs is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase40
+ */
+void CryptoTest::testCase40()
+{
+    bool ok = true;
+
+    qDebug() << "Trace of the spans";
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QString traceName = QDir( tree.path() ).filePath( "trace.json" );
+    const QString arg( "dir/\"quoted\\name\"\n.bin" );
+
+    ok = ok && !Tracer::stop() && !Tracer::start( QString() ) && !Tracer::isEnabled();
+
+    // a span which started before the recording is not recorded
+    QScopedPointer<TraceSpan> early( new TraceSpan( "early", "test" ) );
+    ok = ok && Tracer::start( traceName ) && Tracer::isEnabled();
+    early.reset();
+    {
+        TraceSpan outer( "outer", "test", arg );
+        {
+            CRYPTO_TRACE_SPAN( "inner", "test" );
+            QThread::msleep( 2 );
+        }
+    }
+    QtConcurrent::run( []() { CRYPTO_TRACE_SPAN( "worker", "test" ); } ).waitForFinished();
+    ok = ok && Tracer::stop() && !Tracer::isEnabled();
+    {
+        CRYPTO_TRACE_SPAN( "late", "test" );
+    }
+
+    QFile trace( traceName );
+    ok = ok && trace.open( QIODevice::ReadOnly );
+    QJsonParseError error;
+    const QJsonObject root = QJsonDocument::fromJson( trace.readAll(), &error ).object();
+    ok = ok && ( error.error == QJsonParseError::NoError );
+    ok = ok && ( root.value( "displayTimeUnit" ).toString() == "ms" );
+    const QJsonArray events = root.value( "traceEvents" ).toArray();
+    ok = ok && ( events.size() == 4 ) && ( events.at( 0 ).toObject().value( "ph" ).toString() == "M" );
+
+    QHash<QString, QJsonObject> spans;
+    for ( int i = 1; ok && i < events.size(); i++ )
+    {
+        const QJsonObject event = events.at( i ).toObject();
+        ok = ( event.value( "ph" ).toString() == "X" ) && ( event.value( "cat" ).toString() == "test" );
+        ok = ok && ( event.value( "pid" ).toDouble() == QCoreApplication::applicationPid() );
+        ok = ok && ( event.value( "dur" ).toDouble() >= 0.0 );
+        spans.insert( event.value( "name" ).toString(), event );
+    }
+    ok = ok && ( spans.keys().toSet() == QSet<QString>() << "outer" << "inner" << "worker" );
+
+    // the inner span lies within the outer one (in us, rounded to ns), the argument survives the escaping
+    const QJsonObject outer = spans.value( "outer" );
+    const QJsonObject inner = spans.value( "inner" );
+    ok = ok && ( outer.value( "args" ).toObject().value( "file" ).toString() == arg );
+    ok = ok && !inner.contains( "args" );
+    ok = ok && ( inner.value( "dur" ).toDouble() >= 2000.0 );
+    ok = ok && ( inner.value( "ts" ).toDouble() + 0.001 >= outer.value( "ts" ).toDouble() );
+    ok = ok && ( inner.value( "ts" ).toDouble() + inner.value( "dur" ).toDouble()
+                 <= outer.value( "ts" ).toDouble() + outer.value( "dur" ).toDouble() + 0.002 );
+    ok = ok && ( inner.value( "tid" ).toDouble() == outer.value( "tid" ).toDouble() );
+    ok = ok && ( spans.value( "worker" ).value( "tid" ).toDouble() != outer.value( "tid" ).toDouble() );
+
+    QVERIFY2( ok, "Trace is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Trace is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase41
+ */
+void CryptoTest::testCase41()
+{
+    bool ok = true;
+
+    qDebug() << "Run report";
+    QVector<qint64> sample;
+    for ( int i = 1; i <= 100; i++ )
+    {
+        sample.append( i );
+    }
+    ok = ok && ( RunReport::percentile( QVector<qint64>(), 50 ) == 0 );
+    ok = ok && ( RunReport::percentile( sample, 0 ) == 1 ) && ( RunReport::percentile( sample, 50 ) == 50 );
+    ok = ok && ( RunReport::percentile( sample, 99 ) == 99 ) && ( RunReport::percentile( sample, 99.9 ) == 100 );
+    ok = ok && ( RunReport::percentile( sample, 100 ) == 100 );
+
+    RunReport report( "encrypt" );
+    report.setParameter( "method", "aes" );
+    report.start();
+    report.addFile( "a.bin", 1000, 400, RunReport::Success );
+    report.addFile( "b.bin", 3000, 100, RunReport::Success );
+    report.addFile( "c.bin", 500, 300, RunReport::Error );
+    report.addFile( "d.bin", 700, 200, RunReport::Failed );
+    QThread::msleep( 1 );
+    report.finish();
+    ok = ok && ( report.bytes() == 4000 ) && ( report.elapsedNsecs() >= 1000000 );
+
+    QJsonParseError error;
+    const QJsonObject root = QJsonDocument::fromJson( report.toJson(), &error ).object();
+    ok = ok && ( error.error == QJsonParseError::NoError );
+    ok = ok && ( root.value( "operation" ).toString() == "encrypt" );
+    ok = ok && ( root.value( "parameters" ).toObject().value( "method" ).toString() == "aes" );
+    ok = ok && root.contains( "start_utc" ) && root.contains( "peak_memory" );
+
+    const QJsonObject aggregate = root.value( "aggregate" ).toObject();
+    ok = ok && ( aggregate.value( "files" ).toInt() == 4 ) && ( aggregate.value( "succeeded" ).toInt() == 2 );
+    ok = ok && ( aggregate.value( "bytes" ).toDouble() == 5200 ) && ( aggregate.value( "bytes_succeeded" ).toDouble() == 4000 );
+    ok = ok && ( aggregate.value( "duration_ns" ).toDouble() == report.elapsedNsecs() );
+    ok = ok && qFuzzyCompare( aggregate.value( "throughput_mbs" ).toDouble(), report.throughput() );
+
+    // nearest rank of the sorted durations 100, 200, 300, 400
+    const QJsonObject latency = root.value( "latency_ns" ).toObject();
+    ok = ok && ( latency.value( "min" ).toDouble() == 100 ) && ( latency.value( "max" ).toDouble() == 400 );
+    ok = ok && ( latency.value( "p50" ).toDouble() == 200 ) && ( latency.value( "p90" ).toDouble() == 400 );
+    ok = ok && ( latency.value( "p99" ).toDouble() == 400 ) && ( latency.value( "p999" ).toDouble() == 400 );
+
+    const QJsonObject errors = root.value( "errors" ).toObject();
+    ok = ok && ( errors.value( "error" ).toInt() == 1 ) && ( errors.value( "aborted" ).toInt() == 0 );
+    ok = ok && ( errors.value( "failed" ).toInt() == 1 );
+
+    const QJsonArray files = root.value( "files" ).toArray();
+    ok = ok && ( files.size() == 4 );
+    const QJsonObject file = files.at( 1 ).toObject();
+    ok = ok && ( file.value( "path" ).toString() == "b.bin" ) && ( file.value( "size" ).toDouble() == 3000 );
+    ok = ok && ( file.value( "duration_ns" ).toDouble() == 100 ) && ( file.value( "status" ).toString() == "success" );
+    ok = ok && ( files.at( 3 ).toObject().value( "status" ).toString() == "failed" );
+
+    // the written file holds the same report
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QString reportName = QDir( tree.path() ).filePath( "report.json" );
+    ok = ok && report.write( reportName );
+    QFile written( reportName );
+    ok = ok && written.open( QIODevice::ReadOnly );
+    const QJsonObject copy = QJsonDocument::fromJson( written.readAll() ).object();
+    ok = ok && ( copy.value( "aggregate" ) == root.value( "aggregate" ) ) && ( copy.value( "files" ) == root.value( "files" ) );
+
+    QVERIFY2( ok, "Run report is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Run report is wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase42
+ */
+void CryptoTest::testCase42()
+{
+    bool ok = true;
+
+    qDebug() << "Counters of the job monitor";
+    const int kFiles = 16;
+    const qint64 kFileSize = 4096;
+    JobMonitor::begin( kFiles * kFileSize, kFiles );
+    JobSnapshot snap = JobMonitor::snapshot();
+    ok = ok && snap.running && ( snap.bytesTotal == kFiles * kFileSize ) && ( snap.bytesDone == 0 );
+    ok = ok && ( snap.filesTotal == kFiles ) && ( snap.filesDone == 0 ) && ( snap.filesPending == kFiles );
+    ok = ok && ( snap.reading == 0 ) && ( snap.writing == 0 ) && ( snap.workers == 0 );
+
+    // the stages count the lifetime of their guards
+    {
+        JobStage reading( JobMonitor::Reading );
+        JobStage writing( JobMonitor::Writing );
+        JobStage writing2( JobMonitor::Writing );
+        snap = JobMonitor::snapshot();
+        ok = ok && ( snap.reading == 1 ) && ( snap.writing == 2 );
+    }
+    snap = JobMonitor::snapshot();
+    ok = ok && ( snap.reading == 0 ) && ( snap.writing == 0 );
+
+    // the workers update the counters concurrently, all updates are counted
+    QVector<int> files( kFiles );
+    QtConcurrent::blockingMap( files, [&]( int & ) {
+        JobMonitor::workerStarted();
+        JobMonitor::leave( JobMonitor::Pending );
+        for ( qint64 done = 0; done < kFileSize; done += 512 )
+        {
+            {
+                JobStage reading( JobMonitor::Reading );
+            }
+            JobStage writing( JobMonitor::Writing );
+            JobMonitor::addBytes( 512 );
+        }
+        JobMonitor::fileDone();
+        JobMonitor::workerFinished();
+    } );
+    snap = JobMonitor::snapshot();
+    ok = ok && snap.running && ( snap.bytesDone == kFiles * kFileSize );
+    ok = ok && ( snap.filesDone == kFiles ) && ( snap.filesPending == 0 );
+    ok = ok && ( snap.reading == 0 ) && ( snap.writing == 0 ) && ( snap.workers == 0 );
+
+    // the end keeps the totals
+    JobMonitor::begin( 100, 2 );
+    JobMonitor::end();
+    snap = JobMonitor::snapshot();
+    ok = ok && !snap.running && ( snap.filesPending == 0 ) && ( snap.bytesTotal == 100 ) && ( snap.filesTotal == 2 );
+
+    QVERIFY2( ok, "Counters of the job monitor are wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Counters of the job monitor are wrong" );
+}
+
+/**
+ * @brief CryptoTest::testCase43
+ */
+void CryptoTest::testCase43()
+{
+    bool ok = true;
+
+    qDebug() << "Convergence of the buffer tuner";
+    // the sizes are saved in a private settings file
+    QTemporaryDir tree;
+    ok = ok && tree.isValid();
+    const QSettings::Format format = QSettings::defaultFormat();
+    const QString organization = QCoreApplication::organizationName();
+    QSettings::setDefaultFormat( QSettings::IniFormat );
+    QSettings::setPath( QSettings::IniFormat, QSettings::UserScope, tree.path() );
+    QCoreApplication::setOrganizationName( "cryptotest" );
+
+    // throughput in bytes per ns of the simulated storage, the best size is 16 MiB
+    const qint64 kMiB = 1024 * 1024;
+    QMap<qint64, double> rates;
+    rates.insert( kMiB / 4, 0.2 );
+    rates.insert( kMiB / 2, 0.3 );
+    rates.insert( kMiB, 0.4 );
+    rates.insert( 2 * kMiB, 0.5 );
+    rates.insert( 4 * kMiB, 0.6 );
+    rates.insert( 8 * kMiB, 0.8 );
+    rates.insert( 16 * kMiB, 1.0 );
+    rates.insert( 32 * kMiB, 0.9 );
+    rates.insert( 64 * kMiB, 0.7 );
+
+    // the first job starts at 4 MiB and probes the larger sizes
+    BufferTuner tuner( "cryptotest-storage", 64 * kMiB );
+    ok = ok && ( tuner.chunkSize() == 4 * kMiB ) && !tuner.isConverged();
+    for ( int i = 0; ok && i < 100 && !tuner.isConverged(); i++ )
+    {
+        const qint64 size = tuner.chunkSize();
+        ok = rates.contains( size );
+        // the tail of a file is no sample
+        tuner.addSample( size / 3, 1 );
+        tuner.addSample( size, static_cast<qint64>( size / rates.value( size ) ) );
+    }
+    ok = ok && tuner.isConverged() && ( tuner.chunkSize() == 16 * kMiB );
+
+    // the next job starts at the winner, within its budget
+    tuner.save();
+    ok = ok && ( BufferTuner( "cryptotest-storage", 64 * kMiB ).chunkSize() == 16 * kMiB );
+    ok = ok && ( BufferTuner( "cryptotest-storage", 8 * kMiB ).chunkSize() == 8 * kMiB );
+
+    // a failed allocation halves the size, stops the probing and lowers the budget
+    BufferTuner failing( "cryptotest-storage", 64 * kMiB );
+    failing.allocationFailed();
+    ok = ok && failing.isConverged() && ( failing.chunkSize() == 8 * kMiB );
+    failing.addSample( 8 * kMiB, 1 );
+    ok = ok && ( failing.chunkSize() == 8 * kMiB );
+    for ( int i = 0; i < 10; i++ )
+    {
+        failing.allocationFailed();
+    }
+    ok = ok && ( failing.chunkSize() == kMiB / 4 );
+
+    // without a measurement nothing is saved
+    BufferTuner fresh( "cryptotest-other", 64 * kMiB );
+    fresh.allocationFailed();
+    fresh.save();
+    ok = ok && ( BufferTuner( "cryptotest-other", 64 * kMiB ).chunkSize() == 4 * kMiB );
+    QSettings::setDefaultFormat( format );
+    QCoreApplication::setOrganizationName( organization );
+
+    QVERIFY2( ok, "Buffer tuner is wrong" );
+    Q_ASSERT_X( ok, Q_FUNC_INFO, "Buffer tuner is wrong" );
+}
+
 // ----------------------------------------------------------------------
 /**
  * @brief generateRandomData
@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += testlib
+QT       += testlib concurrent
 QT       -= gui
 
 TARGET = cryptotest
@@ -18,16 +18,45 @@ SRCPATH = $$PWD/..
 INCLUDEPATH += $$SRCPATH
 
 SOURCES += cryptotest.cpp \
-    $$SRCPATH/cryptfiledevice.cpp
+    $$SRCPATH/cryptfiledevice.cpp \
+    $$SRCPATH/tracer.cpp \
+    $$SRCPATH/bufferpool.cpp \
+    $$SRCPATH/compressiondevice.cpp \
+    $$SRCPATH/packarchive.cpp \
+    $$SRCPATH/logsink.cpp \
+    $$SRCPATH/treeverifier.cpp \
+    $$SRCPATH/cpufeatures.cpp \
+    $$SRCPATH/backendprobe.cpp \
+    $$SRCPATH/rekeyer.cpp \
+    $$SRCPATH/jobinput.cpp \
+    $$SRCPATH/runreport.cpp \
+    $$SRCPATH/jobmonitor.cpp \
+    $$SRCPATH/buffertuner.cpp
 
 HEADERS  += \
-    $$SRCPATH/cryptfiledevice.h
+    $$SRCPATH/cryptfiledevice.h \
+    $$SRCPATH/tracer.h \
+    $$SRCPATH/bufferpool.h \
+    $$SRCPATH/compressiondevice.h \
+    $$SRCPATH/packarchive.h \
+    $$SRCPATH/logsink.h \
+    $$SRCPATH/treeverifier.h \
+    $$SRCPATH/cpufeatures.h \
+    $$SRCPATH/backendprobe.h \
+    $$SRCPATH/rekeyer.h \
+    $$SRCPATH/jobinput.h \
+    $$SRCPATH/runreport.h \
+    $$SRCPATH/jobmonitor.h \
+    $$SRCPATH/buffertuner.h
 
 #openssl libraly
 win32 {
 INCLUDEPATH += c:/OpenSSL-Win32/include
 LIBS += -Lc:/OpenSSL-Win32/bin -llibeay32
 }
+win32 {
+LIBS += -lpsapi
+}
 linux|macx {
 LIBS += -lcrypto
 QMAKE_LFLAGS += "-Wl,-rpath,\'\$$ORIGIN/lib\'"
@@ -0,0 +1,227 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file throughputpanel.cpp
+ *
+ * @brief This file contains the definition of methods of the ThroughputPanel class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "throughputpanel.h"
+#include <QVBoxLayout>
+#include <QGridLayout>
+#include <QPainter>
+#include <QLabel>
+#include <QTimer>
+#include <QTime>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+#define COEFF 1048576
+/// sampling interval of the JobMonitor, in ms.
+static int const kSampleInterval = 250;
+/// number of samples shown by the graph (one minute).
+static int const kGraphSamples = 240;
+/// weight of the newest sample in the moving average.
+static double const kAverageWeight = 0.1;
+
+/**
+ * @class RateGraph
+ *
+ * @brief The RateGraph class draws a rolling graph of the throughput.
+ */
+class RateGraph : public QWidget
+{
+public:
+    explicit RateGraph( QWidget *parent = 0 ) :
+        QWidget( parent )
+    {
+        this->setMinimumSize( 200, 80 );
+        this->setSizePolicy( QSizePolicy::Expanding, QSizePolicy::Expanding );
+    }
+
+    void addSample( double value )
+    {
+        samples.append( value );
+        if ( samples.size() > kGraphSamples )
+        {
+            samples.remove( 0, samples.size() - kGraphSamples );
+        }
+        this->update();
+    }
+
+    void clear( void )
+    {
+        samples.clear();
+        this->update();
+    }
+
+protected:
+    void paintEvent( QPaintEvent * ) Q_DECL_OVERRIDE
+    {
+        QPainter painter( this );
+        painter.fillRect( this->rect(), this->palette().base() );
+        painter.setPen( this->palette().mid().color() );
+        painter.drawRect( this->rect().adjusted( 0, 0, -1, -1 ) );
+
+        double maxValue = 1.0;
+        foreach ( const double value, samples )
+        {
+            maxValue = qMax( maxValue, value );
+        }
+
+        const int w = this->width() - 2;
+        const int h = this->height() - 2;
+        if ( samples.size() > 1 )
+        {
+            QPolygonF line;
+            const double step = static_cast<double>( w ) / ( kGraphSamples - 1 );
+            const int offset = kGraphSamples - samples.size();
+            for ( int i = 0; i < samples.size(); i++ )
+            {
+                line << QPointF( 1 + ( offset + i ) * step, 1 + h - samples.at( i ) / maxValue * h );
+            }
+            painter.setRenderHint( QPainter::Antialiasing );
+            painter.setPen( QPen( QColor( "blue" ), 1.5 ) );
+            painter.drawPolyline( line );
+        }
+
+        painter.setPen( this->palette().text().color() );
+        painter.drawText( this->rect().adjusted( 4, 2, -4, -2 ), Qt::AlignTop | Qt::AlignLeft,
+                          QObject::tr( "%1 Mb/s" ).arg( maxValue, 0, 'f', 1 ) );
+    }
+
+private:
+    QVector<double> samples;
+};
+
+/**
+ * @brief The constructor of the class ThroughputPanel
+ *
+ * @param parent of the type QWidget*
+ */
+ThroughputPanel::ThroughputPanel( QWidget *parent ) :
+    QWidget( parent ),
+    lastNsecs( 0 ),
+    averageRate( 0.0 ),
+    averageFiles( 0.0 )
+{
+    this->graph = new RateGraph( this );
+    this->rateLabel = new QLabel( this );
+    this->filesLabel = new QLabel( this );
+    this->queueLabel = new QLabel( this );
+    this->workersLabel = new QLabel( this );
+    this->etaLabel = new QLabel( this );
+
+    QGridLayout *grid = new QGridLayout;
+    grid->addWidget( new QLabel( QObject::tr( "Throughput:" ), this ), 0, 0 );
+    grid->addWidget( rateLabel, 0, 1 );
+    grid->addWidget( new QLabel( QObject::tr( "Files:" ), this ), 1, 0 );
+    grid->addWidget( filesLabel, 1, 1 );
+    grid->addWidget( new QLabel( QObject::tr( "Queues:" ), this ), 2, 0 );
+    grid->addWidget( queueLabel, 2, 1 );
+    grid->addWidget( new QLabel( QObject::tr( "Workers:" ), this ), 3, 0 );
+    grid->addWidget( workersLabel, 3, 1 );
+    grid->addWidget( new QLabel( QObject::tr( "ETA:" ), this ), 4, 0 );
+    grid->addWidget( etaLabel, 4, 1 );
+    grid->setColumnStretch( 1, 1 );
+
+    QVBoxLayout *layout = new QVBoxLayout( this );
+    layout->addWidget( graph, 1 );
+    layout->addLayout( grid );
+
+    this->reset();
+
+    this->timer = new QTimer( this );
+    this->timer->setInterval( kSampleInterval );
+    QObject::connect( timer, SIGNAL(timeout()), this, SLOT(sample()) );
+    this->timer->start();
+}
+
+/**
+ * @brief The function resets the averages and the graph for a new job.
+ */
+void ThroughputPanel::reset( void )
+{
+    this->graph->clear();
+    this->last = JobMonitor::snapshot();
+    this->clock.start();
+    this->lastNsecs = 0;
+    this->averageRate = 0.0;
+    this->averageFiles = 0.0;
+    this->rateLabel->setText( QObject::tr( "-" ) );
+    this->filesLabel->setText( QObject::tr( "-" ) );
+    this->queueLabel->setText( QObject::tr( "-" ) );
+    this->workersLabel->setText( QObject::tr( "-" ) );
+    this->etaLabel->setText( QObject::tr( "-" ) );
+}
+
+/**
+ * @brief Slot for sampling the counters of the JobMonitor.
+ *
+ * Computes the throughput since the previous sample, updates the moving averages,
+ * the graph and the labels.
+ */
+void ThroughputPanel::sample( void )
+{
+    const JobSnapshot snap = JobMonitor::snapshot();
+    if ( !snap.running && !last.running )
+    {
+        return;
+    }
+    if ( snap.running && ( !last.running || snap.bytesDone < last.bytesDone ) )
+    {
+        // a new job has been started
+        this->reset();
+        this->last = snap;
+        return;
+    }
+
+    const qint64 nsecs = this->clock.nsecsElapsed();
+    const double seconds = ( nsecs - this->lastNsecs ) / 1e9;
+    if ( seconds <= 0.0 )
+    {
+        return;
+    }
+    const double rate = ( snap.bytesDone - last.bytesDone ) / seconds / COEFF;
+    const double files = ( snap.filesDone - last.filesDone ) / seconds;
+    this->averageRate += kAverageWeight * ( rate - this->averageRate );
+    this->averageFiles += kAverageWeight * ( files - this->averageFiles );
+    this->lastNsecs = nsecs;
+    this->last = snap;
+
+    this->graph->addSample( rate );
+    this->rateLabel->setText( QObject::tr( "%1 Mb/s (average %2 Mb/s)" )
+                              .arg( rate, 0, 'f', 1 ).arg( this->averageRate, 0, 'f', 1 ) );
+    this->filesLabel->setText( QObject::tr( "%1 of %2, %3 files/s" )
+                               .arg( snap.filesDone ).arg( snap.filesTotal ).arg( this->averageFiles, 0, 'f', 1 ) );
+    this->queueLabel->setText( QObject::tr( "pending %1, reading %2, encrypting %3" )
+                               .arg( snap.filesPending ).arg( snap.reading ).arg( snap.writing ) );
+    this->workersLabel->setText( QString::number( snap.workers ) );
+
+    if ( !snap.running )
+    {
+        this->etaLabel->setText( QObject::tr( "finished" ) );
+    }
+    else if ( this->averageRate > 0.0 )
+    {
+        const double remaining = static_cast<double>( qMax( snap.bytesTotal - snap.bytesDone, 0LL ) ) / COEFF;
+        const int etaMsecs = static_cast<int>( qMin( remaining / this->averageRate * 1000.0, 86399999.0 ) );
+        this->etaLabel->setText( QTime::fromMSecsSinceStartOfDay( etaMsecs ).toString( "hh:mm:ss" ) );
+    }
+    else
+    {
+        this->etaLabel->setText( QObject::tr( "stalled" ) );
+    }
+}
@@ -0,0 +1,72 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file throughputpanel.h
+ *
+ * @brief This file contains the declaration of the class ThroughputPanel
+ */
+#ifndef THROUGHPUTPANEL_H
+#define THROUGHPUTPANEL_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QVector>
+#include "jobmonitor.h"
+
+class QLabel;
+class QTimer;
+class RateGraph;
+
+/**
+ * @class ThroughputPanel
+ *
+ * @brief The ThroughputPanel class shows the live throughput of the running job.
+ *
+ * The panel samples the counters of the JobMonitor on a timer and shows
+ * - a rolling graph of the throughput in Mb/s,
+ * - the number of processed files per second,
+ * - the queue depths of the stages (pending files, reads, encryptions) and the active workers,
+ * - the estimated time of arrival, computed from a moving average of the throughput.
+ * .
+ * MainWindow places the panel in a dockable window.
+ */
+class ThroughputPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ThroughputPanel( QWidget *parent = 0 );
+
+private slots:
+    void sample( void );
+
+private:
+    QTimer *timer;
+    RateGraph *graph;
+    QLabel *rateLabel;
+    QLabel *filesLabel;
+    QLabel *queueLabel;
+    QLabel *workersLabel;
+    QLabel *etaLabel;
+
+    QElapsedTimer clock;
+    JobSnapshot last;
+    qint64 lastNsecs;
+    double averageRate;
+    double averageFiles;
+
+    void reset( void );
+};
+
+#endif // THROUGHPUTPANEL_H
@@ -0,0 +1,217 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file tracer.cpp
+ *
+ * @brief This file contains the definition of methods of the Tracer class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <QVector>
+#include <QThread>
+#include <QMutex>
+#include <QFile>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logTracer, "Tracer")
+/// upper limit of the recorded events, further events are dropped.
+static int const kMaxEvents = 4000000;
+
+/**
+ * @struct TraceEvent
+ *
+ * @brief The TraceEvent structure holds one complete event of the timeline.
+ */
+struct TraceEvent
+{
+    const char *name;
+    const char *category;
+    quint64 threadId;
+    qint64 start;
+    qint64 duration;
+    QString arg;
+};
+Q_DECLARE_TYPEINFO( TraceEvent, Q_MOVABLE_TYPE );
+
+QAtomicInt Tracer::s_enabled( 0 );
+static QMutex s_mutex;
+static QElapsedTimer s_clock;
+static QString s_fileName;
+static QVector<TraceEvent> s_events;
+static qint64 s_dropped = 0;
+
+//------------------------------------------------------------------------------
+// Function Prototypes
+//------------------------------------------------------------------------------
+static QString jsonEscape( const QString &str );
+
+/**
+ * @brief Tracer::start
+ *
+ * Starts the recording of a new timeline. The events of a previous recording,
+ * which has not been stopped, are discarded.
+ *
+ * @param fileName of the type QString &, path to the JSON file written by Tracer::stop
+ * @retval true if the recording was started,
+ * @retval false if the file name is empty.
+ */
+bool Tracer::start( const QString &fileName )
+{
+    if ( fileName.isEmpty() )
+    {
+        return false;
+    }
+
+    QMutexLocker locker( &s_mutex );
+    s_fileName = fileName;
+    s_events.clear();
+    s_events.reserve( 4096 );
+    s_dropped = 0;
+    s_clock.start();
+    s_enabled.store( 1 );
+
+    return true;
+}
+
+/**
+ * @brief Tracer::stop
+ *
+ * Stops the recording and writes the timeline to the file given to Tracer::start.
+ *
+ * @retval true if the file was written,
+ * @retval false if the tracer was not started or the file cannot be written.
+ */
+bool Tracer::stop( void )
+{
+    if ( !s_enabled.testAndSetOrdered( 1, 0 ) )
+    {
+        return false;
+    }
+
+    QMutexLocker locker( &s_mutex );
+    QFile file( s_fileName );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+    {
+        qCritical(logTracer) << QObject::tr( "Cannot write the trace file: %1" ).arg( s_fileName );
+        s_events.clear();
+        return false;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QTextStream out( &file );
+    out.setCodec( "UTF-8" );
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"args\":{\"name\":\"" << jsonEscape( QCoreApplication::applicationName() ) << "\"}}";
+    foreach ( const TraceEvent &event, s_events )
+    {
+        out << ",\n{\"name\":\"" << event.name
+            << "\",\"cat\":\"" << event.category
+            << "\",\"ph\":\"X\",\"pid\":" << pid
+            << ",\"tid\":" << event.threadId
+            << ",\"ts\":" << QString::number( event.start / 1000.0, 'f', 3 )
+            << ",\"dur\":" << QString::number( event.duration / 1000.0, 'f', 3 );
+        if ( !event.arg.isEmpty() )
+        {
+            out << ",\"args\":{\"file\":\"" << jsonEscape( event.arg ) << "\"}";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+    out.flush();
+    file.close();
+
+    qInfo(logTracer) << QObject::tr( "Trace with %1 events written to %2, %3 events dropped" )
+                        .arg( s_events.size() ).arg( s_fileName ).arg( s_dropped );
+    s_events.clear();
+    s_events.squeeze();
+
+    return file.error() == QFileDevice::NoError;
+}
+
+/**
+ * @brief Tracer::timestamp
+ *
+ * @return monotonic time since Tracer::start, in ns.
+ */
+qint64 Tracer::timestamp( void )
+{
+    return s_clock.nsecsElapsed();
+}
+
+/**
+ * @brief Tracer::addEvent
+ *
+ * Adds a complete event of the calling thread to the timeline.
+ *
+ * @param name of the type char*, name of the span (string literal)
+ * @param category of the type char*, category of the span (string literal)
+ * @param startNsecs of the type qint64, start time, see Tracer::timestamp
+ * @param durationNsecs of the type qint64, duration of the span in ns
+ * @param arg of the type QString &, file name argument, may be empty
+ */
+void Tracer::addEvent( const char *name, const char *category,
+                       qint64 startNsecs, qint64 durationNsecs,
+                       const QString &arg )
+{
+    TraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.threadId = reinterpret_cast<quintptr>( QThread::currentThreadId() );
+    event.start = startNsecs;
+    event.duration = durationNsecs;
+    event.arg = arg;
+
+    QMutexLocker locker( &s_mutex );
+    if ( s_events.size() >= kMaxEvents )
+    {
+        s_dropped++;
+        return;
+    }
+    s_events.append( event );
+}
+
+/**
+ * @brief The function escapes a string for a JSON string literal.
+ *
+ * @param str of the type QString &
+ * @return the escaped string
+ */
+static QString jsonEscape( const QString &str )
+{
+    QString result;
+    result.reserve( str.size() + 8 );
+    foreach ( const QChar &c, str )
+    {
+        if ( c == QLatin1Char( '"' ) || c == QLatin1Char( '\\' ) )
+        {
+            result.append( QLatin1Char( '\\' ) ).append( c );
+        }
+        else if ( c.unicode() < 0x20 )
+        {
+            result.append( QString( "\\u%1" ).arg( c.unicode(), 4, 16, QLatin1Char( '0' ) ) );
+        }
+        else
+        {
+            result.append( c );
+        }
+    }
+    return result;
+}
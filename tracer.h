@@ -0,0 +1,111 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file tracer.h
+ *
+ * @brief This file contains the declaration of the classes Tracer and TraceSpan
+ */
+#ifndef TRACER_H
+#define TRACER_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <QString>
+#include <QAtomicInt>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/// declares a TraceSpan with a unique name, which records the rest of the current scope.
+#define CRYPTO_TRACE_CAT_( a, b ) a##b
+#define CRYPTO_TRACE_CAT( a, b ) CRYPTO_TRACE_CAT_( a, b )
+#define CRYPTO_TRACE_SPAN( ... ) TraceSpan CRYPTO_TRACE_CAT( traceSpan, __LINE__ )( __VA_ARGS__ )
+
+/**
+ * @class Tracer
+ *
+ * @brief The Tracer class records a timeline of the program in the Chrome trace-event format.
+ *
+ * The tracer is opt-in: as long as Tracer::start has not been called, a TraceSpan costs
+ * one atomic load. While enabled, every TraceSpan adds a complete event ("ph":"X") with
+ * the name, category, thread id, start time, duration and an optional file name argument.
+ * Tracer::stop writes all events as a JSON file, which can be opened in chrome://tracing
+ * or in the Perfetto UI (https://ui.perfetto.dev).
+ *
+ * @note All functions in this class are thread-safe.
+ */
+class Tracer
+{
+public:
+    static bool start( const QString &fileName );
+    static bool stop( void );
+
+    static bool isEnabled( void )
+    {
+        return s_enabled.load() != 0;
+    }
+
+    static qint64 timestamp( void );
+    static void addEvent( const char *name, const char *category,
+                          qint64 startNsecs, qint64 durationNsecs,
+                          const QString &arg );
+
+private:
+    static QAtomicInt s_enabled;
+};
+
+/**
+ * @class TraceSpan
+ *
+ * @brief The TraceSpan class records its own lifetime as a complete event of the Tracer.
+ *
+ * @code
+ * {
+ *     CRYPTO_TRACE_SPAN( "read", "io", fileName );
+ *     file.read( buffer, size );
+ * }
+ * @endcode
+ *
+ * @note name and category must be string literals, they are stored as pointers.
+ */
+class TraceSpan
+{
+public:
+    TraceSpan( const char *name, const char *category, const QString &arg = QString() ) :
+        m_name( name ),
+        m_category( category ),
+        m_start( Tracer::isEnabled() ? Tracer::timestamp() : -1 )
+    {
+        if ( m_start >= 0 )
+        {
+            m_arg = arg;
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if ( m_start >= 0 && Tracer::isEnabled() )
+        {
+            Tracer::addEvent( m_name, m_category, m_start, Tracer::timestamp() - m_start, m_arg );
+        }
+    }
+
+private:
+    Q_DISABLE_COPY( TraceSpan )
+
+    const char *m_name;
+    const char *m_category;
+    qint64 m_start;
+    QString m_arg;
+};
+
+#endif // TRACER_H
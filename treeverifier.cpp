@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file treeverifier.cpp
+ *
+ * @brief This file contains the definition of methods of the TreeVerifier class.
+ */
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "treeverifier.h"
+#include "compressiondevice.h"
+#include "bufferpool.h"
+#include "tracer.h"
+#include <QtConcurrent>
+#include <QMessageAuthenticationCode>
+#include <QElapsedTimer>
+#include <QDirIterator>
+#include <QSet>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QLoggingCategory>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+Q_LOGGING_CATEGORY(logTreeVerifier, "Verify")
+/// default size of the chunks, in which a file is decrypted, in bytes.
+static qint64 const kDefaultChunkSize = 1024 * 1024;
+/// length of a HMAC-SHA256 digest, hex encoded.
+static int const kDigestLength = 64;
+
+const char *const TreeVerifier::kManifestName = "crypto.hmac";
+
+/**
+ * @struct VerifyTask
+ *
+ * @brief The VerifyTask structure is the functor of QtConcurrent::mapped.
+ */
+struct VerifyTask
+{
+    typedef VerifyResult result_type;
+
+    explicit VerifyTask( const TreeVerifier *verifier ) :
+        m_verifier( verifier )
+    {
+    }
+
+    VerifyResult operator()( const QString &fileName ) const
+    {
+        return m_verifier->verifyFile( fileName );
+    }
+
+    const TreeVerifier *m_verifier;
+};
+
+/**
+ * @brief The constructor of the class TreeVerifier
+ *
+ * @param password of the type QByteArray &, the password of the encrypted files
+ * @param salt of the type QByteArray &, the salt of the encrypted files
+ * @param method of the type CryptFileDevice::EncryptionMethod
+ */
+TreeVerifier::TreeVerifier( const QByteArray &password,
+                            const QByteArray &salt,
+                            CryptFileDevice::EncryptionMethod method ) :
+    m_password( password ),
+    m_salt( salt ),
+    m_method( method ),
+    m_chunkSize( kDefaultChunkSize )
+{
+}
+
+/**
+ * @brief set-function for the chunkSize
+ * @param chunkSize of the type qint64, size of the buffer of every task, in bytes
+ */
+void TreeVerifier::setChunkSize( qint64 chunkSize )
+{
+    m_chunkSize = qMax( Q_INT64_C( 4096 ), chunkSize );
+}
+
+/**
+ * @brief get-function for the chunkSize
+ * @return chunkSize of the type qint64
+ */
+qint64 TreeVerifier::chunkSize( void ) const
+{
+    return m_chunkSize;
+}
+
+/**
+ * @brief TreeVerifier::start
+ *
+ * Reads the manifests of the files and starts the verification in the global thread pool.
+ * The progress of the returned future counts the verified files.
+ *
+ * @param files of the type QStringList &, paths to the encrypted files
+ * @return future of the results, in the order of files
+ */
+QFuture<VerifyResult> TreeVerifier::start( const QStringList &files )
+{
+    this->loadDigests( files );
+    return QtConcurrent::mapped( files, VerifyTask( this ) );
+}
+
+/**
+ * @brief TreeVerifier::verify
+ *
+ * Verifies the files and waits for the results.
+ *
+ * @param files of the type QStringList &, paths to the encrypted files
+ * @return results, in the order of files
+ */
+QList<VerifyResult> TreeVerifier::verify( const QStringList &files )
+{
+    QFuture<VerifyResult> future = this->start( files );
+    future.waitForFinished();
+    return future.results();
+}
+
+/**
+ * @brief TreeVerifier::verifyFile
+ *
+ * Decrypts a file into a pooled buffer, computes the HMAC-SHA256 of the plain data with
+ * the key of the digests (CryptFileDevice::digestKey) and compares it with the manifest. A file without a digest is only checked if it is authenticated
+ * (CryptFileDevice::verify), other files without a digest are not decrypted.
+ *
+ * @param fileName of the type QString &, path to the encrypted file
+ * @return result of the verification
+ */
+VerifyResult TreeVerifier::verifyFile( const QString &fileName ) const
+{
+    CRYPTO_TRACE_SPAN( "verify", "file", fileName );
+    QElapsedTimer timer;
+    timer.start();
+
+    VerifyResult result;
+    result.fileName = fileName;
+    result.expected = m_digests.value( QFileInfo( fileName ).absoluteFilePath() );
+
+    CryptFileDevice device( fileName, m_password, m_salt );
+    device.setEncryptionMethod( m_method );
+    if ( result.expected.isEmpty() )
+    {
+        // the tags of an authenticated file stand in for the digest
+        result.status = VerifyResult::NoDigest;
+        if ( device.open( QIODevice::ReadOnly ) && device.isAuthenticated() )
+        {
+            result.size = device.size();
+            result.status = device.verify() ? VerifyResult::Ok : VerifyResult::Unreadable;
+            result.errorString = ( result.status == VerifyResult::Ok ) ? QString() : device.errorString();
+        }
+        result.durationNsecs = timer.nsecsElapsed();
+        return result;
+    }
+
+    if ( !device.open( QIODevice::ReadOnly ) )
+    {
+        result.errorString = QObject::tr( "Cannot decrypt the file" );
+        result.durationNsecs = timer.nsecsElapsed();
+        return result;
+    }
+
+    QIODevice *input = &device;
+    QScopedPointer<CompressionDevice> compression;
+    if ( CompressionDevice::isCompressed( &device ) )
+    {
+        compression.reset( new CompressionDevice( &device ) );
+        if ( !compression->open( QIODevice::ReadOnly ) )
+        {
+            result.errorString = compression->errorString();
+            result.durationNsecs = timer.nsecsElapsed();
+            return result;
+        }
+        input = compression.data();
+    }
+
+    PooledBuffer chunk = BufferPool::instance().acquire( m_chunkSize );
+    if ( chunk.isNull() )
+    {
+        result.errorString = QObject::tr( "Not enough memory" );
+        result.durationNsecs = timer.nsecsElapsed();
+        return result;
+    }
+
+    QMessageAuthenticationCode hash( QCryptographicHash::Sha256, device.digestKey() );
+    forever
+    {
+        const qint64 read = input->read( chunk.data(), m_chunkSize );
+        if ( read < 0 )
+        {
+            result.errorString = input->errorString();
+            result.durationNsecs = timer.nsecsElapsed();
+            return result;
+        }
+        if ( read == 0 )
+        {
+            break;
+        }
+        hash.addData( chunk.data(), static_cast<int>( read ) );
+        result.size += read;
+    }
+
+    result.actual = hash.result().toHex();
+    result.status = ( result.actual == result.expected ) ? VerifyResult::Ok : VerifyResult::Mismatch;
+    result.durationNsecs = timer.nsecsElapsed();
+    return result;
+}
+
+/**
+ * @brief TreeVerifier::collectFiles
+ *
+ * Expands the paths to a list of files. Directories are listed (recursively, if selected),
+ * the manifests are skipped.
+ *
+ * @param paths of the type QStringList &, files and directories
+ * @param recurse of the type bool, includes the subdirectories
+ * @return absolute paths to the files
+ */
+QStringList TreeVerifier::collectFiles( const QStringList &paths, bool recurse )
+{
+    QStringList files;
+    foreach ( const QString &path, paths )
+    {
+        const QFileInfo info( path );
+        if ( info.isFile() )
+        {
+            files.append( info.absoluteFilePath() );
+            continue;
+        }
+        if ( !info.isDir() )
+        {
+            continue;
+        }
+        QDirIterator it( info.absoluteFilePath(),
+                         QDir::Files | QDir::Hidden | QDir::System,
+                         recurse ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags );
+        while ( it.hasNext() )
+        {
+            it.next();
+            if ( it.fileName() != QLatin1String( kManifestName ) )
+            {
+                files.append( it.filePath() );
+            }
+        }
+    }
+
+    return files;
+}
+
+/**
+ * @brief TreeVerifier::readManifest
+ *
+ * Reads the manifest of a directory. Lines which are not in the format of sha256sum are skipped.
+ *
+ * @param dirPath of the type QString &, path to the directory
+ * @return name of a file -> digest, hex encoded
+ */
+QHash<QString, QByteArray> TreeVerifier::readManifest( const QString &dirPath )
+{
+    QHash<QString, QByteArray> digests;
+    QFile manifest( QDir( dirPath ).filePath( kManifestName ) );
+    if ( !manifest.open( QIODevice::ReadOnly | QIODevice::Text ) )
+    {
+        return digests;
+    }
+
+    while ( !manifest.atEnd() )
+    {
+        const QByteArray line = manifest.readLine().trimmed();
+        // "<digest>  <name>", '*' instead of the second space marks the binary mode of sha256sum
+        if ( line.size() < kDigestLength + 3 || line.at( kDigestLength ) != ' ' )
+        {
+            continue;
+        }
+        const QByteArray digest = line.left( kDigestLength ).toLower();
+        const QString name = QString::fromUtf8( line.mid( kDigestLength + 2 ) );
+        digests.insert( name, digest );
+    }
+
+    return digests;
+}
+
+/**
+ * @brief TreeVerifier::updateManifest
+ *
+ * Merges digests into the manifest of a directory: new names are added, existing ones are replaced,
+ * an empty digest removes the name. The manifest is replaced atomically; it is removed if it
+ * becomes empty.
+ *
+ * @param dirPath of the type QString &, path to the directory
+ * @param digests of the type QHash &, name of a file -> digest, hex encoded
+ * @retval true if the manifest was written,
+ * @retval false otherwise.
+ */
+bool TreeVerifier::updateManifest( const QString &dirPath, const QHash<QString, QByteArray> &digests )
+{
+    QHash<QString, QByteArray> manifest = readManifest( dirPath );
+    for ( QHash<QString, QByteArray>::const_iterator it = digests.constBegin(); it != digests.constEnd(); ++it )
+    {
+        if ( it.value().isEmpty() )
+        {
+            manifest.remove( it.key() );
+        }
+        else
+        {
+            manifest.insert( it.key(), it.value() );
+        }
+    }
+
+    const QString fileName = QDir( dirPath ).filePath( kManifestName );
+    if ( manifest.isEmpty() )
+    {
+        return !QFile::exists( fileName ) || QFile::remove( fileName );
+    }
+
+    QStringList names = manifest.keys();
+    names.sort();
+    QByteArray text;
+    foreach ( const QString &name, names )
+    {
+        text += manifest.value( name ) + "  " + name.toUtf8() + '\n';
+    }
+
+    QSaveFile file( fileName );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Text ) || file.write( text ) != text.size() || !file.commit() )
+    {
+        qWarning(logTreeVerifier) << QObject::tr( "Cannot write the manifest: %1" ).arg( fileName );
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief TreeVerifier::loadDigests
+ *
+ * Reads the manifest of every directory, which contains one of the files.
+ *
+ * @param files of the type QStringList &
+ */
+void TreeVerifier::loadDigests( const QStringList &files )
+{
+    m_digests.clear();
+    QSet<QString> dirs;
+    foreach ( const QString &fileName, files )
+    {
+        const QFileInfo info( fileName );
+        const QString dirPath = info.absolutePath();
+        if ( dirs.contains( dirPath ) )
+        {
+            continue;
+        }
+        dirs.insert( dirPath );
+
+        const QHash<QString, QByteArray> digests = readManifest( dirPath );
+        for ( QHash<QString, QByteArray>::const_iterator it = digests.constBegin(); it != digests.constEnd(); ++it )
+        {
+            m_digests.insert( QDir( dirPath ).filePath( it.key() ), it.value() );
+        }
+    }
+    qInfo(logTreeVerifier) << QObject::tr( "Loaded %1 digests of %2 directories" ).arg( m_digests.size() ).arg( dirs.size() );
+}
@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+//  Home Office
+//  Nürnberg, Germany
+//  E-Mail: sergej1@email.ua
+//
+//  Copyright (C) 2017/2018 free Project Crypto. All rights reserved.
+//------------------------------------------------------------------------------
+//  Project: Crypto - Advanced File Encryptor, based on simple XOR and
+//           reliable AES methods
+//------------------------------------------------------------------------------
+/**
+ * @file treeverifier.h
+ *
+ * @brief This file contains the declaration of the class TreeVerifier
+ */
+#ifndef TREEVERIFIER_H
+#define TREEVERIFIER_H
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "cryptfiledevice.h"
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QFuture>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+/**
+ * @struct VerifyResult
+ *
+ * @brief The VerifyResult structure contains the outcome of the verification of one file.
+ */
+struct VerifyResult
+{
+    /// Outcome of the verification.
+    enum Status
+    {
+        Ok,         ///< the decrypted data matches the stored digest, or all chunks of an authenticated file are intact
+        Mismatch,   ///< the decrypted data does not match the stored digest
+        NoDigest,   ///< the manifest contains no digest of the file, which is not authenticated
+        Unreadable  ///< the file cannot be opened or decrypted
+    };
+
+    //! Path to the encrypted file.
+    QString fileName;
+    //! Outcome of the verification.
+    Status status = Unreadable;
+    //! Digest from the manifest, hex encoded.
+    QByteArray expected;
+    //! Digest of the decrypted data, hex encoded.
+    QByteArray actual;
+    //! Number of the decrypted bytes.
+    qint64 size = 0;
+    //! Time of the verification, in ns.
+    qint64 durationNsecs = 0;
+    //! Reason, if the file is unreadable.
+    QString errorString;
+};
+
+/**
+ * @class TreeVerifier
+ *
+ * @brief The TreeVerifier class checks that encrypted files decrypt to their original content.
+ *
+ * Every directory may contain a manifest (TreeVerifier::kManifestName) in the format of sha256sum:
+ * one line per file with the HMAC-SHA256 of the plain data, hex encoded, two spaces
+ * and the name of the encrypted file. The key is derived from the password (CryptFileDevice::digestKey),
+ * so the manifest does not reveal the plain data (a digest of known content) to a reader without it.
+ * The verifier decrypts each file through a CryptFileDevice (and a CompressionDevice,
+ * if the stream is compressed) into a pooled buffer and compares the HMAC of the plain data with the manifest. Nothing is written to the disk.
+ * Files in the authenticated format (CryptFileDevice::AesGcmCipher) are also checked without a digest:
+ * the tags of all chunks are verified.
+ *
+ * The files are verified in parallel (QtConcurrent, one file per task), every task uses its
+ * own CryptFileDevice.
+ *
+ * @code
+ * TreeVerifier verifier( password, salt, CryptFileDevice::AesCipher );
+ * QList<VerifyResult> results = verifier.verify( TreeVerifier::collectFiles( paths, true ) );
+ * @endcode
+ *
+ * @note The verifier must outlive the QFuture returned by TreeVerifier::start.
+ */
+class TreeVerifier
+{
+public:
+    TreeVerifier( const QByteArray &password,
+                  const QByteArray &salt,
+                  CryptFileDevice::EncryptionMethod method );
+
+    void setChunkSize( qint64 chunkSize );
+    qint64 chunkSize( void ) const;
+
+    QFuture<VerifyResult> start( const QStringList &files );
+    QList<VerifyResult> verify( const QStringList &files );
+    VerifyResult verifyFile( const QString &fileName ) const;
+
+    static QStringList collectFiles( const QStringList &paths, bool recurse );
+    static QHash<QString, QByteArray> readManifest( const QString &dirPath );
+    static bool updateManifest( const QString &dirPath, const QHash<QString, QByteArray> &digests );
+
+    /// name of the manifest file in every directory.
+    static const char *const kManifestName;
+
+private:
+    void loadDigests( const QStringList &files );
+
+    QByteArray m_password;
+    QByteArray m_salt;
+    CryptFileDevice::EncryptionMethod m_method;
+    qint64 m_chunkSize;
+    /// absolute path of a file -> expected digest, read-only while a verification runs
+    QHash<QString, QByteArray> m_digests;
+};
+
+#endif // TREEVERIFIER_H